@@ -0,0 +1,177 @@
+#include <functional>
+
+#include "VulkanExample.hpp"
+
+#define BENCHMARK_OUTPUT "benchmark.json"
+
+struct Options {
+  bool headless;
+  bool allScenes;
+  BenchmarkConfig config;
+  uint32_t startupIterations;
+  const char *outputPath;
+};
+
+static Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  options.headless = false;
+  options.allScenes = true;
+  options.startupIterations = 0;
+  options.outputPath = BENCHMARK_OUTPUT;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      options.headless = true;
+    } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+      options.allScenes = strcmp(argv[++i], "all") == 0;
+      if (!options.allScenes &&
+          !VulkanBenchmark::parseScene(argv[i], options.config.scene))
+        VulkanTools::exitOnError("Unknown benchmark scene");
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      options.config.frameCount = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      options.config.warmupFrames = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+      options.config.drawCount = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--alpha-test") == 0) {
+      options.config.alphaTest = true;
+    } else if (strcmp(argv[i], "--upload-mb") == 0 && i + 1 < argc) {
+      options.config.uploadBytes =
+          (VkDeviceSize)strtoul(argv[++i], NULL, 10) * 1024 * 1024;
+    } else if (strcmp(argv[i], "--barriers") == 0 && i + 1 < argc) {
+      options.config.barrierCount = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--recreate-interval") == 0 && i + 1 < argc) {
+      options.config.recreateInterval = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--startup") == 0 && i + 1 < argc) {
+      options.startupIterations = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      options.outputPath = argv[++i];
+    }
+  }
+
+  return options;
+}
+
+typedef std::function<void(VulkanExample &ve)> WindowFactory;
+
+// Each scene gets a fresh device, so one scene's allocations and pipeline
+// state don't carry over into the next one's numbers.
+static BenchmarkResult runScene(const Options &options, BenchmarkScene scene,
+                                const WindowFactory &createWindow) {
+  BenchmarkConfig config = options.config;
+  config.scene = scene;
+
+  VulkanBenchmark benchmark;
+  benchmark.configure(config);
+  {
+    VulkanExample ve(FRAMES_IN_FLIGHT, options.headless);
+    ve.setBenchmark(&benchmark);
+    if (options.headless) {
+      ve.initOffscreen();
+      ve.renderOffscreen(benchmark.totalFrames());
+    } else {
+      createWindow(ve);
+      ve.initSwapchain();
+      ve.renderLoop();
+    }
+  }
+
+  return benchmark.finish();
+}
+
+// One startup up to its first presented frame, with the caches as given.
+static StartupTimes runStartup(const Options &options, bool pipelineCache,
+                               const WindowFactory &createWindow) {
+  BenchmarkConfig config;
+  config.scene = SCENE_EMPTY;
+  config.frameCount = 1;
+  config.warmupFrames = 0;
+
+  VulkanBenchmark benchmark;
+  benchmark.configure(config);
+  VulkanExample ve(FRAMES_IN_FLIGHT, options.headless);
+  ve.setBenchmark(&benchmark);
+  ve.setPipelineCache(pipelineCache);
+  if (options.headless) {
+    ve.initOffscreen();
+    ve.renderOffscreen(benchmark.totalFrames());
+  } else {
+    createWindow(ve);
+    ve.initSwapchain();
+    ve.renderLoop();
+  }
+
+  return ve.startupTimes();
+}
+
+// Every combination of the enumeration and pipeline caches. A startup that
+// isn't timed goes first, so the pipeline cache file exists and the loader
+// and driver have loaded once, as they would have for a relaunched process.
+static void runStartups(const Options &options,
+                        const WindowFactory &createWindow,
+                        std::vector<StartupResult> &results) {
+  for (uint32_t i = 0; i < 4; i++) {
+    bool enumerationCache = (i & 1) == 0;
+    bool pipelineCache = (i & 2) == 0;
+    VulkanDevice::setEnumerationCache(enumerationCache);
+    runStartup(options, pipelineCache, createWindow);
+
+    std::vector<StartupTimes> samples;
+    for (uint32_t j = 0; j < options.startupIterations; j++)
+      samples.push_back(runStartup(options, pipelineCache, createWindow));
+
+    StartupResult result = VulkanBenchmark::summarizeStartup(samples);
+    result.mode = options.headless ? "headless" : "windowed";
+    result.enumerationCache = enumerationCache;
+    result.pipelineCache = pipelineCache;
+    results.push_back(result);
+
+    fprintf(stdout,
+            "Startup:        %.2f ms p50, enumeration cache %s, "
+            "pipeline cache %s\n",
+            result.phases[STARTUP_TOTAL].p50, enumerationCache ? "on" : "off",
+            pipelineCache ? "on" : "off");
+  }
+  VulkanDevice::setEnumerationCache(true);
+}
+
+static int runBenchmarks(const Options &options,
+                         const WindowFactory &createWindow) {
+  std::vector<BenchmarkResult> results;
+  std::vector<StartupResult> startup;
+  if (options.startupIterations > 0) {
+    runStartups(options, createWindow, startup);
+  } else {
+    for (uint32_t i = 0; i < SCENE_COUNT; i++) {
+      BenchmarkScene scene = (BenchmarkScene)i;
+      if (!options.allScenes && scene != options.config.scene) continue;
+      results.push_back(runScene(options, scene, createWindow));
+    }
+  }
+
+  FILE *file = fopen(options.outputPath, "w");
+  if (!file) {
+    fprintf(stderr, "Could not write %s\n", options.outputPath);
+    return 1;
+  }
+  VulkanBenchmark::writeJson(file, results, startup);
+  fclose(file);
+
+  fprintf(stdout, "Results:        %s\n", options.outputPath);
+  return 0;
+}
+
+#if defined(_WIN32)
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
+                   LPSTR lpCmdLine, int nCmdShow) {
+  return runBenchmarks(parseOptions(__argc, __argv),
+                       [hInstance](VulkanExample &ve) {
+                         ve.createWindow(hInstance);
+                       });
+}
+#elif defined(__linux__)
+int main(int argc, char *argv[]) {
+  return runBenchmarks(parseOptions(argc, argv),
+                       [](VulkanExample &ve) { ve.createWindow(); });
+}
+#endif
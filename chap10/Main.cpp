@@ -1,17 +1,92 @@
 #include "VulkanExample.hpp"
 
+struct Options {
+  bool headless;
+  bool bindless;
+  bool staticRecording;
+  bool justInTime;
+  uint32_t latency;
+  uint32_t windowCount;
+  uint32_t frameCount;
+  const char *readbackPath;
+  const char *deviceGroup;
+};
+
+static Options parseOptions(int argc, char *argv[]) {
+  Options options = {false, false, false, false, 0, 1, HEADLESS_FRAME_COUNT,
+                     NULL, NULL};
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0)
+      options.headless = true;
+    else if (strcmp(argv[i], "--bindless") == 0)
+      options.bindless = true;
+    else if (strcmp(argv[i], "--static") == 0)
+      options.staticRecording = true;
+    else if (strcmp(argv[i], "--just-in-time") == 0)
+      options.justInTime = true;
+    else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+      options.latency = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc)
+      options.windowCount = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      options.frameCount = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--readback") == 0 && i + 1 < argc)
+      options.readbackPath = argv[++i];
+    else if (strcmp(argv[i], "--device-group") == 0 && i + 1 < argc)
+      options.deviceGroup = argv[++i];
+  }
+
+  return options;
+}
+
+static void runHeadless(const Options &options) {
+  VulkanExample ve(FRAMES_IN_FLIGHT, true);
+  ve.setReadbackPath(options.readbackPath);
+  ve.setBindless(options.bindless);
+  ve.setStaticRecording(options.staticRecording);
+  ve.setLatency(options.latency, options.justInTime);
+  if (options.deviceGroup)
+    ve.setDeviceGroup(VulkanDeviceGroup::parseMode(options.deviceGroup));
+  ve.initOffscreen();
+  ve.renderOffscreen(options.frameCount);
+}
+
 #if defined(_WIN32)
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
                    LPSTR lpCmdLine, int nCmdShow) {
-  VulkanExample ve = VulkanExample();
-  ve.createWindow(hInstance);
+  Options options = parseOptions(__argc, __argv);
+  if (options.headless) {
+    runHeadless(options);
+    return 0;
+  }
+
+  VulkanExample ve;
+  ve.setBindless(options.bindless);
+  ve.setStaticRecording(options.staticRecording);
+  ve.setLatency(options.latency, options.justInTime);
+  if (options.deviceGroup)
+    ve.setDeviceGroup(VulkanDeviceGroup::parseMode(options.deviceGroup));
+  for (uint32_t i = 0; i < options.windowCount; i++)
+    ve.createWindow(hInstance);
   ve.initSwapchain();
   ve.renderLoop();
 }
 #elif defined(__linux__)
 int main(int argc, char *argv[]) {
-  VulkanExample ve = VulkanExample();
-  ve.createWindow();
+  Options options = parseOptions(argc, argv);
+  if (options.headless) {
+    runHeadless(options);
+    return 0;
+  }
+
+  VulkanExample ve;
+  ve.setBindless(options.bindless);
+  ve.setStaticRecording(options.staticRecording);
+  ve.setLatency(options.latency, options.justInTime);
+  if (options.deviceGroup)
+    ve.setDeviceGroup(VulkanDeviceGroup::parseMode(options.deviceGroup));
+  for (uint32_t i = 0; i < options.windowCount; i++) ve.createWindow();
   ve.initSwapchain();
   ve.renderLoop();
 }
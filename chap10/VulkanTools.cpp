@@ -1,74 +0,0 @@
-#include "VulkanTools.hpp"
-
-void VulkanTools::exitOnError(const char *msg) {
-#if defined(_WIN32)
-  MessageBox(NULL, msg, ENGINE_NAME, MB_ICONERROR);
-#else
-  printf(msg);
-  fflush(stdout);
-#endif
-  exit(EXIT_FAILURE);
-}
-
-void VulkanTools::setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
-                                 VkImageAspectFlags aspects,
-                                 VkImageLayout oldLayout,
-                                 VkImageLayout newLayout) {
-  VkImageMemoryBarrier imageBarrier = {};
-  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  imageBarrier.pNext = NULL;
-  imageBarrier.oldLayout = oldLayout;
-  imageBarrier.newLayout = newLayout;
-  imageBarrier.image = image;
-  imageBarrier.subresourceRange.aspectMask = aspects;
-  imageBarrier.subresourceRange.baseMipLevel = 0;
-  imageBarrier.subresourceRange.levelCount = 1;
-  imageBarrier.subresourceRange.layerCount = 1;
-
-  switch (oldLayout) {
-    case VK_IMAGE_LAYOUT_PREINITIALIZED:
-      imageBarrier.srcAccessMask =
-          VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-      imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-      imageBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-      imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-      imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-      break;
-  }
-
-  switch (newLayout) {
-    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-      imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-      imageBarrier.srcAccessMask |= VK_ACCESS_TRANSFER_READ_BIT;
-      imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-      imageBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-      imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-      imageBarrier.dstAccessMask |=
-          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-      break;
-    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-      imageBarrier.srcAccessMask =
-          VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-      imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-      break;
-  }
-
-  VkPipelineStageFlagBits srcFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-  VkPipelineStageFlagBits dstFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-  vkCmdPipelineBarrier(cmdBuffer, srcFlags, dstFlags, 0, 0, NULL, 0, NULL, 1,
-                       &imageBarrier);
-}
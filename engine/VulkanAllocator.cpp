@@ -0,0 +1,333 @@
+#include "VulkanAllocator.hpp"
+
+static const uint32_t slabMagic = 0x56484131;
+static const uint32_t largeClass = UINT32_MAX;
+
+static const char *scopeNames[HOST_SCOPE_COUNT] = {
+    "command", "object", "cache", "device", "instance"};
+
+// The start of every slab, and of every large allocation's block.
+struct HostSlab {
+  uint32_t magic;
+  uint32_t sizeClass;
+  size_t size;
+};
+
+static void *systemAllocate(size_t size, size_t alignment) {
+#if defined(_WIN32)
+  return _aligned_malloc(size, alignment);
+#else
+  void *memory = NULL;
+  return posix_memalign(&memory, alignment, size) == 0 ? memory : NULL;
+#endif
+}
+
+static void systemFree(void *memory) {
+#if defined(_WIN32)
+  _aligned_free(memory);
+#else
+  ::free(memory);
+#endif
+}
+
+static HostSlab *slabOf(void *memory) {
+  HostSlab *slab =
+      (HostSlab *)((uintptr_t)memory & ~(uintptr_t)(HOST_SLAB_SIZE - 1));
+  assert(slab->magic == slabMagic);
+  return slab;
+}
+
+static uint32_t sizeClassFor(size_t size, size_t alignment) {
+  size_t needed = size > alignment ? size : alignment;
+  uint32_t sizeClass = 0;
+  while (sizeClass < HOST_CLASS_COUNT &&
+         ((size_t)HOST_MIN_CHUNK << sizeClass) < needed)
+    sizeClass++;
+  return sizeClass < HOST_CLASS_COUNT ? sizeClass : largeClass;
+}
+
+// Free chunks this thread can hand out without a lock. They go back to the
+// shared lists when the thread exits.
+struct HostThreadCache {
+  void *lists[HOST_CLASS_COUNT];
+  uint32_t counts[HOST_CLASS_COUNT];
+
+  HostThreadCache() {
+    memset(lists, 0, sizeof(lists));
+    memset(counts, 0, sizeof(counts));
+  }
+  ~HostThreadCache() {
+    for (uint32_t i = 0; i < HOST_CLASS_COUNT; i++)
+      hostAllocator.spill(i, &lists[i], counts[i], 0);
+  }
+};
+
+static HostThreadCache &threadCache() {
+  static thread_local HostThreadCache cache;
+  return cache;
+}
+
+VulkanHostAllocator hostAllocator;
+
+const VkAllocationCallbacks *vkAllocator =
+    getenv(HOST_ALLOCATOR_DISABLE_ENV) == NULL ? hostAllocator.callbacks()
+                                               : NULL;
+
+VulkanHostAllocator::VulkanHostAllocator()
+    : frees(0), largeAllocations(0), liveBytes(0), peakBytes(0) {
+  allocationCallbacks = {};
+  allocationCallbacks.pUserData = this;
+  allocationCallbacks.pfnAllocation = allocation;
+  allocationCallbacks.pfnReallocation = reallocation;
+  allocationCallbacks.pfnFree = free;
+  allocationCallbacks.pfnInternalAllocation = internalAllocation;
+  allocationCallbacks.pfnInternalFree = internalFree;
+
+  for (uint32_t i = 0; i < HOST_CLASS_COUNT; i++) {
+    pools[i].freeList = NULL;
+    pools[i].slabs = 0;
+  }
+  for (uint32_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+    allocations[i] = 0;
+    reallocations[i] = 0;
+    requestedBytes[i] = 0;
+    internalBytes[i] = 0;
+  }
+}
+
+const VkAllocationCallbacks *VulkanHostAllocator::callbacks() {
+  return &allocationCallbacks;
+}
+
+const char *VulkanHostAllocator::scopeName(uint32_t scope) {
+  return scope < HOST_SCOPE_COUNT ? scopeNames[scope] : "unknown";
+}
+
+size_t VulkanHostAllocator::chunkSize(uint32_t sizeClass) {
+  return (size_t)HOST_MIN_CHUNK << sizeClass;
+}
+
+size_t VulkanHostAllocator::usableSize(void *memory) {
+  HostSlab *slab = slabOf(memory);
+  if (slab->sizeClass != largeClass) return chunkSize(slab->sizeClass);
+
+  return slab->size - ((uint8_t *)memory - (uint8_t *)slab);
+}
+
+void VulkanHostAllocator::addLive(size_t bytes) {
+  uint64_t live = liveBytes.fetch_add(bytes) + bytes;
+  uint64_t peak = peakBytes.load();
+  while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {
+  }
+}
+
+void *VulkanHostAllocator::refill(uint32_t sizeClass, void **list,
+                                  uint32_t &count) {
+  HostPool &pool = pools[sizeClass];
+  std::lock_guard<std::mutex> lock(pool.mutex);
+
+  if (!pool.freeList) {
+    HostSlab *slab = (HostSlab *)systemAllocate(HOST_SLAB_SIZE, HOST_SLAB_SIZE);
+    if (!slab) return NULL;
+
+    slab->magic = slabMagic;
+    slab->sizeClass = sizeClass;
+    slab->size = HOST_SLAB_SIZE;
+    pool.slabs++;
+
+    // The header takes the first chunk, or the first few of the smallest.
+    size_t size = chunkSize(sizeClass);
+    size_t first = size > HOST_SLAB_HEADER ? size : HOST_SLAB_HEADER;
+    for (size_t offset = HOST_SLAB_SIZE - size; offset >= first;
+         offset -= size) {
+      void *chunk = (uint8_t *)slab + offset;
+      *(void **)chunk = pool.freeList;
+      pool.freeList = chunk;
+    }
+  }
+
+  for (uint32_t i = 0; i < HOST_THREAD_BATCH && pool.freeList; i++) {
+    void *chunk = pool.freeList;
+    pool.freeList = *(void **)chunk;
+    *(void **)chunk = *list;
+    *list = chunk;
+    count++;
+  }
+
+  return *list;
+}
+
+void VulkanHostAllocator::spill(uint32_t sizeClass, void **list,
+                                uint32_t &count, uint32_t keep) {
+  if (count <= keep) return;
+
+  HostPool &pool = pools[sizeClass];
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  while (count > keep) {
+    void *chunk = *list;
+    *list = *(void **)chunk;
+    *(void **)chunk = pool.freeList;
+    pool.freeList = chunk;
+    count--;
+  }
+}
+
+void *VulkanHostAllocator::allocate(size_t size, size_t alignment) {
+  if (size == 0) return NULL;
+  if (alignment == 0) alignment = 1;
+
+  uint32_t sizeClass = sizeClassFor(size, alignment);
+  if (sizeClass == largeClass) {
+    // The data starts inside the block's first slab-sized stretch, so
+    // masking its address still finds the header.
+    size_t offset = alignment > HOST_SLAB_HEADER ? alignment : HOST_SLAB_HEADER;
+    assert(offset < HOST_SLAB_SIZE);
+
+    HostSlab *block =
+        (HostSlab *)systemAllocate(offset + size, HOST_SLAB_SIZE);
+    if (!block) return NULL;
+
+    block->magic = slabMagic;
+    block->sizeClass = largeClass;
+    block->size = offset + size;
+    largeAllocations++;
+    addLive(size);
+    return (uint8_t *)block + offset;
+  }
+
+  HostThreadCache &cache = threadCache();
+  void **list = &cache.lists[sizeClass];
+  if (!*list && !refill(sizeClass, list, cache.counts[sizeClass]))
+    return NULL;
+
+  void *chunk = *list;
+  *list = *(void **)chunk;
+  cache.counts[sizeClass]--;
+  addLive(chunkSize(sizeClass));
+  return chunk;
+}
+
+void *VulkanHostAllocator::reallocate(void *original, size_t size,
+                                      size_t alignment) {
+  if (!original) return allocate(size, alignment);
+  if (size == 0) {
+    release(original);
+    return NULL;
+  }
+
+  size_t usable = usableSize(original);
+  if (usable >= size && ((uintptr_t)original & (alignment - 1)) == 0)
+    return original;
+
+  void *memory = allocate(size, alignment);
+  if (!memory) return NULL;
+
+  memcpy(memory, original, usable < size ? usable : size);
+  release(original);
+  return memory;
+}
+
+void VulkanHostAllocator::release(void *memory) {
+  if (!memory) return;
+
+  frees++;
+  HostSlab *slab = slabOf(memory);
+  if (slab->sizeClass == largeClass) {
+    liveBytes -= usableSize(memory);
+    systemFree(slab);
+    return;
+  }
+
+  uint32_t sizeClass = slab->sizeClass;
+  liveBytes -= chunkSize(sizeClass);
+
+  HostThreadCache &cache = threadCache();
+  *(void **)memory = cache.lists[sizeClass];
+  cache.lists[sizeClass] = memory;
+  if (++cache.counts[sizeClass] > HOST_THREAD_CACHE)
+    spill(sizeClass, &cache.lists[sizeClass], cache.counts[sizeClass],
+          HOST_THREAD_CACHE - HOST_THREAD_BATCH);
+}
+
+HostAllocatorStats VulkanHostAllocator::stats() const {
+  HostAllocatorStats stats = {};
+  for (uint32_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+    stats.scopes[i].allocations = allocations[i];
+    stats.scopes[i].reallocations = reallocations[i];
+    stats.scopes[i].requestedBytes = requestedBytes[i];
+    stats.scopes[i].internalBytes = internalBytes[i];
+  }
+  stats.frees = frees;
+  stats.largeAllocations = largeAllocations;
+  stats.liveBytes = liveBytes;
+  stats.peakBytes = peakBytes;
+
+  uint64_t slabs = 0;
+  for (uint32_t i = 0; i < HOST_CLASS_COUNT; i++) slabs += pools[i].slabs;
+  stats.slabBytes = slabs * HOST_SLAB_SIZE;
+  return stats;
+}
+
+void VulkanHostAllocator::print() const {
+  if (!vkAllocator) return;
+
+  HostAllocatorStats current = stats();
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < HOST_SCOPE_COUNT; i++)
+    total += current.scopes[i].allocations;
+  if (total == 0) return;
+
+  fprintf(stdout,
+          "Host Memory:    %llu allocations, %.1f KB peak, %.1f KB in "
+          "slabs\n",
+          (unsigned long long)total, current.peakBytes / 1024.0,
+          current.slabBytes / 1024.0);
+  for (uint32_t i = 0; i < HOST_SCOPE_COUNT; i++) {
+    const HostScopeStats &scope = current.scopes[i];
+    if (scope.allocations + scope.reallocations == 0) continue;
+    fprintf(stdout, "  %-14s %llu, %.1f KB requested\n", scopeName(i),
+            (unsigned long long)scope.allocations,
+            scope.requestedBytes / 1024.0);
+  }
+}
+
+VKAPI_ATTR void *VKAPI_CALL VulkanHostAllocator::allocation(
+    void *user, size_t size, size_t alignment,
+    VkSystemAllocationScope scope) {
+  VulkanHostAllocator *allocator = (VulkanHostAllocator *)user;
+  if (scope < HOST_SCOPE_COUNT) {
+    allocator->allocations[scope]++;
+    allocator->requestedBytes[scope] += size;
+  }
+  return allocator->allocate(size, alignment);
+}
+
+VKAPI_ATTR void *VKAPI_CALL VulkanHostAllocator::reallocation(
+    void *user, void *original, size_t size, size_t alignment,
+    VkSystemAllocationScope scope) {
+  VulkanHostAllocator *allocator = (VulkanHostAllocator *)user;
+  if (scope < HOST_SCOPE_COUNT) {
+    allocator->reallocations[scope]++;
+    allocator->requestedBytes[scope] += size;
+  }
+  return allocator->reallocate(original, size, alignment);
+}
+
+VKAPI_ATTR void VKAPI_CALL VulkanHostAllocator::free(void *user,
+                                                     void *memory) {
+  ((VulkanHostAllocator *)user)->release(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL VulkanHostAllocator::internalAllocation(
+    void *user, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope) {
+  if (scope < HOST_SCOPE_COUNT)
+    ((VulkanHostAllocator *)user)->internalBytes[scope] += size;
+}
+
+VKAPI_ATTR void VKAPI_CALL VulkanHostAllocator::internalFree(
+    void *user, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope) {
+  if (scope < HOST_SCOPE_COUNT)
+    ((VulkanHostAllocator *)user)->internalBytes[scope] -= size;
+}
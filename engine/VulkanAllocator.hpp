@@ -0,0 +1,115 @@
+#ifndef VULKAN_ALLOCATOR_HPP
+#define VULKAN_ALLOCATOR_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+
+#define HOST_ALLOCATOR_DISABLE_ENV "VULKAN_EXAMPLE_HOST_ALLOCATOR_DISABLE"
+#define HOST_SLAB_SIZE (64 * 1024)
+#define HOST_SLAB_HEADER 64
+#define HOST_MIN_CHUNK 16
+#define HOST_CLASS_COUNT 9
+#define HOST_THREAD_CACHE 64
+#define HOST_THREAD_BATCH 32
+#define HOST_SCOPE_COUNT 5
+
+// What the driver asked for in one allocation scope. Frees don't carry a
+// scope, so live bytes are only kept for the whole allocator; internal
+// allocations the driver makes itself and only reports are kept per scope.
+struct HostScopeStats {
+  uint64_t allocations;
+  uint64_t reallocations;
+  uint64_t requestedBytes;
+  uint64_t internalBytes;
+};
+
+struct HostAllocatorStats {
+  HostScopeStats scopes[HOST_SCOPE_COUNT];
+  uint64_t frees;
+  uint64_t largeAllocations;
+  uint64_t liveBytes;
+  uint64_t peakBytes;
+  uint64_t slabBytes;
+};
+
+// VkAllocationCallbacks for every object the engine creates. Requests up to
+// HOST_SLAB_SIZE / 16 bytes come from power-of-two size classes carved out
+// of HOST_SLAB_SIZE slabs, which are aligned to their size so a pointer finds
+// its slab, and so its size class, by masking. Each thread keeps up to
+// HOST_THREAD_CACHE free chunks per class and trades them with the shared
+// lists HOST_THREAD_BATCH at a time, so most driver allocations take no lock.
+// Slabs are kept for the life of the process. Larger requests go to the
+// system with a header in front. Setting HOST_ALLOCATOR_DISABLE_ENV hands
+// everything back to the driver's own allocator.
+class VulkanHostAllocator {
+ public:
+  VulkanHostAllocator();
+
+  const VkAllocationCallbacks *callbacks();
+  HostAllocatorStats stats() const;
+  void print() const;
+  static const char *scopeName(uint32_t scope);
+
+  void *allocate(size_t size, size_t alignment);
+  void *reallocate(void *original, size_t size, size_t alignment);
+  void release(void *memory);
+
+ private:
+  struct HostPool {
+    std::mutex mutex;
+    void *freeList;
+    uint64_t slabs;
+  };
+
+  VkAllocationCallbacks allocationCallbacks;
+  HostPool pools[HOST_CLASS_COUNT];
+  std::atomic<uint64_t> allocations[HOST_SCOPE_COUNT];
+  std::atomic<uint64_t> reallocations[HOST_SCOPE_COUNT];
+  std::atomic<uint64_t> requestedBytes[HOST_SCOPE_COUNT];
+  std::atomic<uint64_t> internalBytes[HOST_SCOPE_COUNT];
+  std::atomic<uint64_t> frees;
+  std::atomic<uint64_t> largeAllocations;
+  std::atomic<uint64_t> liveBytes;
+  std::atomic<uint64_t> peakBytes;
+
+  static size_t chunkSize(uint32_t sizeClass);
+  static size_t usableSize(void *memory);
+  void *refill(uint32_t sizeClass, void **list, uint32_t &count);
+  void spill(uint32_t sizeClass, void **list, uint32_t &count,
+             uint32_t keep);
+  void addLive(size_t bytes);
+
+  friend struct HostThreadCache;
+
+  static VKAPI_ATTR void *VKAPI_CALL
+  allocation(void *user, size_t size, size_t alignment,
+             VkSystemAllocationScope scope);
+  static VKAPI_ATTR void *VKAPI_CALL
+  reallocation(void *user, void *original, size_t size, size_t alignment,
+               VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL free(void *user, void *memory);
+  static VKAPI_ATTR void VKAPI_CALL
+  internalAllocation(void *user, size_t size,
+                     VkInternalAllocationType type,
+                     VkSystemAllocationScope scope);
+  static VKAPI_ATTR void VKAPI_CALL
+  internalFree(void *user, size_t size, VkInternalAllocationType type,
+               VkSystemAllocationScope scope);
+};
+
+extern VulkanHostAllocator hostAllocator;
+
+// Passed as pAllocator to every create and destroy call, so the two always
+// agree. NULL when HOST_ALLOCATOR_DISABLE_ENV is set.
+extern const VkAllocationCallbacks *vkAllocator;
+
+#endif
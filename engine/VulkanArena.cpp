@@ -0,0 +1,67 @@
+#include "VulkanArena.hpp"
+#include "VulkanDebug.hpp"
+
+VulkanFrameArena::VulkanFrameArena() : used(0), overflowBytes(0), peak(0) {}
+
+void VulkanFrameArena::init(size_t size) {
+  block.assign(size, 0);
+  overflow.clear();
+  used = overflowBytes = peak = 0;
+}
+
+void VulkanFrameArena::destroy() {
+  std::vector<uint8_t>().swap(block);
+  std::vector<std::vector<uint8_t> >().swap(overflow);
+  used = overflowBytes = 0;
+}
+
+void VulkanFrameArena::reset() {
+  peak = std::max(peak, used + overflowBytes);
+
+  // Nothing from the last frame is live any more, so this is the one point
+  // where the block can move.
+  if (!overflow.empty()) {
+    overflow.clear();
+    if (peak > block.size()) block.assign(std::max(block.size() * 2, peak), 0);
+  }
+  used = overflowBytes = 0;
+}
+
+void *VulkanFrameArena::allocate(size_t size, size_t alignment) {
+  size_t offset = (used + alignment - 1) & ~(alignment - 1);
+  if (offset + size <= block.size()) {
+    used = offset + size;
+    return block.data() + offset;
+  }
+
+  overflow.push_back(std::vector<uint8_t>(size + alignment));
+  overflowBytes += size + alignment;
+
+  uintptr_t start = (uintptr_t)overflow.back().data();
+  return (void *)((start + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+#if VULKAN_DEBUG
+
+static std::atomic<uint64_t> allocationCount(0);
+
+void *operator new(size_t size) {
+  allocationCount++;
+  void *memory = malloc(size > 0 ? size : 1);
+  if (!memory) throw std::bad_alloc();
+  return memory;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *memory) noexcept { free(memory); }
+
+void operator delete[](void *memory) noexcept { free(memory); }
+
+uint64_t heapAllocations() { return allocationCount; }
+
+#else
+
+uint64_t heapAllocations() { return 0; }
+
+#endif
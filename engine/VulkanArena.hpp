@@ -0,0 +1,92 @@
+#ifndef VULKAN_ARENA_HPP
+#define VULKAN_ARENA_HPP
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#define FRAME_ARENA_SIZE (64 * 1024)
+#define FRAME_ARENA_ALIGNMENT 16
+
+// Holds up to N trivially copyable values in place, for the short lists
+// a frame builds and hands straight to Vulkan: barriers, attachments,
+// create-info chains. Going past N is a bug in the caller, not a reason
+// to reach for the heap.
+template <typename T, uint32_t N>
+class FixedVector {
+ public:
+  FixedVector() : count(0) {}
+
+  void push_back(const T &value) {
+    assert(count < N);
+    items[count++] = value;
+  }
+  void pop_back() {
+    assert(count > 0);
+    count--;
+  }
+  void clear() { count = 0; }
+
+  bool empty() const { return count == 0; }
+  bool full() const { return count == N; }
+  uint32_t size() const { return count; }
+  static uint32_t capacity() { return N; }
+
+  T *data() { return items; }
+  const T *data() const { return items; }
+  T &operator[](uint32_t i) { return items[i]; }
+  const T &operator[](uint32_t i) const { return items[i]; }
+  T &back() { return items[count - 1]; }
+  const T &back() const { return items[count - 1]; }
+
+ private:
+  T items[N];
+  uint32_t count;
+};
+
+// Scratch memory for one frame: allocations bump a pointer and are all
+// released together by reset() at the start of the next frame, so nothing
+// taken from it may be kept past that. Arrays of Vulkan structs come back
+// zeroed, as they would from "= {}". A frame that runs out spills into
+// extra heap blocks, and the next reset() grows the arena to the frame's
+// peak, so an undersized arena only costs allocations until it settles.
+class VulkanFrameArena {
+ public:
+  VulkanFrameArena();
+
+  void init(size_t size = FRAME_ARENA_SIZE);
+  void destroy();
+  void reset();
+
+  void *allocate(size_t size, size_t alignment = FRAME_ARENA_ALIGNMENT);
+
+  template <typename T>
+  T *alloc(uint32_t count = 1) {
+    T *items = (T *)allocate(count * sizeof(T), alignof(T));
+    memset(items, 0, count * sizeof(T));
+    return items;
+  }
+
+  size_t capacity() const { return block.size(); }
+  size_t usedBytes() const { return used + overflowBytes; }
+  size_t peakBytes() const { return peak; }
+
+ private:
+  std::vector<uint8_t> block;
+  std::vector<std::vector<uint8_t> > overflow;
+  size_t used;
+  size_t overflowBytes;
+  size_t peak;
+};
+
+// Calls to operator new in the whole process since it started. Debug
+// builds replace the global allocator to count them, which is how a frame
+// checks it made none; release builds leave it alone and always return 0.
+uint64_t heapAllocations();
+
+#endif
@@ -0,0 +1,494 @@
+#include "VulkanBenchmark.hpp"
+
+static const char *sceneNames[SCENE_COUNT] = {
+    "empty", "draws", "upload", "barriers", "recreate"};
+
+static const char *startupPhaseNames[STARTUP_PHASE_COUNT] = {
+    "instanceMs",  "devicesMs",   "swapchainInitMs", "surfaceMs", "deviceMs",
+    "swapchainMs", "frameLoopMs", "firstFrameMs",    "totalMs"};
+
+// The draw scene's fragment shader discards on a checkerboard in the
+// alpha-tested variant, which --alpha-test picks.
+static constexpr uint32_t drawVariants[2] = {
+    PipelineVariant<0>::id(), PipelineVariant<PIPELINE_ALPHA_TEST>::id()};
+
+static double elapsedMs(std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+VulkanBenchmark::VulkanBenchmark()
+    : device(VK_NULL_HANDLE),
+      memory(NULL),
+      resources(NULL),
+      shaders(NULL),
+      pipelines(NULL),
+      vertexShader(SHADER_INVALID),
+      fragmentShader(SHADER_INVALID),
+      pipelineLayout(VK_NULL_HANDLE),
+      drawPipeline(VK_NULL_HANDLE),
+      barrierLayout(VK_IMAGE_LAYOUT_UNDEFINED),
+      frames(0),
+      frameStartAllocations(0),
+      processStart(0) {
+  result = BenchmarkResult();
+  hostStart = HostAllocatorStats();
+}
+
+const char *VulkanBenchmark::sceneName(BenchmarkScene scene) {
+  return scene < SCENE_COUNT ? sceneNames[scene] : "unknown";
+}
+
+bool VulkanBenchmark::parseScene(const char *name, BenchmarkScene &scene) {
+  for (uint32_t i = 0; i < SCENE_COUNT; i++) {
+    if (strcmp(name, sceneNames[i]) != 0) continue;
+    scene = (BenchmarkScene)i;
+    return true;
+  }
+
+  return false;
+}
+
+const char *VulkanBenchmark::startupPhaseName(StartupPhase phase) {
+  return phase < STARTUP_PHASE_COUNT ? startupPhaseNames[phase] : "unknown";
+}
+
+StartupResult VulkanBenchmark::summarizeStartup(
+    const std::vector<StartupTimes> &samples) {
+  StartupResult startup = StartupResult();
+  startup.iterations = samples.size();
+
+  std::vector<double> phaseMs(samples.size());
+  for (uint32_t i = 0; i < STARTUP_PHASE_COUNT; i++) {
+    for (size_t j = 0; j < samples.size(); j++)
+      phaseMs[j] = samples[j].ms[i];
+    startup.phases[i] = percentiles(phaseMs);
+  }
+
+  return startup;
+}
+
+void VulkanBenchmark::configure(const BenchmarkConfig &config) {
+  this->config = config;
+
+  // Growing these mid-run would count against the frames being measured.
+  frameMs.reserve(config.frameCount);
+  cpuMs.reserve(config.frameCount);
+  gpuMs.reserve(config.frameCount);
+}
+
+uint32_t VulkanBenchmark::totalFrames() const {
+  return config.warmupFrames + config.frameCount;
+}
+
+void VulkanBenchmark::init(VkDevice device,
+                           const VkPhysicalDeviceProperties &properties,
+                           VulkanMemory &memory, VulkanResources &resources,
+                           VulkanShaders &shaders, VulkanPipelines &pipelines,
+                           bool headless) {
+  this->device = device;
+  this->memory = &memory;
+  this->resources = &resources;
+  this->shaders = &shaders;
+  this->pipelines = &pipelines;
+
+  result = BenchmarkResult();
+  result.scene = sceneName(config.scene);
+  result.mode = headless ? "headless" : "windowed";
+  result.device = properties.deviceName;
+  result.driverVersion = properties.driverVersion;
+  result.apiVersion = properties.apiVersion;
+  result.skipped = false;
+
+  frames = 0;
+  frameMs.clear();
+  cpuMs.clear();
+  gpuMs.clear();
+  frameMs.reserve(config.frameCount);
+  cpuMs.reserve(config.frameCount);
+  gpuMs.reserve(config.frameCount);
+
+  if (config.scene == SCENE_RECREATE && headless) {
+    result.skipped = true;
+    result.note = "needs a swapchain";
+  }
+
+  if (config.scene == SCENE_DRAWS) {
+    std::string vertexPath = VulkanShaders::path(BENCHMARK_VERTEX_SHADER);
+    std::string fragmentPath = VulkanShaders::path(BENCHMARK_FRAGMENT_SHADER);
+    if (VulkanTools::fileModifiedTime(vertexPath.c_str()) >= 0 &&
+        VulkanTools::fileModifiedTime(fragmentPath.c_str()) >= 0) {
+      vertexShader = shaders.load(vertexPath.c_str());
+      fragmentShader = shaders.load(fragmentPath.c_str());
+    }
+    if (vertexShader == SHADER_INVALID || fragmentShader == SHADER_INVALID) {
+      result.skipped = true;
+      result.note = vertexPath + " not found";
+    } else {
+      VkPipelineLayoutCreateInfo layoutInfo = {};
+      layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+      layoutInfo.pNext = NULL;
+      layoutInfo.flags = 0;
+      layoutInfo.setLayoutCount = 0;
+      layoutInfo.pSetLayouts = NULL;
+      layoutInfo.pushConstantRangeCount = 0;
+      layoutInfo.pPushConstantRanges = NULL;
+
+      VkResult res = vkd.CreatePipelineLayout(device, &layoutInfo, vkAllocator,
+                                              &pipelineLayout);
+      assert(res == VK_SUCCESS);
+
+      drawDesc = GraphicsPipelineDesc();
+      drawDesc.layout = pipelineLayout;
+    }
+  }
+
+  if (config.scene == SCENE_UPLOAD) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = NULL;
+    bufferInfo.flags = 0;
+    bufferInfo.size = config.uploadBytes;
+    bufferInfo.usage =
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = 0;
+    bufferInfo.pQueueFamilyIndices = NULL;
+    uploadBuffer = resources.createBuffer(bufferInfo,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // The same bytes every run, so drivers that compress or dedupe
+    // transfers see the same data each time.
+    uploadData.resize(config.uploadBytes);
+    for (size_t i = 0; i < uploadData.size(); i++)
+      uploadData[i] = (uint8_t)(i * 2654435761u >> 24);
+  }
+
+  if (config.scene == SCENE_BARRIERS) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = NULL;
+    imageInfo.flags = 0;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent.width = BENCHMARK_IMAGE_SIZE;
+    imageInfo.extent.height = BENCHMARK_IMAGE_SIZE;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage =
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.queueFamilyIndexCount = 0;
+    imageInfo.pQueueFamilyIndices = NULL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrierImage =
+        resources.createImage(imageInfo, VK_IMAGE_ASPECT_COLOR_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    barrierLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  }
+
+  sampleMemory();
+}
+
+void VulkanBenchmark::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  drawPipeline = VK_NULL_HANDLE;
+
+  if (pipelineLayout != VK_NULL_HANDLE)
+    vkd.DestroyPipelineLayout(device, pipelineLayout, vkAllocator);
+  pipelineLayout = VK_NULL_HANDLE;
+
+  if (uploadBuffer.valid()) resources->destroyBuffer(uploadBuffer);
+  if (barrierImage.valid()) resources->destroyImage(barrierImage);
+  uploadBuffer = ResourceHandle();
+  barrierImage = ResourceHandle();
+  uploadData.clear();
+
+  device = VK_NULL_HANDLE;
+}
+
+bool VulkanBenchmark::recreateDue() const {
+  return config.scene == SCENE_RECREATE && frames > 0 &&
+         config.recreateInterval > 0 && frames % config.recreateInterval == 0;
+}
+
+void VulkanBenchmark::upload(VulkanUpload &upload) {
+  if (config.scene != SCENE_UPLOAD || !uploadBuffer.valid()) return;
+
+  // Pieces of a quarter ring keep a large upload from waiting on the whole
+  // ring to drain.
+  VkBuffer buffer = resources->buffer(uploadBuffer)->buffer;
+  VkDeviceSize piece = upload.ringSize / 4;
+  for (VkDeviceSize offset = 0; offset < config.uploadBytes; offset += piece) {
+    VkDeviceSize size = std::min(piece, config.uploadBytes - offset);
+    upload.uploadBuffer(buffer, offset, &uploadData[offset], size,
+                        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  }
+}
+
+void VulkanBenchmark::recordBarriers(VkCommandBuffer cmdBuffer) {
+  if (config.scene != SCENE_BARRIERS || !barrierImage.valid()) return;
+
+  // One barrier per call, so the cost measured is the number of barriers
+  // rather than the number of transitions in one.
+  VkImage image = resources->image(barrierImage)->image;
+  VkImageSubresourceRange range =
+      VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+  for (uint32_t i = 0; i < config.barrierCount; i++) {
+    VkImageLayout next = barrierLayout == VK_IMAGE_LAYOUT_GENERAL
+                             ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+                             : VK_IMAGE_LAYOUT_GENERAL;
+    VulkanTools::BarrierBatch()
+        .image(image, barrierLayout, next, range,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT)
+        .record(cmdBuffer);
+    barrierLayout = next;
+  }
+}
+
+void VulkanBenchmark::prepareDraws(VkRenderPass renderPass) {
+  drawPipeline = VK_NULL_HANDLE;
+  if (config.scene != SCENE_DRAWS || pipelineLayout == VK_NULL_HANDLE)
+    return;
+
+  // A reload retires the old modules and the pipelines built from them, so
+  // the description takes whichever modules are current.
+  drawDesc.vertexShader = shaders->module(vertexShader);
+  drawDesc.fragmentShader = shaders->module(fragmentShader);
+  drawPipeline =
+      pipelines->pipeline(drawDesc, renderPass, drawVariants[config.alphaTest]);
+}
+
+void VulkanBenchmark::recordDraws(VkCommandBuffer cmdBuffer, uint32_t chunk,
+                                  uint32_t chunkCount, VkExtent2D extent) {
+  if (drawPipeline == VK_NULL_HANDLE) return;
+
+  uint32_t first = (uint64_t)config.drawCount * chunk / chunkCount;
+  uint32_t last = (uint64_t)config.drawCount * (chunk + 1) / chunkCount;
+  if (first == last) return;
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)extent.width;
+  viewport.height = (float)extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor = {};
+  scissor.extent = extent;
+
+  vkd.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      drawPipeline);
+  vkd.CmdSetViewport(cmdBuffer, 0, 1, &viewport);
+  vkd.CmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+  // The first instance tells the vertex shader where each draw goes.
+  for (uint32_t i = first; i < last; i++) vkd.CmdDraw(cmdBuffer, 3, 1, 0, i);
+}
+
+void VulkanBenchmark::frameBegin() {
+  frameStart = std::chrono::steady_clock::now();
+  frameStartAllocations = heapAllocations();
+  if (frames == config.warmupFrames) {
+    measureStart = frameStart;
+    processStart = std::clock();
+    hostStart = hostAllocator.stats();
+  }
+}
+
+void VulkanBenchmark::frameEnd(double gpuFrameMs) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  // The first measured frame has no previous end inside the run, so its
+  // frame time starts with its own frameBegin().
+  if (measuring()) {
+    frameMs.push_back(elapsedMs(
+        frames == config.warmupFrames ? frameStart : lastFrameEnd, now));
+    cpuMs.push_back(elapsedMs(frameStart, now));
+    if (gpuFrameMs > 0.0) gpuMs.push_back(gpuFrameMs);
+    result.heapAllocations += heapAllocations() - frameStartAllocations;
+    sampleMemory();
+  }
+
+  lastFrameEnd = now;
+  frames++;
+}
+
+void VulkanBenchmark::sampleMemory() {
+  VkDeviceSize used = 0;
+  VkDeviceSize reserved = 0;
+  uint32_t allocations = 0;
+  for (uint32_t i = 0; i < memory->memoryProperties.memoryHeapCount; i++) {
+    MemoryHeapStats stats = memory->getHeapStats(i);
+    used += stats.usedBytes;
+    reserved += stats.blockBytes;
+    allocations += stats.allocationCount;
+  }
+
+  result.memoryUsed = std::max(result.memoryUsed, used);
+  result.memoryReserved = std::max(result.memoryReserved, reserved);
+  result.allocationCount = std::max(result.allocationCount, allocations);
+
+  for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    result.categories[i] = memory->getCategoryStats((MemoryCategory)i);
+  result.budgets.resize(memory->memoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < result.budgets.size(); i++)
+    result.budgets[i] = memory->getBudget(i);
+  result.budgetQueried = memory->budgetQueried();
+}
+
+BenchmarkTimes VulkanBenchmark::percentiles(std::vector<double> &samples) {
+  BenchmarkTimes times = {};
+  if (samples.empty()) return times;
+
+  std::sort(samples.begin(), samples.end());
+  size_t last = samples.size() - 1;
+  times.p50 = samples[last * 50 / 100];
+  times.p95 = samples[last * 95 / 100];
+  times.p99 = samples[last * 99 / 100];
+  times.maxMs = samples[last];
+
+  double total = 0.0;
+  for (size_t i = 0; i < samples.size(); i++) total += samples[i];
+  times.avgMs = total / samples.size();
+  return times;
+}
+
+const BenchmarkResult &VulkanBenchmark::finish() {
+  result.frames = frameMs.size();
+  result.seconds = 0.0;
+  result.processCpuMs = 0.0;
+  if (!frameMs.empty()) {
+    result.seconds = elapsedMs(measureStart, lastFrameEnd) / 1000.0;
+    result.processCpuMs =
+        (std::clock() - processStart) * 1000.0 / CLOCKS_PER_SEC;
+
+    HostAllocatorStats host = hostAllocator.stats();
+    for (uint32_t i = 0; i < HOST_SCOPE_COUNT; i++)
+      result.hostAllocations[i] =
+          host.scopes[i].allocations + host.scopes[i].reallocations -
+          hostStart.scopes[i].allocations - hostStart.scopes[i].reallocations;
+  }
+
+  result.frameTime = percentiles(frameMs);
+  result.cpuTime = percentiles(cpuMs);
+  result.gpuTime = percentiles(gpuMs);
+  return result;
+}
+
+static void writeString(FILE *file, const std::string &value) {
+  fputc('"', file);
+  for (size_t i = 0; i < value.size(); i++) {
+    char c = value[i];
+    if (c == '"' || c == '\\')
+      fprintf(file, "\\%c", c);
+    else if ((unsigned char)c < 0x20)
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+void VulkanBenchmark::writeTimes(FILE *file, const char *name,
+                                 const BenchmarkTimes &times) {
+  fprintf(file,
+          "      \"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+          "\"max\": %.4f, \"avg\": %.4f},\n",
+          name, times.p50, times.p95, times.p99, times.maxMs, times.avgMs);
+}
+
+void VulkanBenchmark::writeJson(FILE *file,
+                                const std::vector<BenchmarkResult> &results,
+                                const std::vector<StartupResult> &startup) {
+  fprintf(file, "{\n  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult &r = results[i];
+    fprintf(file, "    {\n      \"scene\": ");
+    writeString(file, r.scene);
+    fprintf(file, ",\n      \"mode\": ");
+    writeString(file, r.mode);
+    fprintf(file, ",\n      \"device\": ");
+    writeString(file, r.device);
+    fprintf(file, ",\n      \"driverVersion\": %u,\n", r.driverVersion);
+    fprintf(file, "      \"apiVersion\": \"%u.%u.%u\",\n",
+            VK_VERSION_MAJOR(r.apiVersion), VK_VERSION_MINOR(r.apiVersion),
+            VK_VERSION_PATCH(r.apiVersion));
+    if (r.skipped) {
+      fprintf(file, "      \"skipped\": ");
+      writeString(file, r.note);
+      fprintf(file, "\n    }%s\n", i + 1 < results.size() ? "," : "");
+      continue;
+    }
+    fprintf(file, "      \"frames\": %u,\n", r.frames);
+    fprintf(file, "      \"seconds\": %.4f,\n", r.seconds);
+    writeTimes(file, "frameMs", r.frameTime);
+    writeTimes(file, "cpuMs", r.cpuTime);
+    writeTimes(file, "gpuMs", r.gpuTime);
+    fprintf(file, "      \"processCpuMs\": %.2f,\n", r.processCpuMs);
+    if (VulkanDebug::enabled)
+      fprintf(file, "      \"heapAllocations\": %llu,\n",
+              (unsigned long long)r.heapAllocations);
+    else
+      fprintf(file, "      \"heapAllocations\": null,\n");
+    if (vkAllocator) {
+      fprintf(file, "      \"hostAllocations\": {");
+      for (uint32_t j = 0; j < HOST_SCOPE_COUNT; j++)
+        fprintf(file, "%s\"%s\": %llu", j > 0 ? ", " : "",
+                VulkanHostAllocator::scopeName(j),
+                (unsigned long long)r.hostAllocations[j]);
+      fprintf(file, "},\n");
+    } else {
+      fprintf(file, "      \"hostAllocations\": null,\n");
+    }
+    fprintf(file,
+            "      \"memory\": {\"usedBytes\": %llu, \"reservedBytes\": "
+            "%llu, \"allocations\": %u,\n",
+            (unsigned long long)r.memoryUsed,
+            (unsigned long long)r.memoryReserved, r.allocationCount);
+    fprintf(file, "        \"categories\": {");
+    for (uint32_t j = 0; j < MEMORY_CATEGORY_COUNT; j++)
+      fprintf(file, "%s\"%s\": {\"currentBytes\": %llu, \"peakBytes\": %llu}",
+              j > 0 ? ", " : "", VulkanMemory::categoryName((MemoryCategory)j),
+              (unsigned long long)r.categories[j].currentBytes,
+              (unsigned long long)r.categories[j].peakBytes);
+    fprintf(file, "},\n        \"budgetQueried\": %s,\n",
+            r.budgetQueried ? "true" : "false");
+    fprintf(file, "        \"heaps\": [");
+    for (size_t j = 0; j < r.budgets.size(); j++)
+      fprintf(file,
+              "%s{\"budgetBytes\": %llu, \"usageBytes\": %llu, "
+              "\"peakBytes\": %llu}",
+              j > 0 ? ", " : "", (unsigned long long)r.budgets[j].budgetBytes,
+              (unsigned long long)r.budgets[j].usageBytes,
+              (unsigned long long)r.budgets[j].peakBytes);
+    fprintf(file, "]}\n");
+    fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "  ]");
+
+  if (!startup.empty()) {
+    fprintf(file, ",\n  \"startup\": [\n");
+    for (size_t i = 0; i < startup.size(); i++) {
+      const StartupResult &r = startup[i];
+      fprintf(file, "    {\n      \"mode\": ");
+      writeString(file, r.mode);
+      fprintf(file, ",\n      \"enumerationCache\": %s,\n",
+              r.enumerationCache ? "true" : "false");
+      fprintf(file, "      \"pipelineCache\": %s,\n",
+              r.pipelineCache ? "true" : "false");
+      for (uint32_t j = 0; j < STARTUP_PHASE_COUNT; j++)
+        writeTimes(file, startupPhaseName((StartupPhase)j), r.phases[j]);
+      fprintf(file, "      \"iterations\": %u\n", r.iterations);
+      fprintf(file, "    }%s\n", i + 1 < startup.size() ? "," : "");
+    }
+    fprintf(file, "  ]");
+  }
+  fprintf(file, "\n}\n");
+}
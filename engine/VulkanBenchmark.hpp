@@ -0,0 +1,211 @@
+#ifndef VULKAN_BENCHMARK_HPP
+#define VULKAN_BENCHMARK_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "VulkanAllocator.hpp"
+#include "VulkanArena.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanPipelines.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanShaders.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanUpload.hpp"
+
+#define BENCHMARK_FRAMES 600
+#define BENCHMARK_WARMUP_FRAMES 60
+#define BENCHMARK_DRAW_COUNT 10000
+#define BENCHMARK_UPLOAD_MB 16
+#define BENCHMARK_BARRIER_COUNT 1000
+#define BENCHMARK_RECREATE_INTERVAL 30
+#define BENCHMARK_IMAGE_SIZE 256
+#define BENCHMARK_VERTEX_SHADER "bench.vert.spv"
+#define BENCHMARK_FRAGMENT_SHADER "bench.frag.spv"
+
+enum BenchmarkScene {
+  SCENE_EMPTY = 0,
+  SCENE_DRAWS,
+  SCENE_UPLOAD,
+  SCENE_BARRIERS,
+  SCENE_RECREATE,
+  SCENE_COUNT
+};
+
+struct BenchmarkConfig {
+  BenchmarkScene scene;
+  uint32_t frameCount;
+  uint32_t warmupFrames;
+  uint32_t drawCount;
+  VkDeviceSize uploadBytes;
+  uint32_t barrierCount;
+  uint32_t recreateInterval;
+  bool alphaTest;
+
+  BenchmarkConfig()
+      : scene(SCENE_EMPTY),
+        frameCount(BENCHMARK_FRAMES),
+        warmupFrames(BENCHMARK_WARMUP_FRAMES),
+        drawCount(BENCHMARK_DRAW_COUNT),
+        uploadBytes(BENCHMARK_UPLOAD_MB * 1024 * 1024),
+        barrierCount(BENCHMARK_BARRIER_COUNT),
+        recreateInterval(BENCHMARK_RECREATE_INTERVAL),
+        alphaTest(false) {}
+};
+
+// Startup phases in the order the example runs them. Swapchain creation
+// covers the first swapchains and their images, the frame loop covers
+// command pools and every per-frame system, and the first frame runs from
+// the end of initialization until it is presented, or submitted offscreen.
+enum StartupPhase {
+  STARTUP_INSTANCE = 0,
+  STARTUP_DEVICES,
+  STARTUP_SWAPCHAIN_INIT,
+  STARTUP_SURFACE,
+  STARTUP_DEVICE,
+  STARTUP_SWAPCHAIN,
+  STARTUP_FRAME_LOOP,
+  STARTUP_FIRST_FRAME,
+  STARTUP_TOTAL,
+  STARTUP_PHASE_COUNT
+};
+
+struct StartupTimes {
+  double ms[STARTUP_PHASE_COUNT];
+};
+
+struct BenchmarkTimes {
+  double p50;
+  double p95;
+  double p99;
+  double maxMs;
+  double avgMs;
+};
+
+struct BenchmarkResult {
+  std::string scene;
+  std::string mode;
+  std::string device;
+  uint32_t driverVersion;
+  uint32_t apiVersion;
+  bool skipped;
+  std::string note;
+  uint32_t frames;
+  double seconds;
+  BenchmarkTimes frameTime;
+  BenchmarkTimes cpuTime;
+  BenchmarkTimes gpuTime;
+  double processCpuMs;
+  uint64_t heapAllocations;
+  uint64_t hostAllocations[HOST_SCOPE_COUNT];
+  VkDeviceSize memoryUsed;
+  VkDeviceSize memoryReserved;
+  uint32_t allocationCount;
+  MemoryCategoryStats categories[MEMORY_CATEGORY_COUNT];
+  std::vector<MemoryBudget> budgets;
+  bool budgetQueried;
+};
+
+struct StartupResult {
+  std::string mode;
+  bool enumerationCache;
+  bool pipelineCache;
+  uint32_t iterations;
+  BenchmarkTimes phases[STARTUP_PHASE_COUNT];
+};
+
+// Fixed, deterministic workloads the frame loop runs for a set number of
+// frames. The example calls the hooks for the configured scene from its own
+// frame: upload() while uploads for the frame are queued, recordBarriers()
+// at the start of the command buffer, prepareDraws() and recordDraws() from
+// the draw pass, and recreateDue() before acquiring, which marks swapchains
+// out of date. Frame times are taken between frameEnd() calls, CPU time from
+// frameBegin() to frameEnd(), and GPU time from the profiler's frame scope,
+// all after the warm-up frames. Debug builds also count the heap
+// allocations made between frameBegin() and frameEnd(), and the driver's
+// allocations through vkAllocator are counted per scope over the run. The
+// results are written as JSON, along with any startup timings summarized
+// from the example's startupTimes().
+class VulkanBenchmark {
+ public:
+  VulkanBenchmark();
+
+  static const char *sceneName(BenchmarkScene scene);
+  static bool parseScene(const char *name, BenchmarkScene &scene);
+  static const char *startupPhaseName(StartupPhase phase);
+  static StartupResult summarizeStartup(
+      const std::vector<StartupTimes> &samples);
+
+  void configure(const BenchmarkConfig &config);
+  void init(VkDevice device, const VkPhysicalDeviceProperties &properties,
+            VulkanMemory &memory, VulkanResources &resources,
+            VulkanShaders &shaders, VulkanPipelines &pipelines,
+            bool headless);
+  void destroy();
+
+  BenchmarkScene scene() const { return config.scene; }
+  uint32_t totalFrames() const;
+  bool finished() const { return result.skipped || frames >= totalFrames(); }
+
+  bool recreateDue() const;
+  void upload(VulkanUpload &upload);
+  void recordBarriers(VkCommandBuffer cmdBuffer);
+  void prepareDraws(VkRenderPass renderPass);
+  void recordDraws(VkCommandBuffer cmdBuffer, uint32_t chunk,
+                   uint32_t chunkCount, VkExtent2D extent);
+
+  void frameBegin();
+  void frameEnd(double gpuFrameMs);
+
+  const BenchmarkResult &finish();
+  static void writeJson(
+      FILE *file, const std::vector<BenchmarkResult> &results,
+      const std::vector<StartupResult> &startup = std::vector<StartupResult>());
+
+ private:
+  BenchmarkConfig config;
+  BenchmarkResult result;
+  VkDevice device;
+  VulkanMemory *memory;
+  VulkanResources *resources;
+  VulkanShaders *shaders;
+  VulkanPipelines *pipelines;
+
+  uint32_t vertexShader;
+  uint32_t fragmentShader;
+  VkPipelineLayout pipelineLayout;
+  GraphicsPipelineDesc drawDesc;
+  VkPipeline drawPipeline;
+
+  ResourceHandle uploadBuffer;
+  std::vector<uint8_t> uploadData;
+  ResourceHandle barrierImage;
+  VkImageLayout barrierLayout;
+
+  uint32_t frames;
+  std::chrono::steady_clock::time_point frameStart;
+  uint64_t frameStartAllocations;
+  std::chrono::steady_clock::time_point lastFrameEnd;
+  std::chrono::steady_clock::time_point measureStart;
+  std::clock_t processStart;
+  HostAllocatorStats hostStart;
+  std::vector<double> frameMs;
+  std::vector<double> cpuMs;
+  std::vector<double> gpuMs;
+
+  bool measuring() const { return frames >= config.warmupFrames; }
+  void sampleMemory();
+  static BenchmarkTimes percentiles(std::vector<double> &samples);
+  static void writeTimes(FILE *file, const char *name,
+                         const BenchmarkTimes &times);
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include "VulkanBindless.hpp"
+
+static uint32_t minLimit(uint32_t a, uint32_t b) { return a < b ? a : b; }
+
+VulkanBindless::VulkanBindless()
+    : setLayout(VK_NULL_HANDLE),
+      pipelineLayout(VK_NULL_HANDLE),
+      descriptorSet(VK_NULL_HANDLE),
+      device(VK_NULL_HANDLE),
+      resources(NULL),
+      descriptorPool(VK_NULL_HANDLE),
+      stages(0) {}
+
+BindlessSupport VulkanBindless::query(VkInstance instance,
+                                      VkPhysicalDevice physicalDevice) {
+  BindlessSupport support = {};
+
+  std::vector<const char *> extensions;
+  deviceExtensions(extensions);
+  if (!VulkanDevice::supportsExtensions(physicalDevice, extensions))
+    return support;
+
+  PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 =
+      (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceFeatures2KHR");
+  PFN_vkGetPhysicalDeviceProperties2 getProperties2 =
+      (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceProperties2KHR");
+  if (!getFeatures2 || !getProperties2) return support;
+
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+  indexingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  indexingFeatures.pNext = NULL;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &indexingFeatures;
+  getFeatures2(physicalDevice, &features);
+
+  VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {};
+  indexingProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+  indexingProperties.pNext = NULL;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &indexingProperties;
+  getProperties2(physicalDevice, &properties);
+
+  support.supported =
+      indexingFeatures.runtimeDescriptorArray &&
+      indexingFeatures.descriptorBindingPartiallyBound &&
+      indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+      indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind;
+  support.nonUniformIndexing =
+      indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+      indexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+
+  const VkPhysicalDeviceDescriptorIndexingProperties &limits =
+      indexingProperties;
+  support.maxImages = minLimit(
+      BINDLESS_MAX_IMAGES,
+      minLimit(limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+               limits.maxPerStageDescriptorUpdateAfterBindSamplers));
+  support.maxImages =
+      minLimit(support.maxImages,
+               minLimit(limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                        limits.maxDescriptorSetUpdateAfterBindSamplers));
+  support.maxBuffers = minLimit(
+      BINDLESS_MAX_BUFFERS,
+      minLimit(limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+               limits.maxDescriptorSetUpdateAfterBindStorageBuffers));
+
+  if (support.maxImages == 0 || support.maxBuffers == 0)
+    support.supported = false;
+
+  return support;
+}
+
+void VulkanBindless::deviceExtensions(std::vector<const char *> &extensions) {
+  extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+  extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+}
+
+void VulkanBindless::deviceFeatures(
+    const BindlessSupport &support,
+    VkPhysicalDeviceDescriptorIndexingFeatures &features) {
+  features = VkPhysicalDeviceDescriptorIndexingFeatures();
+  features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  features.pNext = NULL;
+  features.runtimeDescriptorArray = VK_TRUE;
+  features.descriptorBindingPartiallyBound = VK_TRUE;
+  features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  features.shaderSampledImageArrayNonUniformIndexing =
+      support.nonUniformIndexing ? VK_TRUE : VK_FALSE;
+  features.shaderStorageBufferArrayNonUniformIndexing =
+      support.nonUniformIndexing ? VK_TRUE : VK_FALSE;
+}
+
+void VulkanBindless::init(VkDevice device, VulkanResources &resources,
+                          const BindlessSupport &support,
+                          VkShaderStageFlags stages) {
+  assert(support.supported);
+
+  this->device = device;
+  this->resources = &resources;
+  this->stages = stages;
+
+  images.capacity = support.maxImages;
+  images.next = 0;
+  buffers.capacity = support.maxBuffers;
+  buffers.next = 0;
+
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  bindings[0].binding = BINDLESS_IMAGE_BINDING;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = images.capacity;
+  bindings[0].stageFlags = stages;
+  bindings[0].pImmutableSamplers = NULL;
+  bindings[1].binding = BINDLESS_BUFFER_BINDING;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[1].descriptorCount = buffers.capacity;
+  bindings[1].stageFlags = stages;
+  bindings[1].pImmutableSamplers = NULL;
+
+  // Slots are written while earlier frames are still executing, which is
+  // only legal for descriptors those frames don't use; released indices are
+  // held back until the frames that could still use them have retired.
+  VkDescriptorBindingFlags bindingFlags[2];
+  bindingFlags[0] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                    VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+  bindingFlags[1] = bindingFlags[0];
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+  flagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.pNext = NULL;
+  flagsInfo.bindingCount = 2;
+  flagsInfo.pBindingFlags = bindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = 2;
+  layoutInfo.pBindings = bindings;
+
+  VkResult result =
+      vkd.CreateDescriptorSetLayout(device, &layoutInfo, vkAllocator,
+                                    &setLayout);
+  assert(result == VK_SUCCESS);
+
+  VkDescriptorPoolSize poolSizes[2];
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = images.capacity;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[1].descriptorCount = buffers.capacity;
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.pNext = NULL;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = 2;
+  poolInfo.pPoolSizes = poolSizes;
+
+  result =
+      vkd.CreateDescriptorPool(device, &poolInfo, vkAllocator, &descriptorPool);
+  assert(result == VK_SUCCESS);
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.pNext = NULL;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &setLayout;
+
+  result = vkd.AllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+  assert(result == VK_SUCCESS);
+
+  VkPushConstantRange pushRange = {};
+  pushRange.stageFlags = stages;
+  pushRange.offset = 0;
+  pushRange.size = BINDLESS_PUSH_CONSTANT_SIZE;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.pNext = NULL;
+  pipelineLayoutInfo.flags = 0;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+  result = vkd.CreatePipelineLayout(device, &pipelineLayoutInfo, vkAllocator,
+                                    &pipelineLayout);
+  assert(result == VK_SUCCESS);
+}
+
+void VulkanBindless::destroy() {
+  if (pipelineLayout != VK_NULL_HANDLE)
+    vkd.DestroyPipelineLayout(device, pipelineLayout, vkAllocator);
+  if (descriptorPool != VK_NULL_HANDLE)
+    vkd.DestroyDescriptorPool(device, descriptorPool, vkAllocator);
+  if (setLayout != VK_NULL_HANDLE)
+    vkd.DestroyDescriptorSetLayout(device, setLayout, vkAllocator);
+
+  pipelineLayout = VK_NULL_HANDLE;
+  descriptorPool = VK_NULL_HANDLE;
+  setLayout = VK_NULL_HANDLE;
+  descriptorSet = VK_NULL_HANDLE;
+}
+
+uint32_t VulkanBindless::reserve(BindlessTable &table) {
+  if (!table.freeIndices.empty()) {
+    uint32_t index = table.freeIndices.back();
+    table.freeIndices.pop_back();
+    return index;
+  }
+
+  if (table.next == table.capacity)
+    VulkanTools::exitOnError("Bindless descriptor table is full");
+
+  return table.next++;
+}
+
+void VulkanBindless::release(BindlessTable &table, uint32_t index) {
+  BindlessTable *owner = &table;
+  resources->retireCallback(
+      [owner, index]() { owner->freeIndices.push_back(index); });
+}
+
+uint32_t VulkanBindless::addImage(ResourceHandle image, VkSampler sampler,
+                                  VkImageLayout layout) {
+  const ImageResource *resource = resources->image(image);
+  assert(resource != NULL);
+
+  uint32_t index = reserve(images);
+
+  VkDescriptorImageInfo imageInfo = {};
+  imageInfo.sampler = sampler;
+  imageInfo.imageView = resource->view;
+  imageInfo.imageLayout = layout;
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.pNext = NULL;
+  write.dstSet = descriptorSet;
+  write.dstBinding = BINDLESS_IMAGE_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &imageInfo;
+  write.pBufferInfo = NULL;
+  write.pTexelBufferView = NULL;
+
+  vkd.UpdateDescriptorSets(device, 1, &write, 0, NULL);
+  return index;
+}
+
+uint32_t VulkanBindless::addBuffer(ResourceHandle buffer) {
+  const BufferResource *resource = resources->buffer(buffer);
+  assert(resource != NULL);
+
+  uint32_t index = reserve(buffers);
+
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = resource->buffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.pNext = NULL;
+  write.dstSet = descriptorSet;
+  write.dstBinding = BINDLESS_BUFFER_BINDING;
+  write.dstArrayElement = index;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pImageInfo = NULL;
+  write.pBufferInfo = &bufferInfo;
+  write.pTexelBufferView = NULL;
+
+  vkd.UpdateDescriptorSets(device, 1, &write, 0, NULL);
+  return index;
+}
+
+void VulkanBindless::removeImage(uint32_t index) { release(images, index); }
+
+void VulkanBindless::removeBuffer(uint32_t index) { release(buffers, index); }
+
+void VulkanBindless::bind(VkCommandBuffer cmdBuffer,
+                          VkPipelineBindPoint bindPoint) const {
+  vkd.CmdBindDescriptorSets(cmdBuffer, bindPoint, pipelineLayout, 0, 1,
+                            &descriptorSet, 0, NULL);
+}
+
+void VulkanBindless::push(VkCommandBuffer cmdBuffer, const void *data,
+                          uint32_t size, uint32_t offset) const {
+  assert(offset + size <= BINDLESS_PUSH_CONSTANT_SIZE);
+  vkd.CmdPushConstants(cmdBuffer, pipelineLayout, stages, offset, size, data);
+}
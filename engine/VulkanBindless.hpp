@@ -0,0 +1,81 @@
+#ifndef VULKAN_BINDLESS_HPP
+#define VULKAN_BINDLESS_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define BINDLESS_MAX_IMAGES 16384
+#define BINDLESS_MAX_BUFFERS 16384
+#define BINDLESS_PUSH_CONSTANT_SIZE 128
+#define BINDLESS_IMAGE_BINDING 0
+#define BINDLESS_BUFFER_BINDING 1
+
+struct BindlessSupport {
+  bool supported;
+  bool nonUniformIndexing;
+  uint32_t maxImages;
+  uint32_t maxBuffers;
+};
+
+struct BindlessTable {
+  uint32_t capacity;
+  uint32_t next;
+  std::vector<uint32_t> freeIndices;
+};
+
+// One update-after-bind set holds every image and storage buffer the scene
+// uses. Shaders index into it with the values returned by addImage and
+// addBuffer, which draws pass in push constants, so nothing is bound per draw.
+class VulkanBindless {
+ public:
+  VulkanBindless();
+
+  static BindlessSupport query(VkInstance instance,
+                               VkPhysicalDevice physicalDevice);
+  static void deviceExtensions(std::vector<const char *> &extensions);
+  static void deviceFeatures(
+      const BindlessSupport &support,
+      VkPhysicalDeviceDescriptorIndexingFeatures &features);
+
+  void init(VkDevice device, VulkanResources &resources,
+            const BindlessSupport &support,
+            VkShaderStageFlags stages = VK_SHADER_STAGE_ALL);
+  void destroy();
+
+  uint32_t addImage(ResourceHandle image, VkSampler sampler,
+                    VkImageLayout layout =
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  uint32_t addBuffer(ResourceHandle buffer);
+  void removeImage(uint32_t index);
+  void removeBuffer(uint32_t index);
+
+  void bind(VkCommandBuffer cmdBuffer,
+            VkPipelineBindPoint bindPoint =
+                VK_PIPELINE_BIND_POINT_GRAPHICS) const;
+  void push(VkCommandBuffer cmdBuffer, const void *data, uint32_t size,
+            uint32_t offset = 0) const;
+
+  bool enabled() const { return descriptorSet != VK_NULL_HANDLE; }
+
+  VkDescriptorSetLayout setLayout;
+  VkPipelineLayout pipelineLayout;
+  VkDescriptorSet descriptorSet;
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  VkDescriptorPool descriptorPool;
+  VkShaderStageFlags stages;
+  BindlessTable images;
+  BindlessTable buffers;
+
+  uint32_t reserve(BindlessTable &table);
+  void release(BindlessTable &table, uint32_t index);
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "VulkanCapture.hpp"
+
+VulkanCapture::VulkanCapture()
+    : device(VK_NULL_HANDLE),
+      memory(NULL),
+      resources(NULL),
+      exportMemory(false),
+      dedicatedOnly(false),
+      nextSlot(0),
+      captured(0),
+      dropped(0) {}
+
+const char *VulkanCapture::instanceExtension() {
+  return VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME;
+}
+
+CaptureSupport VulkanCapture::query(VkInstance instance,
+                                    VkPhysicalDevice physicalDevice) {
+  CaptureSupport support = {};
+
+  // Opaque fds are the POSIX handle type; Windows drivers export NT
+  // handles, which nothing here imports.
+#if !defined(_WIN32)
+  std::vector<const char *> extensions;
+  extensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+  extensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+  if (!VulkanDevice::supportsExtensions(physicalDevice, extensions))
+    return support;
+
+  PFN_vkGetPhysicalDeviceExternalBufferProperties getBufferProperties =
+      (PFN_vkGetPhysicalDeviceExternalBufferProperties)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceExternalBufferPropertiesKHR");
+  if (!getBufferProperties) return support;
+
+  VkPhysicalDeviceExternalBufferInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_BUFFER_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  VkExternalBufferProperties properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_BUFFER_PROPERTIES;
+  properties.pNext = NULL;
+  getBufferProperties(physicalDevice, &bufferInfo, &properties);
+
+  VkExternalMemoryFeatureFlags features =
+      properties.externalMemoryProperties.externalMemoryFeatures;
+  if (!(features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT)) return support;
+
+  // Dedicated allocations are named through VK_KHR_dedicated_allocation,
+  // which needs VK_KHR_get_memory_requirements2 alongside it.
+  support.dedicatedOnly =
+      (features & VK_EXTERNAL_MEMORY_FEATURE_DEDICATED_ONLY_BIT) != 0;
+  if (support.dedicatedOnly) {
+    extensions.clear();
+    extensions.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+    if (!VulkanDevice::supportsExtensions(physicalDevice, extensions))
+      return CaptureSupport();
+  }
+  support.exportMemory = true;
+#endif
+
+  return support;
+}
+
+void VulkanCapture::deviceExtensions(const CaptureSupport &support,
+                                     std::vector<const char *> &extensions) {
+  if (!support.exportMemory) return;
+
+  extensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+  extensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+  if (support.dedicatedOnly) {
+    extensions.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+  }
+}
+
+void VulkanCapture::init(VkDevice device, VulkanMemory &memory,
+                         VulkanResources &resources,
+                         const CaptureSupport &support, bool exportMemory,
+                         const Sink &sink, uint32_t slotCount) {
+  this->device = device;
+  this->memory = &memory;
+  this->resources = &resources;
+  this->sink = sink;
+
+  this->exportMemory =
+      exportMemory && support.exportMemory && vkd.GetMemoryFdKHR != NULL;
+  if (exportMemory && !this->exportMemory)
+    fprintf(stderr, "Failed to find external memory, capturing to host\n");
+  dedicatedOnly = this->exportMemory && support.dedicatedOnly;
+
+  slots.clear();
+  for (uint32_t i = 0; i < slotCount; i++) {
+    slots.push_back(std::unique_ptr<CaptureSlot>(new CaptureSlot()));
+    CaptureSlot &slot = *slots.back();
+    slot.buffer = VK_NULL_HANDLE;
+    slot.allocation = MemoryAllocation();
+    slot.exportedMemory = VK_NULL_HANDLE;
+    slot.mapped = NULL;
+    slot.fd = -1;
+    slot.capacity = 0;
+    slot.frame = CaptureFrame();
+    slot.state = CAPTURE_SLOT_FREE;
+  }
+  nextSlot = 0;
+  captured = 0;
+  dropped = 0;
+
+  // One thread keeps frames reaching the sink in order.
+  encoder.init(1);
+
+  fprintf(stdout, "Capture:        %u slots%s\n", slotCount,
+          this->exportMemory ? ", exported" : "");
+}
+
+void VulkanCapture::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  // With the device idle every recorded slot can go to the encoder, which
+  // finishes them all before it stops.
+  resources->flush();
+  encoder.destroy();
+
+  for (uint32_t i = 0; i < slots.size(); i++) destroySlot(*slots[i]);
+  slots.clear();
+
+  fprintf(stdout, "Capture:        %llu frames, %llu dropped\n",
+          (unsigned long long)captured.load(), (unsigned long long)dropped);
+  device = VK_NULL_HANDLE;
+}
+
+bool VulkanCapture::supportedFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool VulkanCapture::record(VkCommandBuffer cmdBuffer, VkImage image,
+                           VkFormat format, VkExtent2D extent,
+                           uint64_t frame) {
+  if (device == VK_NULL_HANDLE || !supportedFormat(format)) return false;
+
+  CaptureSlot &slot = *slots[nextSlot];
+  if (slot.state.load(std::memory_order_acquire) != CAPTURE_SLOT_FREE) {
+    dropped++;
+    return false;
+  }
+
+  // A free slot is done with on both the GPU and the encoder, so it can be
+  // replaced right away.
+  VkDeviceSize size =
+      (VkDeviceSize)extent.width * extent.height * CAPTURE_PIXEL_SIZE;
+  if (slot.capacity < size) {
+    destroySlot(slot);
+    createSlot(slot, size);
+  }
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = extent.width;
+  region.imageExtent.height = extent.height;
+  region.imageExtent.depth = 1;
+
+  vkd.CmdCopyImageToBuffer(cmdBuffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1,
+                           &region);
+
+  VulkanTools::BarrierBatch barriers;
+  barriers
+      .buffer(slot.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+              VK_ACCESS_HOST_READ_BIT)
+      .record(cmdBuffer);
+
+  slot.frame.data = slot.mapped;
+  slot.frame.width = extent.width;
+  slot.frame.height = extent.height;
+  slot.frame.rowPitch = extent.width * CAPTURE_PIXEL_SIZE;
+  slot.frame.format = format;
+  slot.frame.frame = frame;
+  slot.frame.fd = slot.fd;
+  slot.frame.size = size;
+  slot.state.store(CAPTURE_SLOT_RECORDED, std::memory_order_relaxed);
+  nextSlot = (nextSlot + 1) % slots.size();
+
+  CaptureSlot *recorded = &slot;
+  resources->retireCallback([this, recorded]() { encode(recorded); });
+  return true;
+}
+
+void VulkanCapture::encode(CaptureSlot *slot) {
+  slot->state.store(CAPTURE_SLOT_ENCODING, std::memory_order_relaxed);
+  encoder.submitBackground([this, slot](uint32_t) {
+    if (sink) sink(slot->frame);
+    captured++;
+    slot->state.store(CAPTURE_SLOT_FREE, std::memory_order_release);
+  });
+}
+
+void VulkanCapture::createSlot(CaptureSlot &slot, VkDeviceSize size) {
+  if (exportMemory && createExported(slot, size)) return;
+  if (exportMemory) {
+    fprintf(stderr, "Failed to export capture memory, capturing to host\n");
+    exportMemory = false;
+  }
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkResult result =
+      vkd.CreateBuffer(device, &bufferInfo, vkAllocator, &slot.buffer);
+  assert(result == VK_SUCCESS);
+
+  // The encoder reads every byte of the frame, so a cached type is worth
+  // more here than anywhere else in the engine.
+  slot.allocation = memory->allocateBuffer(
+      slot.buffer,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT, ALLOCATION_FREE_LIST,
+      MEMORY_STAGING);
+  slot.mapped = slot.allocation.mapped;
+  slot.capacity = size;
+}
+
+bool VulkanCapture::createExported(CaptureSlot &slot, VkDeviceSize size) {
+  VkExternalMemoryBufferCreateInfo externalInfo = {};
+  externalInfo.sType =
+      VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+  externalInfo.pNext = NULL;
+  externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = &externalInfo;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkResult result =
+      vkd.CreateBuffer(device, &bufferInfo, vkAllocator, &slot.buffer);
+  if (result != VK_SUCCESS) {
+    slot.buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  VkMemoryRequirements requirements;
+  vkd.GetBufferMemoryRequirements(device, slot.buffer, &requirements);
+
+  // An encoder on the GPU reads it best from device memory; the sink gets
+  // the bytes as well when that memory is also mappable.
+  uint32_t memoryType = memory->findMemoryType(
+      requirements.memoryTypeBits, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+  dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicatedInfo.pNext = NULL;
+  dedicatedInfo.image = VK_NULL_HANDLE;
+  dedicatedInfo.buffer = slot.buffer;
+
+  VkExportMemoryAllocateInfo exportInfo = {};
+  exportInfo.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+  exportInfo.pNext = dedicatedOnly ? &dedicatedInfo : NULL;
+  exportInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.pNext = &exportInfo;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  if (memoryType == UINT32_MAX ||
+      vkd.AllocateMemory(device, &allocInfo, vkAllocator,
+                         &slot.exportedMemory) != VK_SUCCESS) {
+    slot.exportedMemory = VK_NULL_HANDLE;
+    destroySlot(slot);
+    return false;
+  }
+
+  result = vkd.BindBufferMemory(device, slot.buffer, slot.exportedMemory, 0);
+  assert(result == VK_SUCCESS);
+
+  VkMemoryGetFdInfoKHR fdInfo = {};
+  fdInfo.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
+  fdInfo.pNext = NULL;
+  fdInfo.memory = slot.exportedMemory;
+  fdInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+  if (vkd.GetMemoryFdKHR(device, &fdInfo, &slot.fd) != VK_SUCCESS) {
+    slot.fd = -1;
+    destroySlot(slot);
+    return false;
+  }
+
+  VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  VkMemoryPropertyFlags flags =
+      memory->memoryProperties.memoryTypes[memoryType].propertyFlags;
+  if ((flags & mappable) == mappable) {
+    result = vkd.MapMemory(device, slot.exportedMemory, 0, VK_WHOLE_SIZE, 0,
+                           &slot.mapped);
+    if (result != VK_SUCCESS) slot.mapped = NULL;
+  }
+
+  slot.capacity = size;
+  return true;
+}
+
+void VulkanCapture::destroySlot(CaptureSlot &slot) {
+#if !defined(_WIN32)
+  if (slot.fd >= 0) close(slot.fd);
+#endif
+  slot.fd = -1;
+
+  if (slot.buffer != VK_NULL_HANDLE)
+    vkd.DestroyBuffer(device, slot.buffer, vkAllocator);
+  slot.buffer = VK_NULL_HANDLE;
+
+  // Freeing the memory unmaps it.
+  if (slot.exportedMemory != VK_NULL_HANDLE)
+    vkd.FreeMemory(device, slot.exportedMemory, vkAllocator);
+  else if (slot.allocation.memory != VK_NULL_HANDLE)
+    memory->free(slot.allocation);
+  slot.exportedMemory = VK_NULL_HANDLE;
+  slot.allocation = MemoryAllocation();
+  slot.mapped = NULL;
+  slot.capacity = 0;
+}
+
+VulkanCapture::Sink VulkanCapture::ppmSink(const std::string &prefix) {
+  return [prefix](const CaptureFrame &frame) {
+    if (!frame.data) return;
+
+    char number[32];
+    snprintf(number, sizeof(number), "%06llu.ppm",
+             (unsigned long long)frame.frame);
+    std::string path = prefix + number;
+
+    // writePPM takes RGBA, and most swapchains are BGRA.
+    const void *rgba = frame.data;
+    std::vector<uint8_t> swizzled;
+    if (frame.format == VK_FORMAT_B8G8R8A8_UNORM ||
+        frame.format == VK_FORMAT_B8G8R8A8_SRGB) {
+      const uint8_t *src = (const uint8_t *)frame.data;
+      swizzled.assign(src, src + frame.size);
+      for (size_t i = 0; i + 3 < swizzled.size(); i += CAPTURE_PIXEL_SIZE)
+        std::swap(swizzled[i], swizzled[i + 2]);
+      rgba = swizzled.data();
+    }
+
+    if (!VulkanTools::writePPM(path.c_str(), rgba, frame.width, frame.height,
+                               frame.rowPitch))
+      fprintf(stderr, "Failed to write %s\n", path.c_str());
+  };
+}
@@ -0,0 +1,127 @@
+#ifndef VULKAN_CAPTURE_HPP
+#define VULKAN_CAPTURE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "VulkanDevice.hpp"
+#include "VulkanJobs.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define CAPTURE_ENV "VULKAN_EXAMPLE_CAPTURE"
+#define CAPTURE_EXPORT_ENV "VULKAN_EXAMPLE_CAPTURE_EXPORT"
+#define CAPTURE_SLOT_COUNT 4
+#define CAPTURE_PIXEL_SIZE 4
+
+// exportMemory is set when a transfer destination buffer can be exported
+// as an opaque fd, and dedicatedOnly when the driver only exports memory
+// that was allocated for that one buffer.
+struct CaptureSupport {
+  bool exportMemory;
+  bool dedicatedOnly;
+};
+
+// A captured frame as the sink sees it. data is NULL for exported memory
+// that is not host visible; fd is -1 unless the slot is exported, and the
+// fd stays the capture's, so a sink that keeps it dup()s it.
+struct CaptureFrame {
+  const void *data;
+  uint32_t width;
+  uint32_t height;
+  uint32_t rowPitch;
+  VkFormat format;
+  uint64_t frame;
+  int fd;
+  VkDeviceSize size;
+};
+
+enum CaptureSlotState {
+  CAPTURE_SLOT_FREE = 0,
+  CAPTURE_SLOT_RECORDED,
+  CAPTURE_SLOT_ENCODING
+};
+
+// Copies frames out of the GPU without the render loop waiting on them.
+// record() copies an image into the next slot of a ring of buffers, and
+// once the frame it was recorded in retires the slot goes to the encoder
+// thread, which hands it to the sink and frees it again. A frame that finds
+// its slot still with the encoder is dropped rather than waited for, so a
+// slow sink costs captured frames but never frame time. Slots are host
+// visible and coherent, cached where the device has such a type, and grow
+// when a larger image comes along. With exportMemory each slot is instead
+// its own allocation exported as an opaque fd, dedicated to its buffer
+// where the driver requires it, so a hardware encoder can import it without
+// another copy.
+class VulkanCapture {
+ public:
+  typedef std::function<void(const CaptureFrame &frame)> Sink;
+
+  VulkanCapture();
+
+  static const char *instanceExtension();
+  static CaptureSupport query(VkInstance instance,
+                              VkPhysicalDevice physicalDevice);
+  static void deviceExtensions(const CaptureSupport &support,
+                               std::vector<const char *> &extensions);
+
+  void init(VkDevice device, VulkanMemory &memory, VulkanResources &resources,
+            const CaptureSupport &support, bool exportMemory,
+            const Sink &sink, uint32_t slotCount = CAPTURE_SLOT_COUNT);
+  void destroy();
+
+  bool record(VkCommandBuffer cmdBuffer, VkImage image, VkFormat format,
+              VkExtent2D extent, uint64_t frame);
+
+  bool enabled() const { return device != VK_NULL_HANDLE; }
+  bool exported() const { return exportMemory; }
+  uint64_t capturedFrames() const { return captured; }
+  uint64_t droppedFrames() const { return dropped; }
+
+  // Writes each frame to <prefix><frame>.ppm.
+  static Sink ppmSink(const std::string &prefix);
+
+ private:
+  struct CaptureSlot {
+    VkBuffer buffer;
+    MemoryAllocation allocation;
+    VkDeviceMemory exportedMemory;
+    void *mapped;
+    int fd;
+    VkDeviceSize capacity;
+    CaptureFrame frame;
+    std::atomic<uint32_t> state;
+  };
+
+  VkDevice device;
+  VulkanMemory *memory;
+  VulkanResources *resources;
+  bool exportMemory;
+  bool dedicatedOnly;
+  Sink sink;
+  VulkanJobs encoder;
+
+  std::vector<std::unique_ptr<CaptureSlot> > slots;
+  uint32_t nextSlot;
+  std::atomic<uint64_t> captured;
+  uint64_t dropped;
+
+  void createSlot(CaptureSlot &slot, VkDeviceSize size);
+  bool createExported(CaptureSlot &slot, VkDeviceSize size);
+  void destroySlot(CaptureSlot &slot);
+  void encode(CaptureSlot *slot);
+  static bool supportedFormat(VkFormat format);
+};
+
+#endif
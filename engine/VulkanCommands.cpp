@@ -0,0 +1,242 @@
+#include "VulkanCommands.hpp"
+
+VulkanCommands::VulkanCommands()
+    : device(VK_NULL_HANDLE), threadCount(0), currentFrame(0) {
+  recording = ParallelRecording();
+}
+
+void VulkanCommands::init(VkDevice device, uint32_t queueFamily,
+                          uint32_t threadCount, uint32_t framesInFlight) {
+  this->device = device;
+  this->threadCount = threadCount;
+  currentFrame = 0;
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.pNext = NULL;
+  cmdPoolInfo.queueFamilyIndex = queueFamily;
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  pools.resize(framesInFlight * threadCount);
+  for (uint32_t i = 0; i < pools.size(); i++) {
+    VkResult result =
+        vkd.CreateCommandPool(device, &cmdPoolInfo, vkAllocator,
+                              &pools[i].pool);
+    assert(result == VK_SUCCESS);
+    pools[i].primariesUsed = 0;
+    pools[i].secondariesUsed = 0;
+  }
+}
+
+void VulkanCommands::destroy() {
+  for (uint32_t i = 0; i < pools.size(); i++)
+    vkd.DestroyCommandPool(device, pools[i].pool, vkAllocator);
+  pools.clear();
+  secondaries.clear();
+}
+
+ThreadCommandPool &VulkanCommands::pool(uint32_t frame, uint32_t thread) {
+  return pools[frame * threadCount + thread];
+}
+
+void VulkanCommands::beginFrame(uint32_t frame) {
+  currentFrame = frame;
+
+  for (uint32_t i = 0; i < threadCount; i++) {
+    ThreadCommandPool &threadPool = pool(frame, i);
+    if (threadPool.primariesUsed == 0 && threadPool.secondariesUsed == 0)
+      continue;
+
+    VkResult result = vkd.ResetCommandPool(device, threadPool.pool, 0);
+    assert(result == VK_SUCCESS);
+
+    threadPool.primariesUsed = 0;
+    threadPool.secondariesUsed = 0;
+  }
+}
+
+VkCommandBuffer VulkanCommands::allocate(ThreadCommandPool &threadPool,
+                                         VkCommandBufferLevel level) {
+  bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  std::vector<VkCommandBuffer> &freeList =
+      primary ? threadPool.primaries : threadPool.secondaries;
+  uint32_t &used =
+      primary ? threadPool.primariesUsed : threadPool.secondariesUsed;
+
+  if (used == freeList.size()) {
+    VkCommandBufferAllocateInfo cmdInfo = {};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.pNext = NULL;
+    cmdInfo.commandPool = threadPool.pool;
+    cmdInfo.level = level;
+    cmdInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmdBuffer;
+    VkResult result = vkd.AllocateCommandBuffers(device, &cmdInfo, &cmdBuffer);
+    assert(result == VK_SUCCESS);
+    freeList.push_back(cmdBuffer);
+  }
+
+  return freeList[used++];
+}
+
+VkCommandBuffer VulkanCommands::primary(uint32_t thread) {
+  return allocate(pool(currentFrame, thread), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+}
+
+VkCommandBuffer VulkanCommands::beginSecondary(uint32_t thread,
+                                               VkRenderPass renderPass,
+                                               VkFramebuffer framebuffer) {
+  VkCommandBuffer cmdBuffer = allocate(pool(currentFrame, thread),
+                                       VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.pNext = NULL;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = framebuffer;
+  inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+  inheritanceInfo.queryFlags = 0;
+  inheritanceInfo.pipelineStatistics = 0;
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.pNext = NULL;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (renderPass != VK_NULL_HANDLE)
+    beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  VkResult result = vkd.BeginCommandBuffer(cmdBuffer, &beginInfo);
+  assert(result == VK_SUCCESS);
+
+  return cmdBuffer;
+}
+
+void VulkanCommands::recordParallel(VulkanJobs &jobs, VkCommandBuffer primary,
+                                    uint32_t chunkCount,
+                                    const RecordChunk &record,
+                                    VkRenderPass renderPass,
+                                    VkFramebuffer framebuffer) {
+  if (chunkCount == 0) return;
+
+  secondaries.resize(chunkCount);
+
+  // The jobs only capture what std::function stores in place; the rest of
+  // the call is read back from here until wait() returns.
+  recording.record = &record;
+  recording.renderPass = renderPass;
+  recording.framebuffer = framebuffer;
+
+  for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+    jobs.submit([this, chunk](uint32_t thread) {
+      TRACE_ZONE("recordChunk");
+      VkCommandBuffer cmdBuffer = beginSecondary(
+          thread, recording.renderPass, recording.framebuffer);
+      (*recording.record)(cmdBuffer, chunk);
+
+      VkResult result = vkd.EndCommandBuffer(cmdBuffer);
+      assert(result == VK_SUCCESS);
+
+      secondaries[chunk] = cmdBuffer;
+    });
+  }
+
+  jobs.wait();
+
+  vkd.CmdExecuteCommands(primary, chunkCount, secondaries.data());
+}
+
+VulkanStaticCommands::VulkanStaticCommands()
+    : device(VK_NULL_HANDLE), cmdPool(VK_NULL_HANDLE), records(0), replays(0) {}
+
+void VulkanStaticCommands::init(VkDevice device, uint32_t queueFamily,
+                                uint32_t slotCount) {
+  this->device = device;
+  records = replays = 0;
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.pNext = NULL;
+  cmdPoolInfo.queueFamilyIndex = queueFamily;
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  VkResult result =
+      vkd.CreateCommandPool(device, &cmdPoolInfo, vkAllocator, &cmdPool);
+  assert(result == VK_SUCCESS);
+
+  std::vector<VkCommandBuffer> cmdBuffers(slotCount);
+
+  VkCommandBufferAllocateInfo cmdInfo = {};
+  cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdInfo.pNext = NULL;
+  cmdInfo.commandPool = cmdPool;
+  cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  cmdInfo.commandBufferCount = slotCount;
+
+  result = vkd.AllocateCommandBuffers(device, &cmdInfo, cmdBuffers.data());
+  assert(result == VK_SUCCESS);
+
+  buffers.resize(slotCount);
+  for (uint32_t i = 0; i < slotCount; i++) {
+    buffers[i].cmdBuffer = cmdBuffers[i];
+    buffers[i].renderPass = VK_NULL_HANDLE;
+    buffers[i].key = 0;
+    buffers[i].valid = false;
+  }
+}
+
+void VulkanStaticCommands::destroy() {
+  if (cmdPool != VK_NULL_HANDLE)
+    vkd.DestroyCommandPool(device, cmdPool, vkAllocator);
+  cmdPool = VK_NULL_HANDLE;
+  buffers.clear();
+}
+
+void VulkanStaticCommands::invalidate() {
+  for (uint32_t i = 0; i < buffers.size(); i++) buffers[i].valid = false;
+}
+
+void VulkanStaticCommands::execute(VkCommandBuffer primary, uint32_t slot,
+                                   VkRenderPass renderPass, uint64_t key,
+                                   const Record &record) {
+  StaticCommandBuffer &entry = buffers[slot];
+
+  if (!entry.valid || entry.renderPass != renderPass || entry.key != key) {
+    TRACE_ZONE("recordStatic");
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = NULL;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+    inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+    inheritanceInfo.queryFlags = 0;
+    inheritanceInfo.pipelineStatistics = 0;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = NULL;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult result = vkd.BeginCommandBuffer(entry.cmdBuffer, &beginInfo);
+    assert(result == VK_SUCCESS);
+
+    record(entry.cmdBuffer);
+
+    result = vkd.EndCommandBuffer(entry.cmdBuffer);
+    assert(result == VK_SUCCESS);
+
+    entry.renderPass = renderPass;
+    entry.key = key;
+    entry.valid = true;
+    records++;
+  } else {
+    replays++;
+  }
+
+  vkd.CmdExecuteCommands(primary, 1, &entry.cmdBuffer);
+}
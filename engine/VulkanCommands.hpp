@@ -0,0 +1,97 @@
+#ifndef VULKAN_COMMANDS_HPP
+#define VULKAN_COMMANDS_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <functional>
+#include <vector>
+
+#include "VulkanJobs.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanTrace.hpp"
+
+struct ThreadCommandPool {
+  VkCommandPool pool;
+  std::vector<VkCommandBuffer> primaries;
+  std::vector<VkCommandBuffer> secondaries;
+  uint32_t primariesUsed;
+  uint32_t secondariesUsed;
+};
+
+struct StaticCommandBuffer {
+  VkCommandBuffer cmdBuffer;
+  VkRenderPass renderPass;
+  uint64_t key;
+  bool valid;
+};
+
+class VulkanCommands {
+ public:
+  typedef std::function<void(VkCommandBuffer cmdBuffer, uint32_t chunk)>
+      RecordChunk;
+
+  VulkanCommands();
+  void init(VkDevice device, uint32_t queueFamily, uint32_t threadCount,
+            uint32_t framesInFlight);
+  void destroy();
+
+  void beginFrame(uint32_t frame);
+  VkCommandBuffer primary(uint32_t thread);
+  VkCommandBuffer beginSecondary(
+      uint32_t thread, VkRenderPass renderPass = VK_NULL_HANDLE,
+      VkFramebuffer framebuffer = VK_NULL_HANDLE);
+  void recordParallel(VulkanJobs &jobs, VkCommandBuffer primary,
+                      uint32_t chunkCount, const RecordChunk &record,
+                      VkRenderPass renderPass = VK_NULL_HANDLE,
+                      VkFramebuffer framebuffer = VK_NULL_HANDLE);
+
+ private:
+  struct ParallelRecording {
+    const RecordChunk *record;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+  };
+
+  VkDevice device;
+  uint32_t threadCount;
+  uint32_t currentFrame;
+  std::vector<ThreadCommandPool> pools;
+  std::vector<VkCommandBuffer> secondaries;
+  ParallelRecording recording;
+
+  ThreadCommandPool &pool(uint32_t frame, uint32_t thread);
+  VkCommandBuffer allocate(ThreadCommandPool &threadPool,
+                           VkCommandBufferLevel level);
+};
+
+// Secondary command buffers for content that stays the same from frame to
+// frame. Each slot, one per frame in flight and window, keeps one that is
+// recorded once and replayed until invalidate() is called or the render pass
+// or key, such as the swapchain generation, changes. It is re-recorded only
+// once that slot's previous submission has completed. They are begun without
+// ONE_TIME_SUBMIT and without a framebuffer, so one recording serves every
+// swapchain image.
+class VulkanStaticCommands {
+ public:
+  typedef std::function<void(VkCommandBuffer cmdBuffer)> Record;
+
+  VulkanStaticCommands();
+  void init(VkDevice device, uint32_t queueFamily, uint32_t slotCount);
+  void destroy();
+
+  void invalidate();
+  void execute(VkCommandBuffer primary, uint32_t slot,
+               VkRenderPass renderPass, uint64_t key, const Record &record);
+
+  uint64_t recordCount() const { return records; }
+  uint64_t replayCount() const { return replays; }
+
+ private:
+  VkDevice device;
+  VkCommandPool cmdPool;
+  std::vector<StaticCommandBuffer> buffers;
+  uint64_t records;
+  uint64_t replays;
+};
+
+#endif
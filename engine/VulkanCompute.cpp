@@ -0,0 +1,291 @@
+#include "VulkanCompute.hpp"
+
+VulkanAsyncCompute::VulkanAsyncCompute()
+    : waitStage(VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT),
+      device(VK_NULL_HANDLE),
+      submitter(NULL),
+      timeline(NULL),
+      computeQueue(VK_NULL_HANDLE),
+      graphicsQueue(VK_NULL_HANDLE),
+      computeFamily(0),
+      graphicsFamily(0),
+      currentFrame(0),
+      computeValue(0),
+      submitted(false),
+      graphicsSignalled(false) {}
+
+void VulkanAsyncCompute::init(VkDevice device, const QueueRegistry &queues,
+                              VulkanSubmitter &submitter,
+                              uint32_t framesInFlight, bool enable) {
+  this->device = device;
+  this->submitter = &submitter;
+  timeline = submitter.timeline();
+  computeQueue = queues.queue(QUEUE_COMPUTE);
+  graphicsQueue = queues.queue(QUEUE_GRAPHICS);
+  computeFamily = queues.family(QUEUE_COMPUTE);
+  graphicsFamily = queues.family(QUEUE_GRAPHICS);
+
+  if (!enable || !queues.separate(QUEUE_COMPUTE)) {
+    fprintf(stdout, "Async Compute:  off, sharing the graphics queue\n");
+    return;
+  }
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.pNext = NULL;
+  cmdPoolInfo.queueFamilyIndex = computeFamily;
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = NULL;
+  semaphoreInfo.flags = 0;
+
+  frames.resize(framesInFlight);
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+    ComputeFrame &frame = frames[i];
+
+    VkResult result =
+        vkd.CreateCommandPool(device, &cmdPoolInfo, vkAllocator,
+                              &frame.cmdPool);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferAllocateInfo cmdInfo = {};
+    cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdInfo.pNext = NULL;
+    cmdInfo.commandPool = frame.cmdPool;
+    cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdInfo.commandBufferCount = 1;
+
+    result = vkd.AllocateCommandBuffers(device, &cmdInfo, &frame.cmdBuffer);
+    assert(result == VK_SUCCESS);
+
+    frame.computeComplete = VK_NULL_HANDLE;
+    frame.graphicsComplete = VK_NULL_HANDLE;
+    if (timeline) continue;
+
+    result = vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                                 &frame.computeComplete);
+    assert(result == VK_SUCCESS);
+
+    result = vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                                 &frame.graphicsComplete);
+    assert(result == VK_SUCCESS);
+  }
+
+  fprintf(stdout, "Async Compute:  on, family %u%s\n", computeFamily,
+          computeFamily != graphicsFamily ? " with ownership transfers" : "");
+}
+
+void VulkanAsyncCompute::destroy() {
+  for (uint32_t i = 0; i < frames.size(); i++) {
+    vkd.DestroySemaphore(device, frames[i].computeComplete, vkAllocator);
+    vkd.DestroySemaphore(device, frames[i].graphicsComplete, vkAllocator);
+    vkd.DestroyCommandPool(device, frames[i].cmdPool, vkAllocator);
+  }
+
+  frames.clear();
+  shared.clear();
+  submitted = false;
+  graphicsSignalled = false;
+}
+
+uint32_t VulkanAsyncCompute::share(const SharedResource &resource) {
+  for (uint32_t i = 0; i < shared.size(); i++) {
+    if (!shared[i].active) {
+      shared[i] = resource;
+      return i;
+    }
+  }
+
+  shared.push_back(resource);
+  return shared.size() - 1;
+}
+
+uint32_t VulkanAsyncCompute::shareBuffer(VkBuffer buffer,
+                                         VkPipelineStageFlags graphicsStages,
+                                         VkAccessFlags graphicsAccess,
+                                         VkPipelineStageFlags computeStages,
+                                         VkAccessFlags computeAccess,
+                                         ComputeOwner owner) {
+  SharedResource resource = {};
+  resource.buffer = buffer;
+  resource.image = VK_NULL_HANDLE;
+  resource.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  resource.graphicsStages = graphicsStages;
+  resource.graphicsAccess = graphicsAccess;
+  resource.computeStages = computeStages;
+  resource.computeAccess = computeAccess;
+  resource.owner = owner;
+  resource.active = true;
+  return share(resource);
+}
+
+uint32_t VulkanAsyncCompute::shareImage(
+    VkImage image, const VkImageSubresourceRange &range, VkImageLayout layout,
+    VkPipelineStageFlags graphicsStages, VkAccessFlags graphicsAccess,
+    VkPipelineStageFlags computeStages, VkAccessFlags computeAccess,
+    ComputeOwner owner) {
+  SharedResource resource = {};
+  resource.buffer = VK_NULL_HANDLE;
+  resource.image = image;
+  resource.range = range;
+  resource.layout = layout;
+  resource.graphicsStages = graphicsStages;
+  resource.graphicsAccess = graphicsAccess;
+  resource.computeStages = computeStages;
+  resource.computeAccess = computeAccess;
+  resource.owner = owner;
+  resource.active = true;
+  return share(resource);
+}
+
+void VulkanAsyncCompute::unshare(uint32_t id) {
+  if (id < shared.size()) shared[id].active = false;
+}
+
+void VulkanAsyncCompute::transfer(VulkanTools::BarrierBatch &barriers,
+                                  const SharedResource &resource,
+                                  bool toCompute, bool release) const {
+  uint32_t srcFamily = toCompute ? graphicsFamily : computeFamily;
+  uint32_t dstFamily = toCompute ? computeFamily : graphicsFamily;
+
+  // The releasing side only makes its writes available and the acquiring
+  // side only makes them visible; the semaphore between them orders the two.
+  VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  VkAccessFlags srcAccess = 0;
+  VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  VkAccessFlags dstAccess = 0;
+
+  if (release) {
+    srcStages = toCompute ? resource.graphicsStages : resource.computeStages;
+    srcAccess = toCompute ? resource.graphicsAccess : resource.computeAccess;
+  } else {
+    dstStages = toCompute ? resource.computeStages : resource.graphicsStages;
+    dstAccess = toCompute ? resource.computeAccess : resource.graphicsAccess;
+  }
+
+  if (resource.buffer != VK_NULL_HANDLE)
+    barriers.buffer(resource.buffer, srcStages, srcAccess, dstStages,
+                    dstAccess, 0, VK_WHOLE_SIZE, srcFamily, dstFamily);
+  else
+    barriers.image(resource.image, resource.layout, resource.layout,
+                   resource.range, srcStages, srcAccess, dstStages, dstAccess,
+                   srcFamily, dstFamily);
+}
+
+VkCommandBuffer VulkanAsyncCompute::begin(uint32_t frame,
+                                          VkCommandBuffer graphicsCmdBuffer) {
+  currentFrame = frame;
+  submitted = false;
+  if (!async()) return graphicsCmdBuffer;
+
+  ComputeFrame &computeFrame = frames[frame];
+
+  VkResult result = vkd.ResetCommandPool(device, computeFrame.cmdPool, 0);
+  assert(result == VK_SUCCESS);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.pNext = NULL;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = NULL;
+
+  result = vkd.BeginCommandBuffer(computeFrame.cmdBuffer, &beginInfo);
+  assert(result == VK_SUCCESS);
+
+  VulkanTools::BarrierBatch barriers;
+  for (uint32_t i = 0; i < shared.size(); i++) {
+    SharedResource &resource = shared[i];
+    if (!resource.active || resource.owner != OWNER_TO_COMPUTE) continue;
+
+    if (computeFamily != graphicsFamily)
+      transfer(barriers, resource, true, false);
+    resource.owner = OWNER_COMPUTE;
+  }
+  barriers.record(computeFrame.cmdBuffer);
+
+  return computeFrame.cmdBuffer;
+}
+
+void VulkanAsyncCompute::end(VkCommandBuffer graphicsCmdBuffer) {
+  if (!async()) return;
+
+  ComputeFrame &computeFrame = frames[currentFrame];
+  bool ownership = computeFamily != graphicsFamily;
+
+  VulkanTools::BarrierBatch releases;
+  VulkanTools::BarrierBatch acquires;
+  waitStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+
+  for (uint32_t i = 0; i < shared.size(); i++) {
+    SharedResource &resource = shared[i];
+    if (!resource.active || resource.owner != OWNER_COMPUTE) continue;
+
+    if (ownership) {
+      transfer(releases, resource, false, true);
+      transfer(acquires, resource, false, false);
+    }
+    resource.owner = OWNER_GRAPHICS;
+    waitStage |= resource.graphicsStages;
+  }
+
+  releases.record(computeFrame.cmdBuffer);
+
+  VkResult result = vkd.EndCommandBuffer(computeFrame.cmdBuffer);
+  assert(result == VK_SUCCESS);
+
+  const ComputeFrame &previous =
+      frames[(currentFrame + frames.size() - 1) % frames.size()];
+  if (graphicsSignalled && timeline)
+    submitter->wait(computeQueue, graphicsQueue,
+                    timeline->submitted(graphicsQueue),
+                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+  else if (graphicsSignalled)
+    submitter->wait(computeQueue, previous.graphicsComplete,
+                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+  submitter->submit(computeQueue, computeFrame.cmdBuffer);
+
+  if (timeline)
+    computeValue = timeline->next(computeQueue);
+  else
+    submitter->signal(computeQueue, computeFrame.computeComplete);
+
+  submitted = true;
+  graphicsSignalled = false;
+  acquires.record(graphicsCmdBuffer);
+}
+
+void VulkanAsyncCompute::release(VkCommandBuffer graphicsCmdBuffer) {
+  if (!async()) return;
+
+  VulkanTools::BarrierBatch barriers;
+  for (uint32_t i = 0; i < shared.size(); i++) {
+    SharedResource &resource = shared[i];
+    if (!resource.active || resource.owner != OWNER_GRAPHICS) continue;
+
+    if (computeFamily != graphicsFamily)
+      transfer(barriers, resource, true, true);
+    resource.owner = OWNER_TO_COMPUTE;
+  }
+  barriers.record(graphicsCmdBuffer);
+
+  graphicsSignalled = true;
+}
+
+void VulkanAsyncCompute::queueGraphicsWait() {
+  if (!submitted) return;
+
+  if (timeline)
+    submitter->wait(graphicsQueue, computeQueue, computeValue, waitStage);
+  else
+    submitter->wait(graphicsQueue, frames[currentFrame].computeComplete,
+                    waitStage);
+}
+
+void VulkanAsyncCompute::queueGraphicsSignal() {
+  // The next compute submission waits on the graphics timeline instead.
+  if (!graphicsSignalled || timeline) return;
+
+  submitter->signal(graphicsQueue, frames[currentFrame].graphicsComplete);
+}
@@ -0,0 +1,103 @@
+#ifndef VULKAN_COMPUTE_HPP
+#define VULKAN_COMPUTE_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanSubmit.hpp"
+#include "VulkanTools.hpp"
+
+#define ASYNC_COMPUTE_DISABLE_ENV "VULKAN_EXAMPLE_NO_ASYNC_COMPUTE"
+
+enum ComputeOwner {
+  OWNER_GRAPHICS = 0,
+  OWNER_COMPUTE,
+  OWNER_TO_GRAPHICS,
+  OWNER_TO_COMPUTE
+};
+
+// A resource both queues touch. It is handed over in the same layout each
+// way, and the stage and access masks say how each side uses it.
+struct SharedResource {
+  VkBuffer buffer;
+  VkImage image;
+  VkImageSubresourceRange range;
+  VkImageLayout layout;
+  VkPipelineStageFlags graphicsStages;
+  VkAccessFlags graphicsAccess;
+  VkPipelineStageFlags computeStages;
+  VkAccessFlags computeAccess;
+  ComputeOwner owner;
+  bool active;
+};
+
+struct ComputeFrame {
+  VkCommandPool cmdPool;
+  VkCommandBuffer cmdBuffer;
+  VkSemaphore computeComplete;
+  VkSemaphore graphicsComplete;
+};
+
+// Compute work recorded between begin() and end() goes to the compute queue
+// when it is separate from graphics, and into the graphics command buffer
+// otherwise. Shared resources round-trip each frame. Graphics releases them
+// at the end of its frame and signals a semaphore that the next compute
+// submission waits on. Compute acquires, does its work, releases them back,
+// and signals the semaphore the graphics submission waits on. With a
+// timeline, both sides wait on the other queue's counter instead.
+class VulkanAsyncCompute {
+ public:
+  VulkanAsyncCompute();
+  void init(VkDevice device, const QueueRegistry &queues,
+            VulkanSubmitter &submitter, uint32_t framesInFlight,
+            bool enable = true);
+  void destroy();
+
+  bool async() const { return !frames.empty(); }
+
+  uint32_t shareBuffer(VkBuffer buffer, VkPipelineStageFlags graphicsStages,
+                       VkAccessFlags graphicsAccess,
+                       VkPipelineStageFlags computeStages,
+                       VkAccessFlags computeAccess,
+                       ComputeOwner owner = OWNER_COMPUTE);
+  uint32_t shareImage(VkImage image, const VkImageSubresourceRange &range,
+                      VkImageLayout layout, VkPipelineStageFlags graphicsStages,
+                      VkAccessFlags graphicsAccess,
+                      VkPipelineStageFlags computeStages,
+                      VkAccessFlags computeAccess,
+                      ComputeOwner owner = OWNER_COMPUTE);
+  void unshare(uint32_t id);
+
+  VkCommandBuffer begin(uint32_t frame, VkCommandBuffer graphicsCmdBuffer);
+  void end(VkCommandBuffer graphicsCmdBuffer);
+  void release(VkCommandBuffer graphicsCmdBuffer);
+
+  void queueGraphicsWait();
+  void queueGraphicsSignal();
+
+  VkPipelineStageFlags waitStage;
+
+ private:
+  VkDevice device;
+  VulkanSubmitter *submitter;
+  VulkanTimeline *timeline;
+  VkQueue computeQueue;
+  VkQueue graphicsQueue;
+  uint32_t computeFamily;
+  uint32_t graphicsFamily;
+  std::vector<ComputeFrame> frames;
+  std::vector<SharedResource> shared;
+  uint32_t currentFrame;
+  uint64_t computeValue;
+  bool submitted;
+  bool graphicsSignalled;
+
+  uint32_t share(const SharedResource &resource);
+  void transfer(VulkanTools::BarrierBatch &barriers,
+                const SharedResource &resource, bool toCompute,
+                bool release) const;
+};
+
+#endif
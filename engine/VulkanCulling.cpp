@@ -0,0 +1,564 @@
+#include "VulkanCulling.hpp"
+
+static const float identity[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+                                   0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                   0.0f, 0.0f, 0.0f, 1.0f};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint32_t floorPowerOfTwo(uint32_t value) {
+  uint32_t result = 1;
+  while (result * 2 <= value) result *= 2;
+  return result;
+}
+
+static uint32_t groupCount(uint32_t count, uint32_t groupSize) {
+  return (count + groupSize - 1) / groupSize;
+}
+
+VulkanCulling::VulkanCulling()
+    : device(VK_NULL_HANDLE),
+      resources(NULL),
+      descriptors(NULL),
+      draws(NULL),
+      compute(NULL),
+      support(),
+      capacity(0),
+      cullLayout(VK_NULL_HANDLE),
+      hizLayout(VK_NULL_HANDLE),
+      cullPipelineLayout(VK_NULL_HANDLE),
+      hizPipelineLayout(VK_NULL_HANDLE),
+      cullPipeline(VK_NULL_HANDLE),
+      hizPipeline(VK_NULL_HANDLE),
+      sampler(VK_NULL_HANDLE),
+      mappedBounds(NULL),
+      paramsSize(0),
+      streamSize(0),
+      regionSize(0),
+      version(1),
+      objectCount(0),
+      outputDrawsShare(0),
+      outputCountShare(0),
+      hizWidth(0),
+      hizHeight(0),
+      hizShare(0),
+      hizReady(false),
+      hizValid(false) {
+  memcpy(viewProj, identity, sizeof(viewProj));
+  memcpy(previousViewProj, identity, sizeof(previousViewProj));
+  setViewProjection(identity);
+}
+
+void VulkanCulling::init(VkDevice device, VulkanResources &resources,
+                         VulkanDescriptorLayouts &layouts,
+                         VulkanDescriptorAllocator &descriptors,
+                         VulkanShaders &shaders,
+                         VulkanPipelineCache &pipelineCache,
+                         VulkanIndirectDraws &draws,
+                         VulkanAsyncCompute &compute,
+                         const IndirectSupport &support,
+                         uint32_t framesInFlight) {
+  this->device = device;
+  this->resources = &resources;
+  this->descriptors = &descriptors;
+  this->draws = &draws;
+  this->compute = &compute;
+  this->support = support;
+  this->support.drawCount =
+      support.drawCount && vkd.CmdDrawIndexedIndirectCountKHR != NULL;
+  capacity = draws.capacity();
+
+  // The SPIR-V is built from engine/shaders when glslangValidator is found,
+  // so a tree built without it simply keeps drawing every object.
+  std::string cullPath = VulkanShaders::path(CULLING_SHADER);
+  std::string hizPath = VulkanShaders::path(HIZ_SHADER);
+  if (VulkanTools::fileModifiedTime(cullPath.c_str()) < 0 ||
+      VulkanTools::fileModifiedTime(hizPath.c_str()) < 0) {
+    fprintf(stdout, "Culling:        unavailable, %s not found\n",
+            cullPath.c_str());
+    return;
+  }
+
+  uint32_t cullShader = shaders.load(cullPath.c_str());
+  uint32_t hizShader = shaders.load(hizPath.c_str());
+  if (cullShader == SHADER_INVALID || hizShader == SHADER_INVALID) return;
+
+  DescriptorLayoutKey cullKey;
+  for (uint32_t i = 0; i < 7; i++)
+    cullKey.add(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_SHADER_STAGE_COMPUTE_BIT);
+  cullKey.add(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              VK_SHADER_STAGE_COMPUTE_BIT);
+  cullKey.add(8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+              VK_SHADER_STAGE_COMPUTE_BIT);
+  cullLayout = layouts.layout(cullKey);
+
+  DescriptorLayoutKey hizKey;
+  hizKey.add(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+             VK_SHADER_STAGE_COMPUTE_BIT);
+  hizKey.add(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
+  hizLayout = layouts.layout(hizKey);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.pNext = NULL;
+  pipelineLayoutInfo.flags = 0;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &cullLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = NULL;
+
+  VkResult result = vkd.CreatePipelineLayout(device, &pipelineLayoutInfo,
+                                             vkAllocator, &cullPipelineLayout);
+  assert(result == VK_SUCCESS);
+
+  VkPushConstantRange pushRange = {};
+  pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushRange.offset = 0;
+  pushRange.size = 2 * sizeof(uint32_t);
+
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &hizLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+  result = vkd.CreatePipelineLayout(device, &pipelineLayoutInfo, vkAllocator,
+                                    &hizPipelineLayout);
+  assert(result == VK_SUCCESS);
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.pNext = NULL;
+  samplerInfo.flags = 0;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+  result = vkd.CreateSampler(device, &samplerInfo, vkAllocator, &sampler);
+  assert(result == VK_SUCCESS);
+
+  // Uniform and storage buffer offsets are aligned to at most 256 bytes,
+  // so padding the parameters and every stream to that lets them share one
+  // buffer.
+  paramsSize = alignUp(sizeof(CullParams), 256);
+  streamSize = alignUp(capacity * sizeof(float), 256);
+  regionSize = paramsSize + streamSize * CULL_BOUNDS_STREAMS;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = regionSize * framesInFlight;
+  bufferInfo.usage =
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = NULL;
+
+  boundsBuffer = resources.createBuffer(
+      bufferInfo,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  mappedBounds = (float *)resources.buffer(boundsBuffer)->allocation.mapped;
+  assert(mappedBounds != NULL);
+
+  bufferInfo.size = capacity * sizeof(VkDrawIndexedIndirectCommand);
+  bufferInfo.usage =
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  outputDraws = resources.createBuffer(bufferInfo,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  bufferInfo.size = sizeof(uint32_t);
+  bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  outputCount = resources.createBuffer(bufferInfo,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  // Culling writes the outputs and graphics reads them for its draws.
+  outputDrawsShare = compute.shareBuffer(
+      resources.buffer(outputDraws)->buffer,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  outputCountShare = compute.shareBuffer(
+      resources.buffer(outputCount)->buffer,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+  regionVersions.assign(framesInFlight, 0);
+  regionCounts.assign(framesInFlight, 0);
+  resizeHiZ(1, 1, OWNER_COMPUTE);
+
+  VkPipelineCache cache = pipelineCache.cache;
+  cullPipeline = createPipeline(shaders, cullShader, cullPipelineLayout, cache);
+  hizPipeline = createPipeline(shaders, hizShader, hizPipelineLayout, cache);
+
+  fprintf(stdout, "Culling:        GPU, %u objects%s\n", capacity,
+          this->support.drawCount ? ", compacted" : "");
+}
+
+VkPipeline VulkanCulling::createPipeline(VulkanShaders &shaders,
+                                         uint32_t shader,
+                                         VkPipelineLayout layout,
+                                         VkPipelineCache cache) {
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = NULL;
+  pipelineInfo.flags = 0;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.pNext = NULL;
+  pipelineInfo.stage.flags = 0;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaders.module(shader);
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = NULL;
+  pipelineInfo.layout = layout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline;
+  VkResult result = vkd.CreateComputePipelines(device, cache, 1, &pipelineInfo,
+                                               vkAllocator, &pipeline);
+  assert(result == VK_SUCCESS);
+
+  return pipeline;
+}
+
+void VulkanCulling::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  if (cullPipeline != VK_NULL_HANDLE)
+    vkd.DestroyPipeline(device, cullPipeline, vkAllocator);
+  if (hizPipeline != VK_NULL_HANDLE)
+    vkd.DestroyPipeline(device, hizPipeline, vkAllocator);
+  if (cullPipelineLayout != VK_NULL_HANDLE)
+    vkd.DestroyPipelineLayout(device, cullPipelineLayout, vkAllocator);
+  if (hizPipelineLayout != VK_NULL_HANDLE)
+    vkd.DestroyPipelineLayout(device, hizPipelineLayout, vkAllocator);
+  if (sampler != VK_NULL_HANDLE)
+    vkd.DestroySampler(device, sampler, vkAllocator);
+
+  destroyHiZ();
+  compute->unshare(outputDrawsShare);
+  compute->unshare(outputCountShare);
+  resources->destroyBuffer(boundsBuffer);
+  resources->destroyBuffer(outputDraws);
+  resources->destroyBuffer(outputCount);
+
+  cullPipeline = hizPipeline = VK_NULL_HANDLE;
+  cullPipelineLayout = hizPipelineLayout = VK_NULL_HANDLE;
+  sampler = VK_NULL_HANDLE;
+  boundsBuffer = outputDraws = outputCount = ResourceHandle();
+  mappedBounds = NULL;
+  device = VK_NULL_HANDLE;
+}
+
+void VulkanCulling::setBounds(uint32_t draw, const ObjectBounds &bounds) {
+  assert(draw < capacity);
+
+  if (draw >= this->bounds.size()) {
+    ObjectBounds unbounded = {{0.0f, 0.0f, 0.0f}, -1.0f};
+    this->bounds.resize(draw + 1, unbounded);
+  } else if (memcmp(&this->bounds[draw], &bounds, sizeof(bounds)) == 0) {
+    return;
+  }
+
+  this->bounds[draw] = bounds;
+  version++;
+}
+
+void VulkanCulling::setViewProjection(const float *viewProj) {
+  memcpy(this->viewProj, viewProj, sizeof(this->viewProj));
+
+  // Planes come from the rows of the column-major matrix, for the 0..w
+  // depth range Vulkan clips to.
+  const float *m = viewProj;
+  for (uint32_t i = 0; i < 4; i++) {
+    float row0 = m[i * 4], row1 = m[i * 4 + 1];
+    float row2 = m[i * 4 + 2], row3 = m[i * 4 + 3];
+    planes[0][i] = row3 + row0;
+    planes[1][i] = row3 - row0;
+    planes[2][i] = row3 + row1;
+    planes[3][i] = row3 - row1;
+    planes[4][i] = row2;
+    planes[5][i] = row3 - row2;
+  }
+
+  for (uint32_t i = 0; i < 6; i++) {
+    float length = sqrtf(planes[i][0] * planes[i][0] +
+                         planes[i][1] * planes[i][1] +
+                         planes[i][2] * planes[i][2]);
+    if (length == 0.0f) continue;
+    for (uint32_t j = 0; j < 4; j++) planes[i][j] /= length;
+  }
+}
+
+void VulkanCulling::cull(VkCommandBuffer cmdBuffer, uint32_t frame) {
+  objectCount = enabled() ? draws->drawCount() : 0;
+  if (!enabled()) return;
+
+  // The pyramid is first used on whichever queue culls, so it is moved out
+  // of its undefined layout here even in frames with nothing to draw.
+  VulkanTools::BarrierBatch barriers;
+  if (!hizReady) {
+    barriers
+        .image(resources->image(hiz)->image, VK_IMAGE_LAYOUT_UNDEFINED,
+               VK_IMAGE_LAYOUT_GENERAL,
+               VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT))
+        .record(cmdBuffer);
+    hizReady = true;
+  }
+  if (objectCount == 0) return;
+
+  VkDeviceSize regionOffset = frame * regionSize;
+  VkDeviceSize streamOffset = regionOffset + paramsSize;
+  if (regionVersions[frame] != version || regionCounts[frame] != objectCount) {
+    float *streams = mappedBounds + streamOffset / sizeof(float);
+    uint32_t stride = streamSize / sizeof(float);
+
+    for (uint32_t i = 0; i < objectCount; i++) {
+      bool known = i < bounds.size();
+      streams[i] = known ? bounds[i].center[0] : 0.0f;
+      streams[stride + i] = known ? bounds[i].center[1] : 0.0f;
+      streams[stride * 2 + i] = known ? bounds[i].center[2] : 0.0f;
+      streams[stride * 3 + i] = known ? bounds[i].radius : -1.0f;
+    }
+    regionVersions[frame] = version;
+    regionCounts[frame] = objectCount;
+  }
+
+  CullParams &params =
+      *(CullParams *)((char *)mappedBounds + regionOffset);
+  memcpy(params.planes, planes, sizeof(params.planes));
+  memcpy(params.previousViewProj, previousViewProj,
+         sizeof(params.previousViewProj));
+  params.hizSize[0] = hizWidth;
+  params.hizSize[1] = hizHeight;
+  params.objectCount = objectCount;
+  params.flags = (hizValid ? CULL_FLAG_OCCLUSION : 0) |
+                 (support.drawCount ? CULL_FLAG_COMPACT : 0);
+
+  VkBuffer outputBuffer = resources->buffer(outputDraws)->buffer;
+  VkBuffer countBuffer = resources->buffer(outputCount)->buffer;
+  VkDeviceSize drawSize = capacity * sizeof(VkDrawIndexedIndirectCommand);
+
+  // Last frame's indirect reads have to finish before the outputs are
+  // reset and rewritten.
+  barriers
+      .buffer(outputBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT)
+      .buffer(countBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT)
+      .record(cmdBuffer);
+
+  vkd.CmdFillBuffer(cmdBuffer, countBuffer, 0, sizeof(uint32_t), 0);
+
+  barriers
+      .buffer(countBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT,
+              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+      .record(cmdBuffer);
+
+  VkBuffer paramsBuffer = resources->buffer(boundsBuffer)->buffer;
+  DescriptorSetKey setKey(cullLayout);
+  for (uint32_t i = 0; i < CULL_BOUNDS_STREAMS; i++) {
+    setKey.buffer(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                  paramsBuffer, streamOffset, streamSize);
+    streamOffset += streamSize;
+  }
+  setKey
+      .buffer(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, draws->commandBuffer(),
+              draws->commandOffset(), drawSize)
+      .buffer(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, outputBuffer, 0, drawSize)
+      .buffer(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, countBuffer, 0,
+              sizeof(uint32_t))
+      .image(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+             resources->image(hiz)->view, sampler, VK_IMAGE_LAYOUT_GENERAL)
+      .buffer(8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, paramsBuffer,
+              regionOffset, sizeof(CullParams));
+  VkDescriptorSet set = descriptors->set(setKey);
+
+  vkd.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+  vkd.CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            cullPipelineLayout, 0, 1, &set, 0, NULL);
+  vkd.CmdDispatch(cmdBuffer, groupCount(objectCount, CULLING_GROUP_SIZE), 1,
+                  1);
+
+  barriers
+      .buffer(outputBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+              VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+      .buffer(countBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+              VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+              VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+      .record(cmdBuffer);
+}
+
+void VulkanCulling::draw(VkCommandBuffer cmdBuffer) const {
+  if (objectCount == 0) return;
+
+  VulkanIndirectDraws::record(cmdBuffer, support,
+                              resources->buffer(outputDraws)->buffer, 0,
+                              resources->buffer(outputCount)->buffer, 0,
+                              objectCount);
+}
+
+void VulkanCulling::buildHiZ(VkCommandBuffer cmdBuffer,
+                             const VulkanDepthBuffer &depth) {
+  if (objectCount == 0 || !depth.sampled()) {
+    hizValid = false;
+    return;
+  }
+
+  resizeHiZ(floorPowerOfTwo(depth.imageWidth()),
+            floorPowerOfTwo(depth.imageHeight()), OWNER_GRAPHICS);
+
+  VkImage hizImage = resources->image(hiz)->image;
+
+  // Culling read the pyramid earlier in this frame. The depth buffer is
+  // already in its read-only layout; the render graph moved it there.
+  VulkanTools::BarrierBatch barriers;
+  if (!hizReady) {
+    barriers.image(hizImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_GENERAL,
+                   VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT));
+    hizReady = true;
+  } else {
+    barriers.memory(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_SHADER_WRITE_BIT);
+  }
+  barriers.record(cmdBuffer);
+
+  vkd.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipeline);
+
+  uint32_t size[2] = {hizWidth, hizHeight};
+  for (uint32_t level = 0; level < hizLevels.size(); level++) {
+    DescriptorSetKey setKey(hizLayout);
+    if (level == 0)
+      setKey.image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depth.view(),
+                   sampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    else
+      setKey.image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                   hizLevels[level - 1], sampler, VK_IMAGE_LAYOUT_GENERAL);
+    setKey.image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, hizLevels[level],
+                 VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
+    VkDescriptorSet set = descriptors->set(setKey);
+
+    vkd.CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              hizPipelineLayout, 0, 1, &set, 0, NULL);
+    vkd.CmdPushConstants(cmdBuffer, hizPipelineLayout,
+                         VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(size), size);
+    vkd.CmdDispatch(cmdBuffer, groupCount(size[0], HIZ_GROUP_SIZE),
+                    groupCount(size[1], HIZ_GROUP_SIZE), 1);
+
+    // The last barrier also covers next frame's culling.
+    barriers
+        .memory(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT)
+        .record(cmdBuffer);
+
+    size[0] = size[0] > 1 ? size[0] / 2 : 1;
+    size[1] = size[1] > 1 ? size[1] / 2 : 1;
+  }
+
+  memcpy(previousViewProj, viewProj, sizeof(previousViewProj));
+  hizValid = true;
+}
+
+void VulkanCulling::resizeHiZ(uint32_t width, uint32_t height,
+                              ComputeOwner owner) {
+  if (hiz.valid() && width == hizWidth && height == hizHeight) return;
+
+  destroyHiZ();
+  hizWidth = width;
+  hizHeight = height;
+
+  uint32_t levels = 1;
+  while ((width | height) >> levels) levels++;
+
+  VkImageCreateInfo imageInfo = {};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.pNext = NULL;
+  imageInfo.flags = 0;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.extent.width = width;
+  imageInfo.extent.height = height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = levels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.queueFamilyIndexCount = 0;
+  imageInfo.pQueueFamilyIndices = NULL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  hiz = resources->createImage(imageInfo, VK_IMAGE_ASPECT_COLOR_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                               ALLOCATION_FREE_LIST, MEMORY_DEPTH);
+
+  VkImageViewCreateInfo viewInfo = {};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.pNext = NULL;
+  viewInfo.flags = 0;
+  viewInfo.image = resources->image(hiz)->image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+                         VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+
+  hizLevels.resize(levels);
+  for (uint32_t i = 0; i < levels; i++) {
+    viewInfo.subresourceRange =
+        VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+    VkResult result =
+        vkd.CreateImageView(device, &viewInfo, vkAllocator, &hizLevels[i]);
+    assert(result == VK_SUCCESS);
+  }
+
+  // Graphics builds the pyramid and culling samples it, both in the
+  // general layout.
+  hizShare = compute->shareImage(
+      viewInfo.image,
+      VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 0, levels),
+      VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, owner);
+
+  hizReady = false;
+  hizValid = false;
+}
+
+void VulkanCulling::destroyHiZ() {
+  if (hiz.valid()) compute->unshare(hizShare);
+
+  for (uint32_t i = 0; i < hizLevels.size(); i++)
+    resources->retireImageView(hizLevels[i]);
+  hizLevels.clear();
+
+  resources->destroyImage(hiz);
+  hiz = ResourceHandle();
+}
@@ -0,0 +1,131 @@
+#ifndef VULKAN_CULLING_HPP
+#define VULKAN_CULLING_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "VulkanCompute.hpp"
+#include "VulkanDepthBuffer.hpp"
+#include "VulkanDescriptors.hpp"
+#include "VulkanIndirect.hpp"
+#include "VulkanPipelineCache.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanShaders.hpp"
+#include "VulkanTools.hpp"
+
+#define CULLING_SHADER "cull.comp.spv"
+#define HIZ_SHADER "hiz.comp.spv"
+#define CULLING_GROUP_SIZE 64
+#define HIZ_GROUP_SIZE 8
+#define CULL_FLAG_OCCLUSION 1
+#define CULL_FLAG_COMPACT 2
+#define CULL_BOUNDS_STREAMS 4
+
+// Matches the std140 CullParams block in cull.comp. Each frame's region of
+// the bounds buffer starts with one, so the culling pass reads nothing owned
+// by the graphics queue besides the buffers it shares through
+// VulkanAsyncCompute.
+struct CullParams {
+  float planes[6][4];
+  float previousViewProj[16];
+  float hizSize[2];
+  uint32_t objectCount;
+  uint32_t flags;
+};
+
+// The std140 offsets the shader reads each field at.
+static_assert(offsetof(CullParams, planes) == 0, "CullParams layout");
+static_assert(offsetof(CullParams, previousViewProj) == 96,
+              "CullParams layout");
+static_assert(offsetof(CullParams, hizSize) == 160, "CullParams layout");
+static_assert(offsetof(CullParams, objectCount) == 168, "CullParams layout");
+static_assert(offsetof(CullParams, flags) == 172, "CullParams layout");
+static_assert(sizeof(CullParams) == 176, "CullParams layout");
+
+struct ObjectBounds {
+  float center[3];
+  float radius;
+};
+
+// Culls the draws of a VulkanIndirectDraws list on the GPU. Bounds are kept
+// as separate x, y, z and radius streams so each invocation reads four
+// tightly packed floats, and the draw templates are read straight from the
+// indirect list's own region. A Hi-Z pyramid built from the depth buffer at
+// the end of each frame is tested against the next frame's objects, using
+// the view-projection it was rendered with.
+class VulkanCulling {
+ public:
+  VulkanCulling();
+  void init(VkDevice device, VulkanResources &resources,
+            VulkanDescriptorLayouts &layouts,
+            VulkanDescriptorAllocator &descriptors, VulkanShaders &shaders,
+            VulkanPipelineCache &pipelineCache, VulkanIndirectDraws &draws,
+            VulkanAsyncCompute &compute, const IndirectSupport &support,
+            uint32_t framesInFlight);
+  void destroy();
+
+  bool enabled() const { return cullPipeline != VK_NULL_HANDLE; }
+
+  void setBounds(uint32_t draw, const ObjectBounds &bounds);
+  void setViewProjection(const float *viewProj);
+
+  void cull(VkCommandBuffer cmdBuffer, uint32_t frame);
+  void draw(VkCommandBuffer cmdBuffer) const;
+  void buildHiZ(VkCommandBuffer cmdBuffer, const VulkanDepthBuffer &depth);
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  VulkanDescriptorAllocator *descriptors;
+  VulkanIndirectDraws *draws;
+  VulkanAsyncCompute *compute;
+  IndirectSupport support;
+  uint32_t capacity;
+
+  VkDescriptorSetLayout cullLayout;
+  VkDescriptorSetLayout hizLayout;
+  VkPipelineLayout cullPipelineLayout;
+  VkPipelineLayout hizPipelineLayout;
+  VkPipeline cullPipeline;
+  VkPipeline hizPipeline;
+  VkSampler sampler;
+
+  ResourceHandle boundsBuffer;
+  float *mappedBounds;
+  VkDeviceSize paramsSize;
+  VkDeviceSize streamSize;
+  VkDeviceSize regionSize;
+  std::vector<ObjectBounds> bounds;
+  std::vector<uint64_t> regionVersions;
+  std::vector<uint32_t> regionCounts;
+  uint64_t version;
+
+  ResourceHandle outputDraws;
+  ResourceHandle outputCount;
+  uint32_t objectCount;
+  uint32_t outputDrawsShare;
+  uint32_t outputCountShare;
+
+  ResourceHandle hiz;
+  std::vector<VkImageView> hizLevels;
+  uint32_t hizWidth;
+  uint32_t hizHeight;
+  uint32_t hizShare;
+  bool hizReady;
+  bool hizValid;
+
+  float viewProj[16];
+  float previousViewProj[16];
+  float planes[6][4];
+
+  VkPipeline createPipeline(VulkanShaders &shaders, uint32_t shader,
+                            VkPipelineLayout layout, VkPipelineCache cache);
+  void resizeHiZ(uint32_t width, uint32_t height, ComputeOwner owner);
+  void destroyHiZ();
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "VulkanDebug.hpp"
+
+VulkanDebug debugUtils;
+
+#if VULKAN_DEBUG
+
+static bool hasLayer(const char *name) {
+  uint32_t layerCount = 0;
+  VkResult result = vkEnumerateInstanceLayerProperties(&layerCount, NULL);
+  if (result != VK_SUCCESS) return false;
+
+  std::vector<VkLayerProperties> layers(layerCount);
+  result = vkEnumerateInstanceLayerProperties(&layerCount, layers.data());
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) return false;
+
+  for (uint32_t i = 0; i < layerCount; i++)
+    if (strcmp(name, layers[i].layerName) == 0) return true;
+
+  return false;
+}
+
+VulkanDebugUtils<true>::VulkanDebugUtils()
+    : available(false),
+      validation(false),
+      instance(VK_NULL_HANDLE),
+      device(VK_NULL_HANDLE),
+      messenger(VK_NULL_HANDLE),
+      warnings(0),
+      errors(0),
+      createMessenger(NULL),
+      destroyMessenger(NULL),
+      setObjectName(NULL),
+      cmdBeginLabel(NULL),
+      cmdEndLabel(NULL),
+      cmdInsertLabel(NULL) {
+  messengerInfo = {};
+}
+
+void VulkanDebugUtils<true>::instanceExtensions(
+    std::vector<const char *> &extensions, std::vector<const char *> &layers) {
+  validation = getenv(DEBUG_VALIDATION_DISABLE_ENV) == NULL &&
+               hasLayer(DEBUG_VALIDATION_LAYER);
+  if (validation) layers.push_back(DEBUG_VALIDATION_LAYER);
+
+  available = VulkanDevice::supportsInstanceExtension(
+      VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  if (available) extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+
+  fprintf(stdout, "Validation:     %s%s\n", validation ? "enabled" : "off",
+          available ? ", debug utils" : "");
+}
+
+const void *VulkanDebugUtils<true>::instanceNext() {
+  if (!available) return NULL;
+
+  messengerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+  messengerInfo.pNext = NULL;
+  messengerInfo.flags = 0;
+  messengerInfo.messageSeverity =
+      VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+      VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+  messengerInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                              VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                              VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+  messengerInfo.pfnUserCallback = callback;
+  messengerInfo.pUserData = this;
+  return &messengerInfo;
+}
+
+void VulkanDebugUtils<true>::init(VkInstance instance) {
+  this->instance = instance;
+  if (!available) return;
+
+  createMessenger = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+      instance, "vkCreateDebugUtilsMessengerEXT");
+  destroyMessenger =
+      (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(
+          instance, "vkDestroyDebugUtilsMessengerEXT");
+  setObjectName = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(
+      instance, "vkSetDebugUtilsObjectNameEXT");
+  cmdBeginLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+      instance, "vkCmdBeginDebugUtilsLabelEXT");
+  cmdEndLabel = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+      instance, "vkCmdEndDebugUtilsLabelEXT");
+  cmdInsertLabel = (PFN_vkCmdInsertDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+      instance, "vkCmdInsertDebugUtilsLabelEXT");
+
+  if (!createMessenger || !destroyMessenger) return;
+  VkResult result =
+      createMessenger(instance, &messengerInfo, vkAllocator, &messenger);
+  if (result != VK_SUCCESS) messenger = VK_NULL_HANDLE;
+}
+
+void VulkanDebugUtils<true>::initDevice(VkDevice device) {
+  this->device = device;
+}
+
+void VulkanDebugUtils<true>::destroy() {
+  if (messenger != VK_NULL_HANDLE)
+    destroyMessenger(instance, messenger, vkAllocator);
+  messenger = VK_NULL_HANDLE;
+  device = VK_NULL_HANDLE;
+
+  if (warnings > 0 || errors > 0)
+    fprintf(stdout, "Validation:     %u errors, %u warnings\n",
+            (uint32_t)errors, (uint32_t)warnings);
+}
+
+void VulkanDebugUtils<true>::setName(VkObjectType type, uint64_t handle,
+                                     const char *name) {
+  if (!setObjectName || device == VK_NULL_HANDLE || handle == 0) return;
+
+  VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+  nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+  nameInfo.pNext = NULL;
+  nameInfo.objectType = type;
+  nameInfo.objectHandle = handle;
+  nameInfo.pObjectName = name;
+  setObjectName(device, &nameInfo);
+}
+
+void VulkanDebugUtils<true>::beginLabel(VkCommandBuffer cmdBuffer,
+                                        const char *name) {
+  if (!cmdBeginLabel) return;
+
+  VkDebugUtilsLabelEXT label = {};
+  label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+  label.pNext = NULL;
+  label.pLabelName = name;
+  cmdBeginLabel(cmdBuffer, &label);
+}
+
+void VulkanDebugUtils<true>::endLabel(VkCommandBuffer cmdBuffer) {
+  if (cmdEndLabel) cmdEndLabel(cmdBuffer);
+}
+
+void VulkanDebugUtils<true>::insertLabel(VkCommandBuffer cmdBuffer,
+                                         const char *name) {
+  if (!cmdInsertLabel) return;
+
+  VkDebugUtilsLabelEXT label = {};
+  label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+  label.pNext = NULL;
+  label.pLabelName = name;
+  cmdInsertLabel(cmdBuffer, &label);
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugUtils<true>::callback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    VkDebugUtilsMessageTypeFlagsEXT types,
+    const VkDebugUtilsMessengerCallbackDataEXT *data, void *user) {
+  VulkanDebugUtils<true> *debug = (VulkanDebugUtils<true> *)user;
+  bool error = severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+  if (error)
+    debug->errors++;
+  else
+    debug->warnings++;
+
+  fprintf(stderr, "%s %s: %s\n", error ? "Error" : "Warning",
+          data->pMessageIdName ? data->pMessageIdName : "validation",
+          data->pMessage);
+  return VK_FALSE;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef VULKAN_DEBUG_HPP
+#define VULKAN_DEBUG_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanTools.hpp"
+
+// configure --enable-debug sets this; Visual Studio debug configurations
+// get it from _DEBUG.
+#ifndef VULKAN_DEBUG
+#if defined(_DEBUG)
+#define VULKAN_DEBUG 1
+#else
+#define VULKAN_DEBUG 0
+#endif
+#endif
+
+#define DEBUG_VALIDATION_LAYER "VK_LAYER_KHRONOS_validation"
+#define DEBUG_VALIDATION_DISABLE_ENV "VULKAN_EXAMPLE_VALIDATION_DISABLE"
+
+// Release policy: every call is an empty inline, so object names, labels
+// and the messenger leave nothing behind on the draw path. Callers that
+// build a name at runtime test VulkanDebug::enabled first, which the
+// compiler folds away with the call.
+template <bool Enabled>
+class VulkanDebugUtils {
+ public:
+  static const bool enabled = false;
+
+  void instanceExtensions(std::vector<const char *> &extensions,
+                          std::vector<const char *> &layers) {}
+  const void *instanceNext() { return NULL; }
+  void init(VkInstance instance) {}
+  void initDevice(VkDevice device) {}
+  void destroy() {}
+
+  template <typename T>
+  void name(VkObjectType type, T handle, const char *name) {}
+  void beginLabel(VkCommandBuffer cmdBuffer, const char *name) {}
+  void endLabel(VkCommandBuffer cmdBuffer) {}
+  void insertLabel(VkCommandBuffer cmdBuffer, const char *name) {}
+};
+
+// Debug policy: VK_LAYER_KHRONOS_validation when it is installed, unless
+// DEBUG_VALIDATION_DISABLE_ENV is set, and VK_EXT_debug_utils for a
+// messenger that prints warnings and errors, object names and command
+// buffer labels. The messenger is also chained into instance creation, so
+// messages from vkCreateInstance and vkDestroyInstance are caught too.
+template <>
+class VulkanDebugUtils<true> {
+ public:
+  static const bool enabled = true;
+
+  VulkanDebugUtils();
+
+  void instanceExtensions(std::vector<const char *> &extensions,
+                          std::vector<const char *> &layers);
+  const void *instanceNext();
+  void init(VkInstance instance);
+  void initDevice(VkDevice device);
+  void destroy();
+
+  template <typename T>
+  void name(VkObjectType type, T handle, const char *name) {
+    setName(type, (uint64_t)handle, name);
+  }
+  void beginLabel(VkCommandBuffer cmdBuffer, const char *name);
+  void endLabel(VkCommandBuffer cmdBuffer);
+  void insertLabel(VkCommandBuffer cmdBuffer, const char *name);
+
+ private:
+  bool available;
+  bool validation;
+  VkInstance instance;
+  VkDevice device;
+  VkDebugUtilsMessengerEXT messenger;
+  VkDebugUtilsMessengerCreateInfoEXT messengerInfo;
+  std::atomic<uint32_t> warnings;
+  std::atomic<uint32_t> errors;
+
+  PFN_vkCreateDebugUtilsMessengerEXT createMessenger;
+  PFN_vkDestroyDebugUtilsMessengerEXT destroyMessenger;
+  PFN_vkSetDebugUtilsObjectNameEXT setObjectName;
+  PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginLabel;
+  PFN_vkCmdEndDebugUtilsLabelEXT cmdEndLabel;
+  PFN_vkCmdInsertDebugUtilsLabelEXT cmdInsertLabel;
+
+  void setName(VkObjectType type, uint64_t handle, const char *name);
+  static VKAPI_ATTR VkBool32 VKAPI_CALL
+  callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+           VkDebugUtilsMessageTypeFlagsEXT types,
+           const VkDebugUtilsMessengerCallbackDataEXT *data, void *user);
+};
+
+typedef VulkanDebugUtils<VULKAN_DEBUG != 0> VulkanDebug;
+
+extern VulkanDebug debugUtils;
+
+template <bool Enabled>
+class DebugLabelScope {
+ public:
+  DebugLabelScope(VkCommandBuffer cmdBuffer, const char *name) {}
+};
+
+template <>
+class DebugLabelScope<true> {
+ public:
+  DebugLabelScope(VkCommandBuffer cmdBuffer, const char *name)
+      : cmdBuffer(cmdBuffer) {
+    debugUtils.beginLabel(cmdBuffer, name);
+  }
+  ~DebugLabelScope() { debugUtils.endLabel(cmdBuffer); }
+
+ private:
+  VkCommandBuffer cmdBuffer;
+};
+
+#define DEBUG_CONCAT_(a, b) a##b
+#define DEBUG_CONCAT(a, b) DEBUG_CONCAT_(a, b)
+#define DEBUG_LABEL(cmdBuffer, name)                 \
+  DebugLabelScope<VulkanDebug::enabled> DEBUG_CONCAT( \
+      debugLabel, __LINE__)(cmdBuffer, name)
+
+#endif
@@ -0,0 +1,134 @@
+#include "VulkanDepthBuffer.hpp"
+
+static const VkFormat depthFormats[] = {VK_FORMAT_D32_SFLOAT,
+                                        VK_FORMAT_D32_SFLOAT_S8_UINT,
+                                        VK_FORMAT_D24_UNORM_S8_UINT,
+                                        VK_FORMAT_D16_UNORM};
+
+static const VkFormat stencilFormats[] = {VK_FORMAT_D32_SFLOAT_S8_UINT,
+                                          VK_FORMAT_D24_UNORM_S8_UINT,
+                                          VK_FORMAT_D16_UNORM_S8_UINT};
+
+// Formats that can be sampled after the pass, without a stencil aspect to
+// split off in the view.
+static const VkFormat sampledFormats[] = {VK_FORMAT_D32_SFLOAT,
+                                          VK_FORMAT_D16_UNORM};
+
+static bool hasStencil(VkFormat format) {
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D16_UNORM_S8_UINT;
+}
+
+VulkanDepthBuffer::VulkanDepthBuffer()
+    : memory(NULL),
+      resources(NULL),
+      depthFormat(VK_FORMAT_UNDEFINED),
+      aspects(0),
+      width(0),
+      height(0),
+      lazy(false),
+      readable(false) {}
+
+VkFormat VulkanDepthBuffer::chooseFormat(VkPhysicalDevice physicalDevice,
+                                         bool stencil, bool sampled) {
+  const VkFormat *candidates = stencil ? stencilFormats : depthFormats;
+  uint32_t count = stencil ? sizeof(stencilFormats) / sizeof(VkFormat)
+                           : sizeof(depthFormats) / sizeof(VkFormat);
+  VkFormatFeatureFlags features =
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+  if (sampled && !stencil) {
+    candidates = sampledFormats;
+    count = sizeof(sampledFormats) / sizeof(VkFormat);
+    features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, candidates[i],
+                                        &properties);
+    if ((properties.optimalTilingFeatures & features) == features)
+      return candidates[i];
+  }
+
+  return VK_FORMAT_UNDEFINED;
+}
+
+void VulkanDepthBuffer::init(VkPhysicalDevice physicalDevice,
+                             VulkanMemory &memory, VulkanResources &resources,
+                             bool stencil, bool sampled) {
+  this->memory = &memory;
+  this->resources = &resources;
+  readable = sampled && !stencil;
+
+  depthFormat = chooseFormat(physicalDevice, stencil, readable);
+  if (depthFormat == VK_FORMAT_UNDEFINED)
+    VulkanTools::exitOnError("No supported depth attachment format");
+
+  aspects = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (hasStencil(depthFormat)) aspects |= VK_IMAGE_ASPECT_STENCIL_BIT;
+}
+
+void VulkanDepthBuffer::destroy() {
+  if (resources) resources->destroyImage(depthImage);
+  depthImage = ResourceHandle();
+  width = 0;
+  height = 0;
+}
+
+void VulkanDepthBuffer::resize(uint32_t width, uint32_t height) {
+  if (depthImage.valid() && width == this->width && height == this->height)
+    return;
+
+  // The old image is retired rather than destroyed, so frames still in
+  // flight keep it and the framebuffers built on its view.
+  resources->destroyImage(depthImage);
+
+  this->width = width;
+  this->height = height;
+
+  // Depth is cleared on load and discarded on store, so on tiled GPUs it
+  // never has to leave tile memory and lazily allocated memory is never
+  // committed. A sampled depth buffer is stored instead, for passes that
+  // read it after the render pass.
+  VkImageCreateInfo imageInfo = {};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.pNext = NULL;
+  imageInfo.flags = 0;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = depthFormat;
+  imageInfo.extent.width = width;
+  imageInfo.extent.height = height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    (readable ? VK_IMAGE_USAGE_SAMPLED_BIT
+                              : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.queueFamilyIndexCount = 0;
+  imageInfo.pQueueFamilyIndices = NULL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  depthImage = resources->createImage(
+      imageInfo, aspects, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      readable ? 0 : VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+      ALLOCATION_FREE_LIST, MEMORY_DEPTH);
+
+  uint32_t memoryType = resources->image(depthImage)->allocation.memoryType;
+  lazy = (memory->memoryProperties.memoryTypes[memoryType].propertyFlags &
+          VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+}
+
+VkImage VulkanDepthBuffer::image() const {
+  const ImageResource *resource = resources->image(depthImage);
+  return resource ? resource->image : VK_NULL_HANDLE;
+}
+
+VkImageView VulkanDepthBuffer::view() const {
+  const ImageResource *resource = resources->image(depthImage);
+  return resource ? resource->view : VK_NULL_HANDLE;
+}
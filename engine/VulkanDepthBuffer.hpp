@@ -0,0 +1,48 @@
+#ifndef VULKAN_DEPTH_BUFFER_HPP
+#define VULKAN_DEPTH_BUFFER_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+
+#include "VulkanMemory.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+// A single depth image is shared by every swapchain image. All frames render
+// on one queue and the render pass orders depth writes against the previous
+// frame, so one attachment is enough however many images are in flight.
+class VulkanDepthBuffer {
+ public:
+  VulkanDepthBuffer();
+  void init(VkPhysicalDevice physicalDevice, VulkanMemory &memory,
+            VulkanResources &resources, bool stencil = false,
+            bool sampled = false);
+  void destroy();
+
+  void resize(uint32_t width, uint32_t height);
+
+  VkFormat format() const { return depthFormat; }
+  uint32_t imageWidth() const { return width; }
+  uint32_t imageHeight() const { return height; }
+  VkImage image() const;
+  VkImageView view() const;
+  bool lazilyAllocated() const { return lazy; }
+  bool sampled() const { return readable; }
+  VkImageAspectFlags imageAspects() const { return aspects; }
+
+  static VkFormat chooseFormat(VkPhysicalDevice physicalDevice, bool stencil,
+                               bool sampled = false);
+
+ private:
+  VulkanMemory *memory;
+  VulkanResources *resources;
+  VkFormat depthFormat;
+  VkImageAspectFlags aspects;
+  ResourceHandle depthImage;
+  uint32_t width;
+  uint32_t height;
+  bool lazy;
+  bool readable;
+};
+
+#endif
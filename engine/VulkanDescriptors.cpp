@@ -0,0 +1,368 @@
+#include "VulkanDescriptors.hpp"
+
+// Descriptors reserved per set in each pool, by type.
+static const VkDescriptorPoolSize poolRatios[] = {
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1}};
+
+static bool isImageDescriptor(VkDescriptorType type) {
+  return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+         type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+         type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+         type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+         type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+DescriptorLayoutKey::DescriptorLayoutKey() : bindingCount(0) {}
+
+DescriptorLayoutKey &DescriptorLayoutKey::add(
+    uint32_t binding, VkDescriptorType type, VkShaderStageFlags stages,
+    uint32_t descriptorCount, const VkSampler *immutableSamplers) {
+  assert(bindingCount < DESCRIPTOR_SET_MAX_BINDINGS);
+
+  VkDescriptorSetLayoutBinding &entry = bindings[bindingCount++];
+  entry.binding = binding;
+  entry.descriptorType = type;
+  entry.descriptorCount = descriptorCount;
+  entry.stageFlags = stages;
+  entry.pImmutableSamplers = immutableSamplers;
+  return *this;
+}
+
+bool DescriptorLayoutKey::operator==(const DescriptorLayoutKey &other) const {
+  if (bindingCount != other.bindingCount) return false;
+
+  for (uint32_t i = 0; i < bindingCount; i++) {
+    const VkDescriptorSetLayoutBinding &a = bindings[i];
+    const VkDescriptorSetLayoutBinding &b = other.bindings[i];
+    if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+        a.descriptorCount != b.descriptorCount ||
+        a.stageFlags != b.stageFlags ||
+        a.pImmutableSamplers != b.pImmutableSamplers)
+      return false;
+  }
+
+  return true;
+}
+
+DescriptorSetKey::DescriptorSetKey(VkDescriptorSetLayout layout)
+    : layout(layout), writeCount(0) {}
+
+DescriptorSetKey &DescriptorSetKey::buffer(uint32_t binding,
+                                           VkDescriptorType type,
+                                           VkBuffer buffer,
+                                           VkDeviceSize offset,
+                                           VkDeviceSize range) {
+  assert(writeCount < DESCRIPTOR_SET_MAX_BINDINGS);
+
+  DescriptorWrite &write = writes[writeCount++];
+  write = DescriptorWrite();
+  write.binding = binding;
+  write.type = type;
+  write.buffer.buffer = buffer;
+  write.buffer.offset = offset;
+  write.buffer.range = range;
+  return *this;
+}
+
+DescriptorSetKey &DescriptorSetKey::image(uint32_t binding,
+                                          VkDescriptorType type,
+                                          VkImageView view, VkSampler sampler,
+                                          VkImageLayout layout) {
+  assert(writeCount < DESCRIPTOR_SET_MAX_BINDINGS);
+
+  DescriptorWrite &write = writes[writeCount++];
+  write = DescriptorWrite();
+  write.binding = binding;
+  write.type = type;
+  write.image.sampler = sampler;
+  write.image.imageView = view;
+  write.image.imageLayout = layout;
+  return *this;
+}
+
+bool DescriptorSetKey::operator==(const DescriptorSetKey &other) const {
+  if (layout != other.layout || writeCount != other.writeCount) return false;
+
+  for (uint32_t i = 0; i < writeCount; i++) {
+    const DescriptorWrite &a = writes[i];
+    const DescriptorWrite &b = other.writes[i];
+    if (a.binding != b.binding || a.type != b.type ||
+        a.buffer.buffer != b.buffer.buffer ||
+        a.buffer.offset != b.buffer.offset ||
+        a.buffer.range != b.buffer.range ||
+        a.image.sampler != b.image.sampler ||
+        a.image.imageView != b.image.imageView ||
+        a.image.imageLayout != b.image.imageLayout)
+      return false;
+  }
+
+  return true;
+}
+
+size_t DescriptorLayoutKeyHash::operator()(
+    const DescriptorLayoutKey &key) const {
+  size_t seed = key.bindingCount;
+  for (uint32_t i = 0; i < key.bindingCount; i++) {
+    const VkDescriptorSetLayoutBinding &binding = key.bindings[i];
+    VulkanTools::hashCombine(seed, binding.binding);
+    VulkanTools::hashCombine(seed, binding.descriptorType);
+    VulkanTools::hashCombine(seed, binding.descriptorCount);
+    VulkanTools::hashCombine(seed, binding.stageFlags);
+    VulkanTools::hashCombine(seed, (uint64_t)binding.pImmutableSamplers);
+  }
+  return seed;
+}
+
+size_t DescriptorSetKeyHash::operator()(const DescriptorSetKey &key) const {
+  size_t seed = key.writeCount;
+  VulkanTools::hashCombine(seed, (uint64_t)key.layout);
+  for (uint32_t i = 0; i < key.writeCount; i++) {
+    const DescriptorWrite &write = key.writes[i];
+    VulkanTools::hashCombine(seed, write.binding);
+    VulkanTools::hashCombine(seed, write.type);
+    VulkanTools::hashCombine(seed, (uint64_t)write.buffer.buffer);
+    VulkanTools::hashCombine(seed, write.buffer.offset);
+    VulkanTools::hashCombine(seed, write.buffer.range);
+    VulkanTools::hashCombine(seed, (uint64_t)write.image.sampler);
+    VulkanTools::hashCombine(seed, (uint64_t)write.image.imageView);
+    VulkanTools::hashCombine(seed, write.image.imageLayout);
+  }
+  return seed;
+}
+
+VulkanDescriptorLayouts::VulkanDescriptorLayouts() : device(VK_NULL_HANDLE) {}
+
+void VulkanDescriptorLayouts::init(VkDevice device) { this->device = device; }
+
+void VulkanDescriptorLayouts::destroy() {
+  std::unordered_map<DescriptorLayoutKey, VkDescriptorSetLayout,
+                     DescriptorLayoutKeyHash>::iterator it;
+  for (it = layouts.begin(); it != layouts.end(); ++it)
+    vkd.DestroyDescriptorSetLayout(device, it->second, vkAllocator);
+  layouts.clear();
+}
+
+VkDescriptorSetLayout VulkanDescriptorLayouts::layout(
+    const DescriptorLayoutKey &key) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::unordered_map<DescriptorLayoutKey, VkDescriptorSetLayout,
+                     DescriptorLayoutKeyHash>::iterator it = layouts.find(key);
+  if (it != layouts.end()) return it->second;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = NULL;
+  layoutInfo.flags = 0;
+  layoutInfo.bindingCount = key.bindingCount;
+  layoutInfo.pBindings = key.bindings;
+
+  VkDescriptorSetLayout setLayout;
+  VkResult result =
+      vkd.CreateDescriptorSetLayout(device, &layoutInfo, vkAllocator,
+                                    &setLayout);
+  assert(result == VK_SUCCESS);
+
+  layouts[key] = setLayout;
+  return setLayout;
+}
+
+static const uint32_t emptyBucket = UINT32_MAX;
+
+// Probes from the key's hash to the bucket holding it, or to the empty one
+// it would go in.
+static uint32_t &findBucket(DescriptorFrame &frame,
+                            const DescriptorSetKey &key, size_t hash) {
+  size_t mask = frame.buckets.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    uint32_t &bucket = frame.buckets[i];
+    if (bucket == emptyBucket) return bucket;
+
+    const DescriptorFrameSet &entry = frame.sets[bucket];
+    if (entry.hash == hash && entry.key == key) return bucket;
+  }
+}
+
+static void growBuckets(DescriptorFrame &frame) {
+  frame.buckets.assign(
+      std::max<size_t>(frame.buckets.size() * 2, DESCRIPTOR_FRAME_BUCKETS),
+      emptyBucket);
+  for (uint32_t i = 0; i < frame.sets.size(); i++)
+    findBucket(frame, frame.sets[i].key, frame.sets[i].hash) = i;
+}
+
+VulkanDescriptorAllocator::VulkanDescriptorAllocator()
+    : device(VK_NULL_HANDLE),
+      setsPerPool(DESCRIPTOR_POOL_SETS),
+      currentFrame(0),
+      allocations(0),
+      reuses(0) {}
+
+void VulkanDescriptorAllocator::init(VkDevice device, uint32_t framesInFlight,
+                                     uint32_t setsPerPool) {
+  this->device = device;
+  this->setsPerPool = setsPerPool;
+  currentFrame = 0;
+
+  frames.resize(framesInFlight);
+  for (uint32_t i = 0; i < frames.size(); i++)
+    frames[i].current = VK_NULL_HANDLE;
+}
+
+void VulkanDescriptorAllocator::destroy() {
+  for (uint32_t i = 0; i < frames.size(); i++)
+    for (uint32_t j = 0; j < frames[i].usedPools.size(); j++)
+      vkd.DestroyDescriptorPool(device, frames[i].usedPools[j], vkAllocator);
+
+  for (uint32_t i = 0; i < freePools.size(); i++)
+    vkd.DestroyDescriptorPool(device, freePools[i], vkAllocator);
+
+  frames.clear();
+  freePools.clear();
+}
+
+void VulkanDescriptorAllocator::beginFrame(uint32_t frame) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  currentFrame = frame;
+  DescriptorFrame &descriptorFrame = frames[frame];
+
+  for (uint32_t i = 0; i < descriptorFrame.usedPools.size(); i++) {
+    VkResult result =
+        vkd.ResetDescriptorPool(device, descriptorFrame.usedPools[i], 0);
+    assert(result == VK_SUCCESS);
+    freePools.push_back(descriptorFrame.usedPools[i]);
+  }
+
+  descriptorFrame.usedPools.clear();
+  descriptorFrame.current = VK_NULL_HANDLE;
+  descriptorFrame.sets.clear();
+  std::fill(descriptorFrame.buckets.begin(), descriptorFrame.buckets.end(),
+            emptyBucket);
+  allocations = 0;
+  reuses = 0;
+}
+
+VkDescriptorPool VulkanDescriptorAllocator::nextPool() {
+  if (!freePools.empty()) {
+    VkDescriptorPool pool = freePools.back();
+    freePools.pop_back();
+    return pool;
+  }
+
+  const uint32_t ratioCount = sizeof(poolRatios) / sizeof(poolRatios[0]);
+  VkDescriptorPoolSize poolSizes[ratioCount];
+  for (uint32_t i = 0; i < ratioCount; i++) {
+    poolSizes[i].type = poolRatios[i].type;
+    poolSizes[i].descriptorCount = poolRatios[i].descriptorCount * setsPerPool;
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.pNext = NULL;
+  poolInfo.flags = 0;
+  poolInfo.maxSets = setsPerPool;
+  poolInfo.poolSizeCount = ratioCount;
+  poolInfo.pPoolSizes = poolSizes;
+
+  VkDescriptorPool pool;
+  VkResult result =
+      vkd.CreateDescriptorPool(device, &poolInfo, vkAllocator, &pool);
+  assert(result == VK_SUCCESS);
+
+  // Each new pool is larger than the last, so a heavy frame settles on a
+  // few big pools instead of many small ones.
+  if (setsPerPool < DESCRIPTOR_POOL_MAX_SETS) setsPerPool *= 2;
+
+  return pool;
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::allocateLocked(
+    VkDescriptorSetLayout layout) {
+  DescriptorFrame &descriptorFrame = frames[currentFrame];
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.pNext = NULL;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  VkResult result = VK_ERROR_OUT_OF_POOL_MEMORY;
+
+  if (descriptorFrame.current != VK_NULL_HANDLE) {
+    allocInfo.descriptorPool = descriptorFrame.current;
+    result = vkd.AllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+  }
+
+  // OUT_OF_POOL_MEMORY is only promised by VK_KHR_maintenance1, and a 1.0
+  // driver may report an exhausted pool as any error, so every failure of
+  // the current pool opens a new one.
+  if (result != VK_SUCCESS) {
+    descriptorFrame.current = nextPool();
+    descriptorFrame.usedPools.push_back(descriptorFrame.current);
+
+    allocInfo.descriptorPool = descriptorFrame.current;
+    result = vkd.AllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+  }
+
+  assert(result == VK_SUCCESS);
+  allocations++;
+  return descriptorSet;
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::allocate(
+    VkDescriptorSetLayout layout) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return allocateLocked(layout);
+}
+
+VkDescriptorSet VulkanDescriptorAllocator::set(const DescriptorSetKey &key) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Kept at most half full, so a probe always ends at an empty bucket.
+  DescriptorFrame &descriptorFrame = frames[currentFrame];
+  if (descriptorFrame.buckets.size() < (descriptorFrame.sets.size() + 1) * 2)
+    growBuckets(descriptorFrame);
+
+  size_t hash = DescriptorSetKeyHash()(key);
+  uint32_t &bucket = findBucket(descriptorFrame, key, hash);
+  if (bucket != emptyBucket) {
+    reuses++;
+    return descriptorFrame.sets[bucket].set;
+  }
+
+  VkDescriptorSet descriptorSet = allocateLocked(key.layout);
+
+  VkWriteDescriptorSet writes[DESCRIPTOR_SET_MAX_BINDINGS];
+  for (uint32_t i = 0; i < key.writeCount; i++) {
+    const DescriptorWrite &write = key.writes[i];
+    bool image = isImageDescriptor(write.type);
+
+    writes[i] = VkWriteDescriptorSet();
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].pNext = NULL;
+    writes[i].dstSet = descriptorSet;
+    writes[i].dstBinding = write.binding;
+    writes[i].dstArrayElement = 0;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = write.type;
+    writes[i].pImageInfo = image ? &write.image : NULL;
+    writes[i].pBufferInfo = image ? NULL : &write.buffer;
+    writes[i].pTexelBufferView = NULL;
+  }
+
+  vkd.UpdateDescriptorSets(device, key.writeCount, writes, 0, NULL);
+
+  bucket = descriptorFrame.sets.size();
+  DescriptorFrameSet entry = {key, hash, descriptorSet};
+  descriptorFrame.sets.push_back(entry);
+  return descriptorSet;
+}
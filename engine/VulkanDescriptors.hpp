@@ -0,0 +1,129 @@
+#ifndef VULKAN_DESCRIPTORS_HPP
+#define VULKAN_DESCRIPTORS_HPP
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanTools.hpp"
+
+#define DESCRIPTOR_SET_MAX_BINDINGS 16
+#define DESCRIPTOR_POOL_SETS 64
+#define DESCRIPTOR_POOL_MAX_SETS 4096
+#define DESCRIPTOR_FRAME_BUCKETS 64
+
+struct DescriptorLayoutKey {
+  uint32_t bindingCount;
+  VkDescriptorSetLayoutBinding bindings[DESCRIPTOR_SET_MAX_BINDINGS];
+
+  DescriptorLayoutKey();
+  DescriptorLayoutKey &add(uint32_t binding, VkDescriptorType type,
+                           VkShaderStageFlags stages,
+                           uint32_t descriptorCount = 1,
+                           const VkSampler *immutableSamplers = NULL);
+
+  bool operator==(const DescriptorLayoutKey &other) const;
+};
+
+struct DescriptorWrite {
+  uint32_t binding;
+  VkDescriptorType type;
+  VkDescriptorBufferInfo buffer;
+  VkDescriptorImageInfo image;
+};
+
+struct DescriptorSetKey {
+  VkDescriptorSetLayout layout;
+  uint32_t writeCount;
+  DescriptorWrite writes[DESCRIPTOR_SET_MAX_BINDINGS];
+
+  explicit DescriptorSetKey(VkDescriptorSetLayout layout);
+  DescriptorSetKey &buffer(uint32_t binding, VkDescriptorType type,
+                           VkBuffer buffer, VkDeviceSize offset = 0,
+                           VkDeviceSize range = VK_WHOLE_SIZE);
+  DescriptorSetKey &image(uint32_t binding, VkDescriptorType type,
+                          VkImageView view, VkSampler sampler = VK_NULL_HANDLE,
+                          VkImageLayout layout =
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  bool operator==(const DescriptorSetKey &other) const;
+};
+
+struct DescriptorLayoutKeyHash {
+  size_t operator()(const DescriptorLayoutKey &key) const;
+};
+
+struct DescriptorSetKeyHash {
+  size_t operator()(const DescriptorSetKey &key) const;
+};
+
+// Layouts live as long as the device; identical binding lists share one
+// handle, which also lets pipeline layouts built from them compare equal.
+class VulkanDescriptorLayouts {
+ public:
+  VulkanDescriptorLayouts();
+  void init(VkDevice device);
+  void destroy();
+
+  VkDescriptorSetLayout layout(const DescriptorLayoutKey &key);
+  uint32_t layoutCount() const { return layouts.size(); }
+
+ private:
+  VkDevice device;
+  std::mutex mutex;
+  std::unordered_map<DescriptorLayoutKey, VkDescriptorSetLayout,
+                     DescriptorLayoutKeyHash>
+      layouts;
+};
+
+struct DescriptorFrameSet {
+  DescriptorSetKey key;
+  size_t hash;
+  VkDescriptorSet set;
+};
+
+// The sets written this frame, found through an open-addressed table of
+// indices into them. Both are emptied rather than freed each frame, so a
+// frame that writes as many sets as the last one allocates nothing.
+struct DescriptorFrame {
+  std::vector<VkDescriptorPool> usedPools;
+  VkDescriptorPool current;
+  std::vector<DescriptorFrameSet> sets;
+  std::vector<uint32_t> buckets;
+};
+
+// Sets are never freed one by one. Each frame in flight owns a list of
+// pools that is reset as a whole once the frame's fence has signalled;
+// pools that run dry are replaced by larger ones up to a cap.
+class VulkanDescriptorAllocator {
+ public:
+  VulkanDescriptorAllocator();
+  void init(VkDevice device, uint32_t framesInFlight,
+            uint32_t setsPerPool = DESCRIPTOR_POOL_SETS);
+  void destroy();
+
+  void beginFrame(uint32_t frame);
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  VkDescriptorSet set(const DescriptorSetKey &key);
+
+  uint32_t allocatedSets() const { return allocations; }
+  uint32_t reusedSets() const { return reuses; }
+
+ private:
+  VkDevice device;
+  uint32_t setsPerPool;
+  uint32_t currentFrame;
+  uint32_t allocations;
+  uint32_t reuses;
+  std::mutex mutex;
+  std::vector<DescriptorFrame> frames;
+  std::vector<VkDescriptorPool> freePools;
+
+  VkDescriptorPool nextPool();
+  VkDescriptorSet allocateLocked(VkDescriptorSetLayout layout);
+};
+
+#endif
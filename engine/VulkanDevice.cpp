@@ -0,0 +1,424 @@
+#include "VulkanDevice.hpp"
+
+const char *VulkanDevice::deviceTypeName(VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return "Integrated GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return "Discrete GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return "Virtual GPU";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return "CPU";
+    default:
+      return "Other";
+  }
+}
+
+static int64_t deviceTypeScore(VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return 1000000;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return 100000;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return 50000;
+    default:
+      return 0;
+  }
+}
+
+typedef std::pair<VkInstance, std::string> EnumerationKey;
+
+static std::map<EnumerationKey, std::vector<PhysicalDeviceInfo> >
+    enumerationCache;
+
+// Startup asks for the same extension lists many times over, once per
+// optional feature. With caching on, each is enumerated once: device lists
+// until an instance is released, the instance list for the process.
+static bool cacheEnumeration = true;
+static std::map<VkPhysicalDevice, std::vector<VkExtensionProperties> >
+    extensionCache;
+static std::vector<VkExtensionProperties> instanceExtensionCache;
+
+void VulkanDevice::setEnumerationCache(bool enabled) {
+  cacheEnumeration = enabled;
+  if (enabled) return;
+
+  enumerationCache.clear();
+  extensionCache.clear();
+  instanceExtensionCache.clear();
+}
+
+static const std::vector<VkExtensionProperties> &deviceExtensions(
+    VkPhysicalDevice physicalDevice) {
+  std::map<VkPhysicalDevice, std::vector<VkExtensionProperties> >::iterator
+      cached = extensionCache.find(physicalDevice);
+  if (cached != extensionCache.end()) return cached->second;
+
+  uint32_t extensionCount = 0;
+  VkResult result = vkEnumerateDeviceExtensionProperties(
+      physicalDevice, NULL, &extensionCount, NULL);
+  assert(result == VK_SUCCESS);
+
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  result = vkEnumerateDeviceExtensionProperties(
+      physicalDevice, NULL, &extensionCount, extensions.data());
+  assert(result == VK_SUCCESS);
+
+  if (!cacheEnumeration) extensionCache.clear();
+  return extensionCache[physicalDevice] = extensions;
+}
+
+bool VulkanDevice::supportsExtensions(
+    VkPhysicalDevice physicalDevice,
+    const std::vector<const char *> &requiredExtensions) {
+  const std::vector<VkExtensionProperties> &extensions =
+      deviceExtensions(physicalDevice);
+
+  for (uint32_t i = 0; i < requiredExtensions.size(); i++) {
+    bool found = false;
+
+    for (uint32_t j = 0; j < extensions.size() && !found; j++)
+      found = strcmp(requiredExtensions[i], extensions[j].extensionName) == 0;
+
+    if (!found) return false;
+  }
+
+  return true;
+}
+
+bool VulkanDevice::supportsInstanceExtension(const char *name) {
+  std::vector<VkExtensionProperties> &extensions = instanceExtensionCache;
+  if (!cacheEnumeration || extensions.empty()) {
+    uint32_t extensionCount = 0;
+    VkResult result =
+        vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+    assert(result == VK_SUCCESS);
+
+    extensions.resize(extensionCount);
+    result = vkEnumerateInstanceExtensionProperties(NULL, &extensionCount,
+                                                    extensions.data());
+    assert(result == VK_SUCCESS);
+    extensions.resize(extensionCount);
+  }
+
+  for (uint32_t i = 0; i < extensions.size(); i++)
+    if (strcmp(name, extensions[i].extensionName) == 0) return true;
+
+  return false;
+}
+
+static bool hasGraphicsQueue(
+    const std::vector<VkQueueFamilyProperties> &queueProperties) {
+  for (uint32_t i = 0; i < queueProperties.size(); i++)
+    if (queueProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) return true;
+
+  return false;
+}
+
+std::vector<PhysicalDeviceInfo> VulkanDevice::enumeratePhysicalDevices(
+    VkInstance instance, const std::vector<const char *> &requiredExtensions) {
+  EnumerationKey key(instance, std::string());
+  for (uint32_t i = 0; i < requiredExtensions.size(); i++)
+    key.second.append(requiredExtensions[i]).append(" ");
+
+  std::map<EnumerationKey, std::vector<PhysicalDeviceInfo> >::iterator cached =
+      enumerationCache.find(key);
+  if (cached != enumerationCache.end()) return cached->second;
+
+  uint32_t deviceCount = 0;
+  VkResult result = vkEnumeratePhysicalDevices(instance, &deviceCount, NULL);
+  assert(result == VK_SUCCESS);
+
+  if (deviceCount == 0)
+    VulkanTools::exitOnError("No Vulkan capable physical devices were found.");
+
+  std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+  result = vkEnumeratePhysicalDevices(instance, &deviceCount,
+                                      physicalDevices.data());
+  assert(result == VK_SUCCESS);
+
+  std::vector<PhysicalDeviceInfo> devices(deviceCount);
+
+  for (uint32_t i = 0; i < deviceCount; i++) {
+    PhysicalDeviceInfo &info = devices[i];
+    info.physicalDevice = physicalDevices[i];
+    vkGetPhysicalDeviceProperties(info.physicalDevice, &info.properties);
+    vkGetPhysicalDeviceMemoryProperties(info.physicalDevice,
+                                        &info.memoryProperties);
+
+    info.localMemorySize = 0;
+
+    for (uint32_t j = 0; j < info.memoryProperties.memoryHeapCount; j++) {
+      const VkMemoryHeap &heap = info.memoryProperties.memoryHeaps[j];
+
+      if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        info.localMemorySize += heap.size;
+    }
+
+    uint32_t queueCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(info.physicalDevice, &queueCount,
+                                             NULL);
+    info.queueFamilies.resize(queueCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(info.physicalDevice, &queueCount,
+                                             info.queueFamilies.data());
+
+    info.hasGraphicsQueue = hasGraphicsQueue(info.queueFamilies);
+    info.hasRequiredExtensions =
+        supportsExtensions(info.physicalDevice, requiredExtensions);
+
+    if (!info.hasGraphicsQueue || !info.hasRequiredExtensions) {
+      info.score = -1;
+      continue;
+    }
+
+    const VkPhysicalDeviceLimits &limits = info.properties.limits;
+    info.score = deviceTypeScore(info.properties.deviceType);
+    info.score += info.localMemorySize / (1024 * 1024);
+    info.score += limits.maxImageDimension2D / 256;
+    info.score += limits.maxComputeWorkGroupInvocations / 64;
+  }
+
+  if (cacheEnumeration) enumerationCache[key] = devices;
+  return devices;
+}
+
+void VulkanDevice::releaseEnumeration(VkInstance instance) {
+  std::map<EnumerationKey, std::vector<PhysicalDeviceInfo> >::iterator it =
+      enumerationCache.begin();
+
+  while (it != enumerationCache.end()) {
+    if (it->first.first == instance)
+      enumerationCache.erase(it++);
+    else
+      ++it;
+  }
+
+  // Physical device handles die with their instance and may come back for
+  // the next one, so none of the lists keyed by them can be trusted.
+  extensionCache.clear();
+}
+
+uint32_t VulkanDevice::selectPhysicalDevice(
+    const std::vector<PhysicalDeviceInfo> &devices,
+    const char *deviceOverride) {
+  if (deviceOverride && deviceOverride[0] != '\0') {
+    char *end = NULL;
+    unsigned long index = strtoul(deviceOverride, &end, 10);
+
+    for (uint32_t i = 0; i < devices.size(); i++) {
+      bool matches = *end == '\0' ? i == index
+                                   : strstr(devices[i].properties.deviceName,
+                                            deviceOverride) != NULL;
+
+      if (matches && devices[i].score >= 0) return i;
+    }
+
+    fprintf(stderr,
+            "No suitable device matches %s=%s, selecting automatically.\n",
+            DEVICE_OVERRIDE_ENV, deviceOverride);
+  }
+
+  int64_t bestScore = -1;
+  uint32_t best = 0;
+
+  for (uint32_t i = 0; i < devices.size(); i++) {
+    if (devices[i].score > bestScore) {
+      bestScore = devices[i].score;
+      best = i;
+    }
+  }
+
+  if (bestScore < 0)
+    VulkanTools::exitOnError(
+        "None of the physical devices support graphics and the required "
+        "device extensions.");
+
+  return best;
+}
+
+void VulkanDevice::printPhysicalDevices(
+    const std::vector<PhysicalDeviceInfo> &devices, uint32_t selected,
+    bool verbose) {
+  if (!verbose) {
+    const VkPhysicalDeviceProperties &properties = devices[selected].properties;
+    fprintf(stdout, "Device %u:       %s (%s)\n", selected,
+            properties.deviceName, deviceTypeName(properties.deviceType));
+    return;
+  }
+
+  for (uint32_t i = 0; i < devices.size(); i++) {
+    const PhysicalDeviceInfo &info = devices[i];
+
+    fprintf(stdout, "Device %u%s\n", i, i == selected ? " (selected)" : "");
+    fprintf(stdout, "  Device Name:    %s\n", info.properties.deviceName);
+    fprintf(stdout, "  Device Type:    %s\n",
+            deviceTypeName(info.properties.deviceType));
+    fprintf(stdout, "  Vendor/Device:  0x%04x/0x%04x\n",
+            info.properties.vendorID, info.properties.deviceID);
+    fprintf(stdout, "  Driver Version: %d\n", info.properties.driverVersion);
+    fprintf(stdout, "  API Version:    %d.%d.%d\n",
+            VK_VERSION_MAJOR(info.properties.apiVersion),
+            VK_VERSION_MINOR(info.properties.apiVersion),
+            VK_VERSION_PATCH(info.properties.apiVersion));
+    fprintf(stdout, "  Local Memory:   %llu MB\n",
+            (unsigned long long)(info.localMemorySize / (1024 * 1024)));
+    fprintf(stdout, "  Max Image 2D:   %u\n",
+            info.properties.limits.maxImageDimension2D);
+    fprintf(stdout, "  Graphics Queue: %s\n",
+            info.hasGraphicsQueue ? "yes" : "no");
+    fprintf(stdout, "  Extensions:     %s\n",
+            info.hasRequiredExtensions ? "yes" : "missing");
+    fprintf(stdout, "  Score:          %lld\n", (long long)info.score);
+  }
+}
+
+static uint32_t findQueueFamily(
+    const std::vector<VkQueueFamilyProperties> &queueProperties,
+    VkQueueFlags required, VkQueueFlags excluded) {
+  for (uint32_t i = 0; i < queueProperties.size(); i++) {
+    VkQueueFlags flags = queueProperties[i].queueFlags;
+
+    if (queueProperties[i].queueCount > 0 && (flags & required) == required &&
+        (flags & excluded) == 0)
+      return i;
+  }
+
+  return UINT32_MAX;
+}
+
+QueueRegistry VulkanDevice::discoverQueues(
+    VkPhysicalDevice physicalDevice,
+    const std::vector<VkBool32> &presentSupport) {
+  uint32_t queueCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
+
+  assert(queueCount >= 1);
+
+  std::vector<VkQueueFamilyProperties> queueProperties(queueCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount,
+                                           queueProperties.data());
+
+  QueueRegistry queues = {};
+  uint32_t graphics = UINT32_MAX;
+  uint32_t present = UINT32_MAX;
+
+  for (uint32_t i = 0; i < queueCount; i++) {
+    bool canPresent = i < presentSupport.size() && presentSupport[i];
+
+    if (queueProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+      if (graphics == UINT32_MAX) graphics = i;
+
+      if (canPresent) {
+        graphics = i;
+        present = i;
+        break;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < presentSupport.size() && present == UINT32_MAX;
+       i++)
+    if (presentSupport[i]) present = i;
+
+  if (graphics == UINT32_MAX)
+    VulkanTools::exitOnError("The selected device has no graphics queue.");
+
+  if (!presentSupport.empty() && present == UINT32_MAX)
+    VulkanTools::exitOnError(
+        "None of the queue families can present to the surface.");
+
+  uint32_t compute = findQueueFamily(queueProperties, VK_QUEUE_COMPUTE_BIT,
+                                     VK_QUEUE_GRAPHICS_BIT);
+
+  if (compute == UINT32_MAX) compute = graphics;
+
+  uint32_t transfer =
+      findQueueFamily(queueProperties, VK_QUEUE_TRANSFER_BIT,
+                      VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+  if (transfer == UINT32_MAX) transfer = compute;
+
+  queues.familyQueueCounts.assign(queueCount, 0);
+
+  uint32_t families[QUEUE_TYPE_COUNT] = {graphics, present, compute, transfer};
+
+  for (uint32_t type = 0; type < QUEUE_TYPE_COUNT; type++) {
+    uint32_t family = families[type];
+    queues.familyIndex[type] = family;
+    queues.queues[type] = VK_NULL_HANDLE;
+
+    if (family == UINT32_MAX) {
+      queues.queueIndex[type] = UINT32_MAX;
+      continue;
+    }
+
+    uint32_t &used = queues.familyQueueCounts[family];
+
+    if (type == QUEUE_PRESENT && family == graphics) {
+      queues.queueIndex[type] = queues.queueIndex[QUEUE_GRAPHICS];
+    } else if (used < queueProperties[family].queueCount) {
+      queues.queueIndex[type] = used++;
+    } else {
+      queues.queueIndex[type] = used - 1;
+    }
+  }
+
+  return queues;
+}
+
+void VulkanDevice::queueCreateInfos(
+    const QueueRegistry &queues,
+    std::vector<VkDeviceQueueCreateInfo> &createInfos,
+    std::vector<float> &priorities) {
+  uint32_t maxQueues = 0;
+
+  for (uint32_t i = 0; i < queues.familyQueueCounts.size(); i++)
+    if (queues.familyQueueCounts[i] > maxQueues)
+      maxQueues = queues.familyQueueCounts[i];
+
+  priorities.assign(maxQueues, 1.0f);
+  createInfos.clear();
+
+  for (uint32_t i = 0; i < queues.familyQueueCounts.size(); i++) {
+    if (queues.familyQueueCounts[i] == 0) continue;
+
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.pNext = NULL;
+    queueInfo.flags = 0;
+    queueInfo.queueFamilyIndex = i;
+    queueInfo.queueCount = queues.familyQueueCounts[i];
+    queueInfo.pQueuePriorities = priorities.data();
+    createInfos.push_back(queueInfo);
+  }
+}
+
+void VulkanDevice::getQueues(VkDevice device, QueueRegistry &queues) {
+  for (uint32_t type = 0; type < QUEUE_TYPE_COUNT; type++) {
+    if (queues.familyIndex[type] == UINT32_MAX) continue;
+
+    vkd.GetDeviceQueue(device, queues.familyIndex[type],
+                       queues.queueIndex[type], &queues.queues[type]);
+  }
+}
+
+void VulkanDevice::printQueues(const QueueRegistry &queues) {
+  const char *names[QUEUE_TYPE_COUNT] = {"Graphics", "Present", "Compute",
+                                         "Transfer"};
+
+  for (uint32_t type = 0; type < QUEUE_TYPE_COUNT; type++) {
+    if (queues.familyIndex[type] == UINT32_MAX) continue;
+
+    const char *note = "";
+
+    if (queues.dedicated((QueueType)type))
+      note = " (dedicated family)";
+    else if (queues.separate((QueueType)type))
+      note = " (separate queue)";
+
+    fprintf(stdout, "%-8s Queue: family %u, index %u%s\n", names[type],
+            queues.familyIndex[type], queues.queueIndex[type], note);
+  }
+}
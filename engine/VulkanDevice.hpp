@@ -0,0 +1,78 @@
+#ifndef VULKAN_DEVICE_HPP
+#define VULKAN_DEVICE_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "VulkanTools.hpp"
+
+#define DEVICE_OVERRIDE_ENV "VULKAN_EXAMPLE_DEVICE"
+#define DEVICE_LIST_ENV "VULKAN_EXAMPLE_LIST_DEVICES"
+
+struct PhysicalDeviceInfo {
+  VkPhysicalDevice physicalDevice;
+  VkPhysicalDeviceProperties properties;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize localMemorySize;
+  std::vector<VkQueueFamilyProperties> queueFamilies;
+  bool hasGraphicsQueue;
+  bool hasRequiredExtensions;
+  int64_t score;
+};
+
+enum QueueType {
+  QUEUE_GRAPHICS = 0,
+  QUEUE_PRESENT,
+  QUEUE_COMPUTE,
+  QUEUE_TRANSFER,
+  QUEUE_TYPE_COUNT
+};
+
+struct QueueRegistry {
+  uint32_t familyIndex[QUEUE_TYPE_COUNT];
+  uint32_t queueIndex[QUEUE_TYPE_COUNT];
+  VkQueue queues[QUEUE_TYPE_COUNT];
+  std::vector<uint32_t> familyQueueCounts;
+
+  VkQueue queue(QueueType type) const { return queues[type]; }
+  uint32_t family(QueueType type) const { return familyIndex[type]; }
+
+  bool dedicated(QueueType type) const {
+    return familyIndex[type] != familyIndex[QUEUE_GRAPHICS];
+  }
+
+  bool separate(QueueType type) const {
+    return dedicated(type) ||
+           queueIndex[type] != queueIndex[QUEUE_GRAPHICS];
+  }
+};
+
+namespace VulkanDevice {
+const char *deviceTypeName(VkPhysicalDeviceType type);
+void setEnumerationCache(bool enabled);
+bool supportsExtensions(VkPhysicalDevice physicalDevice,
+                        const std::vector<const char *> &requiredExtensions);
+bool supportsInstanceExtension(const char *name);
+std::vector<PhysicalDeviceInfo> enumeratePhysicalDevices(
+    VkInstance instance, const std::vector<const char *> &requiredExtensions);
+void releaseEnumeration(VkInstance instance);
+uint32_t selectPhysicalDevice(const std::vector<PhysicalDeviceInfo> &devices,
+                              const char *deviceOverride);
+void printPhysicalDevices(const std::vector<PhysicalDeviceInfo> &devices,
+                          uint32_t selected, bool verbose = true);
+QueueRegistry discoverQueues(VkPhysicalDevice physicalDevice,
+                             const std::vector<VkBool32> &presentSupport);
+void queueCreateInfos(const QueueRegistry &queues,
+                      std::vector<VkDeviceQueueCreateInfo> &createInfos,
+                      std::vector<float> &priorities);
+void getQueues(VkDevice device, QueueRegistry &queues);
+void printQueues(const QueueRegistry &queues);
+}
+
+#endif  // VULKAN_DEVICE_HPP
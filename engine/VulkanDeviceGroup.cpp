@@ -0,0 +1,210 @@
+#include "VulkanDeviceGroup.hpp"
+
+VulkanDeviceGroup::VulkanDeviceGroup()
+    : device(VK_NULL_HANDLE),
+      count(1),
+      groupMode(DEVICE_GROUP_SINGLE),
+      presentMode(VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR),
+      allDevices(1),
+      renderDevice(0) {}
+
+static const char *presentName(VkDeviceGroupPresentModeFlagBitsKHR mode) {
+  switch (mode) {
+    case VK_DEVICE_GROUP_PRESENT_MODE_SUM_BIT_KHR:
+      return ", summed present";
+    case VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR:
+      return ", remote present";
+    default:
+      return ", local present";
+  }
+}
+
+const char *VulkanDeviceGroup::instanceExtension() {
+  return VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME;
+}
+
+DeviceGroupSupport VulkanDeviceGroup::query(VkInstance instance,
+                                            VkPhysicalDevice physicalDevice) {
+  DeviceGroupSupport support = {};
+  support.deviceCount = 1;
+  support.devices[0] = physicalDevice;
+
+  std::vector<const char *> extensions;
+  extensions.push_back(VK_KHR_DEVICE_GROUP_EXTENSION_NAME);
+  if (!VulkanDevice::supportsExtensions(physicalDevice, extensions))
+    return support;
+
+  PFN_vkEnumeratePhysicalDeviceGroupsKHR enumerateGroups =
+      (PFN_vkEnumeratePhysicalDeviceGroupsKHR)vkGetInstanceProcAddr(
+          instance, "vkEnumeratePhysicalDeviceGroupsKHR");
+  if (!enumerateGroups) return support;
+
+  uint32_t groupCount = 0;
+  VkResult result = enumerateGroups(instance, &groupCount, NULL);
+  if (result != VK_SUCCESS || groupCount == 0) return support;
+
+  std::vector<VkPhysicalDeviceGroupProperties> groups(groupCount);
+  for (uint32_t i = 0; i < groupCount; i++) {
+    groups[i] = VkPhysicalDeviceGroupProperties();
+    groups[i].sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES;
+    groups[i].pNext = NULL;
+  }
+  result = enumerateGroups(instance, &groupCount, groups.data());
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) return support;
+
+  // The selected device stays first, so it is device index 0 and the one
+  // that presents when the rest can't.
+  for (uint32_t i = 0; i < groupCount; i++) {
+    const VkPhysicalDeviceGroupProperties &group = groups[i];
+    bool member = false;
+    for (uint32_t j = 0; j < group.physicalDeviceCount; j++)
+      member = member || group.physicalDevices[j] == physicalDevice;
+    if (!member || group.physicalDeviceCount < 2) continue;
+
+    support.deviceCount = 1;
+    for (uint32_t j = 0; j < group.physicalDeviceCount; j++)
+      if (group.physicalDevices[j] != physicalDevice)
+        support.devices[support.deviceCount++] = group.physicalDevices[j];
+    break;
+  }
+
+  return support;
+}
+
+DeviceGroupMode VulkanDeviceGroup::parseMode(const char *name) {
+  if (!name) return DEVICE_GROUP_SINGLE;
+  if (strcmp(name, "afr") == 0) return DEVICE_GROUP_ALTERNATE;
+  if (strcmp(name, "sfr") == 0) return DEVICE_GROUP_SPLIT;
+  return DEVICE_GROUP_SINGLE;
+}
+
+void VulkanDeviceGroup::deviceExtensions(
+    const DeviceGroupSupport &support, std::vector<const char *> &extensions) {
+  if (support.deviceCount > 1)
+    extensions.push_back(VK_KHR_DEVICE_GROUP_EXTENSION_NAME);
+}
+
+void VulkanDeviceGroup::createInfo(const DeviceGroupSupport &support,
+                                   VkDeviceGroupDeviceCreateInfo &info) {
+  info = VkDeviceGroupDeviceCreateInfo();
+  info.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO;
+  info.pNext = NULL;
+  info.physicalDeviceCount = support.deviceCount;
+  info.pPhysicalDevices = support.devices;
+}
+
+void VulkanDeviceGroup::init(VkDevice device,
+                             const DeviceGroupSupport &support,
+                             DeviceGroupMode mode, bool present,
+                             VkDeviceGroupPresentModeFlagsKHR surfaceModes,
+                             bool clearable) {
+  this->device = device;
+  count = support.deviceCount;
+  allDevices = count >= 32 ? UINT32_MAX : (1u << count) - 1;
+  renderDevice = 0;
+  groupMode = count > 1 ? mode : DEVICE_GROUP_SINGLE;
+  presentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+
+  // Offscreen frames are read back from one GPU, which only has its own
+  // band of a split frame.
+  if (groupMode == DEVICE_GROUP_SPLIT && !present)
+    groupMode = DEVICE_GROUP_ALTERNATE;
+
+  if (present && grouped()) {
+    VkDeviceGroupPresentCapabilitiesKHR caps = {};
+    caps.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_CAPABILITIES_KHR;
+    caps.pNext = NULL;
+    if (!vkd.GetDeviceGroupPresentCapabilitiesKHR ||
+        vkd.GetDeviceGroupPresentCapabilitiesKHR(device, &caps) != VK_SUCCESS)
+      caps.modes = 0;
+    VkDeviceGroupPresentModeFlagsKHR modes = caps.modes & surfaceModes;
+
+    // Local needs a presentation engine on every GPU, remote needs every
+    // GPU's images to reach one, and sum needs one engine that sees them all.
+    bool local = true;
+    bool summed = false;
+    uint32_t reachable = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      local = local && (caps.presentMask[i] & (1u << i));
+      summed = summed || (caps.presentMask[i] & allDevices) == allDevices;
+      reachable |= caps.presentMask[i];
+    }
+    bool remote = (reachable & allDevices) == allDevices;
+
+    // Summed bands are only right if each GPU can zero the rest of its
+    // image first.
+    if (groupMode == DEVICE_GROUP_SPLIT) {
+      if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_SUM_BIT_KHR) && summed &&
+          clearable)
+        presentMode = VK_DEVICE_GROUP_PRESENT_MODE_SUM_BIT_KHR;
+      else
+        groupMode = DEVICE_GROUP_ALTERNATE;
+    }
+
+    if (groupMode == DEVICE_GROUP_ALTERNATE) {
+      if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR) && local)
+        presentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+      else if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) && remote)
+        presentMode = VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR;
+      else
+        groupMode = DEVICE_GROUP_SINGLE;
+    }
+  }
+
+  if (mode == DEVICE_GROUP_SINGLE) return;
+
+  if (!grouped())
+    fprintf(stdout, "Device Group:   unavailable, one GPU\n");
+  else if (groupMode == DEVICE_GROUP_SINGLE)
+    fprintf(stdout, "Device Group:   %u GPUs, presenting from the first\n",
+            count);
+  else
+    fprintf(stdout, "Device Group:   %u GPUs, %s%s\n", count,
+            groupMode == DEVICE_GROUP_SPLIT ? "split frame"
+                                            : "alternate frames",
+            present ? presentName(presentMode) : "");
+}
+
+VkDeviceGroupPresentModeFlagsKHR VulkanDeviceGroup::swapchainModes() const {
+  return grouped() ? presentMode : 0;
+}
+
+void VulkanDeviceGroup::beginFrame(uint64_t frame) {
+  renderDevice = groupMode == DEVICE_GROUP_ALTERNATE ? frame % count : 0;
+}
+
+uint32_t VulkanDeviceGroup::renderMask() const {
+  if (!grouped()) return 0;
+  if (groupMode == DEVICE_GROUP_SPLIT) return allDevices;
+  return 1u << renderDevice;
+}
+
+uint32_t VulkanDeviceGroup::waitMask() const {
+  // A split frame's external waits all land on the first GPU, which passes
+  // them on to the others.
+  if (groupMode == DEVICE_GROUP_SPLIT) return 1;
+  return renderMask();
+}
+
+const void *VulkanDeviceGroup::beginInfo() {
+  if (!grouped()) return NULL;
+
+  cmdBufferInfo.sType =
+      VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO;
+  cmdBufferInfo.pNext = NULL;
+  cmdBufferInfo.deviceMask = renderMask();
+  return &cmdBufferInfo;
+}
+
+const void *VulkanDeviceGroup::presentInfo(uint32_t swapchainCount,
+                                           const void *pNext) {
+  if (!grouped()) return pNext;
+
+  presentMasks.assign(swapchainCount, renderMask());
+  groupPresentInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_INFO_KHR;
+  groupPresentInfo.pNext = pNext;
+  groupPresentInfo.swapchainCount = swapchainCount;
+  groupPresentInfo.pDeviceMasks = presentMasks.data();
+  groupPresentInfo.mode = presentMode;
+  return &groupPresentInfo;
+}
@@ -0,0 +1,77 @@
+#ifndef VULKAN_DEVICE_GROUP_HPP
+#define VULKAN_DEVICE_GROUP_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanTools.hpp"
+
+#define DEVICE_GROUP_ENV "VULKAN_EXAMPLE_DEVICE_GROUP"
+
+enum DeviceGroupMode {
+  DEVICE_GROUP_SINGLE,
+  DEVICE_GROUP_ALTERNATE,
+  DEVICE_GROUP_SPLIT
+};
+
+struct DeviceGroupSupport {
+  uint32_t deviceCount;
+  VkPhysicalDevice devices[VK_MAX_DEVICE_GROUP_SIZE];
+};
+
+// Runs one logical device across the GPUs of a linked device group.
+// Alternate-frame rendering gives each frame to the next GPU in turn, which
+// presents it itself or, in remote mode, through a GPU that reads the image
+// from its peer memory. Split-frame rendering has every GPU draw one band of
+// each frame over an image it cleared to zero, and the presentation engine
+// sums the GPUs' images. Without a group, or when the surface can't present
+// a mode, everything runs on the first GPU.
+class VulkanDeviceGroup {
+ public:
+  VulkanDeviceGroup();
+
+  static const char *instanceExtension();
+  static DeviceGroupSupport query(VkInstance instance,
+                                  VkPhysicalDevice physicalDevice);
+  static DeviceGroupMode parseMode(const char *name);
+  static void deviceExtensions(const DeviceGroupSupport &support,
+                               std::vector<const char *> &extensions);
+  static void createInfo(const DeviceGroupSupport &support,
+                         VkDeviceGroupDeviceCreateInfo &info);
+
+  void init(VkDevice device, const DeviceGroupSupport &support,
+            DeviceGroupMode mode, bool present,
+            VkDeviceGroupPresentModeFlagsKHR surfaceModes,
+            bool clearable = true);
+
+  bool grouped() const { return count > 1; }
+  bool active() const { return groupMode != DEVICE_GROUP_SINGLE; }
+  bool splitFrame() const { return groupMode == DEVICE_GROUP_SPLIT; }
+  DeviceGroupMode mode() const { return groupMode; }
+  uint32_t deviceCount() const { return active() ? count : 1; }
+  VkDeviceGroupPresentModeFlagsKHR swapchainModes() const;
+
+  void beginFrame(uint64_t frame);
+  uint32_t renderMask() const;
+  uint32_t waitMask() const;
+  const void *beginInfo();
+  const void *presentInfo(uint32_t swapchainCount, const void *pNext);
+
+ private:
+  VkDevice device;
+  uint32_t count;
+  DeviceGroupMode groupMode;
+  VkDeviceGroupPresentModeFlagBitsKHR presentMode;
+  uint32_t allDevices;
+  uint32_t renderDevice;
+
+  VkDeviceGroupCommandBufferBeginInfo cmdBufferInfo;
+  std::vector<uint32_t> presentMasks;
+  VkDeviceGroupPresentInfoKHR groupPresentInfo;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#include "VulkanDispatch.hpp"
+#include "VulkanTools.hpp"
+
+DeviceDispatch vkd;
+
+#define VULKAN_DISPATCH_LOAD(entry)                                       \
+  entry = (PFN_vk##entry)vkGetDeviceProcAddr(device, "vk" #entry);        \
+  if (!entry)                                                             \
+    VulkanTools::exitOnError("vkGetDeviceProcAddr failed to find vk" #entry);
+
+#define VULKAN_DISPATCH_LOAD_OPTIONAL(entry) \
+  entry = (PFN_vk##entry)vkGetDeviceProcAddr(device, "vk" #entry);
+
+void DeviceDispatch::load(VkDevice device) {
+  VULKAN_DEVICE_FUNCTIONS(VULKAN_DISPATCH_LOAD)
+  VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_DISPATCH_LOAD_OPTIONAL)
+}
+
+#undef VULKAN_DISPATCH_LOAD
+#undef VULKAN_DISPATCH_LOAD_OPTIONAL
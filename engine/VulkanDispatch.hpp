@@ -0,0 +1,117 @@
+#ifndef VULKAN_DISPATCH_HPP
+#define VULKAN_DISPATCH_HPP
+
+#include <vulkan/vulkan.h>
+
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+  X(AllocateCommandBuffers)        \
+  X(AllocateDescriptorSets)        \
+  X(AllocateMemory)                \
+  X(BeginCommandBuffer)            \
+  X(BindBufferMemory)              \
+  X(BindImageMemory)               \
+  X(CmdBeginRenderPass)            \
+  X(CmdBindDescriptorSets)         \
+  X(CmdBindIndexBuffer)            \
+  X(CmdBindPipeline)               \
+  X(CmdBindVertexBuffers)          \
+  X(CmdBlitImage)                  \
+  X(CmdClearColorImage)            \
+  X(CmdCopyBuffer)                 \
+  X(CmdCopyBufferToImage)          \
+  X(CmdCopyImageToBuffer)          \
+  X(CmdDispatch)                   \
+  X(CmdDraw)                       \
+  X(CmdDrawIndexed)                \
+  X(CmdDrawIndexedIndirect)        \
+  X(CmdEndRenderPass)              \
+  X(CmdExecuteCommands)            \
+  X(CmdFillBuffer)                 \
+  X(CmdPipelineBarrier)            \
+  X(CmdPushConstants)              \
+  X(CmdResetQueryPool)             \
+  X(CmdSetScissor)                 \
+  X(CmdSetViewport)                \
+  X(CmdWriteTimestamp)             \
+  X(CreateBuffer)                  \
+  X(CreateCommandPool)             \
+  X(CreateComputePipelines)        \
+  X(CreateDescriptorPool)          \
+  X(CreateDescriptorSetLayout)     \
+  X(CreateFence)                   \
+  X(CreateFramebuffer)             \
+  X(CreateGraphicsPipelines)       \
+  X(CreateImage)                   \
+  X(CreateImageView)               \
+  X(CreatePipelineCache)           \
+  X(CreatePipelineLayout)          \
+  X(CreateQueryPool)               \
+  X(CreateRenderPass)              \
+  X(CreateSampler)                 \
+  X(CreateSemaphore)               \
+  X(CreateShaderModule)            \
+  X(DestroyBuffer)                 \
+  X(DestroyCommandPool)            \
+  X(DestroyDescriptorPool)         \
+  X(DestroyDescriptorSetLayout)    \
+  X(DestroyDevice)                 \
+  X(DestroyFence)                  \
+  X(DestroyFramebuffer)            \
+  X(DestroyImage)                  \
+  X(DestroyImageView)              \
+  X(DestroyPipeline)               \
+  X(DestroyPipelineCache)          \
+  X(DestroyPipelineLayout)         \
+  X(DestroyQueryPool)              \
+  X(DestroyRenderPass)             \
+  X(DestroySampler)                \
+  X(DestroySemaphore)              \
+  X(DestroyShaderModule)           \
+  X(DeviceWaitIdle)                \
+  X(EndCommandBuffer)              \
+  X(FreeMemory)                    \
+  X(GetBufferMemoryRequirements)   \
+  X(GetDeviceQueue)                \
+  X(GetImageMemoryRequirements)    \
+  X(GetPipelineCacheData)          \
+  X(GetQueryPoolResults)           \
+  X(MapMemory)                     \
+  X(MergePipelineCaches)           \
+  X(QueueSubmit)                   \
+  X(QueueWaitIdle)                 \
+  X(ResetCommandPool)              \
+  X(ResetDescriptorPool)           \
+  X(ResetFences)                   \
+  X(UpdateDescriptorSets)          \
+  X(WaitForFences)
+
+// Extension entry points are left NULL when the driver doesn't expose them,
+// so callers check the pointer before use.
+#define VULKAN_OPTIONAL_DEVICE_FUNCTIONS(X) \
+  X(CmdDrawIndexedIndirectCountKHR)         \
+  X(GetSemaphoreCounterValueKHR)            \
+  X(WaitSemaphoresKHR)                      \
+  X(GetRefreshCycleDurationGOOGLE)          \
+  X(GetPastPresentationTimingGOOGLE)        \
+  X(WaitForPresentKHR)                      \
+  X(GetDeviceGroupPresentCapabilitiesKHR)   \
+  X(GetDeviceGroupSurfacePresentModesKHR)   \
+  X(AcquireNextImage2KHR)                   \
+  X(GetMemoryFdKHR)
+
+#define VULKAN_DISPATCH_MEMBER(entry) PFN_vk##entry entry;
+
+// Device-level entry points resolved through vkGetDeviceProcAddr, so calls
+// go straight to the driver instead of through the loader trampoline.
+struct DeviceDispatch {
+  VULKAN_DEVICE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+  VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+
+  void load(VkDevice device);
+};
+
+#undef VULKAN_DISPATCH_MEMBER
+
+extern DeviceDispatch vkd;
+
+#endif
@@ -0,0 +1,1561 @@
+#include "VulkanExample.hpp"
+
+static double sinceMs(uint64_t start) {
+  return (VulkanTrace::now() - start) / 1000000.0;
+}
+
+VulkanExample::VulkanExample(uint32_t framesInFlight, bool headless)
+    : device(VK_NULL_HANDLE),
+      instanceProperties2(false),
+      deviceGroupCreation(false),
+      externalMemoryCapabilities(false),
+      deviceGroupMode(VulkanDeviceGroup::parseMode(getenv(DEVICE_GROUP_ENV))),
+      bindlessRequested(false),
+      memoryBudget(false),
+      cmdPool(VK_NULL_HANDLE),
+      headless(headless),
+      readbackPath(NULL),
+      capturePath(getenv(CAPTURE_ENV)),
+      resolutionTarget(VulkanResolution::parseTarget(getenv(RESOLUTION_ENV))),
+      framesInFlight(framesInFlight),
+      currentFrame(0),
+      staticRecording(false),
+      drawChunks(1),
+      windowWidth(WINDOW_WIDTH),
+      windowHeight(WINDOW_HEIGHT),
+      frameRateLimit(FRAME_RATE_LIMIT),
+      latencyFrames(0),
+      justInTime(false),
+      benchmark(NULL),
+      pipelineCachePersistent(true),
+      startupStart(VulkanTrace::now()),
+      startupReady(0),
+      settledFrames(0),
+      steadyFrames(0),
+      steadyAllocations(0),
+      lastAllocations(0) {
+  assert(framesInFlight >= 1);
+  startup = StartupTimes();
+
+#if defined(_WIN32)
+  AllocConsole();
+  AttachConsole(GetCurrentProcessId());
+  freopen("CON", "w", stdout);
+  SetConsoleTitle(TEXT(APPLICATION_NAME));
+  windowInstance = NULL;
+#elif defined(__linux__)
+  windowSystem = VulkanWindowSystem::select(getenv(WINDOW_SYSTEM_ENV));
+#endif
+  uint64_t phaseStart = VulkanTrace::now();
+  createInstance();
+  startup.ms[STARTUP_INSTANCE] = sinceMs(phaseStart);
+
+  phaseStart = VulkanTrace::now();
+  initDevices();
+  startup.ms[STARTUP_DEVICES] = sinceMs(phaseStart);
+}
+
+VulkanExample::~VulkanExample() {
+  if (device != VK_NULL_HANDLE) vkd.DeviceWaitIdle(device);
+
+  if (VulkanDebug::enabled && steadyFrames > 0)
+    fprintf(stdout, "Allocations:    %llu in %u steady frames\n",
+            (unsigned long long)steadyAllocations, steadyFrames);
+
+  destroyFrameResources();
+#if VULKAN_COROUTINES
+  tasks.destroy();
+#endif
+  if (benchmark) benchmark->destroy();
+  commands.destroy();
+  staticCommands.destroy();
+  jobs.destroy();
+  streamer.destroy();
+  mipmaps.destroy();
+  renderQueue.destroy();
+  capture.destroy();
+  resolution.destroy();
+  geometry.destroy();
+  upload.destroy();
+  culling.destroy();
+  compute.destroy();
+  indirect.destroy();
+  descriptors.destroy();
+  uniforms.destroy();
+  profiler.destroy();
+  depthBuffer.destroy();
+  bindless.destroy();
+  descriptorLayouts.destroy();
+  shaders.destroy();
+  graph.destroy();
+  renderPasses.destroy();
+  resources.destroy();
+  timeline.destroy();
+  frameArena.destroy();
+  for (uint32_t i = 0; i < windows.size(); i++) windows[i].swapchain.destroy();
+  pipelines.destroy();
+  pipelineCompiler.destroy();
+  pipelineCache.destroy();
+  memory.destroy();
+
+  if (cmdPool != VK_NULL_HANDLE)
+    vkd.DestroyCommandPool(device, cmdPool, vkAllocator);
+  if (device != VK_NULL_HANDLE) vkd.DestroyDevice(device, vkAllocator);
+  debugUtils.destroy();
+  VulkanDevice::releaseEnumeration(instance);
+  vkDestroyInstance(instance, vkAllocator);
+  hostAllocator.print();
+
+  const char *tracePath = getenv(TRACE_FILE_ENV);
+  if (tracePath) VulkanTrace::exportFile(tracePath);
+}
+
+void VulkanExample::createInstance() {
+  TRACE_ZONE("createInstance");
+  VkApplicationInfo appInfo = {};
+  appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  appInfo.pNext = NULL;
+  appInfo.pApplicationName = APPLICATION_NAME;
+  appInfo.pEngineName = ENGINE_NAME;
+  appInfo.apiVersion = VK_MAKE_VERSION(1, 0, 3);
+
+  std::vector<const char *> enabledExtensions;
+
+  if (!headless) {
+    enabledExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+#if defined(_WIN32)
+    enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+#elif defined(__ANDROID__)
+    enabledExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+#elif defined(__linux__)
+    enabledExtensions.push_back(
+        VulkanWindowSystem::surfaceExtension(windowSystem));
+#endif
+  }
+
+  instanceProperties2 = VulkanDevice::supportsInstanceExtension(
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  if (instanceProperties2)
+    enabledExtensions.push_back(
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
+  deviceGroupCreation = VulkanDevice::supportsInstanceExtension(
+      VulkanDeviceGroup::instanceExtension());
+  if (deviceGroupCreation)
+    enabledExtensions.push_back(VulkanDeviceGroup::instanceExtension());
+
+  // Exporting capture memory needs the instance to report which handle
+  // types a buffer can be exported as, which builds on properties2.
+  externalMemoryCapabilities =
+      captureRequested() && getenv(CAPTURE_EXPORT_ENV) != NULL &&
+      instanceProperties2 &&
+      VulkanDevice::supportsInstanceExtension(
+          VulkanCapture::instanceExtension());
+  if (externalMemoryCapabilities)
+    enabledExtensions.push_back(VulkanCapture::instanceExtension());
+
+  std::vector<const char *> enabledLayers;
+  debugUtils.instanceExtensions(enabledExtensions, enabledLayers);
+
+  VkInstanceCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  createInfo.pNext = debugUtils.instanceNext();
+  createInfo.flags = 0;
+  createInfo.pApplicationInfo = &appInfo;
+  createInfo.enabledLayerCount = enabledLayers.size();
+  createInfo.ppEnabledLayerNames = enabledLayers.data();
+  createInfo.enabledExtensionCount = enabledExtensions.size();
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+
+  VkResult res = vkCreateInstance(&createInfo, vkAllocator, &instance);
+
+  if (res == VK_ERROR_INCOMPATIBLE_DRIVER) {
+    VulkanTools::exitOnError(
+      "Cannot find a compatible Vulkan installable client "
+      "driver (ICD). Please make sure your driver supports "
+      "Vulkan before continuing. The call to vkCreateInstance failed.");
+  } else if (res != VK_SUCCESS) {
+    VulkanTools::exitOnError(
+      "The call to vkCreateInstance failed. Please make sure "
+      "you have a Vulkan installable client driver (ICD) before "
+      "continuing.");
+  }
+
+  debugUtils.init(instance);
+}
+
+void VulkanExample::initDevices() {
+  TRACE_ZONE("initDevices");
+  std::vector<const char *> requiredExtensions;
+  if (!headless) requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+  std::vector<PhysicalDeviceInfo> physicalDevices =
+      VulkanDevice::enumeratePhysicalDevices(instance, requiredExtensions);
+  uint32_t selected = VulkanDevice::selectPhysicalDevice(
+      physicalDevices, getenv(DEVICE_OVERRIDE_ENV));
+
+  VulkanDevice::printPhysicalDevices(physicalDevices, selected,
+                                     getenv(DEVICE_LIST_ENV) != NULL);
+
+  physicalDevice = physicalDevices[selected].physicalDevice;
+  deviceProperties = physicalDevices[selected].properties;
+  memoryProperties = physicalDevices[selected].memoryProperties;
+
+  bindlessSupport = BindlessSupport();
+  timelineSupport = TimelineSupport();
+  if (instanceProperties2) {
+    bindlessSupport = VulkanBindless::query(instance, physicalDevice);
+    timelineSupport = VulkanTimeline::query(instance, physicalDevice);
+  }
+  indirectSupport =
+      VulkanIndirectDraws::query(physicalDevice, deviceProperties.limits);
+  streamingSupport = VulkanTextureStreamer::query(physicalDevice);
+  mipSupport = VulkanMipGenerator::query(physicalDevice);
+  captureSupport = CaptureSupport();
+  if (externalMemoryCapabilities)
+    captureSupport = VulkanCapture::query(instance, physicalDevice);
+  memoryBudget = instanceProperties2 &&
+                 VulkanMemory::supportsBudget(instance, physicalDevice);
+  pacingSupport = PacingSupport();
+  if (instanceProperties2 && !headless)
+    pacingSupport = VulkanFramePacer::query(instance, physicalDevice);
+
+  deviceGroupSupport = DeviceGroupSupport();
+  deviceGroupSupport.deviceCount = 1;
+  deviceGroupSupport.devices[0] = physicalDevice;
+  if (deviceGroupCreation)
+    deviceGroupSupport = VulkanDeviceGroup::query(instance, physicalDevice);
+}
+
+void VulkanExample::createDevice() {
+  TRACE_ZONE("createDevice");
+  queues = VulkanDevice::discoverQueues(physicalDevice, presentSupport());
+
+  std::vector<VkDeviceQueueCreateInfo> queueInfos;
+  std::vector<float> priorities;
+  VulkanDevice::queueCreateInfos(queues, queueInfos, priorities);
+
+  std::vector<const char *> enabledExtensions;
+  if (!headless) enabledExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+  bool useBindless = bindlessRequested && bindlessSupport.supported;
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+  if (useBindless) {
+    VulkanBindless::deviceExtensions(enabledExtensions);
+    VulkanBindless::deviceFeatures(bindlessSupport, indexingFeatures);
+  }
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+  VulkanTimeline::deviceExtensions(timelineSupport, enabledExtensions);
+  VulkanTimeline::deviceFeatures(timelineSupport, timelineFeatures);
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+  VulkanFramePacer::deviceExtensions(pacingSupport, enabledExtensions);
+  VulkanFramePacer::deviceFeatures(pacingSupport, presentIdFeatures,
+                                   presentWaitFeatures);
+
+  // Only a requested mode spans the group; otherwise the device stays on the
+  // selected GPU alone.
+  DeviceGroupSupport groupSupport = deviceGroupSupport;
+  if (deviceGroupMode == DEVICE_GROUP_SINGLE) groupSupport.deviceCount = 1;
+  VkDeviceGroupDeviceCreateInfo groupInfo = {};
+  VulkanDeviceGroup::deviceExtensions(groupSupport, enabledExtensions);
+  VulkanDeviceGroup::createInfo(groupSupport, groupInfo);
+
+  void *features = useBindless ? &indexingFeatures : NULL;
+  if (timelineSupport.supported) {
+    timelineFeatures.pNext = features;
+    features = &timelineFeatures;
+  }
+  if (pacingSupport.presentWait) {
+    presentIdFeatures.pNext = features;
+    features = &presentWaitFeatures;
+  }
+  if (groupSupport.deviceCount > 1) {
+    groupInfo.pNext = features;
+    features = &groupInfo;
+  }
+
+  VulkanMemory::deviceExtensions(memoryBudget, enabledExtensions);
+  VulkanCapture::deviceExtensions(captureSupport, enabledExtensions);
+
+  VkPhysicalDeviceFeatures enabledFeatures = {};
+  VulkanIndirectDraws::deviceExtensions(indirectSupport, enabledExtensions);
+  VulkanIndirectDraws::deviceFeatures(indirectSupport, enabledFeatures);
+  VulkanTextureStreamer::deviceFeatures(streamingSupport, enabledFeatures);
+  VulkanMipGenerator::deviceFeatures(mipSupport, enabledFeatures);
+
+  VkDeviceCreateInfo deviceInfo{};
+  deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  deviceInfo.pNext = features;
+  deviceInfo.flags = 0;
+  deviceInfo.queueCreateInfoCount = queueInfos.size();
+  deviceInfo.pQueueCreateInfos = queueInfos.data();
+  deviceInfo.enabledExtensionCount = enabledExtensions.size();
+  deviceInfo.ppEnabledExtensionNames = enabledExtensions.data();
+  deviceInfo.pEnabledFeatures = &enabledFeatures;
+
+  VkResult result =
+      vkCreateDevice(physicalDevice, &deviceInfo, vkAllocator, &device);
+  assert(result == VK_SUCCESS);
+
+  vkd.load(device);
+
+  VulkanDevice::getQueues(device, queues);
+  VulkanDevice::printQueues(queues);
+
+  debugUtils.initDevice(device);
+  debugUtils.name(VK_OBJECT_TYPE_QUEUE, queues.queue(QUEUE_GRAPHICS),
+                  "graphics queue");
+  if (queues.separate(QUEUE_COMPUTE))
+    debugUtils.name(VK_OBJECT_TYPE_QUEUE, queues.queue(QUEUE_COMPUTE),
+                    "compute queue");
+  if (queues.separate(QUEUE_TRANSFER))
+    debugUtils.name(VK_OBJECT_TYPE_QUEUE, queues.queue(QUEUE_TRANSFER),
+                    "transfer queue");
+
+  VkDeviceGroupPresentModeFlagsKHR surfaceModes = ~0u;
+  bool clearable = true;
+  for (uint32_t i = 0; i < windows.size(); i++) {
+    surfaceModes &= windows[i].swapchain.groupPresentModes(device);
+    clearable = clearable && (windows[i].swapchain.supportedUsage() &
+                              VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+  }
+  deviceGroup.init(device, groupSupport, deviceGroupMode, !headless,
+                   surfaceModes, clearable);
+
+  // A timeline value says nothing about which GPU of a group reached it, so
+  // a group waits on per-frame fences instead.
+  timeline.init(device, timelineSupport,
+                getenv(TIMELINE_DISABLE_ENV) == NULL && !deviceGroup.grouped());
+  frameArena.init();
+  submitter.init(timeline, frameArena);
+
+  memory.init(physicalDevice, device, instance, memoryBudget);
+  resources.init(device, memory, framesInFlight);
+  resources.track(timeline, queues.queue(QUEUE_GRAPHICS));
+  renderPasses.init(device, resources);
+  graph.init(device, memory, resources, renderPasses);
+  descriptorLayouts.init(device);
+  shaders.init(device, resources, getenv(SHADER_RELOAD_ENV) != NULL);
+
+  if (useBindless) {
+    bindless.init(device, resources, bindlessSupport);
+    fprintf(stdout, "Bindless:       %u images, %u buffers\n",
+            bindlessSupport.maxImages, bindlessSupport.maxBuffers);
+  } else if (bindlessRequested) {
+    fprintf(stdout, "Bindless:       unsupported\n");
+  }
+  pipelineCache.init(device, deviceProperties, NULL, pipelineCachePersistent);
+  pipelineCompiler.init(device, pipelineCache);
+  pipelines.init(device, resources, pipelineCache);
+  profiler.init(physicalDevice, device, deviceProperties,
+                queues.family(QUEUE_GRAPHICS), framesInFlight);
+}
+
+void VulkanExample::createCommandPool() {
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.pNext = NULL;
+  cmdPoolInfo.queueFamilyIndex = queues.family(QUEUE_GRAPHICS);
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkResult result =
+      vkd.CreateCommandPool(device, &cmdPoolInfo, vkAllocator, &cmdPool);
+  assert(result == VK_SUCCESS);
+  debugUtils.name(VK_OBJECT_TYPE_COMMAND_POOL, cmdPool, "initial pool");
+}
+
+void VulkanExample::createCommandBuffer() {
+  VkCommandBufferAllocateInfo cmdInfo = {};
+  cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdInfo.pNext = NULL;
+  cmdInfo.commandPool = cmdPool;
+  cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdInfo.commandBufferCount = 1;
+
+  VkResult result =
+      vkd.AllocateCommandBuffers(device, &cmdInfo, &initialCmdBuffer);
+  assert(result == VK_SUCCESS);
+}
+
+void VulkanExample::beginCommandBuffer() {
+  VkResult result = vkd.ResetCommandPool(device, cmdPool, 0);
+  assert(result == VK_SUCCESS);
+
+  VkCommandBufferBeginInfo cmdInfo = {};
+  cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  cmdInfo.pNext = NULL;
+
+  result = vkd.BeginCommandBuffer(initialCmdBuffer, &cmdInfo);
+  assert(result == VK_SUCCESS);
+}
+
+void VulkanExample::submitCommandBuffer() {
+  VkQueue queue = queues.queue(QUEUE_GRAPHICS);
+  VkResult result = vkd.EndCommandBuffer(initialCmdBuffer);
+  assert(result == VK_SUCCESS);
+
+  submitter.submit(queue, initialCmdBuffer);
+  submitter.flush(queue);
+
+  result = vkd.QueueWaitIdle(queue);
+  assert(result == VK_SUCCESS);
+}
+
+void VulkanExample::createFrameResources() {
+  frames.resize(framesInFlight);
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = NULL;
+  semaphoreInfo.flags = 0;
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.pNext = NULL;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+    // Each window acquires into its own semaphore; one render-complete
+    // semaphore per GPU covers the single present to all of them.
+    frames[i].imageAcquired.resize(windows.size());
+    for (uint32_t j = 0; j < windows.size(); j++) {
+      VkResult result = vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                                            &frames[i].imageAcquired[j]);
+      assert(result == VK_SUCCESS);
+    }
+
+    uint32_t splitDevices =
+        deviceGroup.splitFrame() ? deviceGroup.deviceCount() : 0;
+    frames[i].renderComplete.resize(splitDevices > 0 ? splitDevices : 1);
+    for (uint32_t j = 0; j < frames[i].renderComplete.size(); j++) {
+      VkResult result = vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                                            &frames[i].renderComplete[j]);
+      assert(result == VK_SUCCESS);
+    }
+    frames[i].deviceStart.resize(splitDevices);
+    for (uint32_t j = 0; j < frames[i].deviceStart.size(); j++) {
+      VkResult result = vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                                            &frames[i].deviceStart[j]);
+      assert(result == VK_SUCCESS);
+    }
+
+    // Frames wait on the graphics timeline instead when there is one.
+    frames[i].fence = VK_NULL_HANDLE;
+    frames[i].value = 0;
+    if (timeline.enabled()) continue;
+
+    VkResult result =
+        vkd.CreateFence(device, &fenceInfo, vkAllocator, &frames[i].fence);
+    assert(result == VK_SUCCESS);
+  }
+
+  // Names built at runtime are only worth building for the debug policy.
+  if (VulkanDebug::enabled) {
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+      std::string frame = "frame " + std::to_string(i);
+      debugUtils.name(VK_OBJECT_TYPE_FENCE, frames[i].fence,
+                      (frame + " fence").c_str());
+      for (uint32_t j = 0; j < frames[i].imageAcquired.size(); j++)
+        debugUtils.name(VK_OBJECT_TYPE_SEMAPHORE, frames[i].imageAcquired[j],
+                        (frame + " acquired " + std::to_string(j)).c_str());
+      for (uint32_t j = 0; j < frames[i].renderComplete.size(); j++)
+        debugUtils.name(VK_OBJECT_TYPE_SEMAPHORE, frames[i].renderComplete[j],
+                        (frame + " complete " + std::to_string(j)).c_str());
+    }
+  }
+
+  currentFrame = 0;
+}
+
+void VulkanExample::destroyFrameResources() {
+  if (frames.empty()) return;
+
+  vkd.DeviceWaitIdle(device);
+
+  for (uint32_t i = 0; i < frames.size(); i++) {
+    for (uint32_t j = 0; j < frames[i].imageAcquired.size(); j++)
+      vkd.DestroySemaphore(device, frames[i].imageAcquired[j], vkAllocator);
+    for (uint32_t j = 0; j < frames[i].renderComplete.size(); j++)
+      vkd.DestroySemaphore(device, frames[i].renderComplete[j], vkAllocator);
+    for (uint32_t j = 0; j < frames[i].deviceStart.size(); j++)
+      vkd.DestroySemaphore(device, frames[i].deviceStart[j], vkAllocator);
+    vkd.DestroyFence(device, frames[i].fence, vkAllocator);
+  }
+
+  frames.clear();
+}
+
+void VulkanExample::recordChunk(VkCommandBuffer cmdBuffer, uint32_t chunk,
+                                uint32_t view) {
+  // Per-chunk draws go here, pushing their uniforms into the ring and
+  // binding uniforms.descriptorSet at the returned offset. Large static sets
+  // instead go into indirect, which one chunk submits with indirect.draw(),
+  // or with culling.draw() once culling has compacted them on the GPU. view
+  // is the window being drawn, or 0 offscreen. In a split frame each GPU
+  // only owns context.deviceAreas[i] of the target, so draws can be
+  // scissored to it. Batched draws from drawQueue() are split across the
+  // same chunks.
+  renderQueue.record(cmdBuffer, RENDER_QUEUE_COLOR_PASS, GEOMETRY_PASS_SHADED,
+                     renderExtent(view), chunk, drawChunks);
+  if (benchmark)
+    benchmark->recordDraws(cmdBuffer, chunk, drawChunks, renderExtent(view));
+}
+
+void VulkanExample::recordStatic(VkCommandBuffer cmdBuffer, uint32_t view) {
+  // Draws that don't change between frames go here. This is replayed until
+  // invalidateStatic() or a new swapchain, so it can't use uniform ring
+  // offsets or anything else that moves from frame to frame.
+}
+
+uint32_t VulkanExample::viewCount() const {
+  return headless ? 1 : windows.size();
+}
+
+bool VulkanExample::viewReady(uint32_t view) const {
+  return headless || windows[view].acquired;
+}
+
+void VulkanExample::buildGraph() {
+  VkImageLayout targetLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                        : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  graph.reset();
+
+  VkClearValue colorClear = {};
+  colorClear.color.float32[0] = 0.1f;
+  colorClear.color.float32[1] = 0.1f;
+  colorClear.color.float32[2] = 0.1f;
+  colorClear.color.float32[3] = 1.0f;
+  VkClearValue depthClear = {};
+  depthClear.depthStencil.depth = 1.0f;
+  depthClear.depthStencil.stencil = 0;
+
+  // Only the first window feeds Hi-Z culling and keeps its depth buffer
+  // from frame to frame; the others draw into transient depth the graph can
+  // alias between them.
+  uint32_t hizDepth = GRAPH_INVALID;
+  uint32_t readbackTarget = GRAPH_INVALID;
+
+  for (uint32_t view = 0; view < viewCount(); view++) {
+    if (!viewReady(view)) continue;
+
+    const ViewNames &names = viewNames[view];
+    VkExtent2D extent = targetExtent(view);
+    VkExtent2D sceneExtent = renderExtent(view);
+    bool upscaled = sceneExtent.width != extent.width ||
+                    sceneExtent.height != extent.height;
+
+    // The target is waited on at color output for the acquire semaphore,
+    // and the depth buffer after last frame's depth tests and Hi-Z reads.
+    GraphImageDesc targetDesc = {targetFormat(view), extent.width,
+                                 extent.height, VK_IMAGE_ASPECT_COLOR_BIT,
+                                 VK_SAMPLE_COUNT_1_BIT};
+    uint32_t target = graph.importImage(
+        names.target.c_str(), targetImage(view), targetView(view), targetDesc,
+        graphUse(VK_IMAGE_LAYOUT_UNDEFINED,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT),
+        graphUse(targetLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT));
+
+    // At a reduced resolution the scene draws into a transient image of its
+    // own, with depth to match, and is stretched over the target after.
+    uint32_t scene = target;
+    if (upscaled) {
+      GraphImageDesc sceneDesc = {targetFormat(view), sceneExtent.width,
+                                  sceneExtent.height,
+                                  VK_IMAGE_ASPECT_COLOR_BIT,
+                                  VK_SAMPLE_COUNT_1_BIT};
+      scene = graph.createImage(names.scene.c_str(), sceneDesc);
+    }
+
+    GraphImageDesc depthDesc = {depthBuffer.format(), sceneExtent.width,
+                                sceneExtent.height, depthBuffer.imageAspects(),
+                                VK_SAMPLE_COUNT_1_BIT};
+    uint32_t depth;
+    if (view == 0) {
+      depthBuffer.resize(sceneExtent.width, sceneExtent.height);
+      depth = graph.importImage(
+          names.depth.c_str(), depthBuffer.image(), depthBuffer.view(),
+          depthDesc,
+          graphUse(VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT));
+      // Each GPU of a group has a pyramid of its own, which in alternate
+      // frames was built two frames back, and only its band of a split
+      // frame, so only a single GPU culls against Hi-Z.
+      if (!deviceGroup.active()) hizDepth = depth;
+      readbackTarget = target;
+    } else {
+      depth = graph.createImage(names.depth.c_str(), depthDesc);
+    }
+
+    // A split frame is summed at present, so each GPU zeroes the whole
+    // image before the draw clears and fills only its own band. The group
+    // only splits frames when every surface can be cleared.
+    if (deviceGroup.splitFrame()) {
+      assert(windows[view].swapchain.imageUsage &
+             VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+      graph.addPass(names.clear.c_str())
+          .transferDst(target)
+          .sideEffect()
+          .execute([this, target](VkCommandBuffer cmdBuffer,
+                                  const GraphPassContext &) {
+            VkClearColorValue zero = {};
+            VkImageSubresourceRange range =
+                VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+            vkd.CmdClearColorImage(cmdBuffer, graph.image(target),
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero,
+                                   1, &range);
+          });
+    }
+
+    // Callbacks capture no more than std::function keeps without
+    // allocating; anything else they need is looked up when they run.
+    graph.addPass(names.draw.c_str())
+        .color(scene, VK_ATTACHMENT_LOAD_OP_CLEAR, colorClear)
+        .depth(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, depthClear)
+        .secondary()
+        .execute([this, view](VkCommandBuffer cmdBuffer,
+                              const GraphPassContext &context) {
+          uint32_t slot = currentFrame * viewCount() + view;
+          uint32_t generation =
+              headless ? 0 : windows[view].swapchain.generation;
+          if (staticRecording)
+            staticCommands.execute(cmdBuffer, slot, context.renderPass,
+                                   generation,
+                                   [this, view](VkCommandBuffer secondary) {
+                                     recordStatic(secondary, view);
+                                   });
+          if (benchmark) benchmark->prepareDraws(context.renderPass);
+          commands.recordParallel(
+              jobs, cmdBuffer, drawChunks,
+              [this, view](VkCommandBuffer secondary, uint32_t chunk) {
+                recordChunk(secondary, chunk, view);
+              },
+              context.renderPass, context.framebuffer);
+        });
+
+    if (upscaled) {
+      viewImages[view].scene = scene;
+      viewImages[view].target = target;
+      graph.addPass(names.upscale.c_str())
+          .transferSrc(scene)
+          .transferDst(target)
+          .execute([this, view](VkCommandBuffer cmdBuffer,
+                                const GraphPassContext &) {
+            const ViewImages &images = viewImages[view];
+            VulkanResolution::recordUpscale(
+                cmdBuffer, graph.image(images.scene), renderExtent(view),
+                graph.image(images.target), targetExtent(view));
+          });
+    }
+  }
+
+  if (hizDepth != GRAPH_INVALID && culling.enabled() &&
+      depthBuffer.sampled())
+    graph.addPass("hiz")
+        .sampled(hizDepth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+        .sideEffect()
+        .execute([this](VkCommandBuffer cmdBuffer, const GraphPassContext &) {
+          culling.buildHiZ(cmdBuffer, depthBuffer);
+        });
+
+  if (headless)
+    graph.addPass("readback")
+        .transferSrc(readbackTarget)
+        .sideEffect()
+        .execute([this](VkCommandBuffer cmdBuffer, const GraphPassContext &) {
+          recordReadback(cmdBuffer, currentFrame);
+        });
+
+  if (capture.enabled() && readbackTarget != GRAPH_INVALID &&
+      (headless ||
+       (windows[0].swapchain.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)))
+    graph.addPass("capture")
+        .transferSrc(readbackTarget)
+        .sideEffect()
+        .execute([this, readbackTarget](VkCommandBuffer cmdBuffer,
+                                        const GraphPassContext &) {
+          capture.record(cmdBuffer, graph.image(readbackTarget),
+                         targetFormat(0), targetExtent(0),
+                         submitter.totalFrames());
+        });
+
+  graph.compile();
+}
+
+void VulkanExample::recordDrawBuffer(VkCommandBuffer cmdBuffer) {
+  VkCommandBufferBeginInfo cmdInfo = {};
+  cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  cmdInfo.pNext = deviceGroup.beginInfo();
+
+  VkResult result = vkd.BeginCommandBuffer(cmdBuffer, &cmdInfo);
+  assert(result == VK_SUCCESS);
+
+  debugUtils.beginLabel(cmdBuffer, "frame");
+  profiler.beginFrame(cmdBuffer, currentFrame);
+  uint32_t frameScope = profiler.begin(cmdBuffer, "frame");
+
+  upload.acquire(cmdBuffer);
+  mipmaps.record(cmdBuffer);
+  if (benchmark) benchmark->recordBarriers(cmdBuffer);
+
+  // Culling goes to the compute queue when there is one, and the draws it
+  // produces come back to this command buffer before they are read.
+  VkCommandBuffer computeCmdBuffer = compute.begin(currentFrame, cmdBuffer);
+  {
+    DEBUG_LABEL(computeCmdBuffer, "cull");
+    culling.cull(computeCmdBuffer, currentFrame);
+  }
+  compute.end(cmdBuffer);
+
+  buildGraph();
+  graph.execute(cmdBuffer, &profiler);
+
+  profiler.end(cmdBuffer, frameScope);
+  compute.release(cmdBuffer);
+  debugUtils.endLabel(cmdBuffer);
+
+  result = vkd.EndCommandBuffer(cmdBuffer);
+  assert(result == VK_SUCCESS);
+}
+
+void VulkanExample::setSwapchainPolicy(const SwapchainPolicy &policy) {
+  swapchainPolicy = policy;
+
+  for (uint32_t i = 0; i < windows.size(); i++)
+    if (windows[i].swapchain.swapchain != VK_NULL_HANDLE)
+      windows[i].dirty = true;
+}
+
+void VulkanExample::setBenchmark(VulkanBenchmark *benchmark) {
+  this->benchmark = benchmark;
+}
+
+void VulkanExample::setPipelineCache(bool persistent) {
+  pipelineCachePersistent = persistent;
+}
+
+void VulkanExample::windowResized(uint32_t width, uint32_t height,
+                                  uint32_t window) {
+  if (window >= windows.size()) return;
+
+  ExampleWindow &target = windows[window];
+  if (width == target.width && height == target.height) return;
+
+  target.width = width;
+  target.height = height;
+  target.dirty = true;
+}
+
+std::vector<VkBool32> VulkanExample::presentSupport() const {
+  // The present queue has to reach every window's surface.
+  std::vector<VkBool32> support;
+  for (uint32_t i = 0; i < windows.size(); i++) {
+    const std::vector<VkBool32> &surface = windows[i].swapchain.presentSupport;
+    if (i == 0) {
+      support = surface;
+      continue;
+    }
+    for (uint32_t family = 0; family < support.size(); family++)
+      support[family] = support[family] && surface[family];
+  }
+
+  return support;
+}
+
+bool VulkanExample::recreateSwapchains() {
+  bool recording = false;
+
+  for (uint32_t i = 0; i < windows.size(); i++) {
+    ExampleWindow &window = windows[i];
+    if (!window.dirty || window.width == 0 || window.height == 0) continue;
+
+    if (!recording) beginCommandBuffer();
+    recording = true;
+
+    window.swapchain.create(initialCmdBuffer, swapchainPolicy, window.width,
+                            window.height);
+    window.dirty = false;
+  }
+
+  if (recording) submitCommandBuffer();
+  return recording;
+}
+
+uint32_t VulkanExample::acquireImages(FrameResources &frame) {
+  uint32_t acquired = 0;
+
+  // A window that can't hand out an image this frame, because it is
+  // minimized or out of date, sits the frame out while the rest go ahead.
+  for (uint32_t i = 0; i < windows.size(); i++) {
+    ExampleWindow &window = windows[i];
+    window.acquired = false;
+    if (window.dirty || window.swapchain.extent.width == 0 ||
+        window.swapchain.extent.height == 0)
+      continue;
+
+    VkResult result = window.swapchain.getSwapchainNext(
+        frame.imageAcquired[i], &window.imageIndex, ACQUIRE_TIMEOUT,
+        VK_NULL_HANDLE, deviceGroup.renderMask());
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) window.dirty = true;
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) continue;
+
+    window.acquired = true;
+    acquired++;
+  }
+
+  return acquired;
+}
+
+void VulkanExample::presentImages(FrameResources &frame) {
+  uint32_t windowCount = windows.size();
+  VkSwapchainKHR *swapchains = frameArena.alloc<VkSwapchainKHR>(windowCount);
+  uint32_t *imageIndices = frameArena.alloc<uint32_t>(windowCount);
+  uint32_t *presented = frameArena.alloc<uint32_t>(windowCount);
+  VkResult *results = frameArena.alloc<VkResult>(windowCount);
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < windowCount; i++) {
+    if (!windows[i].acquired) continue;
+    swapchains[count] = windows[i].swapchain.swapchain;
+    imageIndices[count] = windows[i].imageIndex;
+    presented[count] = i;
+    results[count] = VK_SUCCESS;
+    count++;
+  }
+
+  // Any swapchain can issue the present, since they share the device.
+  VulkanSwapchain &first = windows[presented[0]].swapchain;
+  first.swapchainPresent(
+      queues.queue(QUEUE_PRESENT), count, swapchains, imageIndices,
+      frame.renderComplete.size(), frame.renderComplete.data(), results,
+      deviceGroup.presentInfo(count, pacer.beginPresent(count)));
+  pacer.endPresent(windows[0].swapchain.swapchain);
+
+  for (uint32_t i = 0; i < count; i++)
+    if (results[i] == VK_SUBOPTIMAL_KHR ||
+        results[i] == VK_ERROR_OUT_OF_DATE_KHR)
+      windows[presented[i]].dirty = true;
+}
+
+void VulkanExample::waitForLatency() {
+  TRACE_ZONE("latency");
+  uint32_t latency = pacer.latency();
+
+  // Waiting on the frame from framesInFlight ago is what renderFrame does
+  // anyway, so only a lower latency needs a wait of its own.
+  if (latency < framesInFlight) {
+    FrameResources &oldest =
+        frames[(currentFrame + framesInFlight - latency) % framesInFlight];
+    if (timeline.enabled()) {
+      timeline.wait(queues.queue(QUEUE_GRAPHICS), oldest.value);
+    } else {
+      VkResult result =
+          vkd.WaitForFences(device, 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+      assert(result == VK_SUCCESS);
+    }
+  }
+
+  pacer.beginFrame(headless ? VK_NULL_HANDLE : windows[0].swapchain.swapchain,
+                   profiler.averageMs("frame"));
+}
+
+// Frames settle for ALLOCATION_WARMUP_FRAMES after startup, a new swapchain
+// or a shader reload, while caches and lists grow to size. Past that a
+// frame should not touch the heap, which debug builds check.
+void VulkanExample::countAllocations(uint64_t allocations) {
+  lastAllocations = allocations;
+  if (!VulkanDebug::enabled) return;
+
+  if (settledFrames < ALLOCATION_WARMUP_FRAMES) {
+    settledFrames++;
+    return;
+  }
+
+  steadyFrames++;
+  if (allocations > 0 && steadyAllocations == 0)
+    fprintf(stderr, "Warning: %llu heap allocations in steady frame %u\n",
+            (unsigned long long)allocations, steadyFrames);
+  steadyAllocations += allocations;
+}
+
+bool VulkanExample::renderFrame() {
+  uint64_t allocations = heapAllocations();
+  if (benchmark) {
+    benchmark->frameBegin();
+    if (benchmark->recreateDue())
+      for (uint32_t i = 0; i < windows.size(); i++) windows[i].dirty = true;
+  }
+  if (!headless && recreateSwapchains()) settledFrames = 0;
+
+  TRACE_ZONE("frame");
+  FrameResources &frame = frames[currentFrame];
+  VkResult result;
+  VkQueue graphicsQueue = queues.queue(QUEUE_GRAPHICS);
+
+  {
+    TRACE_ZONE("acquire");
+    deviceGroup.beginFrame(submitter.totalFrames());
+    if (timeline.enabled()) {
+      timeline.wait(graphicsQueue, frame.value);
+    } else {
+      result =
+          vkd.WaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+      assert(result == VK_SUCCESS);
+    }
+
+    if (!headless && acquireImages(frame) == 0) return false;
+  }
+
+  if (frame.fence != VK_NULL_HANDLE) {
+    result = vkd.ResetFences(device, 1, &frame.fence);
+    assert(result == VK_SUCCESS);
+  }
+
+  VkCommandBuffer cmdBuffer;
+  VkSemaphore uploadComplete;
+
+  {
+    TRACE_ZONE("record");
+    frameArena.reset();
+    memory.beginFrame();
+    resources.beginFrame();
+    commands.beginFrame(currentFrame);
+    uniforms.beginFrame(currentFrame);
+    descriptors.beginFrame(currentFrame);
+    indirect.beginFrame(currentFrame);
+    renderQueue.beginFrame(currentFrame);
+    if (shaders.applyReloads() > 0) settledFrames = 0;
+    cmdBuffer = commands.primary(jobs.callerThread());
+#if VULKAN_COROUTINES
+    tasks.poll();
+#endif
+
+    // The example's one texture is asked for at the size of the window.
+    if (streamedTexture.valid())
+      streamer.demand(streamedTexture,
+                      (float)std::max(windowWidth, windowHeight));
+    streamer.update();
+    if (benchmark) benchmark->upload(upload);
+    uploadComplete = upload.submit();
+    // A new scale resizes the scene, which recorded viewports don't follow.
+    if (resolution.update(profiler.latestMs("frame"))) invalidateStatic();
+    recordDrawBuffer(cmdBuffer);
+  }
+
+  submitter.setDeviceMask(graphicsQueue, deviceGroup.waitMask());
+  if (frame.fence != VK_NULL_HANDLE)
+    submitter.fence(graphicsQueue, frame.fence);
+
+  for (uint32_t i = 0; i < windows.size(); i++)
+    if (windows[i].acquired)
+      submitter.wait(graphicsQueue, frame.imageAcquired[i],
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  if (uploadComplete != VK_NULL_HANDLE)
+    submitter.wait(graphicsQueue, uploadComplete, upload.waitStage);
+  compute.queueGraphicsWait();
+
+  // The first GPU of a split frame takes the waits above and hands them on
+  // to every GPU before they all run the frame.
+  for (uint32_t i = 0; i < frame.deviceStart.size(); i++)
+    submitter.signal(graphicsQueue, frame.deviceStart[i]);
+  submitter.setDeviceMask(graphicsQueue, deviceGroup.renderMask());
+  for (uint32_t i = 0; i < frame.deviceStart.size(); i++)
+    submitter.wait(graphicsQueue, frame.deviceStart[i],
+                   VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, i);
+
+  submitter.submit(graphicsQueue, cmdBuffer);
+
+  if (!headless)
+    for (uint32_t i = 0; i < frame.renderComplete.size(); i++)
+      submitter.signal(graphicsQueue, frame.renderComplete[i],
+                       deviceGroup.splitFrame() ? i : SUBMIT_FIRST_DEVICE);
+  compute.queueGraphicsSignal();
+
+  {
+    TRACE_ZONE("submit");
+    submitter.endFrame();
+  }
+  submitter.setDeviceMask(graphicsQueue, 0);
+  if (timeline.enabled()) frame.value = timeline.submitted(graphicsQueue);
+  pacer.submitted();
+
+  if (!headless) {
+    TRACE_ZONE("present");
+    presentImages(frame);
+  }
+
+  currentFrame = (currentFrame + 1) % framesInFlight;
+  if (benchmark) benchmark->frameEnd(profiler.latestMs("frame"));
+
+  if (startup.ms[STARTUP_TOTAL] == 0.0) {
+    startup.ms[STARTUP_FIRST_FRAME] = sinceMs(startupReady);
+    startup.ms[STARTUP_TOTAL] = sinceMs(startupStart);
+  }
+
+  countAllocations(heapAllocations() - allocations);
+  return true;
+}
+
+void VulkanExample::setBindless(bool enable) { bindlessRequested = enable; }
+
+void VulkanExample::setDeviceGroup(DeviceGroupMode mode) {
+  deviceGroupMode = mode;
+}
+
+void VulkanExample::setStaticRecording(bool enable) {
+  staticRecording = enable;
+}
+
+void VulkanExample::invalidateStatic() { staticCommands.invalidate(); }
+
+void VulkanExample::setFrameRateLimit(uint32_t framesPerSecond) {
+  frameRateLimit = framesPerSecond;
+  nextFrameTime = std::chrono::steady_clock::now();
+}
+
+void VulkanExample::setLatency(uint32_t frames, bool justInTime) {
+  latencyFrames = frames;
+  this->justInTime = justInTime;
+}
+
+void VulkanExample::limitFrameRate() {
+  if (frameRateLimit == 0) return;
+
+  std::chrono::steady_clock::duration budget =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / frameRateLimit));
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  nextFrameTime += budget;
+
+  if (nextFrameTime > now)
+    std::this_thread::sleep_until(nextFrameTime);
+  else
+    nextFrameTime = now;
+}
+
+void VulkanExample::renderLoop() {
+  nextFrameTime = std::chrono::steady_clock::now();
+
+  while (!benchmark || !benchmark->finished()) {
+    waitForLatency();
+    if (!pumpEvents()) break;
+    if (renderFrame()) limitFrameRate();
+  }
+
+  vkd.DeviceWaitIdle(device);
+  pacer.print();
+  resources.flush();
+
+  for (uint32_t i = 0; i < windows.size(); i++)
+    windows[i].swapchain.destroy();
+#if defined(__linux__)
+  windowing.destroy();
+#endif
+}
+
+void VulkanExample::initSwapchain() {
+  uint64_t initStart = VulkanTrace::now();
+
+  if (windows.empty()) VulkanTools::exitOnError("No window to present to");
+
+  for (uint32_t i = 0; i < windows.size(); i++) {
+    uint64_t phaseStart = VulkanTrace::now();
+    windows[i].swapchain.init(instance, physicalDevice);
+    startup.ms[STARTUP_SWAPCHAIN_INIT] += sinceMs(phaseStart);
+
+    phaseStart = VulkanTrace::now();
+#if defined(_WIN32)
+    windows[i].swapchain.createSurface(windowInstance, windows[i].window);
+#elif defined(__linux__)
+    windows[i].swapchain.createSurface(windows[i].window);
+#endif
+    startup.ms[STARTUP_SURFACE] += sinceMs(phaseStart);
+  }
+
+  uint64_t phaseStart = VulkanTrace::now();
+  createDevice();
+  startup.ms[STARTUP_DEVICE] = sinceMs(phaseStart);
+
+  for (uint32_t i = 0; i < windows.size(); i++) {
+    windows[i].swapchain.initDevice(device, queues.family(QUEUE_GRAPHICS),
+                                    queues.family(QUEUE_PRESENT));
+    windows[i].swapchain.setResources(&resources);
+    windows[i].swapchain.groupModes = deviceGroup.swapchainModes();
+    if (captureRequested())
+      windows[i].swapchain.requestedUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (resolutionTarget > 0.0)
+      windows[i].swapchain.requestedUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    windows[i].dirty = true;
+  }
+
+  phaseStart = VulkanTrace::now();
+  createCommandPool();
+  createCommandBuffer();
+  startup.ms[STARTUP_FRAME_LOOP] = sinceMs(phaseStart);
+
+  phaseStart = VulkanTrace::now();
+  recreateSwapchains();
+  startup.ms[STARTUP_SWAPCHAIN] = sinceMs(phaseStart);
+
+  phaseStart = VulkanTrace::now();
+  initFrameLoop();
+  startup.ms[STARTUP_FRAME_LOOP] += sinceMs(phaseStart);
+
+  fprintf(stdout, "Present Mode:   %d\n", windows[0].swapchain.presentMode);
+  fprintf(stdout, "Image Count:    %d\n", windows[0].swapchain.imageCount);
+  if (windows.size() > 1)
+    fprintf(stdout, "Windows:        %u, presented together\n",
+            (uint32_t)windows.size());
+
+  uint64_t initEnd = VulkanTrace::now();
+  startupReady = initEnd;
+  VulkanTrace::record("initSwapchain", initStart, initEnd);
+  fprintf(stdout, "Startup Time:   %.2f ms\n",
+          (initEnd - startupStart) / 1000000.0);
+}
+
+void VulkanExample::initOffscreen() {
+  uint64_t initStart = VulkanTrace::now();
+
+  createDevice();
+  startup.ms[STARTUP_DEVICE] = sinceMs(initStart);
+
+  uint64_t phaseStart = VulkanTrace::now();
+  createCommandPool();
+  createCommandBuffer();
+  beginCommandBuffer();
+  createOffscreenTargets(initialCmdBuffer);
+  submitCommandBuffer();
+  initFrameLoop();
+  startup.ms[STARTUP_FRAME_LOOP] = sinceMs(phaseStart);
+
+  fprintf(stdout, "Offscreen:      %ux%u, %u targets\n", windowWidth,
+          windowHeight, (uint32_t)offscreenTargets.size());
+
+  uint64_t initEnd = VulkanTrace::now();
+  startupReady = initEnd;
+  VulkanTrace::record("initOffscreen", initStart, initEnd);
+  fprintf(stdout, "Startup Time:   %.2f ms\n",
+          (initEnd - startupStart) / 1000000.0);
+}
+
+void VulkanExample::initFrameLoop() {
+  viewNames.resize(viewCount());
+  for (uint32_t i = 0; i < viewNames.size(); i++) {
+    std::string suffix = i == 0 ? "" : std::to_string(i);
+    viewNames[i].target = "target" + suffix;
+    viewNames[i].depth = "depth" + suffix;
+    viewNames[i].clear = "clear" + suffix;
+    viewNames[i].draw = "draw" + suffix;
+    viewNames[i].scene = "scene" + suffix;
+    viewNames[i].upscale = "upscale" + suffix;
+  }
+  viewImages.resize(viewCount());
+
+  graph.setDeviceSplit(deviceGroup.splitFrame() ? deviceGroup.deviceCount()
+                                                : 1);
+  createFrameResources();
+  upload.init(device, memory, queues, submitter, framesInFlight);
+  mipmaps.init(physicalDevice, device, resources, descriptorLayouts,
+               descriptors, shaders, pipelineCache, mipSupport);
+  fprintf(stdout, "Mipmaps:        blit%s\n",
+          mipmaps.computeFallback() ? ", compute fallback" : "");
+  streamer.init(physicalDevice, device, memory, resources, upload,
+                streamingSupport, bindless.enabled() ? &bindless : NULL,
+                &mipmaps);
+
+  GeometryFormat geometryFormat = {};
+  geometryFormat.vertexSize = GEOMETRY_VERTEX_SIZE;
+  geometryFormat.layout = getenv(GEOMETRY_INTERLEAVED_ENV) != NULL
+                              ? GEOMETRY_INTERLEAVED
+                              : GEOMETRY_SPLIT;
+  geometryFormat.indexType = VK_INDEX_TYPE_UINT32;
+  geometry.init(device, resources, upload, geometryFormat);
+
+  const char *texturePath = getenv(TEXTURE_LOAD_ENV);
+  if (texturePath) streamedTexture = streamer.load(texturePath);
+  fprintf(stdout, "Streaming:      %u decode threads%s\n",
+          TEXTURE_DECODE_THREADS,
+          streamingSupport.compressedBC ? ", BC" : ", BC transcoded");
+  uniforms.init(device, resources, descriptorLayouts, deviceProperties.limits,
+                framesInFlight, UNIFORM_RING_FRAME_SIZE,
+                UNIFORM_RING_BIND_RANGE);
+  descriptors.init(device, framesInFlight);
+  indirect.init(device, resources, indirectSupport, framesInFlight,
+                INDIRECT_MAX_DRAWS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  fprintf(stdout, "Indirect:       %s%s\n",
+          indirectSupport.multiDraw ? "multi-draw" : "single draw",
+          indirectSupport.drawCount ? ", draw count" : "");
+  compute.init(device, queues, submitter, framesInFlight,
+               getenv(ASYNC_COMPUTE_DISABLE_ENV) == NULL &&
+                   !deviceGroup.grouped());
+  culling.init(device, resources, descriptorLayouts, descriptors, shaders,
+               pipelineCache, indirect, compute, indirectSupport,
+               framesInFlight);
+  depthBuffer.init(physicalDevice, memory, resources, false,
+                   culling.enabled());
+
+  jobs.init();
+  // One chunk per job thread, the caller's included, so recordChunk()
+  // spreads the frame's draws over every core.
+  drawChunks = jobs.threadCount();
+  commands.init(device, queues.family(QUEUE_GRAPHICS), jobs.threadCount(),
+                framesInFlight);
+  renderQueue.init(device, resources, jobs, geometry, framesInFlight);
+  // Each GPU of a group renders frames or bands of its own, so no one
+  // image holds the frame to copy out.
+  if (captureRequested() && !deviceGroup.grouped())
+    capture.init(device, memory, resources, captureSupport,
+                 getenv(CAPTURE_EXPORT_ENV) != NULL,
+                 captureSink ? captureSink
+                             : VulkanCapture::ppmSink(capturePath));
+  // The scale follows the GPU frame time, and a group's frames or bands
+  // would each need one of their own.
+  if (resolutionTarget > 0.0) {
+    if (profiler.enabled() && !deviceGroup.grouped())
+      resolution.init(resolutionTarget, framesInFlight + 1);
+    else
+      fprintf(stderr, "Failed to enable dynamic resolution without GPU "
+                      "timestamps on one device\n");
+  }
+#if VULKAN_COROUTINES
+  tasks.init(jobs, resources, timeline);
+#endif
+  staticCommands.init(device, queues.family(QUEUE_GRAPHICS),
+                      framesInFlight * viewCount());
+  pacer.init(device, pacingSupport, framesInFlight, latencyFrames, justInTime);
+
+  // The benchmark reads the frame scope every frame, so the periodic report
+  // that resets it is off.
+  if (benchmark) {
+    benchmark->init(device, deviceProperties, memory, resources, shaders,
+                    pipelines, headless);
+    profiler.reportFrames = 0;
+  }
+}
+
+void VulkanExample::createOffscreenTargets(VkCommandBuffer cmdBuffer) {
+  offscreenTargets.resize(framesInFlight);
+
+  VkImageCreateInfo imageInfo = {};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.pNext = NULL;
+  imageInfo.flags = 0;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = OFFSCREEN_FORMAT;
+  imageInfo.extent.width = windowWidth;
+  imageInfo.extent.height = windowHeight;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.queueFamilyIndexCount = 0;
+  imageInfo.pQueueFamilyIndices = NULL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = windowWidth * windowHeight * 4;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = NULL;
+
+  VulkanTools::BarrierBatch barriers;
+  VkImageSubresourceRange range =
+      VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+
+  for (uint32_t i = 0; i < offscreenTargets.size(); i++) {
+    OffscreenTarget &target = offscreenTargets[i];
+    target.image = resources.createImage(
+        imageInfo, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, ALLOCATION_FREE_LIST,
+        MEMORY_SWAPCHAIN);
+    barriers.image(resources.image(target.image)->image,
+                   VK_IMAGE_LAYOUT_UNDEFINED,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, range);
+
+    if (readbackPath)
+      target.readback = resources.createBuffer(
+          bufferInfo,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+          VK_MEMORY_PROPERTY_HOST_CACHED_BIT, ALLOCATION_FREE_LIST,
+          MEMORY_STAGING);
+  }
+
+  barriers.record(cmdBuffer);
+}
+
+VkImage VulkanExample::targetImage(uint32_t view) {
+  if (headless)
+    return resources.image(offscreenTargets[currentFrame].image)->image;
+
+  const ExampleWindow &window = windows[view];
+  return window.swapchain.buffers[window.imageIndex].image;
+}
+
+VkImageView VulkanExample::targetView(uint32_t view) {
+  if (headless)
+    return resources.image(offscreenTargets[currentFrame].image)->view;
+
+  const ExampleWindow &window = windows[view];
+  return window.swapchain.buffers[window.imageIndex].view;
+}
+
+VkFormat VulkanExample::targetFormat(uint32_t view) {
+  return headless ? OFFSCREEN_FORMAT : windows[view].swapchain.colorFormat;
+}
+
+VkExtent2D VulkanExample::targetExtent(uint32_t view) {
+  if (!headless) return windows[view].swapchain.extent;
+
+  VkExtent2D extent = {windowWidth, windowHeight};
+  return extent;
+}
+
+// The extent the scene draws at, which only drops below the target's when
+// the target can be blitted to.
+VkExtent2D VulkanExample::renderExtent(uint32_t view) {
+  VkExtent2D extent = targetExtent(view);
+  if (!resolution.enabled()) return extent;
+  if (!headless && !(windows[view].swapchain.imageUsage &
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+    return extent;
+
+  return resolution.scaled(extent);
+}
+
+void VulkanExample::recordReadback(VkCommandBuffer cmdBuffer,
+                                   uint32_t imageIndex) {
+  const BufferResource *readback =
+      resources.buffer(offscreenTargets[imageIndex].readback);
+  if (!readback) return;
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = windowWidth;
+  region.imageExtent.height = windowHeight;
+  region.imageExtent.depth = 1;
+
+  vkd.CmdCopyImageToBuffer(cmdBuffer,
+                           resources.image(offscreenTargets[imageIndex].image)
+                               ->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readback->buffer, 1, &region);
+
+  VulkanTools::BarrierBatch barriers;
+  barriers
+      .buffer(readback->buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+              VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+              VK_ACCESS_HOST_READ_BIT)
+      .record(cmdBuffer);
+}
+
+void VulkanExample::writeReadback(uint32_t imageIndex) {
+  const BufferResource *readback =
+      resources.buffer(offscreenTargets[imageIndex].readback);
+  if (!readback) return;
+
+  // Non-coherent memory would need an invalidate here; the buffer is
+  // allocated from a coherent type.
+  bool ok = VulkanTools::writePPM(readbackPath, readback->allocation.mapped,
+                                  windowWidth, windowHeight, windowWidth * 4);
+  fprintf(stdout, "Readback:       %s (%s)\n", readbackPath,
+          ok ? "written" : "failed");
+}
+
+void VulkanExample::setReadbackPath(const char *path) { readbackPath = path; }
+
+void VulkanExample::setCaptureSink(const VulkanCapture::Sink &sink) {
+  captureSink = sink;
+}
+
+bool VulkanExample::captureRequested() const {
+  return capturePath != NULL || captureSink;
+}
+
+void VulkanExample::renderOffscreen(uint32_t frameCount) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  uint32_t rendered = 0;
+  for (uint32_t i = 0; i < frameCount; i++) {
+    if (benchmark && benchmark->finished()) break;
+    waitForLatency();
+    if (renderFrame()) rendered++;
+  }
+
+  vkd.DeviceWaitIdle(device);
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  fprintf(stdout, "Rendered:       %u frames in %.3f s (%.1f fps)\n", rendered,
+          seconds, seconds > 0.0 ? rendered / seconds : 0.0);
+  if (submitter.totalFrames() > 0)
+    fprintf(stdout, "Submissions:    %.2f per frame\n",
+            (double)submitter.totalSubmits() / submitter.totalFrames());
+  if (timeline.enabled())
+    fprintf(stdout, "Timeline Waits: %llu blocked on the CPU\n",
+            (unsigned long long)timeline.blockingWaits());
+  if (staticRecording)
+    fprintf(stdout, "Static Records: %llu, replayed %llu times\n",
+            (unsigned long long)staticCommands.recordCount(),
+            (unsigned long long)staticCommands.replayCount());
+
+  if (rendered > 0)
+    writeReadback((currentFrame + framesInFlight - 1) % framesInFlight);
+
+  resources.flush();
+}
+
+#if defined(_WIN32)
+LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam,
+                         LPARAM lParam) {
+  switch (message) {
+    case WM_DESTROY:
+      DestroyWindow(hWnd);
+      PostQuitMessage(0);
+      break;
+    case WM_PAINT:
+      ValidateRect(hWnd, NULL);
+      break;
+    case WM_SIZE: {
+      VulkanExample *example =
+          (VulkanExample *)GetWindowLongPtr(hWnd, GWLP_USERDATA);
+
+      if (example)
+        example->windowResized(LOWORD(lParam), HIWORD(lParam),
+                               example->findWindow(hWnd));
+
+      break;
+    }
+  }
+
+  return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+uint32_t VulkanExample::createWindow(HINSTANCE hInstance) {
+  uint32_t index = windows.size();
+  if (index == 0) {
+    WNDCLASSEX wcex;
+
+    wcex.cbSize = sizeof(WNDCLASSEX);
+    wcex.style = CS_HREDRAW | CS_VREDRAW;
+    wcex.lpfnWndProc = WndProc;
+    wcex.cbClsExtra = 0;
+    wcex.cbWndExtra = 0;
+    wcex.hInstance = hInstance;
+    wcex.hIcon = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_APPLICATION));
+    wcex.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wcex.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);
+    wcex.lpszMenuName = NULL;
+    wcex.lpszClassName = APPLICATION_NAME;
+    wcex.hIconSm = LoadIcon(wcex.hInstance, MAKEINTRESOURCE(IDI_APPLICATION));
+
+    if (!RegisterClassEx(&wcex))
+      VulkanTools::exitOnError("Failed to register window");
+
+    windowInstance = hInstance;
+  }
+
+  // Later windows cascade down and to the right of the first.
+  int screenWidth = GetSystemMetrics(SM_CXSCREEN);
+  int screenHeight = GetSystemMetrics(SM_CYSCREEN);
+  int windowX = screenWidth / 2 - WINDOW_WIDTH / 2 + index * WINDOW_CASCADE;
+  int windowY = screenHeight / 2 - WINDOW_HEIGHT / 2 + index * WINDOW_CASCADE;
+  HWND window = CreateWindow(
+      APPLICATION_NAME, APPLICATION_NAME,
+      WS_OVERLAPPEDWINDOW | WS_CLIPSIBLINGS | WS_CLIPCHILDREN, windowX,
+      windowY, WINDOW_WIDTH, WINDOW_HEIGHT, NULL, NULL, windowInstance, NULL);
+
+  if (!window) VulkanTools::exitOnError("Failed to create window");
+
+  windows.push_back(ExampleWindow());
+  windows.back().window = window;
+  windows.back().width = WINDOW_WIDTH;
+  windows.back().height = WINDOW_HEIGHT;
+  windows.back().dirty = true;
+  windows.back().acquired = false;
+  windows.back().imageIndex = 0;
+
+  SetWindowLongPtr(window, GWLP_USERDATA, (LONG_PTR)this);
+
+  ShowWindow(window, SW_SHOW);
+  SetForegroundWindow(window);
+  SetFocus(window);
+
+  return index;
+}
+
+uint32_t VulkanExample::findWindow(HWND hWnd) const {
+  for (uint32_t i = 0; i < windows.size(); i++)
+    if (windows[i].window == hWnd) return i;
+
+  return UINT32_MAX;
+}
+
+bool VulkanExample::pumpEvents() {
+  TRACE_ZONE("pumpEvents");
+  MSG message;
+  bool running = true;
+
+  while (PeekMessage(&message, NULL, 0, 0, PM_REMOVE)) {
+    if (message.message == WM_QUIT) running = false;
+
+    TranslateMessage(&message);
+    DispatchMessage(&message);
+  }
+
+  return running;
+}
+
+#elif defined(__linux__)
+uint32_t VulkanExample::createWindow() {
+  uint32_t index = windows.size();
+  if (index == 0) windowing.init(windowSystem);
+
+  windows.push_back(ExampleWindow());
+  windows.back().window = windowing.createWindow(WINDOW_WIDTH, WINDOW_HEIGHT);
+  windows.back().width = WINDOW_WIDTH;
+  windows.back().height = WINDOW_HEIGHT;
+  windows.back().dirty = true;
+  windows.back().acquired = false;
+  windows.back().imageIndex = 0;
+
+  return index;
+}
+
+bool VulkanExample::pumpEvents() {
+  TRACE_ZONE("pumpEvents");
+  return windowing.pumpEvents(
+      [this](uint32_t window, uint32_t width, uint32_t height) {
+        windowResized(width, height, window);
+      });
+}
+#endif
@@ -0,0 +1,278 @@
+#ifndef VULKAN_EXAMPLE_HPP
+#define VULKAN_EXAMPLE_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
+#include "VulkanArena.hpp"
+#include "VulkanBenchmark.hpp"
+#include "VulkanBindless.hpp"
+#include "VulkanCapture.hpp"
+#include "VulkanCommands.hpp"
+#include "VulkanCompute.hpp"
+#include "VulkanCulling.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanDepthBuffer.hpp"
+#include "VulkanDescriptors.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanDeviceGroup.hpp"
+#include "VulkanGeometry.hpp"
+#include "VulkanIndirect.hpp"
+#include "VulkanJobs.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanMipmaps.hpp"
+#include "VulkanPacing.hpp"
+#include "VulkanPipelineCache.hpp"
+#include "VulkanPipelineCompiler.hpp"
+#include "VulkanPipelines.hpp"
+#include "VulkanProfiler.hpp"
+#include "VulkanRenderGraph.hpp"
+#include "VulkanRenderQueue.hpp"
+#include "VulkanRenderPasses.hpp"
+#include "VulkanResolution.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanShaders.hpp"
+#include "VulkanStreaming.hpp"
+#include "VulkanSubmit.hpp"
+#include "VulkanSwapchain.hpp"
+#include "VulkanTasks.hpp"
+#include "VulkanTimeline.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanTrace.hpp"
+#include "VulkanUniforms.hpp"
+#include "VulkanUpload.hpp"
+#include "VulkanWindowSystem.hpp"
+
+// One window on screen with its own surface and swapchain. Every window
+// shares the device and is drawn and presented on the same frame.
+struct ExampleWindow {
+#if defined(_WIN32)
+  HWND window;
+#elif defined(__linux__)
+  NativeWindow window;
+#endif
+  VulkanSwapchain swapchain;
+  uint32_t width;
+  uint32_t height;
+  bool dirty;
+  bool acquired;
+  uint32_t imageIndex;
+};
+
+// Graph resource and pass names for one window, which the graph only
+// points at.
+struct ViewNames {
+  std::string target;
+  std::string depth;
+  std::string clear;
+  std::string draw;
+  std::string scene;
+  std::string upscale;
+};
+
+// The graph ids this frame's upscale pass reads and writes for one window,
+// which its callback looks up rather than capturing.
+struct ViewImages {
+  uint32_t scene;
+  uint32_t target;
+};
+
+struct FrameResources {
+  std::vector<VkSemaphore> imageAcquired;
+  // One render-complete per GPU of a split frame, and the semaphores that
+  // start the other GPUs once the first has seen the frame's waits.
+  std::vector<VkSemaphore> renderComplete;
+  std::vector<VkSemaphore> deviceStart;
+  VkFence fence;
+  uint64_t value;
+};
+
+struct OffscreenTarget {
+  ResourceHandle image;
+  ResourceHandle readback;
+};
+
+class VulkanExample {
+ private:
+  void createInstance();
+  void initDevices();
+  void createDevice();
+  void createCommandPool();
+  void createCommandBuffer();
+  void beginCommandBuffer();
+  void submitCommandBuffer();
+  void createFrameResources();
+  void destroyFrameResources();
+  void createOffscreenTargets(VkCommandBuffer cmdBuffer);
+  void initFrameLoop();
+  uint32_t viewCount() const;
+  bool viewReady(uint32_t view) const;
+  bool captureRequested() const;
+  VkImage targetImage(uint32_t view);
+  VkImageView targetView(uint32_t view);
+  VkFormat targetFormat(uint32_t view);
+  VkExtent2D targetExtent(uint32_t view);
+  VkExtent2D renderExtent(uint32_t view);
+  void recordReadback(VkCommandBuffer cmdBuffer, uint32_t imageIndex);
+  void buildGraph();
+  void writeReadback(uint32_t imageIndex);
+  void recordChunk(VkCommandBuffer cmdBuffer, uint32_t chunk, uint32_t view);
+  void recordStatic(VkCommandBuffer cmdBuffer, uint32_t view);
+  void recordDrawBuffer(VkCommandBuffer cmdBuffer);
+  std::vector<VkBool32> presentSupport() const;
+  bool recreateSwapchains();
+  uint32_t acquireImages(FrameResources &frame);
+  void presentImages(FrameResources &frame);
+  void waitForLatency();
+  void countAllocations(uint64_t allocations);
+  bool renderFrame();
+  bool pumpEvents();
+  void limitFrameRate();
+
+  VkInstance instance;
+  VkPhysicalDevice physicalDevice;
+  VkPhysicalDeviceProperties deviceProperties;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDevice device;
+  bool instanceProperties2;
+  bool deviceGroupCreation;
+  bool externalMemoryCapabilities;
+  DeviceGroupSupport deviceGroupSupport;
+  DeviceGroupMode deviceGroupMode;
+  VulkanDeviceGroup deviceGroup;
+  BindlessSupport bindlessSupport;
+  bool bindlessRequested;
+  IndirectSupport indirectSupport;
+  StreamingSupport streamingSupport;
+  MipSupport mipSupport;
+  CaptureSupport captureSupport;
+  TimelineSupport timelineSupport;
+  PacingSupport pacingSupport;
+  bool memoryBudget;
+  QueueRegistry queues;
+  VulkanMemory memory;
+  VulkanResources resources;
+  VulkanTimeline timeline;
+  VulkanFrameArena frameArena;
+  VulkanSubmitter submitter;
+  VulkanUpload upload;
+  VulkanPipelineCache pipelineCache;
+  VulkanPipelineCompiler pipelineCompiler;
+  VulkanPipelines pipelines;
+  VulkanProfiler profiler;
+  VulkanRenderPassCache renderPasses;
+  VulkanRenderGraph graph;
+  VulkanDepthBuffer depthBuffer;
+  VulkanDescriptorLayouts descriptorLayouts;
+  VulkanShaders shaders;
+  VulkanBindless bindless;
+  VulkanMipGenerator mipmaps;
+  VulkanGeometryPool geometry;
+  VulkanRenderQueue renderQueue;
+#if VULKAN_COROUTINES
+  VulkanTaskScheduler tasks;
+#endif
+  VulkanTextureStreamer streamer;
+  ResourceHandle streamedTexture;
+  std::deque<ExampleWindow> windows;
+  std::vector<ViewNames> viewNames;
+  std::vector<ViewImages> viewImages;
+  VkCommandPool cmdPool;
+  VkCommandBuffer initialCmdBuffer;
+
+  bool headless;
+  const char *readbackPath;
+  std::vector<OffscreenTarget> offscreenTargets;
+  VulkanCapture capture;
+  const char *capturePath;
+  VulkanCapture::Sink captureSink;
+  VulkanResolution resolution;
+  double resolutionTarget;
+
+  uint32_t framesInFlight;
+  uint32_t currentFrame;
+  std::vector<FrameResources> frames;
+  VulkanJobs jobs;
+  VulkanCommands commands;
+  VulkanStaticCommands staticCommands;
+  bool staticRecording;
+  VulkanUniformRing uniforms;
+  VulkanDescriptorAllocator descriptors;
+  VulkanIndirectDraws indirect;
+  VulkanAsyncCompute compute;
+  VulkanCulling culling;
+  uint32_t drawChunks;
+
+  SwapchainPolicy swapchainPolicy;
+  uint32_t windowWidth;
+  uint32_t windowHeight;
+
+  uint32_t frameRateLimit;
+  std::chrono::steady_clock::time_point nextFrameTime;
+  VulkanFramePacer pacer;
+  uint32_t latencyFrames;
+  bool justInTime;
+  VulkanBenchmark *benchmark;
+  bool pipelineCachePersistent;
+  StartupTimes startup;
+  uint64_t startupStart;
+  uint64_t startupReady;
+  uint32_t settledFrames;
+  uint32_t steadyFrames;
+  uint64_t steadyAllocations;
+  uint64_t lastAllocations;
+#if defined(_WIN32)
+  HINSTANCE windowInstance;
+#elif defined(__linux__)
+  WindowSystem windowSystem;
+  VulkanWindowSystem windowing;
+#endif
+ public:
+  VulkanExample(uint32_t framesInFlight = FRAMES_IN_FLIGHT,
+                bool headless = false);
+  virtual ~VulkanExample();
+
+#if defined(_WIN32)
+  uint32_t createWindow(HINSTANCE hInstance);
+  uint32_t findWindow(HWND hWnd) const;
+#elif defined(__linux__)
+  uint32_t createWindow();
+#endif
+  void initSwapchain();
+  void initOffscreen();
+  void setReadbackPath(const char *path);
+  void setCaptureSink(const VulkanCapture::Sink &sink);
+  void setBindless(bool enable);
+  void setDeviceGroup(DeviceGroupMode mode);
+  void setStaticRecording(bool enable);
+  void invalidateStatic();
+  void setFrameRateLimit(uint32_t framesPerSecond);
+  void setLatency(uint32_t frames, bool justInTime = false);
+  void setSwapchainPolicy(const SwapchainPolicy &policy);
+  void setBenchmark(VulkanBenchmark *benchmark);
+  void setPipelineCache(bool persistent);
+  const StartupTimes &startupTimes() const { return startup; }
+  uint64_t frameAllocations() const { return lastAllocations; }
+  VulkanTextureStreamer &textures() { return streamer; }
+  VulkanGeometryPool &meshes() { return geometry; }
+  VulkanRenderQueue &drawQueue() { return renderQueue; }
+#if VULKAN_COROUTINES
+  VulkanTaskScheduler &taskScheduler() { return tasks; }
+#endif
+  void windowResized(uint32_t width, uint32_t height, uint32_t window = 0);
+  void renderLoop();
+  void renderOffscreen(uint32_t frameCount = HEADLESS_FRAME_COUNT);
+};
+
+#endif  // VULKAN_EXAMPLE_HPP
@@ -0,0 +1,395 @@
+#include "VulkanGeometry.hpp"
+
+VulkanGeometryPool::VulkanGeometryPool()
+    : device(VK_NULL_HANDLE),
+      resources(NULL),
+      upload(NULL),
+      format(),
+      vertexCapacity(0),
+      indexCapacity(0),
+      streamCount(0),
+      usedVertices(0),
+      usedIndices(0),
+      compactions(0),
+      binds(0),
+      draws(0) {
+  memset(streamStrides, 0, sizeof(streamStrides));
+}
+
+void VulkanGeometryPool::init(VkDevice device, VulkanResources &resources,
+                              VulkanUpload &upload,
+                              const GeometryFormat &format,
+                              uint32_t vertexCapacity,
+                              uint32_t indexCapacity) {
+  assert(format.vertexSize >= GEOMETRY_POSITION_SIZE);
+
+  this->device = device;
+  this->resources = &resources;
+  this->upload = &upload;
+  this->format = format;
+  this->vertexCapacity = vertexCapacity;
+  this->indexCapacity = indexCapacity;
+
+  streamCount = 1;
+  streamStrides[0] = format.vertexSize;
+  if (format.layout == GEOMETRY_SPLIT &&
+      format.vertexSize > GEOMETRY_POSITION_SIZE) {
+    streamCount = 2;
+    streamStrides[0] = GEOMETRY_POSITION_SIZE;
+    streamStrides[1] = format.vertexSize - GEOMETRY_POSITION_SIZE;
+  }
+
+  freeVertices[0] = vertexCapacity;
+  freeIndices[0] = indexCapacity;
+}
+
+void VulkanGeometryPool::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  printStats();
+
+  for (uint32_t i = 0; i < GEOMETRY_STREAM_COUNT; i++) {
+    resources->destroyBuffer(streams[i]);
+    streams[i] = ResourceHandle();
+  }
+  resources->destroyBuffer(indexBuffer);
+  indexBuffer = ResourceHandle();
+
+  meshes.clear();
+  freeVertices.clear();
+  freeIndices.clear();
+  usedVertices = 0;
+  usedIndices = 0;
+  device = VK_NULL_HANDLE;
+}
+
+uint32_t VulkanGeometryPool::indexSize() const {
+  return format.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+}
+
+ResourceHandle VulkanGeometryPool::createBuffer(VkDeviceSize size,
+                                                VkBufferUsageFlags usage) {
+  uint32_t families[2];
+  uint32_t familyCount = upload->sharedFamilies(families);
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = familyCount > 1 ? VK_SHARING_MODE_CONCURRENT
+                                           : VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = familyCount > 1 ? familyCount : 0;
+  bufferInfo.pQueueFamilyIndices = familyCount > 1 ? families : NULL;
+
+  return resources->createBuffer(bufferInfo,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                 ALLOCATION_FREE_LIST, MEMORY_GEOMETRY);
+}
+
+void VulkanGeometryPool::createBuffers(ResourceHandle *streams,
+                                       ResourceHandle &indices) {
+  for (uint32_t i = 0; i < streamCount; i++)
+    streams[i] = createBuffer((VkDeviceSize)vertexCapacity * streamStrides[i],
+                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  indices = createBuffer((VkDeviceSize)indexCapacity * indexSize(),
+                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+bool VulkanGeometryPool::allocateRange(FreeRanges &ranges, uint32_t count,
+                                       uint32_t *first) {
+  FreeRanges::iterator best = ranges.end();
+  for (FreeRanges::iterator it = ranges.begin(); it != ranges.end(); ++it)
+    if (it->second >= count &&
+        (best == ranges.end() || it->second < best->second))
+      best = it;
+  if (best == ranges.end()) return false;
+
+  *first = best->first;
+  uint32_t remaining = best->second - count;
+  ranges.erase(best);
+  if (remaining > 0) ranges[*first + count] = remaining;
+  return true;
+}
+
+void VulkanGeometryPool::freeRange(FreeRanges &ranges, uint32_t first,
+                                   uint32_t count) {
+  FreeRanges::iterator next = ranges.find(first + count);
+  if (next != ranges.end()) {
+    count += next->second;
+    ranges.erase(next);
+  }
+
+  FreeRanges::iterator prev = ranges.lower_bound(first);
+  if (prev != ranges.begin()) {
+    --prev;
+    if (prev->first + prev->second == first) {
+      prev->second += count;
+      return;
+    }
+  }
+
+  ranges[first] = count;
+}
+
+uint32_t VulkanGeometryPool::largestRange(const FreeRanges &ranges) {
+  uint32_t largest = 0;
+  for (FreeRanges::const_iterator it = ranges.begin(); it != ranges.end();
+       ++it)
+    largest = std::max(largest, it->second);
+  return largest;
+}
+
+ResourceHandle VulkanGeometryPool::add(const void *vertices,
+                                       uint32_t vertexCount,
+                                       const void *indices,
+                                       uint32_t indexCount) {
+  assert(device != VK_NULL_HANDLE && vertexCount > 0 && indexCount > 0);
+
+  if (vertexCount > vertexCapacity - usedVertices ||
+      indexCount > indexCapacity - usedIndices) {
+    fprintf(stderr, "Failed to add mesh of %u vertices, geometry pool full\n",
+            vertexCount);
+    return ResourceHandle();
+  }
+
+  if (!streams[0].valid()) createBuffers(streams, indexBuffer);
+
+  // Ranges still retiring don't count toward the room compaction makes, so
+  // it always leaves enough for a mesh that passed the check above.
+  if (largestRange(freeVertices) < vertexCount ||
+      largestRange(freeIndices) < indexCount)
+    compact();
+
+  GeometryMesh mesh = {};
+  mesh.vertexCount = vertexCount;
+  mesh.indexCount = indexCount;
+  bool allocated = allocateRange(freeVertices, vertexCount, &mesh.firstVertex);
+  allocated = allocated &&
+              allocateRange(freeIndices, indexCount, &mesh.firstIndex);
+  assert(allocated);
+  usedVertices += vertexCount;
+  usedIndices += indexCount;
+
+  const uint8_t *source = (const uint8_t *)vertices;
+  VkDeviceSize vertexBytes = (VkDeviceSize)vertexCount * format.vertexSize;
+  if (streamCount == 1) {
+    upload->uploadShared(resources->buffer(streams[0])->buffer,
+                         (VkDeviceSize)mesh.firstVertex * streamStrides[0],
+                         source, vertexBytes);
+  } else {
+    // Each stream is gathered into one run so it goes up in one copy.
+    scratch.resize(vertexBytes);
+    uint8_t *positions = scratch.data();
+    uint8_t *attributes = positions + vertexCount * streamStrides[0];
+    for (uint32_t i = 0; i < vertexCount; i++) {
+      const uint8_t *vertex = source + i * format.vertexSize;
+      memcpy(positions + i * streamStrides[0], vertex, streamStrides[0]);
+      memcpy(attributes + i * streamStrides[1], vertex + streamStrides[0],
+             streamStrides[1]);
+    }
+
+    uint8_t *runs[GEOMETRY_STREAM_COUNT] = {positions, attributes};
+    for (uint32_t i = 0; i < streamCount; i++)
+      upload->uploadShared(resources->buffer(streams[i])->buffer,
+                           (VkDeviceSize)mesh.firstVertex * streamStrides[i],
+                           runs[i],
+                           (VkDeviceSize)vertexCount * streamStrides[i]);
+  }
+
+  upload->uploadShared(resources->buffer(indexBuffer)->buffer,
+                       (VkDeviceSize)mesh.firstIndex * indexSize(), indices,
+                       (VkDeviceSize)indexCount * indexSize());
+
+  return meshes.insert(mesh);
+}
+
+void VulkanGeometryPool::remove(ResourceHandle handle) {
+  GeometryMesh mesh;
+  if (!meshes.remove(handle, &mesh)) return;
+
+  usedVertices -= mesh.vertexCount;
+  usedIndices -= mesh.indexCount;
+
+  // Frames in flight may still draw the mesh. A compaction in the meantime
+  // has already left its ranges behind in the old buffers.
+  uint32_t generation = compactions;
+  resources->retireCallback([this, mesh, generation]() {
+    if (device == VK_NULL_HANDLE || generation != compactions) return;
+    freeRange(freeVertices, mesh.firstVertex, mesh.vertexCount);
+    freeRange(freeIndices, mesh.firstIndex, mesh.indexCount);
+  });
+}
+
+void VulkanGeometryPool::compact() {
+  if (!streams[0].valid()) return;
+
+  ResourceHandle packedStreams[GEOMETRY_STREAM_COUNT];
+  ResourceHandle packedIndices;
+  createBuffers(packedStreams, packedIndices);
+
+  // Copies are gathered in vertices and indices, and runs that were
+  // already adjacent stay one copy.
+  std::vector<VkBufferCopy> vertexCopies;
+  std::vector<VkBufferCopy> indexCopies;
+  uint32_t vertexCursor = 0;
+  uint32_t indexCursor = 0;
+  GeometryMesh *items = meshes.data();
+  for (uint32_t i = 0; i < meshes.size(); i++) {
+    GeometryMesh &mesh = items[i];
+
+    if (!vertexCopies.empty() &&
+        vertexCopies.back().srcOffset + vertexCopies.back().size ==
+            mesh.firstVertex)
+      vertexCopies.back().size += mesh.vertexCount;
+    else
+      vertexCopies.push_back({mesh.firstVertex, vertexCursor,
+                              mesh.vertexCount});
+
+    if (!indexCopies.empty() &&
+        indexCopies.back().srcOffset + indexCopies.back().size ==
+            mesh.firstIndex)
+      indexCopies.back().size += mesh.indexCount;
+    else
+      indexCopies.push_back({mesh.firstIndex, indexCursor, mesh.indexCount});
+
+    mesh.firstVertex = vertexCursor;
+    mesh.firstIndex = indexCursor;
+    vertexCursor += mesh.vertexCount;
+    indexCursor += mesh.indexCount;
+  }
+
+  std::vector<VkBufferCopy> regions;
+  for (uint32_t i = 0; i < streamCount; i++) {
+    regions = vertexCopies;
+    for (uint32_t j = 0; j < regions.size(); j++) {
+      regions[j].srcOffset *= streamStrides[i];
+      regions[j].dstOffset *= streamStrides[i];
+      regions[j].size *= streamStrides[i];
+    }
+    upload->copyShared(resources->buffer(streams[i])->buffer,
+                       resources->buffer(packedStreams[i])->buffer,
+                       regions.data(), regions.size());
+    resources->destroyBuffer(streams[i]);
+    streams[i] = packedStreams[i];
+  }
+
+  regions = indexCopies;
+  for (uint32_t j = 0; j < regions.size(); j++) {
+    regions[j].srcOffset *= indexSize();
+    regions[j].dstOffset *= indexSize();
+    regions[j].size *= indexSize();
+  }
+  upload->copyShared(resources->buffer(indexBuffer)->buffer,
+                     resources->buffer(packedIndices)->buffer,
+                     regions.data(), regions.size());
+  resources->destroyBuffer(indexBuffer);
+  indexBuffer = packedIndices;
+
+  freeVertices.clear();
+  freeIndices.clear();
+  if (vertexCursor < vertexCapacity)
+    freeVertices[vertexCursor] = vertexCapacity - vertexCursor;
+  if (indexCursor < indexCapacity)
+    freeIndices[indexCursor] = indexCapacity - indexCursor;
+  compactions++;
+}
+
+const GeometryMesh *VulkanGeometryPool::mesh(ResourceHandle handle) const {
+  return meshes.get(handle);
+}
+
+VkDrawIndexedIndirectCommand VulkanGeometryPool::command(
+    ResourceHandle handle, uint32_t instanceCount,
+    uint32_t firstInstance) const {
+  VkDrawIndexedIndirectCommand command = {};
+  const GeometryMesh *mesh = meshes.get(handle);
+  if (!mesh) return command;
+
+  command.indexCount = mesh->indexCount;
+  command.instanceCount = instanceCount;
+  command.firstIndex = mesh->firstIndex;
+  command.vertexOffset = (int32_t)mesh->firstVertex;
+  command.firstInstance = firstInstance;
+  return command;
+}
+
+void VulkanGeometryPool::bind(VkCommandBuffer cmdBuffer, GeometryPass pass) {
+  if (!streams[0].valid()) return;
+
+  VkBuffer buffers[GEOMETRY_STREAM_COUNT];
+  VkDeviceSize offsets[GEOMETRY_STREAM_COUNT] = {0, 0};
+  uint32_t count = pass == GEOMETRY_PASS_DEPTH ? 1 : streamCount;
+  for (uint32_t i = 0; i < count; i++)
+    buffers[i] = resources->buffer(streams[i])->buffer;
+
+  vkd.CmdBindVertexBuffers(cmdBuffer, 0, count, buffers, offsets);
+  vkd.CmdBindIndexBuffer(cmdBuffer, resources->buffer(indexBuffer)->buffer, 0,
+                         format.indexType);
+  binds++;
+}
+
+void VulkanGeometryPool::draw(VkCommandBuffer cmdBuffer, ResourceHandle handle,
+                              uint32_t instanceCount,
+                              uint32_t firstInstance) {
+  const GeometryMesh *mesh = meshes.get(handle);
+  if (!mesh) return;
+
+  vkd.CmdDrawIndexed(cmdBuffer, mesh->indexCount, instanceCount,
+                     mesh->firstIndex, (int32_t)mesh->firstVertex,
+                     firstInstance);
+  draws++;
+}
+
+uint32_t VulkanGeometryPool::bindings(
+    GeometryPass pass, VkVertexInputBindingDescription *descriptions) const {
+  uint32_t count = pass == GEOMETRY_PASS_DEPTH ? 1 : streamCount;
+  for (uint32_t i = 0; i < count; i++) {
+    descriptions[i].binding = i;
+    descriptions[i].stride = streamStrides[i];
+    descriptions[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  }
+  return count;
+}
+
+VkVertexInputAttributeDescription VulkanGeometryPool::attribute(
+    uint32_t location, VkFormat format, uint32_t offset) const {
+  VkVertexInputAttributeDescription description = {};
+  description.location = location;
+  description.format = format;
+  description.binding = 0;
+  description.offset = offset;
+  if (streamCount > 1 && offset >= streamStrides[0]) {
+    description.binding = 1;
+    description.offset = offset - streamStrides[0];
+  }
+  return description;
+}
+
+GeometryStats VulkanGeometryPool::stats() const {
+  GeometryStats stats = {};
+  stats.meshes = meshes.size();
+  stats.usedVertices = usedVertices;
+  stats.usedIndices = usedIndices;
+  stats.compactions = compactions;
+  stats.binds = binds;
+  stats.draws = draws;
+  return stats;
+}
+
+void VulkanGeometryPool::printStats() const {
+  if (!streams[0].valid()) return;
+
+  GeometryStats current = stats();
+  fprintf(stdout,
+          "Geometry:       %u meshes, %u of %u vertices, %u of %u indices, "
+          "%s\n",
+          current.meshes, current.usedVertices, vertexCapacity,
+          current.usedIndices, indexCapacity,
+          streamCount > 1 ? "split positions" : "interleaved");
+  fprintf(stdout, "Geometry Draws: %llu binds for %llu draws, %u compactions\n",
+          (unsigned long long)current.binds,
+          (unsigned long long)current.draws, current.compactions);
+}
@@ -0,0 +1,140 @@
+#ifndef VULKAN_GEOMETRY_HPP
+#define VULKAN_GEOMETRY_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "VulkanMemory.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanUpload.hpp"
+
+#define GEOMETRY_INTERLEAVED_ENV "VULKAN_EXAMPLE_GEOMETRY_INTERLEAVED"
+#define GEOMETRY_VERTEX_SIZE 32
+#define GEOMETRY_VERTEX_CAPACITY (1024 * 1024)
+#define GEOMETRY_INDEX_CAPACITY (4 * 1024 * 1024)
+#define GEOMETRY_POSITION_SIZE (3 * sizeof(float))
+#define GEOMETRY_STREAM_COUNT 2
+
+// Interleaved keeps each vertex whole in one stream. Split moves positions
+// into a stream of their own, so depth-only and shadow passes fetch 12
+// bytes a vertex and nothing else.
+enum GeometryLayout { GEOMETRY_INTERLEAVED = 0, GEOMETRY_SPLIT };
+
+enum GeometryPass { GEOMETRY_PASS_SHADED = 0, GEOMETRY_PASS_DEPTH };
+
+// Vertices are handed over whole, vertexSize bytes each with a float3
+// position first, whatever layout the pool keeps them in.
+struct GeometryFormat {
+  uint32_t vertexSize;
+  GeometryLayout layout;
+  VkIndexType indexType;
+};
+
+struct GeometryMesh {
+  uint32_t firstVertex;
+  uint32_t vertexCount;
+  uint32_t firstIndex;
+  uint32_t indexCount;
+};
+
+struct GeometryStats {
+  uint32_t meshes;
+  uint32_t usedVertices;
+  uint32_t usedIndices;
+  uint32_t compactions;
+  uint64_t binds;
+  uint64_t draws;
+};
+
+// Sub-allocates the meshes of one vertex format out of a few large
+// buffers: one or two vertex streams and an index buffer, created with the
+// first mesh. A mesh is a range of vertices and a range of indices, drawn
+// with its first vertex as the vertex offset, so every mesh draws from the
+// same bindings. Ranges are counted in vertices and indices, best-fit from
+// a free list, and go back to it once the frames that drew them have
+// retired. The buffers are shared concurrently with the transfer queue,
+// which writes new meshes and runs compact(): live ranges are copied packed
+// into fresh buffers, and the old ones retire behind the frames still
+// reading them. A mesh that finds no free range compacts the pool first
+// when that would make room. Meshes are added, removed and compacted
+// before the frame's upload is submitted, since the frame that follows
+// binds what they leave behind.
+class VulkanGeometryPool {
+ public:
+  VulkanGeometryPool();
+
+  void init(VkDevice device, VulkanResources &resources,
+            VulkanUpload &upload, const GeometryFormat &format,
+            uint32_t vertexCapacity = GEOMETRY_VERTEX_CAPACITY,
+            uint32_t indexCapacity = GEOMETRY_INDEX_CAPACITY);
+  void destroy();
+
+  ResourceHandle add(const void *vertices, uint32_t vertexCount,
+                     const void *indices, uint32_t indexCount);
+  void remove(ResourceHandle mesh);
+  void compact();
+
+  const GeometryMesh *mesh(ResourceHandle mesh) const;
+  VkDrawIndexedIndirectCommand command(ResourceHandle mesh,
+                                       uint32_t instanceCount = 1,
+                                       uint32_t firstInstance = 0) const;
+  void bind(VkCommandBuffer cmdBuffer, GeometryPass pass);
+  void draw(VkCommandBuffer cmdBuffer, ResourceHandle mesh,
+            uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+  // Vertex input for pipelines drawing from the pool: the bindings a pass
+  // reads, and an attribute at an offset into the whole vertex, placed in
+  // whichever stream holds it. Positions are location 0 in every pass.
+  uint32_t bindings(GeometryPass pass,
+                    VkVertexInputBindingDescription *descriptions) const;
+  VkVertexInputAttributeDescription attribute(uint32_t location,
+                                              VkFormat format,
+                                              uint32_t offset) const;
+
+  // Bumped by every compaction, for callers that keep recorded draws.
+  uint32_t generation() const { return compactions; }
+  GeometryStats stats() const;
+  void printStats() const;
+
+ private:
+  typedef std::map<uint32_t, uint32_t> FreeRanges;
+
+  VkDevice device;
+  VulkanResources *resources;
+  VulkanUpload *upload;
+  GeometryFormat format;
+  uint32_t vertexCapacity;
+  uint32_t indexCapacity;
+  uint32_t streamCount;
+  uint32_t streamStrides[GEOMETRY_STREAM_COUNT];
+  ResourceHandle streams[GEOMETRY_STREAM_COUNT];
+  ResourceHandle indexBuffer;
+
+  HandleTable<GeometryMesh> meshes;
+  FreeRanges freeVertices;
+  FreeRanges freeIndices;
+  uint32_t usedVertices;
+  uint32_t usedIndices;
+  uint32_t compactions;
+  std::atomic<uint64_t> binds;
+  std::atomic<uint64_t> draws;
+  std::vector<uint8_t> scratch;
+
+  uint32_t indexSize() const;
+  ResourceHandle createBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+  void createBuffers(ResourceHandle *streams, ResourceHandle &indices);
+  static bool allocateRange(FreeRanges &ranges, uint32_t count,
+                            uint32_t *first);
+  static void freeRange(FreeRanges &ranges, uint32_t first, uint32_t count);
+  static uint32_t largestRange(const FreeRanges &ranges);
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "VulkanIndirect.hpp"
+
+VulkanIndirectDraws::VulkanIndirectDraws()
+    : device(VK_NULL_HANDLE),
+      resources(NULL),
+      support(),
+      maxDraws(0),
+      mappedCommands(NULL),
+      mappedCounts(NULL),
+      version(1),
+      frame(0) {}
+
+IndirectSupport VulkanIndirectDraws::query(
+    VkPhysicalDevice physicalDevice, const VkPhysicalDeviceLimits &limits) {
+  IndirectSupport support = {};
+
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+  support.multiDraw = features.multiDrawIndirect == VK_TRUE;
+  support.firstInstance = features.drawIndirectFirstInstance == VK_TRUE;
+  support.maxDrawCount = support.multiDraw ? limits.maxDrawIndirectCount : 1;
+
+  std::vector<const char *> extensions;
+  extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  support.drawCount = support.multiDraw &&
+                      VulkanDevice::supportsExtensions(physicalDevice,
+                                                       extensions);
+
+  return support;
+}
+
+void VulkanIndirectDraws::deviceExtensions(
+    const IndirectSupport &support, std::vector<const char *> &extensions) {
+  if (support.drawCount)
+    extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+}
+
+void VulkanIndirectDraws::deviceFeatures(const IndirectSupport &support,
+                                         VkPhysicalDeviceFeatures &features) {
+  if (support.multiDraw) features.multiDrawIndirect = VK_TRUE;
+  if (support.firstInstance) features.drawIndirectFirstInstance = VK_TRUE;
+}
+
+void VulkanIndirectDraws::record(VkCommandBuffer cmdBuffer,
+                                 const IndirectSupport &support,
+                                 VkBuffer commands, VkDeviceSize commandOffset,
+                                 VkBuffer count, VkDeviceSize countOffset,
+                                 uint32_t maxDraws) {
+  if (maxDraws == 0) return;
+
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  if (support.drawCount && vkd.CmdDrawIndexedIndirectCountKHR) {
+    vkd.CmdDrawIndexedIndirectCountKHR(cmdBuffer, commands, commandOffset,
+                                       count, countOffset, maxDraws, stride);
+    return;
+  }
+
+  // Without a GPU-side count every slot up to maxDraws is drawn, so writers
+  // that skip an object leave its instanceCount at zero instead.
+  uint32_t batch = support.maxDrawCount ? support.maxDrawCount : 1;
+  for (uint32_t first = 0; first < maxDraws; first += batch) {
+    uint32_t drawCount = maxDraws - first < batch ? maxDraws - first : batch;
+    vkd.CmdDrawIndexedIndirect(cmdBuffer, commands,
+                               commandOffset + (VkDeviceSize)first * stride,
+                               drawCount, stride);
+  }
+}
+
+void VulkanIndirectDraws::init(VkDevice device, VulkanResources &resources,
+                               const IndirectSupport &support,
+                               uint32_t framesInFlight, uint32_t capacity,
+                               VkBufferUsageFlags extraUsage) {
+  this->device = device;
+  this->resources = &resources;
+  this->support = support;
+  maxDraws = capacity;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = (VkDeviceSize)framesInFlight * maxDraws *
+                    sizeof(VkDrawIndexedIndirectCommand);
+  bufferInfo.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | extraUsage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = NULL;
+
+  commands = resources.createBuffer(bufferInfo,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  mappedCommands = (VkDrawIndexedIndirectCommand *)resources.buffer(commands)
+                       ->allocation.mapped;
+  assert(mappedCommands != NULL);
+
+  bufferInfo.size = framesInFlight * sizeof(uint32_t);
+  counts = resources.createBuffer(bufferInfo,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  mappedCounts = (uint32_t *)resources.buffer(counts)->allocation.mapped;
+  assert(mappedCounts != NULL);
+
+  regionVersions.assign(framesInFlight, 0);
+  draws.reserve(maxDraws);
+  frame = 0;
+}
+
+void VulkanIndirectDraws::destroy() {
+  if (resources) {
+    resources->destroyBuffer(commands);
+    resources->destroyBuffer(counts);
+  }
+
+  commands = ResourceHandle();
+  counts = ResourceHandle();
+  mappedCommands = NULL;
+  mappedCounts = NULL;
+  draws.clear();
+  regionVersions.clear();
+}
+
+uint32_t VulkanIndirectDraws::add(const VkDrawIndexedIndirectCommand &draw) {
+  if (draws.size() >= maxDraws)
+    VulkanTools::exitOnError("Indirect draw buffer is full");
+
+  draws.push_back(draw);
+  version++;
+  return draws.size() - 1;
+}
+
+void VulkanIndirectDraws::set(uint32_t index,
+                              const VkDrawIndexedIndirectCommand &draw) {
+  assert(index < draws.size());
+  if (memcmp(&draws[index], &draw, sizeof(draw)) == 0) return;
+
+  draws[index] = draw;
+  version++;
+}
+
+void VulkanIndirectDraws::clear() {
+  if (draws.empty()) return;
+
+  draws.clear();
+  version++;
+}
+
+void VulkanIndirectDraws::beginFrame(uint32_t frame) {
+  this->frame = frame;
+  if (regionVersions[frame] == version) return;
+
+  memcpy(mappedCommands + (size_t)frame * maxDraws, draws.data(),
+         draws.size() * sizeof(VkDrawIndexedIndirectCommand));
+  mappedCounts[frame] = draws.size();
+  regionVersions[frame] = version;
+}
+
+void VulkanIndirectDraws::draw(VkCommandBuffer cmdBuffer) const {
+  record(cmdBuffer, support, commandBuffer(), commandOffset(), countBuffer(),
+         countOffset(), draws.size());
+}
+
+VkBuffer VulkanIndirectDraws::commandBuffer() const {
+  return resources->buffer(commands)->buffer;
+}
+
+VkBuffer VulkanIndirectDraws::countBuffer() const {
+  return resources->buffer(counts)->buffer;
+}
+
+VkDeviceSize VulkanIndirectDraws::commandOffset() const {
+  return (VkDeviceSize)frame * maxDraws * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+VkDeviceSize VulkanIndirectDraws::countOffset() const {
+  return frame * sizeof(uint32_t);
+}
@@ -0,0 +1,78 @@
+#ifndef VULKAN_INDIRECT_HPP
+#define VULKAN_INDIRECT_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define INDIRECT_MAX_DRAWS 65536
+
+struct IndirectSupport {
+  bool multiDraw;
+  bool firstInstance;
+  bool drawCount;
+  uint32_t maxDrawCount;
+};
+
+// Draws live in a persistently mapped buffer of VkDrawIndexedIndirectCommand
+// with one region per frame in flight, plus a draw count per region. The
+// command buffer then carries a single indirect call however many objects
+// there are. Regions are only rewritten when the draw list has changed since
+// that region was last filled, so a static scene costs no CPU work per frame.
+class VulkanIndirectDraws {
+ public:
+  VulkanIndirectDraws();
+
+  static IndirectSupport query(VkPhysicalDevice physicalDevice,
+                               const VkPhysicalDeviceLimits &limits);
+  static void deviceExtensions(const IndirectSupport &support,
+                               std::vector<const char *> &extensions);
+  static void deviceFeatures(const IndirectSupport &support,
+                             VkPhysicalDeviceFeatures &features);
+  static void record(VkCommandBuffer cmdBuffer, const IndirectSupport &support,
+                     VkBuffer commands, VkDeviceSize commandOffset,
+                     VkBuffer count, VkDeviceSize countOffset,
+                     uint32_t maxDraws);
+
+  void init(VkDevice device, VulkanResources &resources,
+            const IndirectSupport &support, uint32_t framesInFlight,
+            uint32_t capacity = INDIRECT_MAX_DRAWS,
+            VkBufferUsageFlags extraUsage = 0);
+  void destroy();
+
+  uint32_t add(const VkDrawIndexedIndirectCommand &draw);
+  void set(uint32_t index, const VkDrawIndexedIndirectCommand &draw);
+  void clear();
+
+  void beginFrame(uint32_t frame);
+  void draw(VkCommandBuffer cmdBuffer) const;
+
+  uint32_t drawCount() const { return draws.size(); }
+  uint32_t capacity() const { return maxDraws; }
+
+  VkBuffer commandBuffer() const;
+  VkBuffer countBuffer() const;
+  VkDeviceSize commandOffset() const;
+  VkDeviceSize countOffset() const;
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  IndirectSupport support;
+  uint32_t maxDraws;
+  ResourceHandle commands;
+  ResourceHandle counts;
+  VkDrawIndexedIndirectCommand *mappedCommands;
+  uint32_t *mappedCounts;
+  std::vector<VkDrawIndexedIndirectCommand> draws;
+  std::vector<uint64_t> regionVersions;
+  uint64_t version;
+  uint32_t frame;
+};
+
+#endif
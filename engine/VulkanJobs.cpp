@@ -0,0 +1,144 @@
+#include "VulkanJobs.hpp"
+
+VulkanJobs::VulkanJobs()
+    : backgroundQueued(0),
+      queued(0),
+      pending(0),
+      running(false),
+      nextQueue(0) {}
+
+VulkanJobs::~VulkanJobs() { destroy(); }
+
+void VulkanJobs::init(uint32_t workerCount) {
+  if (workerCount == 0) {
+    uint32_t cores = std::thread::hardware_concurrency();
+    workerCount = cores > 1 ? cores - 1 : 1;
+  }
+
+  queues.clear();
+  for (uint32_t i = 0; i < workerCount + 1; i++)
+    queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+
+  running = true;
+  for (uint32_t i = 0; i < workerCount; i++)
+    workers.push_back(std::thread(&VulkanJobs::workerLoop, this, i));
+}
+
+void VulkanJobs::destroy() {
+  if (!running) return;
+
+  // Background jobs still queued run here, so nothing waiting on one is
+  // left hanging.
+  wait();
+  while (runBackground(callerThread())) continue;
+
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    running = false;
+  }
+  wake.notify_all();
+
+  for (uint32_t i = 0; i < workers.size(); i++) workers[i].join();
+  workers.clear();
+  queues.clear();
+}
+
+void VulkanJobs::submit(const Job &job) {
+  // Jobs submit from workers too, so each caller takes its own ticket.
+  JobQueue &queue = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) %
+                            queues.size()];
+
+  pending++;
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(job);
+  }
+
+  queued++;
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+  }
+  wake.notify_one();
+}
+
+void VulkanJobs::submitBackground(const Job &job) {
+  {
+    std::lock_guard<std::mutex> lock(backgroundMutex);
+    background.push_back(job);
+  }
+
+  backgroundQueued++;
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+  }
+  wake.notify_one();
+}
+
+void VulkanJobs::rewind(JobQueue &queue) {
+  if (!queue.empty()) return;
+
+  queue.jobs.clear();
+  queue.head = 0;
+}
+
+bool VulkanJobs::runOne(uint32_t thread) {
+  Job job;
+
+  {
+    JobQueue &own = *queues[thread];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.empty()) {
+      job.swap(own.jobs.back());
+      own.jobs.pop_back();
+      rewind(own);
+    }
+  }
+
+  for (uint32_t i = 1; !job && i < queues.size(); i++) {
+    JobQueue &victim = *queues[(thread + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.empty()) {
+      job.swap(victim.jobs[victim.head++]);
+      rewind(victim);
+    }
+  }
+
+  if (!job) return false;
+
+  queued--;
+  job(thread);
+  pending--;
+  return true;
+}
+
+bool VulkanJobs::runBackground(uint32_t thread) {
+  Job job;
+
+  {
+    std::lock_guard<std::mutex> lock(backgroundMutex);
+    if (background.empty()) return false;
+    job.swap(background.front());
+    background.pop_front();
+  }
+
+  backgroundQueued--;
+  job(thread);
+  return true;
+}
+
+void VulkanJobs::workerLoop(uint32_t thread) {
+  while (running) {
+    if (runOne(thread) || runBackground(thread)) continue;
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wake.wait(lock, [this] {
+      return !running || queued > 0 || backgroundQueued > 0;
+    });
+  }
+}
+
+void VulkanJobs::wait() {
+  while (pending > 0) {
+    if (!runOne(callerThread())) std::this_thread::yield();
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef VULKAN_JOBS_HPP
+#define VULKAN_JOBS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_WORKER_COUNT 0
+
+class VulkanJobs {
+ public:
+  typedef std::function<void(uint32_t thread)> Job;
+
+  VulkanJobs();
+  ~VulkanJobs();
+  void init(uint32_t workerCount = JOB_WORKER_COUNT);
+  void destroy();
+
+  void submit(const Job &job);
+  void wait();
+
+  // For work that may run for longer than a frame, like file reads. wait()
+  // neither waits for it nor runs it on the caller's thread, and workers
+  // only take it when no frame job is queued.
+  void submitBackground(const Job &job);
+
+  uint32_t threadCount() const { return queues.size(); }
+  uint32_t callerThread() const { return queues.size() - 1; }
+
+ private:
+  // The owner pushes and pops at the back and thieves take from head.
+  // Emptying the queue rewinds it without freeing, so once it has grown to
+  // a frame's worth of jobs it stops allocating.
+  struct JobQueue {
+    std::mutex mutex;
+    std::vector<Job> jobs;
+    size_t head;
+
+    JobQueue() : head(0) {}
+    bool empty() const { return head == jobs.size(); }
+  };
+
+  std::vector<std::unique_ptr<JobQueue> > queues;
+  std::mutex backgroundMutex;
+  std::deque<Job> background;
+  std::atomic<uint32_t> backgroundQueued;
+  std::vector<std::thread> workers;
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<uint32_t> queued;
+  std::atomic<uint32_t> pending;
+  std::atomic<bool> running;
+  std::atomic<uint32_t> nextQueue;
+
+  static void rewind(JobQueue &queue);
+  bool runOne(uint32_t thread);
+  bool runBackground(uint32_t thread);
+  void workerLoop(uint32_t thread);
+};
+
+#endif
@@ -0,0 +1,616 @@
+#include "VulkanMemory.hpp"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  if (alignment <= 1) return value;
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize nextPowerOfTwo(VkDeviceSize value) {
+  VkDeviceSize power = 1;
+  while (power < value) power <<= 1;
+  return power;
+}
+
+static uint32_t log2Size(VkDeviceSize value) {
+  uint32_t order = 0;
+  while (value > 1) {
+    value >>= 1;
+    order++;
+  }
+  return order;
+}
+
+static const char *categoryNames[MEMORY_CATEGORY_COUNT] = {
+    "other", "swapchain", "depth", "uniforms", "staging", "textures",
+    "geometry"};
+
+VulkanMemory::VulkanMemory()
+    : bufferImageGranularity(1),
+      physicalDevice(VK_NULL_HANDLE),
+      device(VK_NULL_HANDLE),
+      getProperties2(NULL),
+      memoryAllocationCount(0),
+      maxMemoryAllocationCount(0) {
+  memoryProperties = {};
+  memset(categories, 0, sizeof(categories));
+}
+
+bool VulkanMemory::supportsBudget(VkInstance instance,
+                                  VkPhysicalDevice physicalDevice) {
+  std::vector<const char *> extensions;
+  extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  return VulkanDevice::supportsExtensions(physicalDevice, extensions) &&
+         vkGetInstanceProcAddr(instance,
+                               "vkGetPhysicalDeviceMemoryProperties2KHR");
+}
+
+void VulkanMemory::deviceExtensions(bool budget,
+                                    std::vector<const char *> &extensions) {
+  if (budget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+}
+
+const char *VulkanMemory::categoryName(MemoryCategory category) {
+  return category < MEMORY_CATEGORY_COUNT ? categoryNames[category]
+                                          : "unknown";
+}
+
+void VulkanMemory::init(VkPhysicalDevice physicalDevice, VkDevice device,
+                        VkInstance instance, bool budget) {
+  this->physicalDevice = physicalDevice;
+  this->device = device;
+  getProperties2 = NULL;
+  if (budget)
+    getProperties2 =
+        (PFN_vkGetPhysicalDeviceMemoryProperties2)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  bufferImageGranularity = properties.limits.bufferImageGranularity;
+  if (bufferImageGranularity == 0) bufferImageGranularity = 1;
+  maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+  dedicated.assign(memoryProperties.memoryHeapCount, MemoryHeapStats());
+  memset(categories, 0, sizeof(categories));
+  budgets.assign(memoryProperties.memoryHeapCount, MemoryBudget());
+  pressureListeners.clear();
+  updateBudget();
+}
+
+void VulkanMemory::destroy() {
+  for (uint32_t i = 0; i < blocks.size(); i++) destroyBlock(i);
+  blocks.clear();
+  pressureListeners.clear();
+}
+
+void VulkanMemory::updateBudget() {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+  budgetProperties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  budgetProperties.pNext = NULL;
+
+  if (getProperties2) {
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budgetProperties;
+    getProperties2(physicalDevice, &properties);
+  }
+
+  for (uint32_t heap = 0; heap < budgets.size(); heap++) {
+    MemoryBudget &budget = budgets[heap];
+    if (getProperties2) {
+      budget.budgetBytes = budgetProperties.heapBudget[heap];
+      budget.usageBytes = budgetProperties.heapUsage[heap];
+    } else {
+      budget.budgetBytes = (VkDeviceSize)(
+          memoryProperties.memoryHeaps[heap].size * MEMORY_BUDGET_FALLBACK);
+      budget.usageBytes = getHeapStats(heap).blockBytes;
+    }
+    budget.peakBytes = std::max(budget.peakBytes, budget.usageBytes);
+  }
+}
+
+void VulkanMemory::beginFrame() {
+  updateBudget();
+
+  bool trimmed = false;
+  for (uint32_t heap = 0; heap < budgets.size(); heap++) {
+    VkDeviceSize limit =
+        (VkDeviceSize)(budgets[heap].budgetBytes * MEMORY_BUDGET_PRESSURE);
+    if (budgets[heap].usageBytes <= limit) continue;
+
+    if (!trimmed) {
+      trim();
+      updateBudget();
+      trimmed = true;
+      if (budgets[heap].usageBytes <= limit) continue;
+    }
+
+    VkDeviceSize excess = budgets[heap].usageBytes - limit;
+    for (uint32_t i = 0; i < pressureListeners.size(); i++)
+      pressureListeners[i](heap, excess);
+  }
+}
+
+void VulkanMemory::trim() {
+  for (uint32_t i = 0; i < blocks.size(); i++)
+    if (blocks[i].memory != VK_NULL_HANDLE && blocks[i].allocationCount == 0)
+      destroyBlock(i);
+}
+
+void VulkanMemory::addPressureListener(const PressureListener &listener) {
+  pressureListeners.push_back(listener);
+}
+
+uint32_t VulkanMemory::findMemoryType(uint32_t typeBits,
+                                      VkMemoryPropertyFlags required,
+                                      VkMemoryPropertyFlags preferred) const {
+  VkMemoryPropertyFlags wanted[] = {required | preferred, required};
+
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+      if (!(typeBits & (1u << i))) continue;
+
+      VkMemoryPropertyFlags flags =
+          memoryProperties.memoryTypes[i].propertyFlags;
+      if ((flags & wanted[pass]) == wanted[pass]) return i;
+    }
+  }
+
+  return UINT32_MAX;
+}
+
+VkDeviceSize VulkanMemory::heapBlockSize(uint32_t memoryType) const {
+  uint32_t heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+  VkDeviceSize limit = memoryProperties.memoryHeaps[heap].size / 8;
+  VkDeviceSize size = MEMORY_BLOCK_SIZE;
+
+  while (size > limit && size > MEMORY_MIN_BUDDY_SIZE) size >>= 1;
+
+  return size;
+}
+
+VkDeviceMemory VulkanMemory::allocateMemory(uint32_t memoryType,
+                                            VkDeviceSize size, void **mapped) {
+  if (maxMemoryAllocationCount &&
+      memoryAllocationCount >= maxMemoryAllocationCount)
+    VulkanTools::exitOnError("Reached maxMemoryAllocationCount");
+
+  VkMemoryAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocateInfo.pNext = NULL;
+  allocateInfo.allocationSize = size;
+  allocateInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  VkResult result =
+      vkd.AllocateMemory(device, &allocateInfo, vkAllocator, &memory);
+  if (result != VK_SUCCESS)
+    VulkanTools::exitOnError("Failed to allocate device memory");
+
+  memoryAllocationCount++;
+
+  *mapped = NULL;
+  if (memoryProperties.memoryTypes[memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    result = vkd.MapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    assert(result == VK_SUCCESS);
+  }
+
+  return memory;
+}
+
+uint32_t VulkanMemory::createBlock(uint32_t memoryType,
+                                   AllocationStrategy strategy,
+                                   ResourceKind kind, VkDeviceSize size) {
+  uint32_t index = 0;
+  while (index < blocks.size() && blocks[index].memory != VK_NULL_HANDLE)
+    index++;
+  if (index == blocks.size()) blocks.push_back(MemoryBlock());
+
+  MemoryBlock &block = blocks[index];
+  block.memory = allocateMemory(memoryType, size, &block.mapped);
+  block.size = size;
+  block.memoryType = memoryType;
+  block.strategy = strategy;
+  block.kind = kind;
+  block.usedBytes = 0;
+  block.allocationCount = 0;
+  block.freeRanges.clear();
+  block.freeOrders.clear();
+  block.head = 0;
+  block.lastKind = kind;
+
+  switch (strategy) {
+    case ALLOCATION_FREE_LIST:
+      block.freeRanges[0] = size;
+      break;
+    case ALLOCATION_BUDDY:
+      block.minSize = nextPowerOfTwo(std::max<VkDeviceSize>(
+          MEMORY_MIN_BUDDY_SIZE, bufferImageGranularity));
+      block.freeOrders.resize(log2Size(size / block.minSize) + 1);
+      block.freeOrders.back().push_back(0);
+      break;
+    case ALLOCATION_LINEAR:
+      break;
+  }
+
+  return index;
+}
+
+void VulkanMemory::destroyBlock(uint32_t index) {
+  MemoryBlock &block = blocks[index];
+  if (block.memory == VK_NULL_HANDLE) return;
+
+  vkd.FreeMemory(device, block.memory, vkAllocator);
+  memoryAllocationCount--;
+
+  block.memory = VK_NULL_HANDLE;
+  block.mapped = NULL;
+  block.freeRanges.clear();
+  block.freeOrders.clear();
+}
+
+bool VulkanMemory::allocateFreeList(MemoryBlock &block, VkDeviceSize size,
+                                    VkDeviceSize alignment,
+                                    MemoryAllocation &allocation) {
+  std::map<VkDeviceSize, VkDeviceSize>::iterator best = block.freeRanges.end();
+  VkDeviceSize bestOffset = 0;
+
+  for (std::map<VkDeviceSize, VkDeviceSize>::iterator it =
+           block.freeRanges.begin();
+       it != block.freeRanges.end(); ++it) {
+    VkDeviceSize offset = alignUp(it->first, alignment);
+    if (offset + size > it->first + it->second) continue;
+
+    if (best == block.freeRanges.end() || it->second < best->second) {
+      best = it;
+      bestOffset = offset;
+    }
+  }
+
+  if (best == block.freeRanges.end()) return false;
+
+  VkDeviceSize rangeOffset = best->first;
+  VkDeviceSize rangeEnd = best->first + best->second;
+  block.freeRanges.erase(best);
+
+  if (bestOffset + size < rangeEnd)
+    block.freeRanges[bestOffset + size] = rangeEnd - (bestOffset + size);
+
+  allocation.offset = bestOffset;
+  allocation.rangeOffset = rangeOffset;
+  allocation.rangeSize = bestOffset + size - rangeOffset;
+  return true;
+}
+
+void VulkanMemory::freeFreeList(MemoryBlock &block,
+                                const MemoryAllocation &allocation) {
+  VkDeviceSize offset = allocation.rangeOffset;
+  VkDeviceSize size = allocation.rangeSize;
+
+  std::map<VkDeviceSize, VkDeviceSize>::iterator next =
+      block.freeRanges.find(offset + size);
+  if (next != block.freeRanges.end()) {
+    size += next->second;
+    block.freeRanges.erase(next);
+  }
+
+  std::map<VkDeviceSize, VkDeviceSize>::iterator prev =
+      block.freeRanges.lower_bound(offset);
+  if (prev != block.freeRanges.begin()) {
+    --prev;
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  block.freeRanges[offset] = size;
+}
+
+bool VulkanMemory::allocateBuddy(MemoryBlock &block, VkDeviceSize size,
+                                 VkDeviceSize alignment,
+                                 MemoryAllocation &allocation) {
+  VkDeviceSize need = nextPowerOfTwo(
+      std::max(std::max(size, alignment), block.minSize));
+  if (need > block.size) return false;
+
+  uint32_t order = log2Size(need / block.minSize);
+  uint32_t available = order;
+  while (available < block.freeOrders.size() &&
+         block.freeOrders[available].empty())
+    available++;
+  if (available == block.freeOrders.size()) return false;
+
+  VkDeviceSize offset = block.freeOrders[available].back();
+  block.freeOrders[available].pop_back();
+
+  while (available > order) {
+    available--;
+    block.freeOrders[available].push_back(offset +
+                                          (block.minSize << available));
+  }
+
+  allocation.offset = offset;
+  allocation.rangeOffset = offset;
+  allocation.rangeSize = need;
+  return true;
+}
+
+void VulkanMemory::freeBuddy(MemoryBlock &block,
+                             const MemoryAllocation &allocation) {
+  VkDeviceSize offset = allocation.rangeOffset;
+  uint32_t order = log2Size(allocation.rangeSize / block.minSize);
+
+  while (order + 1 < block.freeOrders.size()) {
+    VkDeviceSize buddy = offset ^ (block.minSize << order);
+    std::vector<VkDeviceSize> &freeList = block.freeOrders[order];
+
+    std::vector<VkDeviceSize>::iterator it =
+        std::find(freeList.begin(), freeList.end(), buddy);
+    if (it == freeList.end()) break;
+
+    freeList.erase(it);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+
+  block.freeOrders[order].push_back(offset);
+}
+
+bool VulkanMemory::allocateLinear(MemoryBlock &block, VkDeviceSize size,
+                                  VkDeviceSize alignment, ResourceKind kind,
+                                  MemoryAllocation &allocation) {
+  VkDeviceSize offset = alignUp(block.head, alignment);
+  if (block.allocationCount > 0 && block.lastKind != kind)
+    offset = alignUp(offset, bufferImageGranularity);
+  if (offset + size > block.size) return false;
+
+  block.head = offset + size;
+  block.lastKind = kind;
+
+  allocation.offset = offset;
+  allocation.rangeOffset = offset;
+  allocation.rangeSize = size;
+  return true;
+}
+
+bool VulkanMemory::allocateFromBlock(MemoryBlock &block, VkDeviceSize size,
+                                     VkDeviceSize alignment, ResourceKind kind,
+                                     MemoryAllocation &allocation) {
+  switch (block.strategy) {
+    case ALLOCATION_FREE_LIST:
+      return allocateFreeList(block, size, alignment, allocation);
+    case ALLOCATION_BUDDY:
+      return allocateBuddy(block, size, alignment, allocation);
+    case ALLOCATION_LINEAR:
+      return allocateLinear(block, size, alignment, kind, allocation);
+  }
+  return false;
+}
+
+MemoryAllocation VulkanMemory::allocate(
+    const VkMemoryRequirements &requirements, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, ResourceKind kind,
+    AllocationStrategy strategy, MemoryCategory category) {
+  MemoryAllocation allocation = {};
+
+  allocation.memoryType =
+      findMemoryType(requirements.memoryTypeBits, required, preferred);
+  if (allocation.memoryType == UINT32_MAX)
+    VulkanTools::exitOnError("No suitable memory type");
+
+  allocation.size = requirements.size;
+  allocation.category = category;
+
+  MemoryCategoryStats &stats = categories[category];
+  stats.currentBytes += requirements.size;
+  stats.peakBytes = std::max(stats.peakBytes, stats.currentBytes);
+  stats.allocationCount++;
+  VkDeviceSize blockSize = heapBlockSize(allocation.memoryType);
+
+  if (requirements.size > blockSize / 2) {
+    allocation.memory = allocateMemory(allocation.memoryType,
+                                       requirements.size, &allocation.mapped);
+    allocation.block = UINT32_MAX;
+    allocation.rangeSize = requirements.size;
+
+    uint32_t heap =
+        memoryProperties.memoryTypes[allocation.memoryType].heapIndex;
+    dedicated[heap].blockBytes += requirements.size;
+    dedicated[heap].usedBytes += requirements.size;
+    dedicated[heap].allocationCount++;
+    dedicated[heap].dedicatedCount++;
+    return allocation;
+  }
+
+  ResourceKind blockKind = RESOURCE_LINEAR;
+  if (strategy == ALLOCATION_FREE_LIST && bufferImageGranularity > 1)
+    blockKind = kind;
+
+  uint32_t index = 0;
+  for (; index < blocks.size(); index++) {
+    MemoryBlock &block = blocks[index];
+    if (block.memory == VK_NULL_HANDLE ||
+        block.memoryType != allocation.memoryType ||
+        block.strategy != strategy || block.kind != blockKind)
+      continue;
+
+    if (allocateFromBlock(block, requirements.size, requirements.alignment,
+                          kind, allocation))
+      break;
+  }
+
+  if (index == blocks.size()) {
+    index = createBlock(allocation.memoryType, strategy, blockKind, blockSize);
+
+    bool found = allocateFromBlock(blocks[index], requirements.size,
+                                   requirements.alignment, kind, allocation);
+    assert(found);
+  }
+
+  MemoryBlock &block = blocks[index];
+  block.usedBytes += allocation.rangeSize;
+  block.allocationCount++;
+
+  allocation.memory = block.memory;
+  allocation.block = index;
+  allocation.mapped =
+      block.mapped ? (char *)block.mapped + allocation.offset : NULL;
+  return allocation;
+}
+
+MemoryAllocation VulkanMemory::allocateBuffer(VkBuffer buffer,
+                                              VkMemoryPropertyFlags required,
+                                              VkMemoryPropertyFlags preferred,
+                                              AllocationStrategy strategy,
+                                              MemoryCategory category) {
+  VkMemoryRequirements requirements;
+  vkd.GetBufferMemoryRequirements(device, buffer, &requirements);
+
+  MemoryAllocation allocation = allocate(requirements, required, preferred,
+                                         RESOURCE_LINEAR, strategy, category);
+
+  VkResult result = vkd.BindBufferMemory(device, buffer, allocation.memory,
+                                         allocation.offset);
+  assert(result == VK_SUCCESS);
+
+  return allocation;
+}
+
+MemoryAllocation VulkanMemory::allocateImage(VkImage image,
+                                             VkImageTiling tiling,
+                                             VkMemoryPropertyFlags required,
+                                             VkMemoryPropertyFlags preferred,
+                                             AllocationStrategy strategy,
+                                             MemoryCategory category) {
+  VkMemoryRequirements requirements;
+  vkd.GetImageMemoryRequirements(device, image, &requirements);
+
+  ResourceKind kind =
+      tiling == VK_IMAGE_TILING_OPTIMAL ? RESOURCE_OPTIMAL : RESOURCE_LINEAR;
+  MemoryAllocation allocation =
+      allocate(requirements, required, preferred, kind, strategy, category);
+
+  VkResult result =
+      vkd.BindImageMemory(device, image, allocation.memory, allocation.offset);
+  assert(result == VK_SUCCESS);
+
+  return allocation;
+}
+
+void VulkanMemory::free(MemoryAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) return;
+
+  MemoryCategoryStats &stats = categories[allocation.category];
+  stats.currentBytes -= allocation.size;
+  stats.allocationCount--;
+
+  if (allocation.block == UINT32_MAX) {
+    vkd.FreeMemory(device, allocation.memory, vkAllocator);
+    memoryAllocationCount--;
+
+    uint32_t heap =
+        memoryProperties.memoryTypes[allocation.memoryType].heapIndex;
+    dedicated[heap].blockBytes -= allocation.rangeSize;
+    dedicated[heap].usedBytes -= allocation.rangeSize;
+    dedicated[heap].allocationCount--;
+    dedicated[heap].dedicatedCount--;
+
+    allocation = MemoryAllocation();
+    return;
+  }
+
+  MemoryBlock &block = blocks[allocation.block];
+  assert(block.memory == allocation.memory);
+
+  switch (block.strategy) {
+    case ALLOCATION_FREE_LIST:
+      freeFreeList(block, allocation);
+      break;
+    case ALLOCATION_BUDDY:
+      freeBuddy(block, allocation);
+      break;
+    case ALLOCATION_LINEAR:
+      break;
+  }
+
+  block.usedBytes -= allocation.rangeSize;
+  block.allocationCount--;
+
+  if (block.allocationCount == 0) {
+    block.head = 0;
+
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+      if (i != allocation.block && blocks[i].memory != VK_NULL_HANDLE &&
+          blocks[i].allocationCount == 0 &&
+          blocks[i].memoryType == block.memoryType &&
+          blocks[i].strategy == block.strategy &&
+          blocks[i].kind == block.kind) {
+        destroyBlock(allocation.block);
+        break;
+      }
+    }
+  }
+
+  allocation = MemoryAllocation();
+}
+
+MemoryHeapStats VulkanMemory::getHeapStats(uint32_t heap) const {
+  MemoryHeapStats stats = dedicated[heap];
+  stats.heapSize = memoryProperties.memoryHeaps[heap].size;
+
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    const MemoryBlock &block = blocks[i];
+    if (block.memory == VK_NULL_HANDLE ||
+        memoryProperties.memoryTypes[block.memoryType].heapIndex != heap)
+      continue;
+
+    stats.blockBytes += block.size;
+    stats.usedBytes += block.usedBytes;
+    stats.blockCount++;
+    stats.allocationCount += block.allocationCount;
+  }
+
+  return stats;
+}
+
+MemoryCategoryStats VulkanMemory::getCategoryStats(
+    MemoryCategory category) const {
+  return categories[category];
+}
+
+MemoryBudget VulkanMemory::getBudget(uint32_t heap) const {
+  return budgets[heap];
+}
+
+void VulkanMemory::printStats() const {
+  for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+    MemoryHeapStats stats = getHeapStats(heap);
+
+    fprintf(stdout,
+            "Heap %u: %llu MB, %u blocks, %llu / %llu KB used, "
+            "%u allocations (%u dedicated)\n",
+            heap, (unsigned long long)(stats.heapSize >> 20), stats.blockCount,
+            (unsigned long long)(stats.usedBytes >> 10),
+            (unsigned long long)(stats.blockBytes >> 10),
+            stats.allocationCount, stats.dedicatedCount);
+    fprintf(stdout, "Heap %u budget: %llu / %llu MB%s, peak %llu MB\n", heap,
+            (unsigned long long)(budgets[heap].usageBytes >> 20),
+            (unsigned long long)(budgets[heap].budgetBytes >> 20),
+            getProperties2 ? "" : " (estimated)",
+            (unsigned long long)(budgets[heap].peakBytes >> 20));
+  }
+
+  for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+    if (categories[i].peakBytes == 0) continue;
+    fprintf(stdout, "Memory %s: %llu KB, peak %llu KB, %u allocations\n",
+            categoryNames[i],
+            (unsigned long long)(categories[i].currentBytes >> 10),
+            (unsigned long long)(categories[i].peakBytes >> 10),
+            categories[i].allocationCount);
+  }
+}
@@ -0,0 +1,182 @@
+#ifndef VULKAN_MEMORY_HPP
+#define VULKAN_MEMORY_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanTools.hpp"
+
+#define MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+#define MEMORY_MIN_BUDDY_SIZE 256
+#define MEMORY_BUDGET_FALLBACK 0.8
+#define MEMORY_BUDGET_PRESSURE 0.9
+
+enum AllocationStrategy {
+  ALLOCATION_FREE_LIST = 0,
+  ALLOCATION_BUDDY,
+  ALLOCATION_LINEAR
+};
+
+enum ResourceKind { RESOURCE_LINEAR = 0, RESOURCE_OPTIMAL };
+
+enum MemoryCategory {
+  MEMORY_OTHER = 0,
+  MEMORY_SWAPCHAIN,
+  MEMORY_DEPTH,
+  MEMORY_UNIFORMS,
+  MEMORY_STAGING,
+  MEMORY_TEXTURES,
+  MEMORY_GEOMETRY,
+  MEMORY_CATEGORY_COUNT
+};
+
+struct MemoryAllocation {
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  uint32_t memoryType;
+  uint32_t block;
+  VkDeviceSize rangeOffset;
+  VkDeviceSize rangeSize;
+  void *mapped;
+  MemoryCategory category;
+};
+
+struct MemoryHeapStats {
+  VkDeviceSize heapSize;
+  VkDeviceSize blockBytes;
+  VkDeviceSize usedBytes;
+  uint32_t blockCount;
+  uint32_t allocationCount;
+  uint32_t dedicatedCount;
+};
+
+struct MemoryCategoryStats {
+  VkDeviceSize currentBytes;
+  VkDeviceSize peakBytes;
+  uint32_t allocationCount;
+};
+
+struct MemoryBudget {
+  VkDeviceSize budgetBytes;
+  VkDeviceSize usageBytes;
+  VkDeviceSize peakBytes;
+};
+
+struct MemoryBlock {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  uint32_t memoryType;
+  AllocationStrategy strategy;
+  ResourceKind kind;
+  void *mapped;
+  VkDeviceSize usedBytes;
+  uint32_t allocationCount;
+
+  std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+
+  VkDeviceSize minSize;
+  std::vector<std::vector<VkDeviceSize> > freeOrders;
+
+  VkDeviceSize head;
+  ResourceKind lastKind;
+};
+
+// Allocations are counted by category as they are made and freed. Each
+// frame, beginFrame() reads every heap's budget and usage from
+// VK_EXT_memory_budget, or without it takes the allocated blocks against a
+// fixed share of the heap. A heap past MEMORY_BUDGET_PRESSURE of its budget
+// first gives back empty blocks, then calls the pressure listeners with the
+// bytes it is over, so staging rings can shrink and streamed textures be
+// evicted before the driver starts paging.
+class VulkanMemory {
+ public:
+  typedef std::function<void(uint32_t heap, VkDeviceSize excess)>
+      PressureListener;
+
+  VulkanMemory();
+  static bool supportsBudget(VkInstance instance,
+                             VkPhysicalDevice physicalDevice);
+  static void deviceExtensions(bool budget,
+                               std::vector<const char *> &extensions);
+  static const char *categoryName(MemoryCategory category);
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device,
+            VkInstance instance = VK_NULL_HANDLE, bool budget = false);
+  void destroy();
+  void beginFrame();
+  void trim();
+  void addPressureListener(const PressureListener &listener);
+
+  uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+                          VkMemoryPropertyFlags preferred = 0) const;
+
+  MemoryAllocation allocate(
+      const VkMemoryRequirements &requirements, VkMemoryPropertyFlags required,
+      VkMemoryPropertyFlags preferred = 0, ResourceKind kind = RESOURCE_LINEAR,
+      AllocationStrategy strategy = ALLOCATION_FREE_LIST,
+      MemoryCategory category = MEMORY_OTHER);
+  MemoryAllocation allocateBuffer(
+      VkBuffer buffer, VkMemoryPropertyFlags required,
+      VkMemoryPropertyFlags preferred = 0,
+      AllocationStrategy strategy = ALLOCATION_FREE_LIST,
+      MemoryCategory category = MEMORY_OTHER);
+  MemoryAllocation allocateImage(
+      VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags required,
+      VkMemoryPropertyFlags preferred = 0,
+      AllocationStrategy strategy = ALLOCATION_FREE_LIST,
+      MemoryCategory category = MEMORY_OTHER);
+  void free(MemoryAllocation &allocation);
+
+  MemoryHeapStats getHeapStats(uint32_t heap) const;
+  MemoryCategoryStats getCategoryStats(MemoryCategory category) const;
+  MemoryBudget getBudget(uint32_t heap) const;
+  bool budgetQueried() const { return getProperties2 != NULL; }
+  void printStats() const;
+
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize bufferImageGranularity;
+
+ private:
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  PFN_vkGetPhysicalDeviceMemoryProperties2 getProperties2;
+  uint32_t memoryAllocationCount;
+  uint32_t maxMemoryAllocationCount;
+  std::vector<MemoryBlock> blocks;
+  std::vector<MemoryHeapStats> dedicated;
+  MemoryCategoryStats categories[MEMORY_CATEGORY_COUNT];
+  std::vector<MemoryBudget> budgets;
+  std::vector<PressureListener> pressureListeners;
+
+  void updateBudget();
+
+  VkDeviceSize heapBlockSize(uint32_t memoryType) const;
+  uint32_t createBlock(uint32_t memoryType, AllocationStrategy strategy,
+                       ResourceKind kind, VkDeviceSize size);
+  void destroyBlock(uint32_t index);
+  VkDeviceMemory allocateMemory(uint32_t memoryType, VkDeviceSize size,
+                                void **mapped);
+
+  bool allocateFreeList(MemoryBlock &block, VkDeviceSize size,
+                        VkDeviceSize alignment, MemoryAllocation &allocation);
+  bool allocateBuddy(MemoryBlock &block, VkDeviceSize size,
+                     VkDeviceSize alignment, MemoryAllocation &allocation);
+  bool allocateLinear(MemoryBlock &block, VkDeviceSize size,
+                      VkDeviceSize alignment, ResourceKind kind,
+                      MemoryAllocation &allocation);
+  bool allocateFromBlock(MemoryBlock &block, VkDeviceSize size,
+                         VkDeviceSize alignment, ResourceKind kind,
+                         MemoryAllocation &allocation);
+  void freeFreeList(MemoryBlock &block, const MemoryAllocation &allocation);
+  void freeBuddy(MemoryBlock &block, const MemoryAllocation &allocation);
+};
+
+#endif
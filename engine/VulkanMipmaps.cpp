@@ -0,0 +1,388 @@
+#include "VulkanMipmaps.hpp"
+
+// Float and normalized formats the downsample shader can write without a
+// format qualifier. Integer formats can't go through its float image.
+static const VkFormat computeFormats[] = {
+    VK_FORMAT_R8_UNORM,
+    VK_FORMAT_R8G8_UNORM,
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_B8G8R8A8_UNORM,
+    VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+    VK_FORMAT_B10G11R11_UFLOAT_PACK32,
+    VK_FORMAT_R16_UNORM,
+    VK_FORMAT_R16_SFLOAT,
+    VK_FORMAT_R16G16_UNORM,
+    VK_FORMAT_R16G16_SFLOAT,
+    VK_FORMAT_R16G16B16A16_UNORM,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_FORMAT_R32_SFLOAT,
+    VK_FORMAT_R32G32_SFLOAT,
+    VK_FORMAT_R32G32B32A32_SFLOAT};
+
+static bool computeFormat(VkFormat format) {
+  for (uint32_t i = 0; i < sizeof(computeFormats) / sizeof(computeFormats[0]);
+       i++)
+    if (computeFormats[i] == format) return true;
+  return false;
+}
+
+static uint32_t groupCount(uint32_t count, uint32_t groupSize) {
+  return (count + groupSize - 1) / groupSize;
+}
+
+static uint32_t levelSize(uint32_t size, uint32_t level) {
+  return std::max(size >> level, 1u);
+}
+
+VulkanMipGenerator::VulkanMipGenerator()
+    : physicalDevice(VK_NULL_HANDLE),
+      device(VK_NULL_HANDLE),
+      resources(NULL),
+      descriptors(NULL),
+      support(),
+      layout(VK_NULL_HANDLE),
+      pipelineLayout(VK_NULL_HANDLE),
+      pipeline(VK_NULL_HANDLE),
+      sampler(VK_NULL_HANDLE) {}
+
+MipSupport VulkanMipGenerator::query(VkPhysicalDevice physicalDevice) {
+  MipSupport support = {};
+
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+  support.storageWithoutFormat =
+      features.shaderStorageImageWriteWithoutFormat == VK_TRUE;
+
+  return support;
+}
+
+void VulkanMipGenerator::deviceFeatures(const MipSupport &support,
+                                        VkPhysicalDeviceFeatures &features) {
+  if (support.storageWithoutFormat)
+    features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+}
+
+void VulkanMipGenerator::init(VkPhysicalDevice physicalDevice,
+                              VkDevice device, VulkanResources &resources,
+                              VulkanDescriptorLayouts &layouts,
+                              VulkanDescriptorAllocator &descriptors,
+                              VulkanShaders &shaders,
+                              VulkanPipelineCache &pipelineCache,
+                              const MipSupport &support) {
+  this->physicalDevice = physicalDevice;
+  this->device = device;
+  this->resources = &resources;
+  this->descriptors = &descriptors;
+  this->support = support;
+
+  // Without the shader, or a device that can store to an image without
+  // naming its format, only blits are left.
+  std::string path = VulkanShaders::path(MIP_SHADER);
+  if (!support.storageWithoutFormat ||
+      VulkanTools::fileModifiedTime(path.c_str()) < 0)
+    return;
+
+  uint32_t shader = shaders.load(path.c_str());
+  if (shader == SHADER_INVALID) return;
+
+  DescriptorLayoutKey key;
+  key.add(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          VK_SHADER_STAGE_COMPUTE_BIT);
+  key.add(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
+  layout = layouts.layout(key);
+
+  VkPushConstantRange pushRange = {};
+  pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushRange.offset = 0;
+  pushRange.size = 2 * sizeof(uint32_t);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.pNext = NULL;
+  pipelineLayoutInfo.flags = 0;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &layout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+  VkResult result = vkd.CreatePipelineLayout(device, &pipelineLayoutInfo,
+                                             vkAllocator, &pipelineLayout);
+  assert(result == VK_SUCCESS);
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.pNext = NULL;
+  samplerInfo.flags = 0;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = 0.0f;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+  result = vkd.CreateSampler(device, &samplerInfo, vkAllocator, &sampler);
+  assert(result == VK_SUCCESS);
+
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = NULL;
+  pipelineInfo.flags = 0;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.pNext = NULL;
+  pipelineInfo.stage.flags = 0;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaders.module(shader);
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = NULL;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  result = vkd.CreateComputePipelines(device, pipelineCache.cache, 1,
+                                      &pipelineInfo, vkAllocator, &pipeline);
+  assert(result == VK_SUCCESS);
+}
+
+void VulkanMipGenerator::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  for (uint32_t i = 0; i < views.size(); i++)
+    vkd.DestroyImageView(device, views[i], vkAllocator);
+  views.clear();
+  images.clear();
+
+  if (pipeline != VK_NULL_HANDLE)
+    vkd.DestroyPipeline(device, pipeline, vkAllocator);
+  if (pipelineLayout != VK_NULL_HANDLE)
+    vkd.DestroyPipelineLayout(device, pipelineLayout, vkAllocator);
+  if (sampler != VK_NULL_HANDLE)
+    vkd.DestroySampler(device, sampler, vkAllocator);
+
+  pipeline = VK_NULL_HANDLE;
+  pipelineLayout = VK_NULL_HANDLE;
+  sampler = VK_NULL_HANDLE;
+  device = VK_NULL_HANDLE;
+}
+
+MipMethod VulkanMipGenerator::method(VkFormat format) const {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+  VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+
+  VkFormatFeatureFlags blit =
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+  VkFormatFeatureFlags storage =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+
+  if ((features & blit) == blit &&
+      (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+    return MIP_BLIT_LINEAR;
+  if (pipeline != VK_NULL_HANDLE && (features & storage) == storage &&
+      computeFormat(format))
+    return MIP_COMPUTE;
+  if ((features & blit) == blit) return MIP_BLIT_NEAREST;
+  return MIP_UNSUPPORTED;
+}
+
+VkImageUsageFlags VulkanMipGenerator::usage(MipMethod method) {
+  switch (method) {
+    case MIP_BLIT_LINEAR:
+    case MIP_BLIT_NEAREST:
+      return VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+             VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    case MIP_COMPUTE:
+      return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    default:
+      return 0;
+  }
+}
+
+uint32_t VulkanMipGenerator::levelCount(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  while ((width | height) >> levels) levels++;
+  return levels;
+}
+
+VkImageLayout VulkanMipGenerator::sourceLayout(MipMethod method) {
+  return method == MIP_COMPUTE ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                               : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+}
+
+VkImageLayout VulkanMipGenerator::destinationLayout(MipMethod method) {
+  return method == MIP_COMPUTE ? VK_IMAGE_LAYOUT_GENERAL
+                               : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+}
+
+bool VulkanMipGenerator::add(VkImage image, VkFormat format, uint32_t width,
+                             uint32_t height, uint32_t levels,
+                             VkImageLayout baseLayout,
+                             VkImageLayout finalLayout) {
+  assert(levels >= 1 && levels <= levelCount(width, height));
+
+  MipImage item = {};
+  item.image = image;
+  item.width = width;
+  item.height = height;
+  item.levels = levels;
+  item.method = method(format);
+  item.baseLayout = baseLayout;
+  item.finalLayout = finalLayout;
+  item.firstView = views.size();
+  if (item.method == MIP_UNSUPPORTED) return false;
+
+  if (item.method == MIP_COMPUTE) {
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.pNext = NULL;
+    viewInfo.flags = 0;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+                           VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+
+    for (uint32_t i = 0; i < levels; i++) {
+      viewInfo.subresourceRange =
+          VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+      VkImageView view;
+      VkResult result =
+          vkd.CreateImageView(device, &viewInfo, vkAllocator, &view);
+      assert(result == VK_SUCCESS);
+      views.push_back(view);
+    }
+  }
+
+  images.push_back(item);
+  return true;
+}
+
+void VulkanMipGenerator::blit(VkCommandBuffer cmdBuffer,
+                              const MipImage &image, uint32_t level) {
+  VkImageBlit region = {};
+  region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.srcSubresource.mipLevel = level - 1;
+  region.srcSubresource.baseArrayLayer = 0;
+  region.srcSubresource.layerCount = 1;
+  region.srcOffsets[0] = {0, 0, 0};
+  region.srcOffsets[1] = {(int32_t)levelSize(image.width, level - 1),
+                          (int32_t)levelSize(image.height, level - 1), 1};
+  region.dstSubresource = region.srcSubresource;
+  region.dstSubresource.mipLevel = level;
+  region.dstOffsets[0] = {0, 0, 0};
+  region.dstOffsets[1] = {(int32_t)levelSize(image.width, level),
+                          (int32_t)levelSize(image.height, level), 1};
+
+  vkd.CmdBlitImage(cmdBuffer, image.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                   image.method == MIP_BLIT_LINEAR ? VK_FILTER_LINEAR
+                                                   : VK_FILTER_NEAREST);
+}
+
+void VulkanMipGenerator::dispatch(VkCommandBuffer cmdBuffer,
+                                  const MipImage &image, uint32_t level) {
+  DescriptorSetKey setKey(layout);
+  setKey.image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+               views[image.firstView + level - 1], sampler,
+               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  setKey.image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+               views[image.firstView + level], VK_NULL_HANDLE,
+               VK_IMAGE_LAYOUT_GENERAL);
+  VkDescriptorSet set = descriptors->set(setKey);
+
+  uint32_t size[2] = {levelSize(image.width, level),
+                      levelSize(image.height, level)};
+  vkd.CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &set, 0, NULL);
+  vkd.CmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(size), size);
+  vkd.CmdDispatch(cmdBuffer, groupCount(size[0], MIP_GROUP_SIZE),
+                  groupCount(size[1], MIP_GROUP_SIZE), 1);
+}
+
+void VulkanMipGenerator::record(VkCommandBuffer cmdBuffer) {
+  if (images.empty()) return;
+
+  // Level 0 becomes the first source and every other level a destination.
+  VulkanTools::BarrierBatch barriers;
+  uint32_t levels = 0;
+  bool compute = false;
+  for (uint32_t i = 0; i < images.size(); i++) {
+    const MipImage &image = images[i];
+    VkImageLayout source =
+        image.levels > 1 ? sourceLayout(image.method) : image.finalLayout;
+    if (barriers.full()) barriers.record(cmdBuffer);
+    if (image.baseLayout != source)
+      barriers.image(
+          image.image, image.baseLayout, source,
+          VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 0, 1));
+    if (barriers.full()) barriers.record(cmdBuffer);
+    if (image.levels > 1)
+      barriers.image(
+          image.image, VK_IMAGE_LAYOUT_UNDEFINED,
+          destinationLayout(image.method),
+          VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 1));
+    levels = std::max(levels, image.levels);
+    compute = compute || image.method == MIP_COMPUTE;
+  }
+  if (!barriers.empty()) barriers.record(cmdBuffer);
+
+  if (compute)
+    vkd.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+  // Each step writes the same level of every image, then hands the level
+  // it read to its final layout and the level it wrote on as the next
+  // source.
+  for (uint32_t level = 1; level < levels; level++) {
+    for (uint32_t i = 0; i < images.size(); i++) {
+      const MipImage &image = images[i];
+      if (level >= image.levels) continue;
+      if (image.method == MIP_COMPUTE)
+        dispatch(cmdBuffer, image, level);
+      else
+        blit(cmdBuffer, image, level);
+    }
+
+    for (uint32_t i = 0; i < images.size(); i++) {
+      const MipImage &image = images[i];
+      if (level >= image.levels) continue;
+
+      bool computed = image.method == MIP_COMPUTE;
+      VkImageLayout source = sourceLayout(image.method);
+      VkImageLayout next =
+          level + 1 == image.levels ? image.finalLayout : source;
+      VulkanTools::LayoutAccess read = VulkanTools::layoutAccess(next, false);
+      if (barriers.full()) barriers.record(cmdBuffer);
+      if (source != image.finalLayout)
+        barriers.image(
+            image.image, source, image.finalLayout,
+            VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, level - 1,
+                                          1));
+      if (barriers.full()) barriers.record(cmdBuffer);
+      barriers.image(
+          image.image, destinationLayout(image.method), next,
+          VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, level, 1),
+          computed ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                   : VK_PIPELINE_STAGE_TRANSFER_BIT,
+          computed ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_TRANSFER_WRITE_BIT,
+          read.stages, read.access);
+    }
+    barriers.record(cmdBuffer);
+  }
+
+  // The per-level views go with the frame that used them.
+  for (uint32_t i = 0; i < views.size(); i++)
+    resources->retireImageView(views[i]);
+  views.clear();
+  images.clear();
+}
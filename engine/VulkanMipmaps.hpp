@@ -0,0 +1,102 @@
+#ifndef VULKAN_MIPMAPS_HPP
+#define VULKAN_MIPMAPS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "VulkanDescriptors.hpp"
+#include "VulkanPipelineCache.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanShaders.hpp"
+#include "VulkanTools.hpp"
+
+#define MIP_SHADER "downsample.comp.spv"
+#define MIP_GROUP_SIZE 8
+
+struct MipSupport {
+  bool storageWithoutFormat;
+};
+
+enum MipMethod {
+  MIP_UNSUPPORTED = 0,
+  MIP_BLIT_LINEAR,
+  MIP_COMPUTE,
+  MIP_BLIT_NEAREST
+};
+
+struct MipImage {
+  VkImage image;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+  MipMethod method;
+  VkImageLayout baseLayout;
+  VkImageLayout finalLayout;
+  // The image's per-level views in the generator's list, for MIP_COMPUTE.
+  uint32_t firstView;
+};
+
+// Fills in the mip chains of images whose level 0 has been written. Images
+// queued with add() are all generated by the next record(), level by level
+// across every image, so each step down the chain costs one batch of
+// barriers however many images are in flight and a frame of texture loads
+// shares one submission. Levels are blitted with a linear filter where the
+// format allows it, and otherwise averaged by a compute pass writing
+// storage views of each level; formats with neither fall back to a nearest
+// blit. Blits need a graphics queue, so record() goes in a graphics
+// command buffer after the uploads that wrote level 0 were acquired.
+class VulkanMipGenerator {
+ public:
+  VulkanMipGenerator();
+
+  static MipSupport query(VkPhysicalDevice physicalDevice);
+  static void deviceFeatures(const MipSupport &support,
+                             VkPhysicalDeviceFeatures &features);
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device,
+            VulkanResources &resources, VulkanDescriptorLayouts &layouts,
+            VulkanDescriptorAllocator &descriptors, VulkanShaders &shaders,
+            VulkanPipelineCache &pipelineCache, const MipSupport &support);
+  void destroy();
+
+  MipMethod method(VkFormat format) const;
+  static VkImageUsageFlags usage(MipMethod method);
+  static uint32_t levelCount(uint32_t width, uint32_t height);
+
+  bool add(VkImage image, VkFormat format, uint32_t width, uint32_t height,
+           uint32_t levels, VkImageLayout baseLayout,
+           VkImageLayout finalLayout =
+               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  void record(VkCommandBuffer cmdBuffer);
+  uint32_t pending() const { return images.size(); }
+  bool computeFallback() const { return pipeline != VK_NULL_HANDLE; }
+
+ private:
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VulkanResources *resources;
+  VulkanDescriptorAllocator *descriptors;
+  MipSupport support;
+
+  VkDescriptorSetLayout layout;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+  VkSampler sampler;
+
+  std::vector<MipImage> images;
+  std::vector<VkImageView> views;
+
+  static VkImageLayout sourceLayout(MipMethod method);
+  static VkImageLayout destinationLayout(MipMethod method);
+  void blit(VkCommandBuffer cmdBuffer, const MipImage &image,
+            uint32_t level);
+  void dispatch(VkCommandBuffer cmdBuffer, const MipImage &image,
+                uint32_t level);
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "VulkanPacing.hpp"
+
+// Display timing reports CLOCK_MONOTONIC, which steady_clock is on Linux.
+static uint64_t monotonicNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void accumulate(ProfileStats &stats, double ms) {
+  if (stats.count == 0 || ms < stats.minMs) stats.minMs = ms;
+  if (stats.count == 0 || ms > stats.maxMs) stats.maxMs = ms;
+  stats.totalMs += ms;
+  stats.count++;
+}
+
+VulkanFramePacer::VulkanFramePacer()
+    : device(VK_NULL_HANDLE),
+      latencyFrames(1),
+      justInTime(false),
+      presentCount(0),
+      inputTime(0),
+      presentStart(0),
+      cpuFrameMs(0.0),
+      refreshMs(0.0) {
+  support.displayTiming = false;
+  support.presentWait = false;
+}
+
+PacingSupport VulkanFramePacer::query(VkInstance instance,
+                                      VkPhysicalDevice physicalDevice) {
+  PacingSupport support = {};
+
+  std::vector<const char *> extensions;
+  extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+  support.displayTiming =
+      VulkanDevice::supportsExtensions(physicalDevice, extensions);
+
+  extensions.clear();
+  extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+  extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  if (!VulkanDevice::supportsExtensions(physicalDevice, extensions))
+    return support;
+
+  PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 =
+      (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceFeatures2KHR");
+  if (!getFeatures2) return support;
+
+  VkPhysicalDevicePresentIdFeaturesKHR idFeatures = {};
+  idFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  idFeatures.pNext = NULL;
+
+  VkPhysicalDevicePresentWaitFeaturesKHR waitFeatures = {};
+  waitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  waitFeatures.pNext = &idFeatures;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &waitFeatures;
+  getFeatures2(physicalDevice, &features);
+
+  support.presentWait = idFeatures.presentId && waitFeatures.presentWait;
+  return support;
+}
+
+void VulkanFramePacer::deviceExtensions(
+    const PacingSupport &support, std::vector<const char *> &extensions) {
+  if (support.displayTiming)
+    extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+  if (support.presentWait) {
+    extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  }
+}
+
+void VulkanFramePacer::deviceFeatures(
+    const PacingSupport &support,
+    VkPhysicalDevicePresentIdFeaturesKHR &idFeatures,
+    VkPhysicalDevicePresentWaitFeaturesKHR &features) {
+  idFeatures = VkPhysicalDevicePresentIdFeaturesKHR();
+  idFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  idFeatures.pNext = NULL;
+  idFeatures.presentId = support.presentWait ? VK_TRUE : VK_FALSE;
+
+  features = VkPhysicalDevicePresentWaitFeaturesKHR();
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  features.pNext = &idFeatures;
+  features.presentWait = support.presentWait ? VK_TRUE : VK_FALSE;
+}
+
+void VulkanFramePacer::init(VkDevice device, const PacingSupport &support,
+                            uint32_t framesInFlight, uint32_t latencyFrames,
+                            bool justInTime) {
+  this->device = device;
+  this->support = support;
+  if (!vkd.GetPastPresentationTimingGOOGLE ||
+      !vkd.GetRefreshCycleDurationGOOGLE)
+    this->support.displayTiming = false;
+  if (!vkd.WaitForPresentKHR) this->support.presentWait = false;
+
+  if (latencyFrames == 0 || latencyFrames > framesInFlight)
+    latencyFrames = framesInFlight;
+  this->latencyFrames = latencyFrames;
+  this->justInTime = justInTime;
+
+  presentCount = 0;
+  cpuFrameMs = 0.0;
+  refreshMs = 0.0;
+  samples.assign(PACING_HISTORY, PresentSample());
+  latencyStats = ProfileStats();
+  presentStats = ProfileStats();
+  delayStats = ProfileStats();
+
+  fprintf(stdout, "Pacing:         %u frame%s of latency%s%s%s\n",
+          latencyFrames, latencyFrames == 1 ? "" : "s",
+          justInTime ? ", just-in-time" : "",
+          this->support.displayTiming ? ", display timing" : "",
+          this->support.presentWait ? ", present wait" : "");
+}
+
+void VulkanFramePacer::waitPresent(VkSwapchainKHR swapchain) {
+  if (!support.presentWait || swapchain == VK_NULL_HANDLE) return;
+  if (presentCount < latencyFrames) return;
+
+  // Only a wait that actually blocked says when the image reached the
+  // display; one that was already done only says it happened before now.
+  uint64_t target = presentCount + 1 - latencyFrames;
+  VkResult result = vkd.WaitForPresentKHR(device, swapchain, target, 0);
+  if (result != VK_TIMEOUT) return;
+
+  TRACE_ZONE("waitPresent");
+  result = vkd.WaitForPresentKHR(device, swapchain, target,
+                                 PACING_PRESENT_TIMEOUT);
+  if (result == VK_SUCCESS && !support.displayTiming)
+    photon(target, monotonicNs());
+}
+
+void VulkanFramePacer::beginFrame(VkSwapchainKHR swapchain,
+                                  double gpuFrameMs) {
+  waitPresent(swapchain);
+
+  uint64_t now = monotonicNs();
+  if (justInTime && latencyFrames > 1) {
+    // The GPU still has latency - 1 frames queued once the wait returns.
+    double delayMs = (latencyFrames - 1) * gpuFrameMs - cpuFrameMs -
+                     PACING_MARGIN_MS;
+    if (delayMs > 0.0) {
+      TRACE_ZONE("justInTime");
+      std::this_thread::sleep_for(
+          std::chrono::duration<double, std::milli>(delayMs));
+      accumulate(delayStats, delayMs);
+      now = monotonicNs();
+    }
+  }
+
+  inputTime = now;
+}
+
+void VulkanFramePacer::submitted() {
+  double ms = (monotonicNs() - inputTime) / 1000000.0;
+  cpuFrameMs = cpuFrameMs == 0.0 ? ms : cpuFrameMs * 0.9 + ms * 0.1;
+}
+
+const void *VulkanFramePacer::beginPresent(uint32_t swapchainCount) {
+  presentCount++;
+  PresentSample &sample = samples[presentCount % PACING_HISTORY];
+  sample.presentId = presentCount;
+  sample.inputTime = inputTime;
+
+  const void *chain = NULL;
+
+  if (support.presentWait) {
+    presentIds.assign(swapchainCount, presentCount);
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.pNext = chain;
+    presentIdInfo.swapchainCount = swapchainCount;
+    presentIdInfo.pPresentIds = presentIds.data();
+    chain = &presentIdInfo;
+  }
+
+  if (support.displayTiming) {
+    VkPresentTimeGOOGLE presentTime = {};
+    presentTime.presentID = (uint32_t)presentCount;
+    presentTime.desiredPresentTime = 0;
+    presentTimes.assign(swapchainCount, presentTime);
+    presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+    presentTimesInfo.pNext = chain;
+    presentTimesInfo.swapchainCount = swapchainCount;
+    presentTimesInfo.pTimes = presentTimes.data();
+    chain = &presentTimesInfo;
+  }
+
+  presentStart = monotonicNs();
+  return chain;
+}
+
+void VulkanFramePacer::endPresent(VkSwapchainKHR swapchain) {
+  accumulate(presentStats, (monotonicNs() - presentStart) / 1000000.0);
+  collectTimings(swapchain);
+}
+
+void VulkanFramePacer::collectTimings(VkSwapchainKHR swapchain) {
+  if (!support.displayTiming || swapchain == VK_NULL_HANDLE) return;
+
+  if (refreshMs == 0.0) {
+    VkRefreshCycleDurationGOOGLE refresh = {};
+    if (vkd.GetRefreshCycleDurationGOOGLE(device, swapchain, &refresh) ==
+        VK_SUCCESS)
+      refreshMs = refresh.refreshDuration / 1000000.0;
+  }
+
+  uint32_t count = 0;
+  VkResult result =
+      vkd.GetPastPresentationTimingGOOGLE(device, swapchain, &count, NULL);
+  if (result != VK_SUCCESS || count == 0) return;
+
+  pastTimings.resize(count);
+  result = vkd.GetPastPresentationTimingGOOGLE(device, swapchain, &count,
+                                               pastTimings.data());
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) return;
+
+  for (uint32_t i = 0; i < count; i++)
+    photon(pastTimings[i].presentID, pastTimings[i].actualPresentTime);
+}
+
+void VulkanFramePacer::photon(uint64_t presentId, uint64_t time) {
+  // Display timing only hands back the low 32 bits of the id.
+  const PresentSample &sample = samples[presentId % PACING_HISTORY];
+  if ((uint32_t)sample.presentId != (uint32_t)presentId) return;
+  if (time < sample.inputTime) return;
+
+  accumulate(latencyStats, (time - sample.inputTime) / 1000000.0);
+}
+
+void VulkanFramePacer::print() const {
+  if (presentStats.count > 0)
+    fprintf(stdout, "Present:        %.3f ms avg, %.3f ms max per call\n",
+            presentStats.totalMs / presentStats.count, presentStats.maxMs);
+  if (refreshMs > 0.0)
+    fprintf(stdout, "Refresh:        %.2f ms\n", refreshMs);
+  if (latencyStats.count > 0)
+    fprintf(stdout,
+            "Latency:        %.2f ms avg motion-to-photon (%.2f - %.2f)\n",
+            latencyStats.totalMs / latencyStats.count, latencyStats.minMs,
+            latencyStats.maxMs);
+  else if (presentStats.count > 0)
+    fprintf(stdout, "Latency:        no display timing feedback\n");
+  if (delayStats.count > 0)
+    fprintf(stdout, "Delayed Start:  %.2f ms avg over %u frames\n",
+            delayStats.totalMs / delayStats.count, delayStats.count);
+}
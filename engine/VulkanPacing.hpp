@@ -0,0 +1,91 @@
+#ifndef VULKAN_PACING_HPP
+#define VULKAN_PACING_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanProfiler.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanTrace.hpp"
+
+#define PACING_HISTORY 64
+#define PACING_MARGIN_MS 1.0
+#define PACING_PRESENT_TIMEOUT 100000000ull
+
+struct PacingSupport {
+  bool displayTiming;
+  bool presentWait;
+};
+
+struct PresentSample {
+  uint64_t presentId;
+  uint64_t inputTime;
+};
+
+// Keeps the CPU at most latency() frames ahead of the display. The frame
+// loop waits on the GPU work from that many frames ago, and beginFrame()
+// also waits on that frame's present when VK_KHR_present_wait is there.
+// With just-in-time enabled it then sleeps until the queued GPU work is
+// predicted to drain, less the measured CPU time of a frame, so input is
+// sampled as late as possible. Each present remembers when its input was
+// sampled. VK_GOOGLE_display_timing or a present wait that blocked reports
+// when it reached the display, which gives motion-to-photon latency. A
+// present to several swapchains gives them all the same id, and the one
+// passed to beginFrame() and endPresent() is the one that is timed.
+class VulkanFramePacer {
+ public:
+  VulkanFramePacer();
+
+  static PacingSupport query(VkInstance instance,
+                             VkPhysicalDevice physicalDevice);
+  static void deviceExtensions(const PacingSupport &support,
+                               std::vector<const char *> &extensions);
+  static void deviceFeatures(const PacingSupport &support,
+                             VkPhysicalDevicePresentIdFeaturesKHR &idFeatures,
+                             VkPhysicalDevicePresentWaitFeaturesKHR &features);
+
+  void init(VkDevice device, const PacingSupport &support,
+            uint32_t framesInFlight, uint32_t latencyFrames, bool justInTime);
+
+  uint32_t latency() const { return latencyFrames; }
+  void beginFrame(VkSwapchainKHR swapchain, double gpuFrameMs);
+  void submitted();
+  const void *beginPresent(uint32_t swapchainCount = 1);
+  void endPresent(VkSwapchainKHR swapchain);
+
+  void print() const;
+
+ private:
+  VkDevice device;
+  PacingSupport support;
+  uint32_t latencyFrames;
+  bool justInTime;
+
+  uint64_t presentCount;
+  uint64_t inputTime;
+  uint64_t presentStart;
+  double cpuFrameMs;
+  double refreshMs;
+  std::vector<PresentSample> samples;
+
+  std::vector<uint64_t> presentIds;
+  VkPresentIdKHR presentIdInfo;
+  std::vector<VkPresentTimeGOOGLE> presentTimes;
+  VkPresentTimesInfoGOOGLE presentTimesInfo;
+  std::vector<VkPastPresentationTimingGOOGLE> pastTimings;
+
+  ProfileStats latencyStats;
+  ProfileStats presentStats;
+  ProfileStats delayStats;
+
+  void waitPresent(VkSwapchainKHR swapchain);
+  void collectTimings(VkSwapchainKHR swapchain);
+  void photon(uint64_t presentId, uint64_t time);
+};
+
+#endif
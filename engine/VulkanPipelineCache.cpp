@@ -0,0 +1,134 @@
+#include "VulkanPipelineCache.hpp"
+
+static bool readFile(const std::string &path, std::vector<char> &data) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  bool ok = size > 0;
+  if (ok) {
+    data.resize(size);
+    ok = fread(data.data(), 1, size, file) == (size_t)size;
+  }
+
+  fclose(file);
+  return ok;
+}
+
+VulkanPipelineCache::VulkanPipelineCache()
+    : cache(VK_NULL_HANDLE),
+      loaded(false),
+      device(VK_NULL_HANDLE),
+      persistent(true) {
+  properties = {};
+}
+
+void VulkanPipelineCache::init(VkDevice device,
+                               const VkPhysicalDeviceProperties &properties,
+                               const char *path, bool persistent) {
+  this->device = device;
+  this->properties = properties;
+  this->persistent = persistent;
+
+  if (!path) path = getenv(PIPELINE_CACHE_ENV);
+  this->path = path ? path : PIPELINE_CACHE_FILE;
+
+  // A cache that isn't persistent starts empty and is never written, so
+  // every pipeline is compiled as on a first run.
+  std::vector<char> data;
+  loaded = persistent && readFile(this->path, data) && validate(data);
+  if (!loaded) data.clear();
+
+  cache = createCache(data);
+
+  if (persistent)
+    fprintf(stdout, "Pipeline Cache: %s (%s)\n", this->path.c_str(),
+            loaded ? "loaded" : "empty");
+  else
+    fprintf(stdout, "Pipeline Cache: not persistent\n");
+}
+
+void VulkanPipelineCache::destroy() {
+  if (cache == VK_NULL_HANDLE) return;
+
+  save();
+  vkd.DestroyPipelineCache(device, cache, vkAllocator);
+  cache = VK_NULL_HANDLE;
+}
+
+bool VulkanPipelineCache::validate(const std::vector<char> &data) const {
+  PipelineCacheHeader header;
+  if (data.size() < sizeof(header)) return false;
+
+  memcpy(&header, data.data(), sizeof(header));
+
+  return header.headerLength >= sizeof(header) &&
+         header.headerLength <= data.size() &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache VulkanPipelineCache::createCache(
+    const std::vector<char> &data) {
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.pNext = NULL;
+  cacheInfo.flags = 0;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? NULL : data.data();
+
+  VkPipelineCache pipelineCache;
+  VkResult result =
+      vkd.CreatePipelineCache(device, &cacheInfo, vkAllocator, &pipelineCache);
+  assert(result == VK_SUCCESS);
+
+  return pipelineCache;
+}
+
+VkPipelineCache VulkanPipelineCache::createWorkerCache() {
+  return createCache(std::vector<char>());
+}
+
+void VulkanPipelineCache::merge(VkPipelineCache workerCache) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    VkResult result = vkd.MergePipelineCaches(device, cache, 1, &workerCache);
+    assert(result == VK_SUCCESS);
+  }
+
+  vkd.DestroyPipelineCache(device, workerCache, vkAllocator);
+}
+
+bool VulkanPipelineCache::save() {
+  if (!persistent) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  size_t size = 0;
+  VkResult result = vkd.GetPipelineCacheData(device, cache, &size, NULL);
+  if (result != VK_SUCCESS || size == 0) return false;
+
+  std::vector<char> data(size);
+  result = vkd.GetPipelineCacheData(device, cache, &size, data.data());
+  if (result != VK_SUCCESS || !validate(data)) return false;
+
+  std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) return false;
+
+  bool ok = fwrite(data.data(), 1, size, file) == size;
+  ok = fflush(file) == 0 && ok;
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || !VulkanTools::replaceFile(temporary.c_str(), path.c_str())) {
+    remove(temporary.c_str());
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,50 @@
+#ifndef VULKAN_PIPELINE_CACHE_HPP
+#define VULKAN_PIPELINE_CACHE_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "VulkanTools.hpp"
+
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+#define PIPELINE_CACHE_ENV "VULKAN_EXAMPLE_PIPELINE_CACHE"
+
+struct PipelineCacheHeader {
+  uint32_t headerLength;
+  uint32_t headerVersion;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+class VulkanPipelineCache {
+ public:
+  VulkanPipelineCache();
+  void init(VkDevice device, const VkPhysicalDeviceProperties &properties,
+            const char *path = NULL, bool persistent = true);
+  void destroy();
+
+  VkPipelineCache createWorkerCache();
+  void merge(VkPipelineCache workerCache);
+  bool save();
+
+  VkPipelineCache cache;
+  bool loaded;
+
+ private:
+  VkDevice device;
+  VkPhysicalDeviceProperties properties;
+  std::string path;
+  bool persistent;
+  std::mutex mutex;
+
+  bool validate(const std::vector<char> &data) const;
+  VkPipelineCache createCache(const std::vector<char> &data);
+};
+
+#endif
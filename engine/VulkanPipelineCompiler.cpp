@@ -0,0 +1,98 @@
+#include "VulkanPipelineCompiler.hpp"
+
+VulkanPipelineCompiler::VulkanPipelineCompiler()
+    : device(VK_NULL_HANDLE),
+      pipelineCache(NULL),
+      pending(0),
+      running(false) {}
+
+VulkanPipelineCompiler::~VulkanPipelineCompiler() { destroy(); }
+
+void VulkanPipelineCompiler::init(VkDevice device,
+                                  VulkanPipelineCache &pipelineCache,
+                                  uint32_t threadCount) {
+  this->device = device;
+  this->pipelineCache = &pipelineCache;
+  running = true;
+
+  for (uint32_t i = 0; i < threadCount; i++)
+    workerCaches.push_back(pipelineCache.createWorkerCache());
+
+  for (uint32_t i = 0; i < threadCount; i++)
+    workers.push_back(
+        std::thread(&VulkanPipelineCompiler::workerLoop, this, i));
+}
+
+void VulkanPipelineCompiler::destroy() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running) return;
+    running = false;
+  }
+  wake.notify_all();
+
+  for (uint32_t i = 0; i < workers.size(); i++) workers[i].join();
+  workers.clear();
+
+  while (!jobs.empty()) {
+    jobs.front().promise->set_value(VK_NULL_HANDLE);
+    jobs.pop_front();
+    pending--;
+  }
+
+  for (uint32_t i = 0; i < workerCaches.size(); i++)
+    pipelineCache->merge(workerCaches[i]);
+  workerCaches.clear();
+}
+
+PipelineFuture VulkanPipelineCompiler::compile(const Build &build) {
+  CompileJob job;
+  job.build = build;
+  job.promise = std::make_shared<std::promise<VkPipeline> >();
+  PipelineFuture future = job.promise->get_future().share();
+
+  if (workers.empty()) {
+    job.promise->set_value(build(device, pipelineCache->cache));
+    return future;
+  }
+
+  pending++;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(job);
+  }
+  wake.notify_one();
+
+  return future;
+}
+
+void VulkanPipelineCompiler::workerLoop(uint32_t worker) {
+  for (;;) {
+    CompileJob job;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this] { return !running || !jobs.empty(); });
+      if (!running) return;
+
+      job = jobs.front();
+      jobs.pop_front();
+    }
+
+    job.promise->set_value(job.build(device, workerCaches[worker]));
+    pending--;
+  }
+}
+
+bool VulkanPipelineCompiler::ready(const PipelineFuture &future) {
+  return future.valid() && future.wait_for(std::chrono::seconds(0)) ==
+                               std::future_status::ready;
+}
+
+VkPipeline VulkanPipelineCompiler::resolve(const PipelineFuture &future,
+                                           VkPipeline fallback) {
+  if (!ready(future)) return fallback;
+
+  VkPipeline pipeline = future.get();
+  return pipeline != VK_NULL_HANDLE ? pipeline : fallback;
+}
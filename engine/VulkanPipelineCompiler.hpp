@@ -0,0 +1,59 @@
+#ifndef VULKAN_PIPELINE_COMPILER_HPP
+#define VULKAN_PIPELINE_COMPILER_HPP
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "VulkanPipelineCache.hpp"
+
+#define PIPELINE_COMPILE_THREADS 2
+
+typedef std::shared_future<VkPipeline> PipelineFuture;
+
+class VulkanPipelineCompiler {
+ public:
+  typedef std::function<VkPipeline(VkDevice device, VkPipelineCache cache)>
+      Build;
+
+  VulkanPipelineCompiler();
+  ~VulkanPipelineCompiler();
+  void init(VkDevice device, VulkanPipelineCache &pipelineCache,
+            uint32_t threadCount = PIPELINE_COMPILE_THREADS);
+  void destroy();
+
+  PipelineFuture compile(const Build &build);
+  uint32_t pendingCount() const { return pending; }
+
+  static bool ready(const PipelineFuture &future);
+  static VkPipeline resolve(const PipelineFuture &future,
+                            VkPipeline fallback = VK_NULL_HANDLE);
+
+ private:
+  struct CompileJob {
+    Build build;
+    std::shared_ptr<std::promise<VkPipeline> > promise;
+  };
+
+  VkDevice device;
+  VulkanPipelineCache *pipelineCache;
+  std::vector<std::thread> workers;
+  std::vector<VkPipelineCache> workerCaches;
+  std::deque<CompileJob> jobs;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::atomic<uint32_t> pending;
+  bool running;
+
+  void workerLoop(uint32_t worker);
+};
+
+#endif
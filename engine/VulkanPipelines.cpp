@@ -0,0 +1,278 @@
+#include "VulkanPipelines.hpp"
+
+GraphicsPipelineDesc::GraphicsPipelineDesc()
+    : vertexShader(VK_NULL_HANDLE),
+      fragmentShader(VK_NULL_HANDLE),
+      layout(VK_NULL_HANDLE),
+      bindingCount(0),
+      attributeCount(0),
+      topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
+      cullMode(VK_CULL_MODE_NONE),
+      frontFace(VK_FRONT_FACE_COUNTER_CLOCKWISE),
+      depthTest(VK_FALSE),
+      depthWrite(VK_FALSE),
+      depthCompare(VK_COMPARE_OP_LESS_OR_EQUAL),
+      blend(VK_FALSE) {}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::addBinding(
+    const VkVertexInputBindingDescription &binding) {
+  assert(bindingCount < PIPELINE_MAX_VERTEX_BINDINGS);
+  bindings[bindingCount++] = binding;
+  return *this;
+}
+
+GraphicsPipelineDesc &GraphicsPipelineDesc::addAttribute(
+    const VkVertexInputAttributeDescription &attribute) {
+  assert(attributeCount < PIPELINE_MAX_VERTEX_ATTRIBUTES);
+  attributes[attributeCount++] = attribute;
+  return *this;
+}
+
+bool GraphicsPipelineDesc::operator==(const GraphicsPipelineDesc &other) const {
+  if (vertexShader != other.vertexShader ||
+      fragmentShader != other.fragmentShader || layout != other.layout ||
+      bindingCount != other.bindingCount ||
+      attributeCount != other.attributeCount || topology != other.topology ||
+      cullMode != other.cullMode || frontFace != other.frontFace ||
+      depthTest != other.depthTest || depthWrite != other.depthWrite ||
+      depthCompare != other.depthCompare || blend != other.blend)
+    return false;
+
+  for (uint32_t i = 0; i < bindingCount; i++)
+    if (bindings[i].binding != other.bindings[i].binding ||
+        bindings[i].stride != other.bindings[i].stride ||
+        bindings[i].inputRate != other.bindings[i].inputRate)
+      return false;
+
+  for (uint32_t i = 0; i < attributeCount; i++)
+    if (attributes[i].location != other.attributes[i].location ||
+        attributes[i].binding != other.attributes[i].binding ||
+        attributes[i].format != other.attributes[i].format ||
+        attributes[i].offset != other.attributes[i].offset)
+      return false;
+
+  return true;
+}
+
+bool GraphicsPipelineKey::operator==(const GraphicsPipelineKey &other) const {
+  return renderPass == other.renderPass && variant == other.variant &&
+         desc == other.desc;
+}
+
+size_t GraphicsPipelineKeyHash::operator()(
+    const GraphicsPipelineKey &key) const {
+  const GraphicsPipelineDesc &desc = key.desc;
+  size_t seed = 0;
+  VulkanTools::hashCombine(seed, (uint64_t)key.renderPass);
+  VulkanTools::hashCombine(seed, key.variant);
+  VulkanTools::hashCombine(seed, (uint64_t)desc.vertexShader);
+  VulkanTools::hashCombine(seed, (uint64_t)desc.fragmentShader);
+  VulkanTools::hashCombine(seed, (uint64_t)desc.layout);
+  VulkanTools::hashCombine(seed, desc.topology);
+  VulkanTools::hashCombine(seed, desc.cullMode);
+  VulkanTools::hashCombine(seed, desc.frontFace);
+  VulkanTools::hashCombine(seed, desc.depthTest);
+  VulkanTools::hashCombine(seed, desc.depthWrite);
+  VulkanTools::hashCombine(seed, desc.depthCompare);
+  VulkanTools::hashCombine(seed, desc.blend);
+
+  for (uint32_t i = 0; i < desc.bindingCount; i++) {
+    VulkanTools::hashCombine(seed, desc.bindings[i].binding);
+    VulkanTools::hashCombine(seed, desc.bindings[i].stride);
+    VulkanTools::hashCombine(seed, desc.bindings[i].inputRate);
+  }
+  for (uint32_t i = 0; i < desc.attributeCount; i++) {
+    VulkanTools::hashCombine(seed, desc.attributes[i].location);
+    VulkanTools::hashCombine(seed, desc.attributes[i].binding);
+    VulkanTools::hashCombine(seed, desc.attributes[i].format);
+    VulkanTools::hashCombine(seed, desc.attributes[i].offset);
+  }
+
+  return seed;
+}
+
+PipelineConstants::PipelineConstants(uint32_t variant) {
+  uint32_t features = pipelineVariantFeatures(variant);
+  values[PIPELINE_CONSTANT_ALPHA_TEST] =
+      (features & PIPELINE_ALPHA_TEST) ? VK_TRUE : VK_FALSE;
+  values[PIPELINE_CONSTANT_SKINNING] =
+      (features & PIPELINE_SKINNING) ? VK_TRUE : VK_FALSE;
+  values[PIPELINE_CONSTANT_SAMPLES] = pipelineVariantSamples(variant);
+
+  for (uint32_t i = 0; i < PIPELINE_CONSTANT_COUNT; i++) {
+    entries[i].constantID = i;
+    entries[i].offset = i * sizeof(uint32_t);
+    entries[i].size = sizeof(uint32_t);
+  }
+
+  info.mapEntryCount = PIPELINE_CONSTANT_COUNT;
+  info.pMapEntries = entries;
+  info.dataSize = sizeof(values);
+  info.pData = values;
+}
+
+VulkanPipelines::VulkanPipelines()
+    : device(VK_NULL_HANDLE), resources(NULL), pipelineCache(NULL) {}
+
+void VulkanPipelines::init(VkDevice device, VulkanResources &resources,
+                           VulkanPipelineCache &pipelineCache) {
+  this->device = device;
+  this->resources = &resources;
+  this->pipelineCache = &pipelineCache;
+
+  resources.addModuleListener(
+      [this](VkShaderModule module) { releaseModule(module); });
+}
+
+void VulkanPipelines::destroy() {
+  std::unordered_map<GraphicsPipelineKey, VkPipeline,
+                     GraphicsPipelineKeyHash>::iterator it;
+  for (it = pipelines.begin(); it != pipelines.end(); ++it)
+    vkd.DestroyPipeline(device, it->second, vkAllocator);
+  pipelines.clear();
+}
+
+VkPipeline VulkanPipelines::pipeline(const GraphicsPipelineDesc &desc,
+                                     VkRenderPass renderPass,
+                                     uint32_t variant) {
+  GraphicsPipelineKey key;
+  key.desc = desc;
+  key.renderPass = renderPass;
+  key.variant = variant;
+
+  std::unordered_map<GraphicsPipelineKey, VkPipeline,
+                     GraphicsPipelineKeyHash>::iterator it =
+      pipelines.find(key);
+  if (it != pipelines.end()) return it->second;
+
+  VkPipeline pipeline = create(key);
+  pipelines[key] = pipeline;
+  return pipeline;
+}
+
+void VulkanPipelines::releaseModule(VkShaderModule module) {
+  std::unordered_map<GraphicsPipelineKey, VkPipeline,
+                     GraphicsPipelineKeyHash>::iterator it =
+      pipelines.begin();
+  while (it != pipelines.end()) {
+    if (it->first.desc.vertexShader == module ||
+        it->first.desc.fragmentShader == module) {
+      resources->retirePipeline(it->second);
+      it = pipelines.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+VkPipeline VulkanPipelines::create(const GraphicsPipelineKey &key) {
+  const GraphicsPipelineDesc &desc = key.desc;
+  PipelineConstants constants(key.variant);
+
+  VkPipelineShaderStageCreateInfo stages[2] = {};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].pNext = NULL;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = desc.vertexShader;
+  stages[0].pName = "main";
+  stages[0].pSpecializationInfo = &constants.info;
+  stages[1] = stages[0];
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = desc.fragmentShader;
+
+  VkPipelineVertexInputStateCreateInfo vertexInput = {};
+  vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInput.pNext = NULL;
+  vertexInput.vertexBindingDescriptionCount = desc.bindingCount;
+  vertexInput.pVertexBindingDescriptions = desc.bindings;
+  vertexInput.vertexAttributeDescriptionCount = desc.attributeCount;
+  vertexInput.pVertexAttributeDescriptions = desc.attributes;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+  inputAssembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.pNext = NULL;
+  inputAssembly.topology = desc.topology;
+
+  VkPipelineViewportStateCreateInfo viewportState = {};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.pNext = NULL;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterization = {};
+  rasterization.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterization.pNext = NULL;
+  rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterization.cullMode = desc.cullMode;
+  rasterization.frontFace = desc.frontFace;
+  rasterization.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisample = {};
+  multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample.pNext = NULL;
+  multisample.rasterizationSamples = pipelineVariantSamples(key.variant);
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+  depthStencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.pNext = NULL;
+  depthStencil.depthTestEnable = desc.depthTest;
+  depthStencil.depthWriteEnable = desc.depthWrite;
+  depthStencil.depthCompareOp = desc.depthCompare;
+
+  VkPipelineColorBlendAttachmentState blendAttachment = {};
+  blendAttachment.blendEnable = desc.blend;
+  blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  blendAttachment.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+  VkPipelineColorBlendStateCreateInfo colorBlend = {};
+  colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlend.pNext = NULL;
+  colorBlend.attachmentCount = 1;
+  colorBlend.pAttachments = &blendAttachment;
+
+  VkDynamicState dynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                     VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.pNext = NULL;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = NULL;
+  pipelineInfo.flags = 0;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = stages;
+  pipelineInfo.pVertexInputState = &vertexInput;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterization;
+  pipelineInfo.pMultisampleState = &multisample;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlend;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = desc.layout;
+  pipelineInfo.renderPass = key.renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline;
+  VkResult result =
+      vkd.CreateGraphicsPipelines(device, pipelineCache->cache, 1,
+                                  &pipelineInfo, vkAllocator, &pipeline);
+  assert(result == VK_SUCCESS);
+
+  return pipeline;
+}
@@ -0,0 +1,169 @@
+#ifndef VULKAN_PIPELINES_HPP
+#define VULKAN_PIPELINES_HPP
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <unordered_map>
+
+#include "VulkanPipelineCache.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define PIPELINE_MAX_VERTEX_BINDINGS 4
+#define PIPELINE_MAX_VERTEX_ATTRIBUTES 8
+
+// Specialization constant ids every variant sets, so a shader declares the
+// ones it branches on like
+//   layout(constant_id = 0) const bool ALPHA_TEST = false;
+// and the others cost it nothing.
+#define PIPELINE_CONSTANT_ALPHA_TEST 0
+#define PIPELINE_CONSTANT_SKINNING 1
+#define PIPELINE_CONSTANT_SAMPLES 2
+#define PIPELINE_CONSTANT_COUNT 3
+
+enum PipelineFeatureBits {
+  PIPELINE_ALPHA_TEST = 0x1,
+  PIPELINE_SKINNING = 0x2
+};
+
+#define PIPELINE_FEATURE_BITS 2
+#define PIPELINE_FEATURE_MASK ((1u << PIPELINE_FEATURE_BITS) - 1)
+
+// A variant id packs the feature bits with log2 of the sample count above
+// them, so it is a small integer known at compile time.
+constexpr uint32_t pipelineSampleShift(uint32_t samples) {
+  return samples <= 1 ? 0 : 1 + pipelineSampleShift(samples >> 1);
+}
+
+constexpr uint32_t pipelineVariantId(uint32_t features,
+                                     VkSampleCountFlagBits samples) {
+  return (features & PIPELINE_FEATURE_MASK) |
+         pipelineSampleShift(samples) << PIPELINE_FEATURE_BITS;
+}
+
+constexpr uint32_t pipelineVariantFeatures(uint32_t variant) {
+  return variant & PIPELINE_FEATURE_MASK;
+}
+
+constexpr VkSampleCountFlagBits pipelineVariantSamples(uint32_t variant) {
+  return (VkSampleCountFlagBits)(1u << (variant >> PIPELINE_FEATURE_BITS));
+}
+
+// One pipeline variant as template parameters, for code that knows which
+// variant it draws with when it is compiled. Tables of them stay constexpr:
+//   static constexpr uint32_t variants[] = {
+//       PipelineVariant<0>::id(), PipelineVariant<PIPELINE_ALPHA_TEST>::id()};
+template <uint32_t Features,
+          VkSampleCountFlagBits Samples = VK_SAMPLE_COUNT_1_BIT>
+struct PipelineVariant {
+  static_assert((Features & ~PIPELINE_FEATURE_MASK) == 0,
+                "Unknown pipeline feature");
+  static_assert(Samples >= 1 && Samples <= 64 &&
+                    (Samples & (Samples - 1)) == 0,
+                "Sample count is a power of two up to 64");
+
+  static constexpr uint32_t id() {
+    return pipelineVariantId(Features, Samples);
+  }
+  static constexpr bool alphaTest() {
+    return (Features & PIPELINE_ALPHA_TEST) != 0;
+  }
+  static constexpr bool skinning() {
+    return (Features & PIPELINE_SKINNING) != 0;
+  }
+  static constexpr VkSampleCountFlagBits samples() { return Samples; }
+};
+
+// The state that differs between pipelines built from the same shaders,
+// fixed-size so it can be hashed and compared as a cache key. Viewport and
+// scissor are always dynamic.
+struct GraphicsPipelineDesc {
+  VkShaderModule vertexShader;
+  VkShaderModule fragmentShader;
+  VkPipelineLayout layout;
+  uint32_t bindingCount;
+  VkVertexInputBindingDescription bindings[PIPELINE_MAX_VERTEX_BINDINGS];
+  uint32_t attributeCount;
+  VkVertexInputAttributeDescription
+      attributes[PIPELINE_MAX_VERTEX_ATTRIBUTES];
+  VkPrimitiveTopology topology;
+  VkCullModeFlags cullMode;
+  VkFrontFace frontFace;
+  VkBool32 depthTest;
+  VkBool32 depthWrite;
+  VkCompareOp depthCompare;
+  VkBool32 blend;
+
+  GraphicsPipelineDesc();
+  GraphicsPipelineDesc &addBinding(
+      const VkVertexInputBindingDescription &binding);
+  GraphicsPipelineDesc &addAttribute(
+      const VkVertexInputAttributeDescription &attribute);
+
+  bool operator==(const GraphicsPipelineDesc &other) const;
+};
+
+struct GraphicsPipelineKey {
+  GraphicsPipelineDesc desc;
+  VkRenderPass renderPass;
+  uint32_t variant;
+
+  bool operator==(const GraphicsPipelineKey &other) const;
+};
+
+struct GraphicsPipelineKeyHash {
+  size_t operator()(const GraphicsPipelineKey &key) const;
+};
+
+// The specialization info for one variant. It points into itself, so it
+// stays where it was made.
+struct PipelineConstants {
+  uint32_t values[PIPELINE_CONSTANT_COUNT];
+  VkSpecializationMapEntry entries[PIPELINE_CONSTANT_COUNT];
+  VkSpecializationInfo info;
+
+  explicit PipelineConstants(uint32_t variant);
+
+ private:
+  PipelineConstants(const PipelineConstants &);
+  PipelineConstants &operator=(const PipelineConstants &);
+};
+
+// Graphics pipelines by description, render pass and variant. Features
+// that would otherwise be branches in an uber-shader, like alpha test and
+// skinning, reach the shaders as specialization constants, so the driver
+// folds them away, and the sample count sets both the rasterization
+// samples and a constant of its own. Each variant is only built the first
+// time it is asked for, through the shared pipeline cache. Pipelines made
+// from a shader module are retired with it, so a hot-reloaded shader is
+// rebuilt rather than matched to a stale handle.
+class VulkanPipelines {
+ public:
+  VulkanPipelines();
+  void init(VkDevice device, VulkanResources &resources,
+            VulkanPipelineCache &pipelineCache);
+  void destroy();
+
+  VkPipeline pipeline(const GraphicsPipelineDesc &desc,
+                      VkRenderPass renderPass, uint32_t variant);
+  template <typename Variant>
+  VkPipeline pipeline(const GraphicsPipelineDesc &desc,
+                      VkRenderPass renderPass) {
+    return pipeline(desc, renderPass, Variant::id());
+  }
+
+  void releaseModule(VkShaderModule module);
+  uint32_t pipelineCount() const { return pipelines.size(); }
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  VulkanPipelineCache *pipelineCache;
+  std::unordered_map<GraphicsPipelineKey, VkPipeline, GraphicsPipelineKeyHash>
+      pipelines;
+
+  VkPipeline create(const GraphicsPipelineKey &key);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "VulkanProfiler.hpp"
+
+VulkanProfiler::VulkanProfiler()
+    : reportFrames(PROFILER_REPORT_FRAMES),
+      device(VK_NULL_HANDLE),
+      queryPool(VK_NULL_HANDLE),
+      timestampPeriod(1.0),
+      timestampMask(0),
+      maxScopes(0),
+      currentFrame(0),
+      framesSinceReport(0) {}
+
+void VulkanProfiler::init(VkPhysicalDevice physicalDevice, VkDevice device,
+                          const VkPhysicalDeviceProperties &properties,
+                          uint32_t queueFamily, uint32_t framesInFlight,
+                          uint32_t maxScopes) {
+  this->device = device;
+  this->maxScopes = maxScopes;
+  timestampPeriod = properties.limits.timestampPeriod;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           families.data());
+
+  uint32_t validBits =
+      queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+  if (validBits == 0) {
+    fprintf(stdout, "GPU Profiler:   timestamps not supported\n");
+    return;
+  }
+
+  timestampMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+
+  VkQueryPoolCreateInfo queryInfo = {};
+  queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryInfo.pNext = NULL;
+  queryInfo.flags = 0;
+  queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryInfo.queryCount = framesInFlight * maxScopes * 2;
+  queryInfo.pipelineStatistics = 0;
+
+  VkResult result =
+      vkd.CreateQueryPool(device, &queryInfo, vkAllocator, &queryPool);
+  assert(result == VK_SUCCESS);
+
+  scopeNames.resize(framesInFlight);
+  timestamps.resize(maxScopes * 2);
+}
+
+void VulkanProfiler::destroy() {
+  if (queryPool == VK_NULL_HANDLE) return;
+
+  vkd.DestroyQueryPool(device, queryPool, vkAllocator);
+  queryPool = VK_NULL_HANDLE;
+  scopeNames.clear();
+}
+
+void VulkanProfiler::beginFrame(VkCommandBuffer cmdBuffer, uint32_t frame) {
+  if (!enabled()) return;
+
+  currentFrame = frame;
+  collect(frame);
+
+  scopeNames[frame].clear();
+  vkd.CmdResetQueryPool(cmdBuffer, queryPool, firstQuery(frame), maxScopes * 2);
+
+  if (reportFrames != 0 && ++framesSinceReport >= reportFrames) {
+    print();
+    reset();
+    framesSinceReport = 0;
+  }
+}
+
+void VulkanProfiler::collect(uint32_t frame) {
+  std::vector<const char *> &names = scopeNames[frame];
+  uint32_t queryCount = names.size() * 2;
+  if (queryCount == 0) return;
+
+  // The frame's fence has already been waited on, so the results are
+  // available and no wait is requested here.
+  VkResult result = vkd.GetQueryPoolResults(
+      device, queryPool, firstQuery(frame), queryCount,
+      queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) return;
+
+  for (uint32_t i = 0; i < names.size(); i++) {
+    uint64_t ticks =
+        (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+    double ms = ticks * timestampPeriod / 1000000.0;
+
+    std::map<std::string, ProfileStats>::iterator it = stats.find(names[i]);
+    if (it == stats.end()) {
+      ProfileStats entry = {ms, ms, ms, 1, ms};
+      stats[names[i]] = entry;
+      continue;
+    }
+
+    ProfileStats &entry = it->second;
+    if (ms < entry.minMs) entry.minMs = ms;
+    if (ms > entry.maxMs) entry.maxMs = ms;
+    entry.totalMs += ms;
+    entry.count++;
+    entry.lastMs = ms;
+  }
+}
+
+uint32_t VulkanProfiler::begin(VkCommandBuffer cmdBuffer, const char *name) {
+  if (!enabled()) return UINT32_MAX;
+
+  std::vector<const char *> &names = scopeNames[currentFrame];
+  if (names.size() >= maxScopes) return UINT32_MAX;
+
+  uint32_t scope = names.size();
+  names.push_back(name);
+  vkd.CmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool,
+                        firstQuery(currentFrame) + scope * 2);
+
+  return scope;
+}
+
+void VulkanProfiler::end(VkCommandBuffer cmdBuffer, uint32_t scope) {
+  if (scope == UINT32_MAX) return;
+
+  vkd.CmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool, firstQuery(currentFrame) + scope * 2 + 1);
+}
+
+double VulkanProfiler::averageMs(const char *name) const {
+  std::map<std::string, ProfileStats>::const_iterator it = stats.find(name);
+  if (it == stats.end() || it->second.count == 0) return 0.0;
+
+  return it->second.totalMs / it->second.count;
+}
+
+double VulkanProfiler::latestMs(const char *name) const {
+  std::map<std::string, ProfileStats>::const_iterator it = stats.find(name);
+  return it == stats.end() ? 0.0 : it->second.lastMs;
+}
+
+void VulkanProfiler::print() {
+  if (stats.empty()) return;
+
+  fprintf(stdout, "GPU Profile (ms)       min      avg      max\n");
+
+  std::map<std::string, ProfileStats>::iterator it;
+  for (it = stats.begin(); it != stats.end(); ++it) {
+    const ProfileStats &entry = it->second;
+    fprintf(stdout, "  %-16s %8.3f %8.3f %8.3f\n", it->first.c_str(),
+            entry.minMs, entry.totalMs / entry.count, entry.maxMs);
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef VULKAN_PROFILER_HPP
+#define VULKAN_PROFILER_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "VulkanTools.hpp"
+
+#define PROFILER_MAX_SCOPES 64
+#define PROFILER_REPORT_FRAMES 300
+
+struct ProfileStats {
+  double minMs;
+  double maxMs;
+  double totalMs;
+  uint32_t count;
+  double lastMs;
+};
+
+class VulkanProfiler {
+ public:
+  VulkanProfiler();
+  void init(VkPhysicalDevice physicalDevice, VkDevice device,
+            const VkPhysicalDeviceProperties &properties, uint32_t queueFamily,
+            uint32_t framesInFlight, uint32_t maxScopes = PROFILER_MAX_SCOPES);
+  void destroy();
+
+  void beginFrame(VkCommandBuffer cmdBuffer, uint32_t frame);
+  uint32_t begin(VkCommandBuffer cmdBuffer, const char *name);
+  void end(VkCommandBuffer cmdBuffer, uint32_t scope);
+
+  void print();
+  void reset() { stats.clear(); }
+  double averageMs(const char *name) const;
+  double latestMs(const char *name) const;
+  bool enabled() const { return queryPool != VK_NULL_HANDLE; }
+
+  std::map<std::string, ProfileStats> stats;
+  uint32_t reportFrames;
+
+ private:
+  VkDevice device;
+  VkQueryPool queryPool;
+  double timestampPeriod;
+  uint64_t timestampMask;
+  uint32_t maxScopes;
+  uint32_t currentFrame;
+  uint32_t framesSinceReport;
+  std::vector<std::vector<const char *> > scopeNames;
+  std::vector<uint64_t> timestamps;
+
+  uint32_t firstQuery(uint32_t frame) const { return frame * maxScopes * 2; }
+  void collect(uint32_t frame);
+};
+
+class ProfileScope {
+ public:
+  ProfileScope(VulkanProfiler &profiler, VkCommandBuffer cmdBuffer,
+               const char *name)
+      : profiler(profiler), cmdBuffer(cmdBuffer) {
+    scope = profiler.begin(cmdBuffer, name);
+  }
+  ~ProfileScope() { profiler.end(cmdBuffer, scope); }
+
+ private:
+  VulkanProfiler &profiler;
+  VkCommandBuffer cmdBuffer;
+  uint32_t scope;
+};
+
+#endif
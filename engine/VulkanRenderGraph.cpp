@@ -0,0 +1,748 @@
+#include "VulkanRenderGraph.hpp"
+
+static const VkAccessFlags writeAccessMask =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+    VK_ACCESS_MEMORY_WRITE_BIT;
+
+static const VkPipelineStageFlags depthStages =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+GraphUse graphUse(VkImageLayout layout, VkPipelineStageFlags stages,
+                  VkAccessFlags access) {
+  GraphUse use;
+  use.layout = layout;
+  use.stages = stages;
+  use.access = access;
+  return use;
+}
+
+static VkImageUsageFlags usageFor(const GraphUse &use) {
+  switch (use.layout) {
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    case VK_IMAGE_LAYOUT_GENERAL:
+      return VK_IMAGE_USAGE_STORAGE_BIT;
+    default:
+      break;
+  }
+
+  VkImageUsageFlags usage = 0;
+  if (use.access & VK_ACCESS_INPUT_ATTACHMENT_READ_BIT)
+    usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  if (use.access & VK_ACCESS_SHADER_READ_BIT)
+    usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (use.access & VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT)
+    usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  return usage;
+}
+
+static bool overlaps(const GraphMemorySlot &slot, uint32_t first,
+                     uint32_t last) {
+  for (uint32_t i = 0; i < slot.firstPasses.size(); i++)
+    if (first <= slot.lastPasses[i] && slot.firstPasses[i] <= last)
+      return true;
+  return false;
+}
+
+RenderGraphPass::RenderGraphPass(const char *name) { reset(name); }
+
+void RenderGraphPass::reset(const char *name) {
+  this->name = name;
+  accesses.clear();
+  colors.clear();
+  depthStencil = GraphAttachment();
+  depthStencil.resource = GRAPH_INVALID;
+  contents = VK_SUBPASS_CONTENTS_INLINE;
+  sideEffects = false;
+  live = false;
+  callback = GraphCallback();
+}
+
+RenderGraphPass &RenderGraphPass::color(uint32_t resource,
+                                        VkAttachmentLoadOp loadOp,
+                                        const VkClearValue &clear) {
+  assert(colors.size() < RENDER_PASS_MAX_COLOR_ATTACHMENTS);
+
+  GraphAttachment attachment = {};
+  attachment.resource = resource;
+  attachment.loadOp = loadOp;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.clear = clear;
+  colors.push_back(attachment);
+
+  return write(resource,
+               graphUse(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT));
+}
+
+RenderGraphPass &RenderGraphPass::depth(uint32_t resource,
+                                        VkAttachmentLoadOp loadOp,
+                                        const VkClearValue &clear) {
+  depthStencil.resource = resource;
+  depthStencil.loadOp = loadOp;
+  depthStencil.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthStencil.clear = clear;
+
+  return write(resource,
+               graphUse(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        depthStages,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT));
+}
+
+RenderGraphPass &RenderGraphPass::sampled(uint32_t resource,
+                                          VkPipelineStageFlags stages,
+                                          VkImageLayout layout) {
+  return read(resource, graphUse(layout, stages, VK_ACCESS_SHADER_READ_BIT));
+}
+
+RenderGraphPass &RenderGraphPass::storage(uint32_t resource,
+                                          VkPipelineStageFlags stages,
+                                          bool write) {
+  if (!write)
+    return read(resource, graphUse(VK_IMAGE_LAYOUT_GENERAL, stages,
+                                   VK_ACCESS_SHADER_READ_BIT));
+
+  return this->write(
+      resource,
+      graphUse(VK_IMAGE_LAYOUT_GENERAL, stages,
+               VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT));
+}
+
+RenderGraphPass &RenderGraphPass::transferSrc(uint32_t resource) {
+  return read(resource, graphUse(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_ACCESS_TRANSFER_READ_BIT));
+}
+
+RenderGraphPass &RenderGraphPass::transferDst(uint32_t resource) {
+  return write(resource, graphUse(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_ACCESS_TRANSFER_WRITE_BIT));
+}
+
+RenderGraphPass &RenderGraphPass::read(uint32_t resource, const GraphUse &use) {
+  GraphAccess access = {resource, use, false};
+  accesses.push_back(access);
+  return *this;
+}
+
+RenderGraphPass &RenderGraphPass::write(uint32_t resource,
+                                        const GraphUse &use) {
+  GraphAccess access = {resource, use, true};
+  accesses.push_back(access);
+  return *this;
+}
+
+RenderGraphPass &RenderGraphPass::secondary() {
+  contents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+  return *this;
+}
+
+RenderGraphPass &RenderGraphPass::sideEffect() {
+  sideEffects = true;
+  return *this;
+}
+
+RenderGraphPass &RenderGraphPass::execute(const GraphCallback &callback) {
+  this->callback = callback;
+  return *this;
+}
+
+VulkanRenderGraph::VulkanRenderGraph()
+    : device(VK_NULL_HANDLE),
+      memory(NULL),
+      resources(NULL),
+      renderPasses(NULL),
+      passCount(0),
+      livePasses(0),
+      barriers(0),
+      physicalKey(0),
+      requestedBytes(0),
+      aliasedBytes(0),
+      splitDevices(1) {}
+
+void VulkanRenderGraph::init(VkDevice device, VulkanMemory &memory,
+                             VulkanResources &resources,
+                             VulkanRenderPassCache &renderPasses) {
+  this->device = device;
+  this->memory = &memory;
+  this->resources = &resources;
+  this->renderPasses = &renderPasses;
+}
+
+void VulkanRenderGraph::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  reset();
+  passes.clear();
+  releaseTransients();
+  device = VK_NULL_HANDLE;
+}
+
+void VulkanRenderGraph::setDeviceSplit(uint32_t deviceCount) {
+  splitDevices = std::max(deviceCount, 1u);
+}
+
+void VulkanRenderGraph::reset() {
+  passCount = 0;
+  graphResources.clear();
+  livePasses = 0;
+}
+
+uint32_t VulkanRenderGraph::importImage(const char *name, VkImage image,
+                                        VkImageView view,
+                                        const GraphImageDesc &desc,
+                                        const GraphUse &before,
+                                        const GraphUse &after) {
+  GraphResource resource = {};
+  resource.name = name;
+  resource.transient = false;
+  resource.image = image;
+  resource.view = view;
+  resource.buffer = VK_NULL_HANDLE;
+  resource.desc = desc;
+  resource.before = before;
+  resource.after = after;
+  graphResources.push_back(resource);
+  return graphResources.size() - 1;
+}
+
+uint32_t VulkanRenderGraph::importBuffer(const char *name, VkBuffer buffer,
+                                         VkDeviceSize size,
+                                         const GraphUse &before,
+                                         const GraphUse &after) {
+  GraphResource resource = {};
+  resource.name = name;
+  resource.transient = false;
+  resource.image = VK_NULL_HANDLE;
+  resource.view = VK_NULL_HANDLE;
+  resource.buffer = buffer;
+  resource.size = size;
+  resource.before = before;
+  resource.after = after;
+  graphResources.push_back(resource);
+  return graphResources.size() - 1;
+}
+
+uint32_t VulkanRenderGraph::createImage(const char *name,
+                                        const GraphImageDesc &desc) {
+  GraphResource resource = {};
+  resource.name = name;
+  resource.transient = true;
+  resource.image = VK_NULL_HANDLE;
+  resource.view = VK_NULL_HANDLE;
+  resource.buffer = VK_NULL_HANDLE;
+  resource.desc = desc;
+  resource.before = graphUse();
+  resource.after = graphUse();
+  graphResources.push_back(resource);
+  return graphResources.size() - 1;
+}
+
+RenderGraphPass &VulkanRenderGraph::addPass(const char *name) {
+  // Passes outlive reset(), so their lists keep what they grew to.
+  if (passCount == passes.size()) passes.push_back(RenderGraphPass(name));
+
+  RenderGraphPass &pass = passes[passCount++];
+  pass.reset(name);
+  return pass;
+}
+
+VkImage VulkanRenderGraph::image(uint32_t resource) const {
+  return graphResources[resource].image;
+}
+
+VkImageView VulkanRenderGraph::view(uint32_t resource) const {
+  return graphResources[resource].view;
+}
+
+VkBuffer VulkanRenderGraph::buffer(uint32_t resource) const {
+  return graphResources[resource].buffer;
+}
+
+bool VulkanRenderGraph::exported(const GraphResource &resource) const {
+  return !resource.transient && (resource.after.stages != 0 ||
+                                 resource.after.layout !=
+                                     VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+void VulkanRenderGraph::cull() {
+  // Walking back from the exported resources, a pass is kept when it has
+  // side effects or writes something a kept pass after it still needs.
+  // Attachments that aren't loaded overwrite everything before them.
+  needed.assign(graphResources.size(), false);
+  for (uint32_t i = 0; i < graphResources.size(); i++)
+    needed[i] = exported(graphResources[i]);
+
+  livePasses = 0;
+  for (uint32_t i = passCount; i-- > 0;) {
+    RenderGraphPass &pass = passes[i];
+
+    pass.live = pass.sideEffects;
+    for (uint32_t j = 0; j < pass.accesses.size() && !pass.live; j++)
+      pass.live = pass.accesses[j].write && needed[pass.accesses[j].resource];
+    if (!pass.live) continue;
+
+    livePasses++;
+    for (uint32_t j = 0; j < pass.colors.size(); j++)
+      if (pass.colors[j].loadOp != VK_ATTACHMENT_LOAD_OP_LOAD)
+        needed[pass.colors[j].resource] = false;
+    if (pass.depthStencil.resource != GRAPH_INVALID &&
+        pass.depthStencil.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD)
+      needed[pass.depthStencil.resource] = false;
+
+    for (uint32_t j = 0; j < pass.accesses.size(); j++)
+      if (!pass.accesses[j].write) needed[pass.accesses[j].resource] = true;
+    for (uint32_t j = 0; j < pass.colors.size(); j++)
+      if (pass.colors[j].loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+        needed[pass.colors[j].resource] = true;
+    if (pass.depthStencil.resource != GRAPH_INVALID &&
+        pass.depthStencil.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+      needed[pass.depthStencil.resource] = true;
+  }
+}
+
+void VulkanRenderGraph::compile() {
+  cull();
+
+  for (uint32_t i = 0; i < graphResources.size(); i++) {
+    GraphResource &resource = graphResources[i];
+    resource.firstPass = GRAPH_INVALID;
+    resource.lastPass = GRAPH_INVALID;
+    resource.usage = 0;
+    resource.physical = GRAPH_INVALID;
+  }
+
+  for (uint32_t i = 0; i < passCount; i++) {
+    if (!passes[i].live) continue;
+
+    for (uint32_t j = 0; j < passes[i].accesses.size(); j++) {
+      const GraphAccess &access = passes[i].accesses[j];
+      GraphResource &resource = graphResources[access.resource];
+      if (resource.firstPass == GRAPH_INVALID) resource.firstPass = i;
+      resource.lastPass = i;
+      resource.usage |= usageFor(access.use);
+    }
+  }
+
+  // Attachments nothing reads afterwards aren't stored, and ones with no
+  // contents yet aren't loaded.
+  for (uint32_t i = 0; i < passCount; i++) {
+    RenderGraphPass &pass = passes[i];
+    if (!pass.live) continue;
+
+    uint32_t count = pass.colors.size();
+    for (uint32_t j = 0; j <= count; j++) {
+      GraphAttachment &attachment =
+          j < count ? pass.colors[j] : pass.depthStencil;
+      if (attachment.resource == GRAPH_INVALID) continue;
+
+      const GraphResource &resource = graphResources[attachment.resource];
+      bool empty = resource.firstPass == i &&
+                   (resource.transient ||
+                    resource.before.layout == VK_IMAGE_LAYOUT_UNDEFINED);
+      if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD && empty)
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.storeOp = exported(resource) || resource.lastPass > i
+                               ? VK_ATTACHMENT_STORE_OP_STORE
+                               : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+  }
+
+  allocateTransients();
+}
+
+void VulkanRenderGraph::allocateTransients() {
+  transients.clear();
+  size_t key = 0;
+  for (uint32_t i = 0; i < graphResources.size(); i++) {
+    const GraphResource &resource = graphResources[i];
+    if (!resource.transient || resource.firstPass == GRAPH_INVALID) continue;
+
+    transients.push_back(i);
+    VulkanTools::hashCombine(
+        key, VulkanTools::hashBytes(&resource.desc, sizeof(resource.desc)));
+    VulkanTools::hashCombine(key, resource.usage);
+    VulkanTools::hashCombine(key, resource.firstPass);
+    VulkanTools::hashCombine(key, resource.lastPass);
+  }
+
+  if (key != physicalKey || transients.size() != physicalImages.size()) {
+    releaseTransients();
+    physicalKey = key;
+
+    for (uint32_t i = 0; i < transients.size(); i++) {
+      const GraphResource &resource = graphResources[transients[i]];
+
+      VkImageCreateInfo imageInfo = {};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.pNext = NULL;
+      imageInfo.flags = 0;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.format = resource.desc.format;
+      imageInfo.extent.width = resource.desc.width;
+      imageInfo.extent.height = resource.desc.height;
+      imageInfo.extent.depth = 1;
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.samples = resource.desc.samples;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.usage = resource.usage;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      imageInfo.queueFamilyIndexCount = 0;
+      imageInfo.pQueueFamilyIndices = NULL;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+      GraphPhysicalImage physical = {};
+      VkResult result =
+          vkd.CreateImage(device, &imageInfo, vkAllocator, &physical.image);
+      assert(result == VK_SUCCESS);
+
+      vkd.GetImageMemoryRequirements(device, physical.image,
+                                     &physical.requirements);
+      physical.slot = GRAPH_INVALID;
+      physicalImages.push_back(physical);
+    }
+
+    // Largest first, each image goes into the first slot whose memory
+    // types suit it and whose occupants are all dead before it starts or
+    // born after it ends.
+    std::vector<uint32_t> order(transients.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+      return physicalImages[a].requirements.size >
+             physicalImages[b].requirements.size;
+    });
+
+    requestedBytes = 0;
+    for (uint32_t i = 0; i < order.size(); i++) {
+      GraphPhysicalImage &physical = physicalImages[order[i]];
+      const GraphResource &resource = graphResources[transients[order[i]]];
+      const VkMemoryRequirements &requirements = physical.requirements;
+      requestedBytes += requirements.size;
+
+      for (uint32_t j = 0; j < slots.size(); j++) {
+        GraphMemorySlot &slot = slots[j];
+        if ((slot.requirements.memoryTypeBits &
+             requirements.memoryTypeBits) == 0 ||
+            overlaps(slot, resource.firstPass, resource.lastPass))
+          continue;
+
+        slot.requirements.size =
+            std::max(slot.requirements.size, requirements.size);
+        slot.requirements.alignment =
+            std::max(slot.requirements.alignment, requirements.alignment);
+        slot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+        physical.slot = j;
+        break;
+      }
+
+      if (physical.slot == GRAPH_INVALID) {
+        GraphMemorySlot slot = {};
+        slot.requirements = requirements;
+        slot.category = (resource.desc.aspects & VK_IMAGE_ASPECT_DEPTH_BIT)
+                            ? MEMORY_DEPTH
+                            : MEMORY_OTHER;
+        physical.slot = slots.size();
+        slots.push_back(slot);
+      }
+
+      slots[physical.slot].firstPasses.push_back(resource.firstPass);
+      slots[physical.slot].lastPasses.push_back(resource.lastPass);
+    }
+
+    aliasedBytes = 0;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+      slots[i].allocation =
+          memory->allocate(slots[i].requirements,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                           RESOURCE_OPTIMAL, ALLOCATION_FREE_LIST,
+                           slots[i].category);
+      aliasedBytes += slots[i].requirements.size;
+    }
+
+    for (uint32_t i = 0; i < physicalImages.size(); i++) {
+      GraphPhysicalImage &physical = physicalImages[i];
+      const GraphResource &resource = graphResources[transients[i]];
+      const MemoryAllocation &allocation = slots[physical.slot].allocation;
+
+      VkResult result = vkd.BindImageMemory(device, physical.image,
+                                            allocation.memory,
+                                            allocation.offset);
+      assert(result == VK_SUCCESS);
+
+      VkImageViewCreateInfo viewInfo = {};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.pNext = NULL;
+      viewInfo.flags = 0;
+      viewInfo.image = physical.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = resource.desc.format;
+      viewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+                             VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+      viewInfo.subresourceRange =
+          VulkanTools::subresourceRange(resource.desc.aspects);
+
+      result =
+          vkd.CreateImageView(device, &viewInfo, vkAllocator, &physical.view);
+      assert(result == VK_SUCCESS);
+    }
+
+    if (!transients.empty())
+      fprintf(stdout, "Render graph:   %u transients, %.1f MB in %.1f MB\n",
+              (uint32_t)transients.size(), requestedBytes / (1024.0 * 1024.0),
+              aliasedBytes / (1024.0 * 1024.0));
+  }
+
+  for (uint32_t i = 0; i < transients.size(); i++) {
+    GraphResource &resource = graphResources[transients[i]];
+    resource.physical = i;
+    resource.image = physicalImages[i].image;
+    resource.view = physicalImages[i].view;
+  }
+}
+
+void VulkanRenderGraph::releaseTransients() {
+  for (uint32_t i = 0; i < physicalImages.size(); i++) {
+    resources->retireImageView(physicalImages[i].view);
+    resources->retireImage(physicalImages[i].image);
+  }
+  for (uint32_t i = 0; i < slots.size(); i++)
+    resources->retireMemory(slots[i].allocation);
+
+  physicalImages.clear();
+  slots.clear();
+  physicalKey = 0;
+  requestedBytes = 0;
+  aliasedBytes = 0;
+}
+
+void VulkanRenderGraph::transition(VulkanTools::BarrierBatch &batch,
+                                   GraphResource &resource,
+                                   const GraphUse &use, bool write) {
+  GraphState &state = resource.state;
+  bool layoutChange =
+      resource.buffer == VK_NULL_HANDLE && state.layout != use.layout;
+  VkPipelineStageFlags srcStages = 0;
+  VkAccessFlags srcAccess = 0;
+
+  // Reads only wait when there is a write they can't see yet. Writes and
+  // layout transitions wait for everything since the last write as well.
+  if (write || layoutChange) {
+    srcStages = state.writeStages | state.readStages;
+    srcAccess = state.writeAccess;
+  } else if (state.writeStages != 0 && use.access != 0 &&
+             ((use.stages & ~state.visibleStages) != 0 ||
+              (use.access & ~state.visibleAccess) != 0)) {
+    srcStages = state.writeStages;
+    srcAccess = state.writeAccess;
+  }
+
+  if (srcStages != 0 || layoutChange) {
+    if (srcStages == 0) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStages =
+        use.stages != 0 ? use.stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    if (resource.buffer != VK_NULL_HANDLE)
+      batch.buffer(resource.buffer, srcStages, srcAccess, dstStages,
+                   use.access);
+    else
+      batch.image(resource.image, state.layout, use.layout,
+                  VulkanTools::subresourceRange(resource.desc.aspects),
+                  srcStages, srcAccess, dstStages, use.access);
+    barriers++;
+  }
+
+  if (write) {
+    state.writeStages = use.stages;
+    state.writeAccess = use.access & writeAccessMask;
+    state.readStages = 0;
+    state.visibleStages = 0;
+    state.visibleAccess = 0;
+  } else if (layoutChange) {
+    // Later reads chain through the stages that waited on the transition.
+    state.writeStages = use.stages;
+    state.writeAccess = 0;
+    state.readStages = use.stages;
+    state.visibleStages = use.stages;
+    state.visibleAccess = use.access;
+  } else {
+    if (srcStages != 0) {
+      state.visibleStages |= use.stages;
+      state.visibleAccess |= use.access;
+    }
+    state.readStages |= use.stages;
+  }
+
+  if (resource.buffer == VK_NULL_HANDLE) state.layout = use.layout;
+}
+
+void VulkanRenderGraph::beginRenderPass(VkCommandBuffer cmdBuffer,
+                                        const RenderGraphPass &pass,
+                                        GraphPassContext &context) {
+  const VkImageLayout colorLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  const VkImageLayout depthLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  // The graph's barriers already put every attachment in its layout, so
+  // the render pass starts and ends there.
+  RenderPassKey key;
+  VkClearValue clearValues[FRAMEBUFFER_MAX_ATTACHMENTS];
+  uint32_t width = UINT32_MAX;
+  uint32_t height = UINT32_MAX;
+
+  for (uint32_t i = 0; i < pass.colors.size(); i++) {
+    const GraphAttachment &attachment = pass.colors[i];
+    const GraphResource &resource = graphResources[attachment.resource];
+    key.addColor(resource.desc.format, attachment.loadOp, attachment.storeOp,
+                 colorLayout, resource.desc.samples, colorLayout);
+    clearValues[i] = attachment.clear;
+    width = std::min(width, resource.desc.width);
+    height = std::min(height, resource.desc.height);
+  }
+
+  const GraphAttachment &depth = pass.depthStencil;
+  if (depth.resource != GRAPH_INVALID) {
+    const GraphResource &resource = graphResources[depth.resource];
+    key.setDepth(resource.desc.format, depth.loadOp, depth.storeOp,
+                 depthLayout, resource.desc.samples, depthLayout);
+    clearValues[pass.colors.size()] = depth.clear;
+    width = std::min(width, resource.desc.width);
+    height = std::min(height, resource.desc.height);
+  }
+
+  context.renderPass = renderPasses->renderPass(key);
+  context.extent.width = width;
+  context.extent.height = height;
+
+  FramebufferKey framebufferKey(context.renderPass, width, height);
+  for (uint32_t i = 0; i < pass.colors.size(); i++)
+    framebufferKey.addView(graphResources[pass.colors[i].resource].view);
+  if (depth.resource != GRAPH_INVALID)
+    framebufferKey.addView(graphResources[depth.resource].view);
+  context.framebuffer = renderPasses->framebuffer(framebufferKey);
+
+  VkRenderPassBeginInfo passInfo = {};
+  passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  passInfo.pNext = NULL;
+  passInfo.renderPass = context.renderPass;
+  passInfo.framebuffer = context.framebuffer;
+  passInfo.renderArea.offset.x = 0;
+  passInfo.renderArea.offset.y = 0;
+  passInfo.renderArea.extent = context.extent;
+  passInfo.clearValueCount = framebufferKey.attachmentCount;
+  passInfo.pClearValues = clearValues;
+
+  VkDeviceGroupRenderPassBeginInfo groupInfo = {};
+  if (splitDevices > 1) {
+    deviceAreas.resize(splitDevices);
+    for (uint32_t i = 0; i < splitDevices; i++) {
+      uint32_t top = height * i / splitDevices;
+      deviceAreas[i].offset.x = 0;
+      deviceAreas[i].offset.y = top;
+      deviceAreas[i].extent.width = width;
+      deviceAreas[i].extent.height = height * (i + 1) / splitDevices - top;
+    }
+
+    groupInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO;
+    groupInfo.pNext = NULL;
+    groupInfo.deviceMask = (1u << splitDevices) - 1;
+    groupInfo.deviceRenderAreaCount = splitDevices;
+    groupInfo.pDeviceRenderAreas = deviceAreas.data();
+    passInfo.pNext = &groupInfo;
+
+    context.deviceAreaCount = splitDevices;
+    context.deviceAreas = deviceAreas.data();
+  }
+
+  vkd.CmdBeginRenderPass(cmdBuffer, &passInfo, pass.contents);
+}
+
+void VulkanRenderGraph::execute(VkCommandBuffer cmdBuffer,
+                                VulkanProfiler *profiler) {
+  barriers = 0;
+
+  for (uint32_t i = 0; i < graphResources.size(); i++) {
+    GraphResource &resource = graphResources[i];
+    GraphState &state = resource.state;
+    state.layout = resource.before.layout;
+    state.writeStages = resource.before.stages;
+    state.writeAccess = resource.before.access & writeAccessMask;
+    state.readStages = 0;
+    state.visibleStages = 0;
+    state.visibleAccess = 0;
+  }
+
+  VulkanTools::BarrierBatch batch;
+  for (uint32_t i = 0; i < passCount; i++) {
+    RenderGraphPass &pass = passes[i];
+    if (!pass.live) continue;
+
+    // A transient picks up after whatever last used its memory, which may
+    // be another image this frame or its own last use in the previous one.
+    for (uint32_t j = 0; j < pass.accesses.size(); j++) {
+      GraphResource &resource = graphResources[pass.accesses[j].resource];
+      if (resource.physical == GRAPH_INVALID || resource.firstPass != i)
+        continue;
+
+      const GraphMemorySlot &slot =
+          slots[physicalImages[resource.physical].slot];
+      resource.state.writeStages = slot.lastStages;
+      resource.state.writeAccess = slot.lastAccess;
+    }
+
+    for (uint32_t j = 0; j < pass.accesses.size(); j++) {
+      const GraphAccess &access = pass.accesses[j];
+      transition(batch, graphResources[access.resource], access.use,
+                 access.write);
+    }
+
+    debugUtils.beginLabel(cmdBuffer, pass.name);
+    uint32_t scope = profiler ? profiler->begin(cmdBuffer, pass.name) : 0;
+    batch.record(cmdBuffer);
+
+    bool graphics =
+        !pass.colors.empty() || pass.depthStencil.resource != GRAPH_INVALID;
+    GraphPassContext context = {};
+    if (graphics) beginRenderPass(cmdBuffer, pass, context);
+    if (pass.callback) pass.callback(cmdBuffer, context);
+    if (graphics) vkd.CmdEndRenderPass(cmdBuffer);
+
+    if (profiler) profiler->end(cmdBuffer, scope);
+    debugUtils.endLabel(cmdBuffer);
+
+    for (uint32_t j = 0; j < pass.accesses.size(); j++) {
+      const GraphResource &resource =
+          graphResources[pass.accesses[j].resource];
+      if (resource.physical == GRAPH_INVALID || resource.lastPass != i)
+        continue;
+
+      GraphMemorySlot &slot = slots[physicalImages[resource.physical].slot];
+      slot.lastStages = resource.state.writeStages | resource.state.readStages;
+      slot.lastAccess = resource.state.writeAccess;
+    }
+  }
+
+  for (uint32_t i = 0; i < graphResources.size(); i++) {
+    GraphResource &resource = graphResources[i];
+    if (!exported(resource) || resource.firstPass == GRAPH_INVALID) continue;
+
+    GraphUse after = resource.after;
+    if (after.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+      after.layout = resource.state.layout;
+    transition(batch, resource, after, false);
+  }
+  batch.record(cmdBuffer);
+}
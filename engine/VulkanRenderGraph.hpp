@@ -0,0 +1,219 @@
+#ifndef VULKAN_RENDER_GRAPH_HPP
+#define VULKAN_RENDER_GRAPH_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "VulkanArena.hpp"
+#include "VulkanDebug.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanProfiler.hpp"
+#include "VulkanRenderPasses.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define GRAPH_INVALID UINT32_MAX
+
+// How a resource is used at one point: by a pass, by whatever touched an
+// imported resource before the graph, or by whatever reads it after.
+struct GraphUse {
+  VkImageLayout layout;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+};
+
+GraphUse graphUse(VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                  VkPipelineStageFlags stages = 0, VkAccessFlags access = 0);
+
+struct GraphImageDesc {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  VkImageAspectFlags aspects;
+  VkSampleCountFlagBits samples;
+};
+
+struct GraphAccess {
+  uint32_t resource;
+  GraphUse use;
+  bool write;
+};
+
+struct GraphAttachment {
+  uint32_t resource;
+  VkAttachmentLoadOp loadOp;
+  VkAttachmentStoreOp storeOp;
+  VkClearValue clear;
+};
+
+// Under split-frame rendering each GPU of the device group only renders
+// its own band of the extent, given by deviceAreas.
+struct GraphPassContext {
+  VkRenderPass renderPass;
+  VkFramebuffer framebuffer;
+  VkExtent2D extent;
+  uint32_t deviceAreaCount;
+  const VkRect2D *deviceAreas;
+};
+
+typedef std::function<void(VkCommandBuffer cmdBuffer,
+                           const GraphPassContext &context)>
+    GraphCallback;
+
+// A pass declares everything it reads and writes. Attachments make it a
+// graphics pass: the graph begins the render pass around the callback and
+// picks the store ops from whether anything later reads the attachment.
+struct RenderGraphPass {
+  const char *name;
+  std::vector<GraphAccess> accesses;
+  FixedVector<GraphAttachment, RENDER_PASS_MAX_COLOR_ATTACHMENTS> colors;
+  GraphAttachment depthStencil;
+  VkSubpassContents contents;
+  bool sideEffects;
+  bool live;
+  GraphCallback callback;
+
+  explicit RenderGraphPass(const char *name);
+  void reset(const char *name);
+  RenderGraphPass &color(uint32_t resource, VkAttachmentLoadOp loadOp,
+                         const VkClearValue &clear = VkClearValue());
+  RenderGraphPass &depth(uint32_t resource, VkAttachmentLoadOp loadOp,
+                         const VkClearValue &clear = VkClearValue());
+  RenderGraphPass &sampled(
+      uint32_t resource, VkPipelineStageFlags stages,
+      VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  RenderGraphPass &storage(uint32_t resource, VkPipelineStageFlags stages,
+                           bool write);
+  RenderGraphPass &transferSrc(uint32_t resource);
+  RenderGraphPass &transferDst(uint32_t resource);
+  RenderGraphPass &read(uint32_t resource, const GraphUse &use);
+  RenderGraphPass &write(uint32_t resource, const GraphUse &use);
+  RenderGraphPass &secondary();
+  RenderGraphPass &sideEffect();
+  RenderGraphPass &execute(const GraphCallback &callback);
+};
+
+// What the graph knows about a resource while it records: the layout it is
+// in, the stages and access of the last write, the stages that have read it
+// since, and which stages and access that write is already visible to.
+struct GraphState {
+  VkImageLayout layout;
+  VkPipelineStageFlags writeStages;
+  VkAccessFlags writeAccess;
+  VkPipelineStageFlags readStages;
+  VkPipelineStageFlags visibleStages;
+  VkAccessFlags visibleAccess;
+};
+
+struct GraphResource {
+  const char *name;
+  bool transient;
+  VkImage image;
+  VkImageView view;
+  VkBuffer buffer;
+  VkDeviceSize size;
+  GraphImageDesc desc;
+  GraphUse before;
+  GraphUse after;
+  VkImageUsageFlags usage;
+  uint32_t firstPass;
+  uint32_t lastPass;
+  uint32_t physical;
+  GraphState state;
+};
+
+struct GraphPhysicalImage {
+  VkImage image;
+  VkImageView view;
+  VkMemoryRequirements requirements;
+  uint32_t slot;
+};
+
+// Transient images whose lifetimes never overlap share one of these.
+struct GraphMemorySlot {
+  MemoryAllocation allocation;
+  VkMemoryRequirements requirements;
+  MemoryCategory category;
+  std::vector<uint32_t> firstPasses;
+  std::vector<uint32_t> lastPasses;
+  VkPipelineStageFlags lastStages;
+  VkAccessFlags lastAccess;
+};
+
+// Records a frame from passes that declare their reads and writes. Passes
+// run in the order they were added; compile() drops the ones nothing
+// depends on, and execute() places the barriers and layout transitions
+// between the rest. Transient images are created by the graph and alias
+// onto shared memory when their lifetimes don't overlap. They are kept
+// from frame to frame for as long as the graph declares the same set.
+// setDeviceSplit() splits every render pass into horizontal bands, one per
+// GPU of a device group.
+class VulkanRenderGraph {
+ public:
+  VulkanRenderGraph();
+  void init(VkDevice device, VulkanMemory &memory, VulkanResources &resources,
+            VulkanRenderPassCache &renderPasses);
+  void destroy();
+  void setDeviceSplit(uint32_t deviceCount);
+
+  void reset();
+  uint32_t importImage(const char *name, VkImage image, VkImageView view,
+                       const GraphImageDesc &desc,
+                       const GraphUse &before = graphUse(),
+                       const GraphUse &after = graphUse());
+  uint32_t importBuffer(const char *name, VkBuffer buffer, VkDeviceSize size,
+                        const GraphUse &before = graphUse(),
+                        const GraphUse &after = graphUse());
+  uint32_t createImage(const char *name, const GraphImageDesc &desc);
+  RenderGraphPass &addPass(const char *name);
+
+  void compile();
+  void execute(VkCommandBuffer cmdBuffer, VulkanProfiler *profiler = NULL);
+
+  VkImage image(uint32_t resource) const;
+  VkImageView view(uint32_t resource) const;
+  VkBuffer buffer(uint32_t resource) const;
+
+  uint32_t livePassCount() const { return livePasses; }
+  uint32_t barrierCount() const { return barriers; }
+  VkDeviceSize transientBytes() const { return requestedBytes; }
+  VkDeviceSize allocatedBytes() const { return aliasedBytes; }
+
+ private:
+  VkDevice device;
+  VulkanMemory *memory;
+  VulkanResources *resources;
+  VulkanRenderPassCache *renderPasses;
+
+  std::deque<RenderGraphPass> passes;
+  uint32_t passCount;
+  std::vector<GraphResource> graphResources;
+  std::vector<bool> needed;
+  std::vector<uint32_t> transients;
+  uint32_t livePasses;
+  uint32_t barriers;
+
+  std::vector<GraphPhysicalImage> physicalImages;
+  std::vector<GraphMemorySlot> slots;
+  size_t physicalKey;
+  VkDeviceSize requestedBytes;
+  VkDeviceSize aliasedBytes;
+  uint32_t splitDevices;
+  std::vector<VkRect2D> deviceAreas;
+
+  bool exported(const GraphResource &resource) const;
+  void cull();
+  void allocateTransients();
+  void releaseTransients();
+  void transition(VulkanTools::BarrierBatch &batch, GraphResource &resource,
+                  const GraphUse &use, bool write);
+  void beginRenderPass(VkCommandBuffer cmdBuffer, const RenderGraphPass &pass,
+                       GraphPassContext &context);
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "VulkanRenderPasses.hpp"
+
+static void hashAttachment(size_t &seed, const AttachmentKey &attachment) {
+  VulkanTools::hashCombine(seed, attachment.format);
+  VulkanTools::hashCombine(seed, attachment.samples);
+  VulkanTools::hashCombine(seed, attachment.loadOp);
+  VulkanTools::hashCombine(seed, attachment.storeOp);
+  VulkanTools::hashCombine(seed, attachment.initialLayout);
+  VulkanTools::hashCombine(seed, attachment.finalLayout);
+}
+
+static AttachmentKey attachmentKey(VkFormat format, VkAttachmentLoadOp loadOp,
+                                   VkAttachmentStoreOp storeOp,
+                                   VkImageLayout finalLayout,
+                                   VkSampleCountFlagBits samples,
+                                   VkImageLayout initialLayout) {
+  AttachmentKey attachment;
+  attachment.format = format;
+  attachment.samples = samples;
+  attachment.loadOp = loadOp;
+  attachment.storeOp = storeOp;
+  attachment.initialLayout = initialLayout;
+  attachment.finalLayout = finalLayout;
+  return attachment;
+}
+
+static VkAttachmentDescription attachmentDescription(
+    const AttachmentKey &attachment) {
+  VkAttachmentDescription description = {};
+  description.flags = 0;
+  description.format = attachment.format;
+  description.samples = attachment.samples;
+  description.loadOp = attachment.loadOp;
+  description.storeOp = attachment.storeOp;
+  description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  description.initialLayout = attachment.initialLayout;
+  description.finalLayout = attachment.finalLayout;
+  return description;
+}
+
+bool AttachmentKey::operator==(const AttachmentKey &other) const {
+  return format == other.format && samples == other.samples &&
+         loadOp == other.loadOp && storeOp == other.storeOp &&
+         initialLayout == other.initialLayout &&
+         finalLayout == other.finalLayout;
+}
+
+RenderPassKey::RenderPassKey() : colorCount(0) {
+  depth = attachmentKey(VK_FORMAT_UNDEFINED, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                        VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT,
+                        VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+RenderPassKey &RenderPassKey::addColor(VkFormat format,
+                                       VkAttachmentLoadOp loadOp,
+                                       VkAttachmentStoreOp storeOp,
+                                       VkImageLayout finalLayout,
+                                       VkSampleCountFlagBits samples,
+                                       VkImageLayout initialLayout) {
+  assert(colorCount < RENDER_PASS_MAX_COLOR_ATTACHMENTS);
+  color[colorCount++] = attachmentKey(format, loadOp, storeOp, finalLayout,
+                                      samples, initialLayout);
+  return *this;
+}
+
+RenderPassKey &RenderPassKey::setDepth(VkFormat format,
+                                       VkAttachmentLoadOp loadOp,
+                                       VkAttachmentStoreOp storeOp,
+                                       VkImageLayout finalLayout,
+                                       VkSampleCountFlagBits samples,
+                                       VkImageLayout initialLayout) {
+  depth = attachmentKey(format, loadOp, storeOp, finalLayout, samples,
+                        initialLayout);
+  return *this;
+}
+
+bool RenderPassKey::operator==(const RenderPassKey &other) const {
+  if (colorCount != other.colorCount || !(depth == other.depth)) return false;
+
+  for (uint32_t i = 0; i < colorCount; i++)
+    if (!(color[i] == other.color[i])) return false;
+
+  return true;
+}
+
+FramebufferKey::FramebufferKey(VkRenderPass renderPass, uint32_t width,
+                               uint32_t height, uint32_t layers)
+    : renderPass(renderPass),
+      attachmentCount(0),
+      width(width),
+      height(height),
+      layers(layers) {}
+
+FramebufferKey &FramebufferKey::addView(VkImageView view) {
+  assert(attachmentCount < FRAMEBUFFER_MAX_ATTACHMENTS);
+  views[attachmentCount++] = view;
+  return *this;
+}
+
+bool FramebufferKey::references(VkImageView view) const {
+  for (uint32_t i = 0; i < attachmentCount; i++)
+    if (views[i] == view) return true;
+
+  return false;
+}
+
+bool FramebufferKey::operator==(const FramebufferKey &other) const {
+  if (renderPass != other.renderPass ||
+      attachmentCount != other.attachmentCount || width != other.width ||
+      height != other.height || layers != other.layers)
+    return false;
+
+  for (uint32_t i = 0; i < attachmentCount; i++)
+    if (views[i] != other.views[i]) return false;
+
+  return true;
+}
+
+size_t RenderPassKeyHash::operator()(const RenderPassKey &key) const {
+  size_t seed = key.colorCount;
+  for (uint32_t i = 0; i < key.colorCount; i++)
+    hashAttachment(seed, key.color[i]);
+  hashAttachment(seed, key.depth);
+  return seed;
+}
+
+size_t FramebufferKeyHash::operator()(const FramebufferKey &key) const {
+  size_t seed = key.attachmentCount;
+  VulkanTools::hashCombine(seed, (uint64_t)key.renderPass);
+  for (uint32_t i = 0; i < key.attachmentCount; i++)
+    VulkanTools::hashCombine(seed, (uint64_t)key.views[i]);
+  VulkanTools::hashCombine(seed, key.width);
+  VulkanTools::hashCombine(seed, key.height);
+  VulkanTools::hashCombine(seed, key.layers);
+  return seed;
+}
+
+VulkanRenderPassCache::VulkanRenderPassCache()
+    : device(VK_NULL_HANDLE), resources(NULL) {}
+
+void VulkanRenderPassCache::init(VkDevice device, VulkanResources &resources) {
+  this->device = device;
+  this->resources = &resources;
+
+  resources.addViewListener(
+      [this](VkImageView imageView) { releaseView(imageView); });
+}
+
+void VulkanRenderPassCache::destroy() {
+  std::unordered_map<FramebufferKey, VkFramebuffer,
+                     FramebufferKeyHash>::iterator fb;
+  for (fb = framebuffers.begin(); fb != framebuffers.end(); ++fb)
+    vkd.DestroyFramebuffer(device, fb->second, vkAllocator);
+  framebuffers.clear();
+
+  std::unordered_map<RenderPassKey, VkRenderPass, RenderPassKeyHash>::iterator
+      pass;
+  for (pass = renderPasses.begin(); pass != renderPasses.end(); ++pass)
+    vkd.DestroyRenderPass(device, pass->second, vkAllocator);
+  renderPasses.clear();
+}
+
+VkRenderPass VulkanRenderPassCache::renderPass(const RenderPassKey &key) {
+  std::unordered_map<RenderPassKey, VkRenderPass, RenderPassKeyHash>::iterator
+      it = renderPasses.find(key);
+  if (it != renderPasses.end()) return it->second;
+
+  VkRenderPass renderPass = createRenderPass(key);
+  renderPasses[key] = renderPass;
+  return renderPass;
+}
+
+VkFramebuffer VulkanRenderPassCache::framebuffer(const FramebufferKey &key) {
+  std::unordered_map<FramebufferKey, VkFramebuffer,
+                     FramebufferKeyHash>::iterator it = framebuffers.find(key);
+  if (it != framebuffers.end()) return it->second;
+
+  VkFramebuffer framebuffer = createFramebuffer(key);
+  framebuffers[key] = framebuffer;
+  return framebuffer;
+}
+
+void VulkanRenderPassCache::releaseView(VkImageView view) {
+  std::unordered_map<FramebufferKey, VkFramebuffer,
+                     FramebufferKeyHash>::iterator it = framebuffers.begin();
+
+  while (it != framebuffers.end()) {
+    if (it->first.references(view)) {
+      resources->retireFramebuffer(it->second);
+      it = framebuffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+VkRenderPass VulkanRenderPassCache::createRenderPass(
+    const RenderPassKey &key) {
+  std::vector<VkAttachmentDescription> attachments;
+  std::vector<VkAttachmentReference> colorRefs(key.colorCount);
+
+  VkPipelineStageFlags attachmentStages = 0;
+  VkAccessFlags attachmentAccess = 0;
+  VkPipelineStageFlags finalStages = 0;
+  VkAccessFlags finalAccess = 0;
+
+  for (uint32_t i = 0; i < key.colorCount; i++) {
+    colorRefs[i].attachment = attachments.size();
+    colorRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments.push_back(attachmentDescription(key.color[i]));
+
+    VulkanTools::LayoutAccess after =
+        VulkanTools::layoutAccess(key.color[i].finalLayout, false);
+    finalStages |= after.stages;
+    finalAccess |= after.access;
+  }
+
+  if (key.colorCount > 0) {
+    attachmentStages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    attachmentAccess |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  }
+
+  VkAttachmentReference depthRef = {};
+  if (key.hasDepth()) {
+    depthRef.attachment = attachments.size();
+    depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments.push_back(attachmentDescription(key.depth));
+
+    attachmentStages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    attachmentAccess |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  }
+
+  VkSubpassDescription subpass = {};
+  subpass.flags = 0;
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.inputAttachmentCount = 0;
+  subpass.pInputAttachments = NULL;
+  subpass.colorAttachmentCount = key.colorCount;
+  subpass.pColorAttachments = colorRefs.empty() ? NULL : colorRefs.data();
+  subpass.pResolveAttachments = NULL;
+  subpass.pDepthStencilAttachment = key.hasDepth() ? &depthRef : NULL;
+  subpass.preserveAttachmentCount = 0;
+  subpass.pPreserveAttachments = NULL;
+
+  // The first dependency orders the layout transitions after whatever the
+  // submission waited for at the attachment stages, and after the previous
+  // pass's depth writes when the depth image is shared; the second makes the
+  // attachment writes visible to the stages of the final layouts.
+  VkSubpassDependency dependencies[2] = {};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = attachmentStages;
+  dependencies[0].dstStageMask = attachmentStages;
+  dependencies[0].srcAccessMask =
+      key.hasDepth() ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0;
+  dependencies[0].dstAccessMask = attachmentAccess;
+  dependencies[0].dependencyFlags = 0;
+
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = attachmentStages;
+  dependencies[1].dstStageMask =
+      finalStages ? finalStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  dependencies[1].srcAccessMask = attachmentAccess;
+  dependencies[1].dstAccessMask = finalAccess;
+  dependencies[1].dependencyFlags = 0;
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.pNext = NULL;
+  renderPassInfo.flags = 0;
+  renderPassInfo.attachmentCount = attachments.size();
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 2;
+  renderPassInfo.pDependencies = dependencies;
+
+  VkRenderPass renderPass;
+  VkResult result =
+      vkd.CreateRenderPass(device, &renderPassInfo, vkAllocator, &renderPass);
+  assert(result == VK_SUCCESS);
+
+  return renderPass;
+}
+
+VkFramebuffer VulkanRenderPassCache::createFramebuffer(
+    const FramebufferKey &key) {
+  VkFramebufferCreateInfo framebufferInfo = {};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.pNext = NULL;
+  framebufferInfo.flags = 0;
+  framebufferInfo.renderPass = key.renderPass;
+  framebufferInfo.attachmentCount = key.attachmentCount;
+  framebufferInfo.pAttachments = key.views;
+  framebufferInfo.width = key.width;
+  framebufferInfo.height = key.height;
+  framebufferInfo.layers = key.layers;
+
+  VkFramebuffer framebuffer;
+  VkResult result =
+      vkd.CreateFramebuffer(device, &framebufferInfo, vkAllocator,
+                            &framebuffer);
+  assert(result == VK_SUCCESS);
+
+  return framebuffer;
+}
@@ -0,0 +1,96 @@
+#ifndef VULKAN_RENDER_PASSES_HPP
+#define VULKAN_RENDER_PASSES_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define RENDER_PASS_MAX_COLOR_ATTACHMENTS 4
+#define FRAMEBUFFER_MAX_ATTACHMENTS (RENDER_PASS_MAX_COLOR_ATTACHMENTS + 1)
+
+struct AttachmentKey {
+  VkFormat format;
+  VkSampleCountFlagBits samples;
+  VkAttachmentLoadOp loadOp;
+  VkAttachmentStoreOp storeOp;
+  VkImageLayout initialLayout;
+  VkImageLayout finalLayout;
+
+  bool operator==(const AttachmentKey &other) const;
+};
+
+struct RenderPassKey {
+  uint32_t colorCount;
+  AttachmentKey color[RENDER_PASS_MAX_COLOR_ATTACHMENTS];
+  AttachmentKey depth;
+
+  RenderPassKey();
+  RenderPassKey &addColor(
+      VkFormat format, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
+      VkImageLayout finalLayout,
+      VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+      VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+  RenderPassKey &setDepth(
+      VkFormat format, VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
+      VkImageLayout finalLayout,
+      VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+      VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+  bool hasDepth() const { return depth.format != VK_FORMAT_UNDEFINED; }
+
+  bool operator==(const RenderPassKey &other) const;
+};
+
+struct FramebufferKey {
+  VkRenderPass renderPass;
+  uint32_t attachmentCount;
+  VkImageView views[FRAMEBUFFER_MAX_ATTACHMENTS];
+  uint32_t width;
+  uint32_t height;
+  uint32_t layers;
+
+  FramebufferKey(VkRenderPass renderPass, uint32_t width, uint32_t height,
+                 uint32_t layers = 1);
+  FramebufferKey &addView(VkImageView view);
+  bool references(VkImageView view) const;
+
+  bool operator==(const FramebufferKey &other) const;
+};
+
+struct RenderPassKeyHash {
+  size_t operator()(const RenderPassKey &key) const;
+};
+
+struct FramebufferKeyHash {
+  size_t operator()(const FramebufferKey &key) const;
+};
+
+class VulkanRenderPassCache {
+ public:
+  VulkanRenderPassCache();
+  void init(VkDevice device, VulkanResources &resources);
+  void destroy();
+
+  VkRenderPass renderPass(const RenderPassKey &key);
+  VkFramebuffer framebuffer(const FramebufferKey &key);
+  void releaseView(VkImageView view);
+
+  uint32_t renderPassCount() const { return renderPasses.size(); }
+  uint32_t framebufferCount() const { return framebuffers.size(); }
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  std::unordered_map<RenderPassKey, VkRenderPass, RenderPassKeyHash>
+      renderPasses;
+  std::unordered_map<FramebufferKey, VkFramebuffer, FramebufferKeyHash>
+      framebuffers;
+
+  VkRenderPass createRenderPass(const RenderPassKey &key);
+  VkFramebuffer createFramebuffer(const FramebufferKey &key);
+};
+
+#endif
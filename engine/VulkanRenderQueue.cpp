@@ -0,0 +1,405 @@
+#include "VulkanRenderQueue.hpp"
+
+VulkanRenderQueue::VulkanRenderQueue()
+    : device(VK_NULL_HANDLE),
+      resources(NULL),
+      jobs(NULL),
+      geometry(NULL),
+      maxItems(0),
+      mappedInstances(NULL),
+      sortChunks(1),
+      sortShift(0),
+      sortScatter(false),
+      version(0),
+      sortedVersion(0),
+      frame(0),
+      sorts(0),
+      pipelineBinds(0),
+      setBinds(0),
+      draws(0) {
+  memset(passStart, 0, sizeof(passStart));
+}
+
+void VulkanRenderQueue::init(VkDevice device, VulkanResources &resources,
+                             VulkanJobs &jobs, VulkanGeometryPool &geometry,
+                             uint32_t framesInFlight, uint32_t capacity) {
+  this->device = device;
+  this->resources = &resources;
+  this->jobs = &jobs;
+  this->geometry = &geometry;
+  maxItems = capacity;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = (VkDeviceSize)framesInFlight * maxItems * sizeof(uint32_t);
+  bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = NULL;
+
+  instanceBuffer = resources.createBuffer(
+      bufferInfo,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  mappedInstances =
+      (uint32_t *)resources.buffer(instanceBuffer)->allocation.mapped;
+  assert(mappedInstances != NULL);
+
+  // Id 0 is no set and no material, so draws can leave either out.
+  sets.assign(1, VK_NULL_HANDLE);
+  materials.assign(1, VK_NULL_HANDLE);
+
+  items.reserve(maxItems);
+  keys.reserve(maxItems);
+  sortScratch.reserve(maxItems);
+  instances.reserve(maxItems);
+  batches.reserve(maxItems);
+  histograms.reserve(jobs.threadCount() * RENDER_SORT_BUCKETS);
+  regionVersions.assign(framesInFlight, 0);
+  version = 1;
+  sortedVersion = 0;
+  frame = 0;
+}
+
+void VulkanRenderQueue::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  printStats();
+  resources->destroyBuffer(instanceBuffer);
+  instanceBuffer = ResourceHandle();
+  mappedInstances = NULL;
+
+  pipelines.clear();
+  sets.clear();
+  materials.clear();
+  items.clear();
+  batches.clear();
+  regionVersions.clear();
+  device = VK_NULL_HANDLE;
+}
+
+uint32_t VulkanRenderQueue::addPipeline(VkPipeline pipeline,
+                                        VkPipelineLayout layout) {
+  assert(pipelines.size() < (1u << RENDER_KEY_PIPELINE_BITS));
+
+  RenderPipeline entry = {pipeline, layout};
+  pipelines.push_back(entry);
+  return pipelines.size() - 1;
+}
+
+uint32_t VulkanRenderQueue::addDescriptorSet(VkDescriptorSet set) {
+  assert(sets.size() < (1u << RENDER_KEY_SET_BITS));
+
+  sets.push_back(set);
+  return sets.size() - 1;
+}
+
+uint32_t VulkanRenderQueue::addMaterial(VkDescriptorSet set) {
+  assert(materials.size() < (1u << RENDER_KEY_MATERIAL_BITS));
+
+  materials.push_back(set);
+  return materials.size() - 1;
+}
+
+uint64_t VulkanRenderQueue::sortKey(const RenderDraw &draw) {
+  // A non-negative float's bits sort as the float does, so the top half
+  // of them is depth to 7 bits of mantissa.
+  float depth = std::max(draw.depth, 0.0f);
+  uint32_t depthBits;
+  memcpy(&depthBits, &depth, sizeof(depthBits));
+
+  // The mesh field only groups instances; a mesh whose slot aliases
+  // another's is told apart when the batches are merged.
+  uint64_t key = (uint64_t)draw.pass << RENDER_KEY_PASS_SHIFT;
+  key |= (uint64_t)draw.pipeline << RENDER_KEY_PIPELINE_SHIFT;
+  key |= (uint64_t)draw.descriptorSet << RENDER_KEY_SET_SHIFT;
+  key |= (uint64_t)draw.material << RENDER_KEY_MATERIAL_SHIFT;
+  key |= (uint64_t)(draw.mesh.index & ((1u << RENDER_KEY_MESH_BITS) - 1))
+         << RENDER_KEY_MESH_SHIFT;
+  key |= (uint64_t)(depthBits >> (32 - RENDER_KEY_DEPTH_BITS))
+         << RENDER_KEY_DEPTH_SHIFT;
+  return key;
+}
+
+uint32_t VulkanRenderQueue::keyField(uint64_t key, uint32_t shift,
+                                     uint32_t bits) {
+  return (uint32_t)(key >> shift) & ((1u << bits) - 1);
+}
+
+bool VulkanRenderQueue::add(const RenderDraw &draw) {
+  assert(draw.pass < RENDER_PASS_COUNT && draw.pipeline < pipelines.size() &&
+         draw.descriptorSet < sets.size() && draw.material < materials.size());
+  if (items.size() >= maxItems) return false;
+
+  RenderItem item = {sortKey(draw), draw.mesh, draw.instance};
+  items.push_back(item);
+  version++;
+  return true;
+}
+
+void VulkanRenderQueue::clear() {
+  if (items.empty()) return;
+
+  items.clear();
+  version++;
+}
+
+void VulkanRenderQueue::runSortJobs(bool scatter) {
+  sortScatter = scatter;
+  if (sortChunks == 1) {
+    scatter ? scatterChunk(0) : countChunk(0);
+    return;
+  }
+
+  for (uint32_t chunk = 0; chunk < sortChunks; chunk++)
+    jobs->submit([this, chunk](uint32_t) {
+      sortScatter ? scatterChunk(chunk) : countChunk(chunk);
+    });
+  jobs->wait();
+}
+
+void VulkanRenderQueue::countChunk(uint32_t chunk) {
+  uint32_t first = (uint64_t)keys.size() * chunk / sortChunks;
+  uint32_t last = (uint64_t)keys.size() * (chunk + 1) / sortChunks;
+  uint32_t *counts = histograms.data() + chunk * RENDER_SORT_BUCKETS;
+  memset(counts, 0, RENDER_SORT_BUCKETS * sizeof(uint32_t));
+
+  for (uint32_t i = first; i < last; i++)
+    counts[keyField(keys[i].key, sortShift, RENDER_SORT_RADIX_BITS)]++;
+}
+
+void VulkanRenderQueue::scatterChunk(uint32_t chunk) {
+  uint32_t first = (uint64_t)keys.size() * chunk / sortChunks;
+  uint32_t last = (uint64_t)keys.size() * (chunk + 1) / sortChunks;
+  uint32_t *offsets = histograms.data() + chunk * RENDER_SORT_BUCKETS;
+
+  for (uint32_t i = first; i < last; i++)
+    sortScratch[offsets[keyField(keys[i].key, sortShift,
+                                 RENDER_SORT_RADIX_BITS)]++] = keys[i];
+}
+
+void VulkanRenderQueue::sort() {
+  uint32_t count = items.size();
+  keys.resize(count);
+  sortScratch.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    keys[i].key = items[i].key;
+    keys[i].item = i;
+  }
+
+  // Each chunk counts its own keys, and the counts are turned into offsets
+  // bucket by bucket across the chunks in order, so every chunk scatters
+  // on its own and the sort stays stable.
+  sortChunks = count >= RENDER_SORT_PARALLEL_MIN ? jobs->threadCount() : 1;
+  histograms.resize(sortChunks * RENDER_SORT_BUCKETS);
+
+  for (sortShift = 0; sortShift < 64; sortShift += RENDER_SORT_RADIX_BITS) {
+    runSortJobs(false);
+
+    // A digit every key shares, like the pass in a one-pass queue, would
+    // only copy the keys across unchanged.
+    bool uniform = false;
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket < RENDER_SORT_BUCKETS; bucket++) {
+      uint32_t start = offset;
+      for (uint32_t chunk = 0; chunk < sortChunks; chunk++) {
+        uint32_t &entry = histograms[chunk * RENDER_SORT_BUCKETS + bucket];
+        uint32_t chunkCount = entry;
+        entry = offset;
+        offset += chunkCount;
+      }
+      if (offset - start == count) uniform = true;
+    }
+    if (uniform) continue;
+
+    runSortJobs(true);
+    keys.swap(sortScratch);
+  }
+
+  sorts++;
+}
+
+void VulkanRenderQueue::build() {
+  sort();
+
+  // Keys that differ only in depth, on the same mesh, are one instanced
+  // draw, and their instance values are laid out in batch order.
+  batches.clear();
+  instances.resize(keys.size());
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    const RenderItem &item = items[keys[i].item];
+    instances[i] = item.instance;
+
+    if (!batches.empty()) {
+      RenderBatch &last = batches.back();
+      if ((last.key >> RENDER_KEY_MESH_SHIFT) ==
+              (keys[i].key >> RENDER_KEY_MESH_SHIFT) &&
+          last.mesh.index == item.mesh.index &&
+          last.mesh.generation == item.mesh.generation) {
+        last.instanceCount++;
+        continue;
+      }
+    }
+
+    RenderBatch batch = {keys[i].key, item.mesh, i, 1};
+    batches.push_back(batch);
+  }
+
+  uint32_t batch = 0;
+  for (uint32_t pass = 0; pass <= RENDER_PASS_COUNT; pass++) {
+    while (batch < batches.size() &&
+           keyField(batches[batch].key, RENDER_KEY_PASS_SHIFT,
+                    RENDER_KEY_PASS_BITS) < pass)
+      batch++;
+    passStart[pass] = batch;
+  }
+
+  sortedVersion = version;
+}
+
+void VulkanRenderQueue::beginFrame(uint32_t frame) {
+  this->frame = frame;
+  if (regionVersions[frame] == version) return;
+
+  if (sortedVersion != version) build();
+  memcpy(mappedInstances + (size_t)frame * maxItems, instances.data(),
+         instances.size() * sizeof(uint32_t));
+  regionVersions[frame] = version;
+}
+
+void VulkanRenderQueue::record(VkCommandBuffer cmdBuffer, uint32_t pass,
+                               GeometryPass streams, VkExtent2D extent,
+                               uint32_t chunk, uint32_t chunkCount) {
+  assert(pass < RENDER_PASS_COUNT);
+  uint32_t passBatches = passStart[pass + 1] - passStart[pass];
+  uint32_t first =
+      passStart[pass] + (uint64_t)passBatches * chunk / chunkCount;
+  uint32_t last =
+      passStart[pass] + (uint64_t)passBatches * (chunk + 1) / chunkCount;
+  if (first == last) return;
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)extent.width;
+  viewport.height = (float)extent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor = {};
+  scissor.extent = extent;
+
+  vkd.CmdSetViewport(cmdBuffer, 0, 1, &viewport);
+  vkd.CmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+  geometry->bind(cmdBuffer, streams);
+  VkBuffer buffer = resources->buffer(instanceBuffer)->buffer;
+  VkDeviceSize offset = (VkDeviceSize)frame * maxItems * sizeof(uint32_t);
+  vkd.CmdBindVertexBuffers(cmdBuffer, RENDER_INSTANCE_BINDING, 1, &buffer,
+                           &offset);
+
+  // Every secondary command buffer starts with nothing bound, and a new
+  // pipeline layout may disturb the sets bound under the old one.
+  uint32_t boundPipeline = UINT32_MAX;
+  uint32_t boundSet = UINT32_MAX;
+  uint32_t boundMaterial = UINT32_MAX;
+  VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+  uint64_t chunkPipelineBinds = 0;
+  uint64_t chunkSetBinds = 0;
+
+  for (uint32_t i = first; i < last; i++) {
+    const RenderBatch &batch = batches[i];
+    uint32_t pipeline = keyField(batch.key, RENDER_KEY_PIPELINE_SHIFT,
+                                 RENDER_KEY_PIPELINE_BITS);
+    uint32_t set =
+        keyField(batch.key, RENDER_KEY_SET_SHIFT, RENDER_KEY_SET_BITS);
+    uint32_t material = keyField(batch.key, RENDER_KEY_MATERIAL_SHIFT,
+                                 RENDER_KEY_MATERIAL_BITS);
+
+    if (pipeline != boundPipeline) {
+      const RenderPipeline &entry = pipelines[pipeline];
+      vkd.CmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          entry.pipeline);
+      if (entry.layout != boundLayout) {
+        boundSet = UINT32_MAX;
+        boundMaterial = UINT32_MAX;
+        boundLayout = entry.layout;
+      }
+      boundPipeline = pipeline;
+      chunkPipelineBinds++;
+    }
+
+    if (set != boundSet && set != 0) {
+      vkd.CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                boundLayout, RENDER_SHARED_SET, 1, &sets[set],
+                                0, NULL);
+      chunkSetBinds++;
+    }
+    boundSet = set;
+
+    if (material != boundMaterial && material != 0) {
+      vkd.CmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                boundLayout, RENDER_MATERIAL_SET, 1,
+                                &materials[material], 0, NULL);
+      chunkSetBinds++;
+    }
+    boundMaterial = material;
+
+    geometry->draw(cmdBuffer, batch.mesh, batch.instanceCount,
+                   batch.firstInstance);
+  }
+
+  pipelineBinds += chunkPipelineBinds;
+  setBinds += chunkSetBinds;
+  draws += last - first;
+}
+
+VkVertexInputBindingDescription VulkanRenderQueue::instanceBinding() {
+  VkVertexInputBindingDescription description = {};
+  description.binding = RENDER_INSTANCE_BINDING;
+  description.stride = sizeof(uint32_t);
+  description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+  return description;
+}
+
+VkVertexInputAttributeDescription VulkanRenderQueue::instanceAttribute(
+    uint32_t location) {
+  VkVertexInputAttributeDescription description = {};
+  description.location = location;
+  description.binding = RENDER_INSTANCE_BINDING;
+  description.format = VK_FORMAT_R32_UINT;
+  description.offset = 0;
+  return description;
+}
+
+uint32_t VulkanRenderQueue::batchCount(uint32_t pass) const {
+  assert(pass < RENDER_PASS_COUNT);
+  return passStart[pass + 1] - passStart[pass];
+}
+
+RenderQueueStats VulkanRenderQueue::stats() const {
+  RenderQueueStats stats = {};
+  stats.items = items.size();
+  stats.batches = batches.size();
+  stats.sorts = sorts;
+  stats.pipelineBinds = pipelineBinds;
+  stats.setBinds = setBinds;
+  stats.draws = draws;
+  return stats;
+}
+
+void VulkanRenderQueue::printStats() const {
+  if (pipelines.empty()) return;
+
+  RenderQueueStats current = stats();
+  fprintf(stdout, "Render Queue:   %u items in %u batches, %u sorts\n",
+          current.items, current.batches, current.sorts);
+  fprintf(stdout,
+          "Render Binds:   %llu pipeline and %llu set binds for %llu draws\n",
+          (unsigned long long)current.pipelineBinds,
+          (unsigned long long)current.setBinds,
+          (unsigned long long)current.draws);
+}
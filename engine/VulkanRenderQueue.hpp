@@ -0,0 +1,178 @@
+#ifndef VULKAN_RENDER_QUEUE_HPP
+#define VULKAN_RENDER_QUEUE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "VulkanGeometry.hpp"
+#include "VulkanJobs.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define RENDER_QUEUE_MAX_ITEMS (128 * 1024)
+#define RENDER_QUEUE_COLOR_PASS 0
+#define RENDER_SORT_PARALLEL_MIN 16384
+#define RENDER_SORT_RADIX_BITS 8
+#define RENDER_SORT_BUCKETS (1 << RENDER_SORT_RADIX_BITS)
+
+// Sort key fields from the top bit down, so items sort by pass first and
+// by depth last. Mesh comes before depth to keep every instance of a mesh
+// together whatever its distance.
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_PIPELINE_BITS 10
+#define RENDER_KEY_SET_BITS 10
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_MESH_BITS 12
+#define RENDER_KEY_DEPTH_BITS 16
+#define RENDER_PASS_COUNT (1 << RENDER_KEY_PASS_BITS)
+#define RENDER_KEY_DEPTH_SHIFT 0
+#define RENDER_KEY_MESH_SHIFT (RENDER_KEY_DEPTH_SHIFT + RENDER_KEY_DEPTH_BITS)
+#define RENDER_KEY_MATERIAL_SHIFT (RENDER_KEY_MESH_SHIFT + RENDER_KEY_MESH_BITS)
+#define RENDER_KEY_SET_SHIFT \
+  (RENDER_KEY_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS)
+#define RENDER_KEY_PIPELINE_SHIFT (RENDER_KEY_SET_SHIFT + RENDER_KEY_SET_BITS)
+#define RENDER_KEY_PASS_SHIFT \
+  (RENDER_KEY_PIPELINE_SHIFT + RENDER_KEY_PIPELINE_BITS)
+
+// Instance values are a per-instance vertex attribute at this binding,
+// after the geometry pool's streams.
+#define RENDER_INSTANCE_BINDING GEOMETRY_STREAM_COUNT
+#define RENDER_SHARED_SET 0
+#define RENDER_MATERIAL_SET 1
+
+// One object to draw. pipeline, descriptorSet and material are ids from
+// the queue's add functions, with 0 for no set or material. depth is the
+// view distance, nearer first, and instance is handed to the vertex shader
+// as its instance attribute.
+struct RenderDraw {
+  uint32_t pass;
+  uint32_t pipeline;
+  uint32_t descriptorSet;
+  uint32_t material;
+  ResourceHandle mesh;
+  float depth;
+  uint32_t instance;
+};
+
+struct RenderBatch {
+  uint64_t key;
+  ResourceHandle mesh;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+};
+
+struct RenderQueueStats {
+  uint32_t items;
+  uint32_t batches;
+  uint32_t sorts;
+  uint64_t pipelineBinds;
+  uint64_t setBinds;
+  uint64_t draws;
+};
+
+// Batches the draws of a scene that repeats a few meshes many times. Items
+// are kept until clear(), and whenever they have changed beginFrame() sorts
+// them by 64-bit key, with a radix sort split across the job threads for
+// large queues, and merges neighbours that share everything but depth into
+// one instanced draw. Each batch's instance values go to the frame's region
+// of a mapped buffer, read as a per-instance attribute, so the shader finds
+// its object from the attribute rather than gl_InstanceIndex. record() then
+// walks one pass's batches, or a chunk of them per secondary command
+// buffer, binding pipelines and sets only where they change. Pipelines take
+// viewport and scissor as dynamic state and read the geometry pool's
+// vertex streams; the shared set goes in set 0 and materials in set 1.
+class VulkanRenderQueue {
+ public:
+  VulkanRenderQueue();
+
+  void init(VkDevice device, VulkanResources &resources, VulkanJobs &jobs,
+            VulkanGeometryPool &geometry, uint32_t framesInFlight,
+            uint32_t capacity = RENDER_QUEUE_MAX_ITEMS);
+  void destroy();
+
+  uint32_t addPipeline(VkPipeline pipeline, VkPipelineLayout layout);
+  uint32_t addDescriptorSet(VkDescriptorSet set);
+  uint32_t addMaterial(VkDescriptorSet set);
+
+  bool add(const RenderDraw &draw);
+  void clear();
+
+  void beginFrame(uint32_t frame);
+  void record(VkCommandBuffer cmdBuffer, uint32_t pass, GeometryPass streams,
+              VkExtent2D extent, uint32_t chunk = 0,
+              uint32_t chunkCount = 1);
+
+  static uint64_t sortKey(const RenderDraw &draw);
+  static VkVertexInputBindingDescription instanceBinding();
+  static VkVertexInputAttributeDescription instanceAttribute(
+      uint32_t location);
+
+  uint32_t batchCount(uint32_t pass) const;
+  RenderQueueStats stats() const;
+  void printStats() const;
+
+ private:
+  struct RenderItem {
+    uint64_t key;
+    ResourceHandle mesh;
+    uint32_t instance;
+  };
+
+  struct SortEntry {
+    uint64_t key;
+    uint32_t item;
+  };
+
+  struct RenderPipeline {
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+  };
+
+  VkDevice device;
+  VulkanResources *resources;
+  VulkanJobs *jobs;
+  VulkanGeometryPool *geometry;
+  uint32_t maxItems;
+  ResourceHandle instanceBuffer;
+  uint32_t *mappedInstances;
+
+  std::vector<RenderPipeline> pipelines;
+  std::vector<VkDescriptorSet> sets;
+  std::vector<VkDescriptorSet> materials;
+
+  std::vector<RenderItem> items;
+  std::vector<SortEntry> keys;
+  std::vector<SortEntry> sortScratch;
+  std::vector<uint32_t> histograms;
+  uint32_t sortChunks;
+  uint32_t sortShift;
+  bool sortScatter;
+
+  std::vector<RenderBatch> batches;
+  std::vector<uint32_t> instances;
+  uint32_t passStart[RENDER_PASS_COUNT + 1];
+  std::vector<uint64_t> regionVersions;
+  uint64_t version;
+  uint64_t sortedVersion;
+  uint32_t frame;
+
+  uint32_t sorts;
+  std::atomic<uint64_t> pipelineBinds;
+  std::atomic<uint64_t> setBinds;
+  std::atomic<uint64_t> draws;
+
+  void build();
+  void sort();
+  void runSortJobs(bool scatter);
+  void countChunk(uint32_t chunk);
+  void scatterChunk(uint32_t chunk);
+  static uint32_t keyField(uint64_t key, uint32_t shift, uint32_t bits);
+};
+
+#endif
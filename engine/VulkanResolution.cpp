@@ -0,0 +1,122 @@
+#include "VulkanResolution.hpp"
+
+VulkanResolution::VulkanResolution()
+    : targetMs(0.0),
+      settleFrames(0),
+      minScale(RESOLUTION_MIN_SCALE),
+      maxScale(RESOLUTION_MAX_SCALE),
+      currentScale(1.0f),
+      smoothedMs(0.0),
+      holdFrames(0),
+      changes(0),
+      frames(0),
+      scaleSum(0.0),
+      lowestScale(1.0f) {}
+
+double VulkanResolution::parseTarget(const char *value) {
+  if (!value || value[0] == '\0') return 0.0;
+
+  char *end = NULL;
+  double target = strtod(value, &end);
+
+  // Anything that isn't a number, like "on", asks for the default target.
+  if (end == value || *end != '\0') return RESOLUTION_TARGET_MS;
+  return target > 0.0 ? target : 0.0;
+}
+
+void VulkanResolution::init(double targetMs, uint32_t settleFrames,
+                            float minScale, float maxScale) {
+  this->targetMs = targetMs;
+  this->settleFrames = settleFrames;
+  this->minScale = minScale;
+  this->maxScale = maxScale;
+  currentScale = maxScale;
+  lowestScale = maxScale;
+  smoothedMs = 0.0;
+  holdFrames = settleFrames;
+
+  fprintf(stdout, "Resolution:     %.2f ms target, %.2f-%.2f scale\n",
+          targetMs, minScale, maxScale);
+}
+
+void VulkanResolution::destroy() {
+  if (!enabled()) return;
+
+  fprintf(stdout, "Resolution:     %.2f min, %.2f avg scale, %u changes\n",
+          lowestScale, frames ? scaleSum / frames : currentScale, changes);
+  targetMs = 0.0;
+}
+
+float VulkanResolution::quantize(float scale) const {
+  float steps = std::floor(scale / RESOLUTION_STEP + 0.5f);
+  return std::max(minScale, std::min(maxScale, steps * RESOLUTION_STEP));
+}
+
+bool VulkanResolution::update(double gpuMs) {
+  if (!enabled()) return false;
+
+  frames++;
+  scaleSum += currentScale;
+
+  // No timing yet, e.g. right after the profiler was reset. Timings that
+  // arrive while holding were measured at the old scale, so they are left
+  // out of the average.
+  if (gpuMs <= 0.0) return false;
+  if (holdFrames > 0) {
+    holdFrames--;
+    return false;
+  }
+
+  smoothedMs = smoothedMs > 0.0 ? smoothedMs + RESOLUTION_SMOOTHING *
+                                                   (gpuMs - smoothedMs)
+                                : gpuMs;
+
+  float next = currentScale;
+
+  if (smoothedMs > targetMs) {
+    float ideal = currentScale * (float)std::sqrt(targetMs / smoothedMs);
+    next = std::min(quantize(ideal), quantize(currentScale - RESOLUTION_STEP));
+  } else if (smoothedMs < targetMs * RESOLUTION_HEADROOM) {
+    next = quantize(currentScale + RESOLUTION_STEP);
+  }
+
+  if (next == currentScale) return false;
+
+  currentScale = next;
+  lowestScale = std::min(lowestScale, next);
+  holdFrames = settleFrames;
+  changes++;
+
+  smoothedMs = 0.0;
+  return true;
+}
+
+VkExtent2D VulkanResolution::scaled(VkExtent2D extent) const {
+  if (!enabled()) return extent;
+
+  VkExtent2D result = {};
+  result.width = std::max(1u, (uint32_t)(extent.width * currentScale + 0.5f));
+  result.height =
+      std::max(1u, (uint32_t)(extent.height * currentScale + 0.5f));
+  return result;
+}
+
+void VulkanResolution::recordUpscale(VkCommandBuffer cmdBuffer, VkImage src,
+                                     VkExtent2D srcExtent, VkImage dst,
+                                     VkExtent2D dstExtent) {
+  VkImageBlit region = {};
+  region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.srcSubresource.layerCount = 1;
+  region.srcOffsets[1].x = srcExtent.width;
+  region.srcOffsets[1].y = srcExtent.height;
+  region.srcOffsets[1].z = 1;
+  region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.dstSubresource.layerCount = 1;
+  region.dstOffsets[1].x = dstExtent.width;
+  region.dstOffsets[1].y = dstExtent.height;
+  region.dstOffsets[1].z = 1;
+
+  vkd.CmdBlitImage(cmdBuffer, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+                   VK_FILTER_LINEAR);
+}
@@ -0,0 +1,71 @@
+#ifndef VULKAN_RESOLUTION_HPP
+#define VULKAN_RESOLUTION_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cmath>
+
+#include "VulkanTools.hpp"
+
+#define RESOLUTION_ENV "VULKAN_EXAMPLE_DYNAMIC_RESOLUTION"
+#define RESOLUTION_TARGET_MS 16.0
+#define RESOLUTION_MIN_SCALE 0.5f
+#define RESOLUTION_MAX_SCALE 1.0f
+#define RESOLUTION_STEP 0.05f
+#define RESOLUTION_HEADROOM 0.85
+#define RESOLUTION_SMOOTHING 0.1
+
+// Scales the scene's render extent to hold GPU frame time at a target. GPU
+// time is taken as proportional to the pixels drawn, so each update aims
+// the scale at the square root of the target over the smoothed frame time.
+// A frame over the target scales down at once. Scaling back up waits until
+// there is headroom, and goes one step at a time, so the scale doesn't
+// swing between two steps. Scales are multiples of RESOLUTION_STEP, which
+// keeps the transient scene targets and depth buffer from being rebuilt
+// every frame. After each change the controller holds for settleFrames,
+// since the timings arriving until then were measured at the old scale.
+class VulkanResolution {
+ public:
+  VulkanResolution();
+
+  static double parseTarget(const char *value);
+
+  void init(double targetMs, uint32_t settleFrames,
+            float minScale = RESOLUTION_MIN_SCALE,
+            float maxScale = RESOLUTION_MAX_SCALE);
+  void destroy();
+
+  bool update(double gpuMs);
+  VkExtent2D scaled(VkExtent2D extent) const;
+
+  // Stretches src over dst with a linear filter. Swapchain and offscreen
+  // formats are 8-bit RGBA or BGRA, which every device can blit and filter.
+  static void recordUpscale(VkCommandBuffer cmdBuffer, VkImage src,
+                            VkExtent2D srcExtent, VkImage dst,
+                            VkExtent2D dstExtent);
+
+  bool enabled() const { return targetMs > 0.0; }
+  float scale() const { return currentScale; }
+  uint32_t changeCount() const { return changes; }
+
+ private:
+  double targetMs;
+  uint32_t settleFrames;
+  float minScale;
+  float maxScale;
+  float currentScale;
+  double smoothedMs;
+  uint32_t holdFrames;
+
+  uint32_t changes;
+  uint64_t frames;
+  double scaleSum;
+  float lowestScale;
+
+  float quantize(float scale) const;
+};
+
+#endif
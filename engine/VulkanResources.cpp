@@ -0,0 +1,303 @@
+#include "VulkanResources.hpp"
+
+VulkanResources::VulkanResources()
+    : device(VK_NULL_HANDLE),
+      memory(NULL),
+      framesInFlight(1),
+      currentFrame(0),
+      timeline(NULL),
+      timelineQueue(VK_NULL_HANDLE) {}
+
+void VulkanResources::init(VkDevice device, VulkanMemory &memory,
+                           uint32_t framesInFlight) {
+  this->device = device;
+  this->memory = &memory;
+  this->framesInFlight = framesInFlight;
+  currentFrame = 0;
+}
+
+void VulkanResources::track(VulkanTimeline &timeline, VkQueue queue) {
+  if (!timeline.enabled()) return;
+
+  this->timeline = &timeline;
+  timelineQueue = queue;
+}
+
+void VulkanResources::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  flush();
+
+  for (uint32_t i = 0; i < buffers.size(); i++) {
+    BufferResource &resource = buffers.data()[i];
+    vkd.DestroyBuffer(device, resource.buffer, vkAllocator);
+    memory->free(resource.allocation);
+  }
+  buffers.clear();
+
+  for (uint32_t i = 0; i < images.size(); i++) {
+    ImageResource &resource = images.data()[i];
+    if (resource.view != VK_NULL_HANDLE)
+      vkd.DestroyImageView(device, resource.view, vkAllocator);
+    vkd.DestroyImage(device, resource.image, vkAllocator);
+    memory->free(resource.allocation);
+  }
+  images.clear();
+}
+
+void VulkanResources::flush() {
+  while (!pending.empty()) {
+    release(pending.front());
+    pending.pop_front();
+  }
+}
+
+void VulkanResources::beginFrame() {
+  currentFrame++;
+
+  if (timeline) {
+    uint64_t completed = timeline->completed(timelineQueue);
+    while (!pending.empty() && pending.front().value <= completed) {
+      release(pending.front());
+      pending.pop_front();
+    }
+    return;
+  }
+
+  while (!pending.empty() &&
+         pending.front().frame + framesInFlight <= currentFrame) {
+    release(pending.front());
+    pending.pop_front();
+  }
+}
+
+ResourceHandle VulkanResources::createBuffer(
+    const VkBufferCreateInfo &bufferInfo, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, AllocationStrategy strategy,
+    MemoryCategory category) {
+  BufferResource resource = {};
+  resource.size = bufferInfo.size;
+
+  VkResult result =
+      vkd.CreateBuffer(device, &bufferInfo, vkAllocator, &resource.buffer);
+  assert(result == VK_SUCCESS);
+
+  resource.allocation = memory->allocateBuffer(resource.buffer, required,
+                                               preferred, strategy, category);
+
+  return buffers.insert(resource);
+}
+
+ResourceHandle VulkanResources::createImage(const VkImageCreateInfo &imageInfo,
+                                            VkImageAspectFlags aspects,
+                                            VkMemoryPropertyFlags required,
+                                            VkMemoryPropertyFlags preferred,
+                                            AllocationStrategy strategy,
+                                            MemoryCategory category) {
+  ImageResource resource = {};
+  resource.format = imageInfo.format;
+  resource.extent = imageInfo.extent;
+
+  VkResult result =
+      vkd.CreateImage(device, &imageInfo, vkAllocator, &resource.image);
+  assert(result == VK_SUCCESS);
+
+  resource.allocation =
+      memory->allocateImage(resource.image, imageInfo.tiling, required,
+                            preferred, strategy, category);
+
+  VkImageViewCreateInfo viewInfo = {};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.pNext = NULL;
+  viewInfo.flags = 0;
+  viewInfo.image = resource.image;
+  viewInfo.format = imageInfo.format;
+  viewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+                         VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+  viewInfo.subresourceRange = VulkanTools::subresourceRange(aspects);
+
+  switch (imageInfo.imageType) {
+    case VK_IMAGE_TYPE_1D:
+      viewInfo.viewType = imageInfo.arrayLayers > 1
+                              ? VK_IMAGE_VIEW_TYPE_1D_ARRAY
+                              : VK_IMAGE_VIEW_TYPE_1D;
+      break;
+    case VK_IMAGE_TYPE_3D:
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+      break;
+    default:
+      viewInfo.viewType = imageInfo.arrayLayers > 1
+                              ? VK_IMAGE_VIEW_TYPE_2D_ARRAY
+                              : VK_IMAGE_VIEW_TYPE_2D;
+      break;
+  }
+
+  result = vkd.CreateImageView(device, &viewInfo, vkAllocator, &resource.view);
+  assert(result == VK_SUCCESS);
+
+  return images.insert(resource);
+}
+
+const BufferResource *VulkanResources::buffer(ResourceHandle handle) const {
+  return buffers.get(handle);
+}
+
+const ImageResource *VulkanResources::image(ResourceHandle handle) const {
+  return images.get(handle);
+}
+
+void VulkanResources::destroyBuffer(ResourceHandle handle) {
+  BufferResource resource;
+  if (buffers.remove(handle, &resource))
+    retireBuffer(resource.buffer, resource.allocation);
+}
+
+void VulkanResources::destroyImage(ResourceHandle handle) {
+  ImageResource resource;
+  if (!images.remove(handle, &resource)) return;
+
+  if (resource.view != VK_NULL_HANDLE) retireImageView(resource.view);
+  retireImage(resource.image, resource.allocation);
+}
+
+void VulkanResources::defer(DeferredDestroy &entry) {
+  entry.frame = currentFrame;
+  entry.value = timeline ? timeline->next(timelineQueue) : 0;
+  pending.push_back(entry);
+}
+
+void VulkanResources::release(DeferredDestroy &entry) {
+  switch (entry.kind) {
+    case DESTROY_BUFFER:
+      vkd.DestroyBuffer(device, entry.buffer, vkAllocator);
+      break;
+    case DESTROY_IMAGE:
+      vkd.DestroyImage(device, entry.image, vkAllocator);
+      break;
+    case DESTROY_IMAGE_VIEW:
+      vkd.DestroyImageView(device, entry.imageView, vkAllocator);
+      break;
+    case DESTROY_FRAMEBUFFER:
+      vkd.DestroyFramebuffer(device, entry.framebuffer, vkAllocator);
+      break;
+    case DESTROY_RENDER_PASS:
+      vkd.DestroyRenderPass(device, entry.renderPass, vkAllocator);
+      break;
+    case DESTROY_PIPELINE:
+      vkd.DestroyPipeline(device, entry.pipeline, vkAllocator);
+      break;
+    case DESTROY_PIPELINE_LAYOUT:
+      vkd.DestroyPipelineLayout(device, entry.pipelineLayout, vkAllocator);
+      break;
+    case DESTROY_SAMPLER:
+      vkd.DestroySampler(device, entry.sampler, vkAllocator);
+      break;
+    case DESTROY_SHADER_MODULE:
+      vkd.DestroyShaderModule(device, entry.shaderModule, vkAllocator);
+      break;
+    case DESTROY_MEMORY:
+      break;
+    case DESTROY_CALLBACK:
+      entry.callback();
+      break;
+  }
+
+  memory->free(entry.allocation);
+}
+
+void VulkanResources::retireBuffer(VkBuffer buffer,
+                                   const MemoryAllocation &allocation) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_BUFFER;
+  entry.buffer = buffer;
+  entry.allocation = allocation;
+  defer(entry);
+}
+
+void VulkanResources::retireImage(VkImage image,
+                                  const MemoryAllocation &allocation) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_IMAGE;
+  entry.image = image;
+  entry.allocation = allocation;
+  defer(entry);
+}
+
+void VulkanResources::retireMemory(const MemoryAllocation &allocation) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_MEMORY;
+  entry.allocation = allocation;
+  defer(entry);
+}
+
+void VulkanResources::retireImageView(VkImageView imageView) {
+  // Listeners retire whatever references the view first, so those objects
+  // are released before the view itself.
+  for (uint32_t i = 0; i < viewListeners.size(); i++)
+    viewListeners[i](imageView);
+
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_IMAGE_VIEW;
+  entry.imageView = imageView;
+  defer(entry);
+}
+
+void VulkanResources::retireFramebuffer(VkFramebuffer framebuffer) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_FRAMEBUFFER;
+  entry.framebuffer = framebuffer;
+  defer(entry);
+}
+
+void VulkanResources::retireRenderPass(VkRenderPass renderPass) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_RENDER_PASS;
+  entry.renderPass = renderPass;
+  defer(entry);
+}
+
+void VulkanResources::retirePipeline(VkPipeline pipeline) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_PIPELINE;
+  entry.pipeline = pipeline;
+  defer(entry);
+}
+
+void VulkanResources::retirePipelineLayout(VkPipelineLayout pipelineLayout) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_PIPELINE_LAYOUT;
+  entry.pipelineLayout = pipelineLayout;
+  defer(entry);
+}
+
+void VulkanResources::retireSampler(VkSampler sampler) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_SAMPLER;
+  entry.sampler = sampler;
+  defer(entry);
+}
+
+void VulkanResources::retireShaderModule(VkShaderModule shaderModule) {
+  for (uint32_t i = 0; i < moduleListeners.size(); i++)
+    moduleListeners[i](shaderModule);
+
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_SHADER_MODULE;
+  entry.shaderModule = shaderModule;
+  defer(entry);
+}
+
+void VulkanResources::retireCallback(const std::function<void()> &callback) {
+  DeferredDestroy entry = {};
+  entry.kind = DESTROY_CALLBACK;
+  entry.callback = callback;
+  defer(entry);
+}
+
+void VulkanResources::addViewListener(const ViewListener &listener) {
+  viewListeners.push_back(listener);
+}
+
+void VulkanResources::addModuleListener(const ModuleListener &listener) {
+  moduleListeners.push_back(listener);
+}
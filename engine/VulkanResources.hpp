@@ -0,0 +1,215 @@
+#ifndef VULKAN_RESOURCES_HPP
+#define VULKAN_RESOURCES_HPP
+
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "VulkanMemory.hpp"
+#include "VulkanTimeline.hpp"
+#include "VulkanTools.hpp"
+
+struct ResourceHandle {
+  uint32_t index;
+  uint32_t generation;
+
+  ResourceHandle() : index(UINT32_MAX), generation(0) {}
+  bool valid() const { return index != UINT32_MAX; }
+};
+
+template <typename T>
+class HandleTable {
+ public:
+  ResourceHandle insert(const T &item) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    } else {
+      slot = sparse.size();
+      sparse.push_back(0);
+      generations.push_back(1);
+    }
+
+    sparse[slot] = items.size();
+    items.push_back(item);
+    owners.push_back(slot);
+
+    ResourceHandle handle;
+    handle.index = slot;
+    handle.generation = generations[slot];
+    return handle;
+  }
+
+  bool contains(ResourceHandle handle) const {
+    return handle.index < sparse.size() &&
+           generations[handle.index] == handle.generation;
+  }
+
+  T *get(ResourceHandle handle) {
+    return contains(handle) ? &items[sparse[handle.index]] : NULL;
+  }
+
+  const T *get(ResourceHandle handle) const {
+    return contains(handle) ? &items[sparse[handle.index]] : NULL;
+  }
+
+  bool remove(ResourceHandle handle, T *removed = NULL) {
+    if (!contains(handle)) return false;
+
+    uint32_t dense = sparse[handle.index];
+    uint32_t last = items.size() - 1;
+    if (removed) *removed = items[dense];
+
+    items[dense] = items[last];
+    owners[dense] = owners[last];
+    sparse[owners[dense]] = dense;
+    items.pop_back();
+    owners.pop_back();
+
+    generations[handle.index]++;
+    freeSlots.push_back(handle.index);
+    return true;
+  }
+
+  void clear() {
+    for (uint32_t i = 0; i < owners.size(); i++) {
+      generations[owners[i]]++;
+      freeSlots.push_back(owners[i]);
+    }
+    items.clear();
+    owners.clear();
+  }
+
+  uint32_t size() const { return items.size(); }
+  T *data() { return items.data(); }
+  const T *data() const { return items.data(); }
+
+ private:
+  std::vector<T> items;
+  std::vector<uint32_t> owners;
+  std::vector<uint32_t> sparse;
+  std::vector<uint32_t> generations;
+  std::vector<uint32_t> freeSlots;
+};
+
+struct BufferResource {
+  VkBuffer buffer;
+  VkDeviceSize size;
+  MemoryAllocation allocation;
+};
+
+struct ImageResource {
+  VkImage image;
+  VkImageView view;
+  VkFormat format;
+  VkExtent3D extent;
+  MemoryAllocation allocation;
+};
+
+enum DestroyKind {
+  DESTROY_BUFFER = 0,
+  DESTROY_IMAGE,
+  DESTROY_IMAGE_VIEW,
+  DESTROY_FRAMEBUFFER,
+  DESTROY_RENDER_PASS,
+  DESTROY_PIPELINE,
+  DESTROY_PIPELINE_LAYOUT,
+  DESTROY_SAMPLER,
+  DESTROY_SHADER_MODULE,
+  DESTROY_MEMORY,
+  DESTROY_CALLBACK
+};
+
+struct DeferredDestroy {
+  DestroyKind kind;
+  uint64_t frame;
+  uint64_t value;
+  union {
+    VkBuffer buffer;
+    VkImage image;
+    VkImageView imageView;
+    VkFramebuffer framebuffer;
+    VkRenderPass renderPass;
+    VkPipeline pipeline;
+    VkPipelineLayout pipelineLayout;
+    VkSampler sampler;
+    VkShaderModule shaderModule;
+  };
+  MemoryAllocation allocation;
+  std::function<void()> callback;
+};
+
+// Retired objects are destroyed once the GPU can no longer be using them:
+// framesInFlight frames later by default, or as soon as the tracked queue's
+// timeline passes the value it was retired at. The tracked queue should be
+// the one every other queue's frame work ends up waited on by.
+class VulkanResources {
+ public:
+  typedef std::function<void(VkImageView imageView)> ViewListener;
+  typedef std::function<void(VkShaderModule shaderModule)> ModuleListener;
+
+  VulkanResources();
+  void init(VkDevice device, VulkanMemory &memory, uint32_t framesInFlight);
+  void track(VulkanTimeline &timeline, VkQueue queue);
+  void destroy();
+
+  void beginFrame();
+  void flush();
+  uint64_t frameNumber() const { return currentFrame; }
+
+  ResourceHandle createBuffer(const VkBufferCreateInfo &bufferInfo,
+                              VkMemoryPropertyFlags required,
+                              VkMemoryPropertyFlags preferred = 0,
+                              AllocationStrategy strategy =
+                                  ALLOCATION_FREE_LIST,
+                              MemoryCategory category = MEMORY_OTHER);
+  ResourceHandle createImage(const VkImageCreateInfo &imageInfo,
+                             VkImageAspectFlags aspects,
+                             VkMemoryPropertyFlags required,
+                             VkMemoryPropertyFlags preferred = 0,
+                             AllocationStrategy strategy =
+                                 ALLOCATION_FREE_LIST,
+                             MemoryCategory category = MEMORY_OTHER);
+  const BufferResource *buffer(ResourceHandle handle) const;
+  const ImageResource *image(ResourceHandle handle) const;
+  void destroyBuffer(ResourceHandle handle);
+  void destroyImage(ResourceHandle handle);
+
+  void retireBuffer(VkBuffer buffer,
+                    const MemoryAllocation &allocation = MemoryAllocation());
+  void retireImage(VkImage image,
+                   const MemoryAllocation &allocation = MemoryAllocation());
+  void retireMemory(const MemoryAllocation &allocation);
+  void retireImageView(VkImageView imageView);
+  void retireFramebuffer(VkFramebuffer framebuffer);
+  void retireRenderPass(VkRenderPass renderPass);
+  void retirePipeline(VkPipeline pipeline);
+  void retirePipelineLayout(VkPipelineLayout pipelineLayout);
+  void retireSampler(VkSampler sampler);
+  void retireShaderModule(VkShaderModule shaderModule);
+  void retireCallback(const std::function<void()> &callback);
+  void addViewListener(const ViewListener &listener);
+  void addModuleListener(const ModuleListener &listener);
+
+  HandleTable<BufferResource> buffers;
+  HandleTable<ImageResource> images;
+
+ private:
+  VkDevice device;
+  VulkanMemory *memory;
+  uint32_t framesInFlight;
+  uint64_t currentFrame;
+  VulkanTimeline *timeline;
+  VkQueue timelineQueue;
+  std::deque<DeferredDestroy> pending;
+  std::vector<ViewListener> viewListeners;
+  std::vector<ModuleListener> moduleListeners;
+
+  void defer(DeferredDestroy &entry);
+  void release(DeferredDestroy &entry);
+};
+
+#endif
@@ -0,0 +1,610 @@
+#include "VulkanShaders.hpp"
+
+#define SPIRV_MAGIC 0x07230203
+#define SPIRV_HEADER_WORDS 5
+
+enum SpirvOp {
+  SPIRV_OP_ENTRY_POINT = 15,
+  SPIRV_OP_TYPE_INT = 21,
+  SPIRV_OP_TYPE_FLOAT = 22,
+  SPIRV_OP_TYPE_VECTOR = 23,
+  SPIRV_OP_TYPE_MATRIX = 24,
+  SPIRV_OP_TYPE_IMAGE = 25,
+  SPIRV_OP_TYPE_SAMPLER = 26,
+  SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+  SPIRV_OP_TYPE_ARRAY = 28,
+  SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+  SPIRV_OP_TYPE_STRUCT = 30,
+  SPIRV_OP_TYPE_POINTER = 32,
+  SPIRV_OP_CONSTANT = 43,
+  SPIRV_OP_VARIABLE = 59,
+  SPIRV_OP_DECORATE = 71,
+  SPIRV_OP_MEMBER_DECORATE = 72
+};
+
+enum SpirvDecoration {
+  SPIRV_DECORATION_BLOCK = 2,
+  SPIRV_DECORATION_BUFFER_BLOCK = 3,
+  SPIRV_DECORATION_ARRAY_STRIDE = 6,
+  SPIRV_DECORATION_MATRIX_STRIDE = 7,
+  SPIRV_DECORATION_BINDING = 33,
+  SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+  SPIRV_DECORATION_OFFSET = 35
+};
+
+enum SpirvStorageClass {
+  SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+  SPIRV_STORAGE_UNIFORM = 2,
+  SPIRV_STORAGE_PUSH_CONSTANT = 9,
+  SPIRV_STORAGE_STORAGE_BUFFER = 12
+};
+
+struct SpirvId {
+  uint32_t opcode;
+  uint32_t word1;
+  uint32_t word2;
+  uint32_t word3;
+  uint32_t sampled;
+  uint32_t constant;
+  uint32_t set;
+  uint32_t binding;
+  uint32_t arrayStride;
+  bool block;
+  bool bufferBlock;
+  std::vector<uint32_t> members;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> matrixStrides;
+};
+
+static VkShaderStageFlags executionStage(uint32_t model) {
+  switch (model) {
+    case 0:
+      return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+      return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+      return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+      return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+      return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+      return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+      return 0;
+  }
+}
+
+static uint32_t typeSize(const std::vector<SpirvId> &ids, uint32_t type,
+                         uint32_t matrixStride) {
+  if (type >= ids.size()) return 0;
+  const SpirvId &id = ids[type];
+
+  switch (id.opcode) {
+    case SPIRV_OP_TYPE_INT:
+    case SPIRV_OP_TYPE_FLOAT:
+      return id.word1 / 8;
+    case SPIRV_OP_TYPE_VECTOR:
+      return typeSize(ids, id.word1, 0) * id.word2;
+    case SPIRV_OP_TYPE_MATRIX:
+      return (matrixStride ? matrixStride : typeSize(ids, id.word1, 0)) *
+             id.word2;
+    case SPIRV_OP_TYPE_ARRAY: {
+      uint32_t length = id.word2 < ids.size() ? ids[id.word2].constant : 0;
+      uint32_t stride =
+          id.arrayStride ? id.arrayStride : typeSize(ids, id.word1, 0);
+      return stride * length;
+    }
+    case SPIRV_OP_TYPE_STRUCT: {
+      uint32_t size = 0;
+      for (uint32_t i = 0; i < id.members.size(); i++) {
+        uint32_t offset = i < id.offsets.size() ? id.offsets[i] : size;
+        uint32_t stride =
+            i < id.matrixStrides.size() ? id.matrixStrides[i] : 0;
+        uint32_t end = offset + typeSize(ids, id.members[i], stride);
+        if (end > size) size = end;
+      }
+      return size;
+    }
+    default:
+      return 0;
+  }
+}
+
+static bool descriptorType(const std::vector<SpirvId> &ids, uint32_t type,
+                           uint32_t storage, VkDescriptorType &result,
+                           uint32_t &count) {
+  count = 1;
+
+  while (type < ids.size() &&
+         (ids[type].opcode == SPIRV_OP_TYPE_ARRAY ||
+          ids[type].opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY)) {
+    const SpirvId &array = ids[type];
+    if (array.opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY)
+      count = 0;
+    else if (array.word2 < ids.size())
+      count *= ids[array.word2].constant;
+    type = array.word1;
+  }
+
+  if (type >= ids.size()) return false;
+  const SpirvId &id = ids[type];
+
+  switch (id.opcode) {
+    case SPIRV_OP_TYPE_SAMPLER:
+      result = VK_DESCRIPTOR_TYPE_SAMPLER;
+      return true;
+    case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+      result = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      return true;
+    case SPIRV_OP_TYPE_IMAGE:
+      // Dim 5 is Buffer (texel buffers) and 6 is SubpassData.
+      if (id.word2 == 6)
+        result = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      else if (id.word2 == 5)
+        result = id.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                 : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      else
+        result = id.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                                 : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+      return true;
+    case SPIRV_OP_TYPE_STRUCT:
+      if (storage == SPIRV_STORAGE_STORAGE_BUFFER || id.bufferBlock)
+        result = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      else
+        result = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool VulkanSpirv::reflect(const uint32_t *code, size_t wordCount,
+                          ShaderReflection &reflection) {
+  reflection.stages = 0;
+  reflection.pushConstantSize = 0;
+  reflection.bindings.clear();
+
+  if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) return false;
+
+  uint32_t bound = code[3];
+  std::vector<SpirvId> ids(bound);
+  std::vector<uint32_t> variables;
+
+  size_t word = SPIRV_HEADER_WORDS;
+  while (word < wordCount) {
+    uint32_t opcode = code[word] & 0xffff;
+    uint32_t length = code[word] >> 16;
+    if (length == 0 || word + length > wordCount) return false;
+
+    const uint32_t *op = code + word;
+    uint32_t target = length > 1 ? op[1] : 0;
+
+    switch (opcode) {
+      case SPIRV_OP_ENTRY_POINT:
+        reflection.stages |= executionStage(op[1]);
+        break;
+      case SPIRV_OP_TYPE_INT:
+      case SPIRV_OP_TYPE_FLOAT:
+      case SPIRV_OP_TYPE_VECTOR:
+      case SPIRV_OP_TYPE_MATRIX:
+      case SPIRV_OP_TYPE_SAMPLER:
+      case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+      case SPIRV_OP_TYPE_ARRAY:
+      case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+      case SPIRV_OP_TYPE_POINTER:
+      case SPIRV_OP_TYPE_IMAGE:
+        if (target >= bound) return false;
+        ids[target].opcode = opcode;
+        ids[target].word1 = length > 2 ? op[2] : 0;
+        ids[target].word2 = length > 3 ? op[3] : 0;
+        ids[target].word3 = length > 4 ? op[4] : 0;
+        if (opcode == SPIRV_OP_TYPE_IMAGE && length > 7)
+          ids[target].sampled = op[7];
+        break;
+      case SPIRV_OP_TYPE_STRUCT:
+        if (target >= bound) return false;
+        ids[target].opcode = opcode;
+        ids[target].members.assign(op + 2, op + length);
+        break;
+      case SPIRV_OP_CONSTANT:
+        if (length > 3 && op[2] < bound) ids[op[2]].constant = op[3];
+        break;
+      case SPIRV_OP_VARIABLE:
+        if (length < 4 || op[2] >= bound) return false;
+        ids[op[2]].opcode = opcode;
+        ids[op[2]].word1 = op[1];
+        ids[op[2]].word2 = op[3];
+        variables.push_back(op[2]);
+        break;
+      case SPIRV_OP_DECORATE:
+        if (length < 3 || target >= bound) break;
+        if (op[2] == SPIRV_DECORATION_BLOCK) ids[target].block = true;
+        if (op[2] == SPIRV_DECORATION_BUFFER_BLOCK)
+          ids[target].bufferBlock = true;
+        if (length < 4) break;
+        if (op[2] == SPIRV_DECORATION_DESCRIPTOR_SET) ids[target].set = op[3];
+        if (op[2] == SPIRV_DECORATION_BINDING) ids[target].binding = op[3];
+        if (op[2] == SPIRV_DECORATION_ARRAY_STRIDE)
+          ids[target].arrayStride = op[3];
+        break;
+      case SPIRV_OP_MEMBER_DECORATE: {
+        if (length < 5 || target >= bound) break;
+        uint32_t member = op[2];
+        std::vector<uint32_t> *values = NULL;
+        if (op[3] == SPIRV_DECORATION_OFFSET) values = &ids[target].offsets;
+        if (op[3] == SPIRV_DECORATION_MATRIX_STRIDE)
+          values = &ids[target].matrixStrides;
+        if (!values) break;
+        if (values->size() <= member) values->resize(member + 1, 0);
+        (*values)[member] = op[4];
+        break;
+      }
+      default:
+        break;
+    }
+
+    word += length;
+  }
+
+  for (uint32_t i = 0; i < variables.size(); i++) {
+    const SpirvId &variable = ids[variables[i]];
+    uint32_t storage = variable.word2;
+    if (variable.word1 >= bound) continue;
+
+    const SpirvId &pointer = ids[variable.word1];
+    if (pointer.opcode != SPIRV_OP_TYPE_POINTER) continue;
+    uint32_t pointee = pointer.word2;
+
+    if (storage == SPIRV_STORAGE_PUSH_CONSTANT) {
+      uint32_t size = typeSize(ids, pointee, 0);
+      if (size > reflection.pushConstantSize)
+        reflection.pushConstantSize = size;
+      continue;
+    }
+
+    if (storage != SPIRV_STORAGE_UNIFORM_CONSTANT &&
+        storage != SPIRV_STORAGE_UNIFORM &&
+        storage != SPIRV_STORAGE_STORAGE_BUFFER)
+      continue;
+
+    ShaderBinding binding;
+    binding.set = variable.set;
+    binding.binding = variable.binding;
+    if (!descriptorType(ids, pointee, storage, binding.type, binding.count))
+      continue;
+
+    reflection.bindings.push_back(binding);
+  }
+
+  return true;
+}
+
+DescriptorLayoutKey ShaderReflection::layoutKey(uint32_t set) const {
+  DescriptorLayoutKey key;
+  for (uint32_t i = 0; i < bindings.size(); i++)
+    if (bindings[i].set == set)
+      key.add(bindings[i].binding, bindings[i].type, stages,
+              bindings[i].count);
+  return key;
+}
+
+VulkanShaders::VulkanShaders()
+    : device(VK_NULL_HANDLE),
+      resources(NULL),
+      reflectionDirty(false),
+      watching(false) {
+  emptyReflection.stages = 0;
+  emptyReflection.pushConstantSize = 0;
+}
+
+VulkanShaders::~VulkanShaders() { destroy(); }
+
+void VulkanShaders::init(VkDevice device, VulkanResources &resources,
+                         bool hotReload, const char *reflectionPath) {
+  this->device = device;
+  this->resources = &resources;
+
+  if (!reflectionPath) reflectionPath = getenv(SHADER_REFLECTION_ENV);
+  this->reflectionPath =
+      reflectionPath ? reflectionPath : SHADER_REFLECTION_FILE;
+  loadReflection();
+
+  if (hotReload) {
+    watching = true;
+    watcher = std::thread(&VulkanShaders::watchLoop, this);
+  }
+}
+
+void VulkanShaders::destroy() {
+  if (watcher.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(watchMutex);
+      watching = false;
+    }
+    wake.notify_all();
+    watcher.join();
+  }
+
+  if (device == VK_NULL_HANDLE) return;
+
+  for (uint32_t i = 0; i < reloads.size(); i++)
+    vkd.DestroyShaderModule(device, reloads[i].module, vkAllocator);
+  reloads.clear();
+
+  std::unordered_map<uint64_t, ShaderModuleEntry>::iterator it;
+  for (it = modules.begin(); it != modules.end(); ++it)
+    vkd.DestroyShaderModule(device, it->second.module, vkAllocator);
+  modules.clear();
+  shaders.clear();
+  watches.clear();
+
+  if (reflectionDirty) saveReflection();
+  device = VK_NULL_HANDLE;
+}
+
+bool VulkanShaders::prepare(const char *path, VulkanTools::MappedFile &file,
+                            uint64_t &hash, ShaderReflection &reflection) {
+  if (!file.open(path) || file.size() % sizeof(uint32_t) != 0) return false;
+
+  hash = VulkanTools::hashBytes(file.data(), file.size());
+
+  std::lock_guard<std::mutex> lock(reflectionMutex);
+  std::unordered_map<uint64_t, ShaderReflection>::iterator cached =
+      reflections.find(hash);
+  if (cached != reflections.end()) {
+    reflection = cached->second;
+    return true;
+  }
+
+  if (!VulkanSpirv::reflect((const uint32_t *)file.data(),
+                            file.size() / sizeof(uint32_t), reflection))
+    return false;
+
+  reflections[hash] = reflection;
+  reflectionDirty = true;
+  return true;
+}
+
+VkShaderModule VulkanShaders::createModule(const void *code, size_t size) {
+  VkShaderModuleCreateInfo moduleInfo = {};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.pNext = NULL;
+  moduleInfo.flags = 0;
+  moduleInfo.codeSize = size;
+  moduleInfo.pCode = (const uint32_t *)code;
+
+  VkShaderModule module;
+  VkResult result =
+      vkd.CreateShaderModule(device, &moduleInfo, vkAllocator, &module);
+  assert(result == VK_SUCCESS);
+
+  return module;
+}
+
+void VulkanShaders::releaseModule(uint64_t hash) {
+  std::unordered_map<uint64_t, ShaderModuleEntry>::iterator it =
+      modules.find(hash);
+  if (it == modules.end() || --it->second.references > 0) return;
+
+  resources->retireShaderModule(it->second.module);
+  modules.erase(it);
+}
+
+std::string VulkanShaders::path(const char *name) {
+  const char *dir = getenv(SHADER_DIR_ENV);
+  return std::string(dir ? dir : SHADER_DIR) + "/" + name;
+}
+
+uint32_t VulkanShaders::load(const char *path) {
+  VulkanTools::MappedFile file;
+  ShaderEntry entry;
+  entry.path = path;
+
+  if (!prepare(path, file, entry.hash, entry.reflection)) {
+    fprintf(stderr, "Failed to load shader %s\n", path);
+    return SHADER_INVALID;
+  }
+
+  std::unordered_map<uint64_t, ShaderModuleEntry>::iterator it =
+      modules.find(entry.hash);
+  if (it != modules.end()) {
+    it->second.references++;
+    entry.module = it->second.module;
+  } else {
+    entry.module = createModule(file.data(), file.size());
+    ShaderModuleEntry moduleEntry = {entry.module, 1};
+    modules[entry.hash] = moduleEntry;
+  }
+
+  uint32_t shader = shaders.size();
+  shaders.push_back(entry);
+
+  if (watcher.joinable()) {
+    ShaderWatch watch;
+    watch.shader = shader;
+    watch.path = path;
+    watch.modified = VulkanTools::fileModifiedTime(path);
+
+    std::lock_guard<std::mutex> lock(watchMutex);
+    watches.push_back(watch);
+  }
+
+  return shader;
+}
+
+VkShaderModule VulkanShaders::module(uint32_t shader) const {
+  return shader < shaders.size() ? shaders[shader].module : VK_NULL_HANDLE;
+}
+
+const ShaderReflection &VulkanShaders::reflection(uint32_t shader) const {
+  return shader < shaders.size() ? shaders[shader].reflection
+                                 : emptyReflection;
+}
+
+uint32_t VulkanShaders::applyReloads(std::vector<uint32_t> *reloaded) {
+  std::vector<ShaderReload> ready;
+  {
+    std::lock_guard<std::mutex> lock(watchMutex);
+    if (reloads.empty()) return 0;
+    ready.swap(reloads);
+  }
+
+  uint32_t applied = 0;
+
+  for (uint32_t i = 0; i < ready.size(); i++) {
+    const ShaderReload &reload = ready[i];
+    ShaderEntry &entry = shaders[reload.shader];
+
+    if (reload.hash == entry.hash) {
+      vkd.DestroyShaderModule(device, reload.module, vkAllocator);
+      continue;
+    }
+
+    std::unordered_map<uint64_t, ShaderModuleEntry>::iterator it =
+        modules.find(reload.hash);
+    if (it != modules.end()) {
+      it->second.references++;
+      vkd.DestroyShaderModule(device, reload.module, vkAllocator);
+    } else {
+      ShaderModuleEntry moduleEntry = {reload.module, 1};
+      it = modules.insert(std::make_pair(reload.hash, moduleEntry)).first;
+    }
+
+    // Pipelines still in flight keep the old module until it retires.
+    releaseModule(entry.hash);
+    entry.hash = reload.hash;
+    entry.module = it->second.module;
+    entry.reflection = reload.reflection;
+
+    if (reloaded) reloaded->push_back(reload.shader);
+    applied++;
+    fprintf(stdout, "Reloaded shader %s\n", entry.path.c_str());
+  }
+
+  return applied;
+}
+
+void VulkanShaders::watchLoop() {
+  std::unique_lock<std::mutex> lock(watchMutex);
+
+  while (watching) {
+    wake.wait_for(lock,
+                  std::chrono::milliseconds(SHADER_RELOAD_INTERVAL_MS));
+    if (!watching) break;
+
+    std::vector<ShaderWatch> current = watches;
+    lock.unlock();
+
+    std::vector<ShaderReload> found;
+    for (uint32_t i = 0; i < current.size(); i++) {
+      int64_t modified = VulkanTools::fileModifiedTime(current[i].path.c_str());
+      if (modified == current[i].modified) continue;
+      current[i].modified = modified;
+
+      VulkanTools::MappedFile file;
+      ShaderReload reload;
+      reload.shader = current[i].shader;
+      if (!prepare(current[i].path.c_str(), file, reload.hash,
+                   reload.reflection)) {
+        fprintf(stderr, "Failed to reload shader %s\n",
+                current[i].path.c_str());
+        continue;
+      }
+
+      reload.module = createModule(file.data(), file.size());
+      found.push_back(reload);
+    }
+
+    lock.lock();
+    for (uint32_t i = 0; i < current.size(); i++)
+      watches[i].modified = current[i].modified;
+    reloads.insert(reloads.end(), found.begin(), found.end());
+  }
+}
+
+void VulkanShaders::loadReflection() {
+  VulkanTools::MappedFile file;
+  if (!file.open(reflectionPath.c_str())) return;
+
+  const uint32_t *words = (const uint32_t *)file.data();
+  size_t wordCount = file.size() / sizeof(uint32_t);
+  if (wordCount < 3 || words[0] != SHADER_REFLECTION_MAGIC ||
+      words[1] != SHADER_REFLECTION_VERSION)
+    return;
+
+  uint32_t count = words[2];
+  size_t word = 3;
+
+  // Each entry is the 64-bit hash, stages, push constant size and binding
+  // count, followed by four words per binding.
+  for (uint32_t i = 0; i < count; i++) {
+    if (word + 5 > wordCount) break;
+
+    uint64_t hash = words[word] | ((uint64_t)words[word + 1] << 32);
+    ShaderReflection reflection;
+    reflection.stages = words[word + 2];
+    reflection.pushConstantSize = words[word + 3];
+    uint32_t bindingCount = words[word + 4];
+    word += 5;
+
+    if (word + bindingCount * 4 > wordCount) break;
+
+    reflection.bindings.resize(bindingCount);
+    for (uint32_t j = 0; j < bindingCount; j++, word += 4) {
+      reflection.bindings[j].set = words[word];
+      reflection.bindings[j].binding = words[word + 1];
+      reflection.bindings[j].type = (VkDescriptorType)words[word + 2];
+      reflection.bindings[j].count = words[word + 3];
+    }
+
+    reflections[hash] = reflection;
+  }
+
+  fprintf(stdout, "Shader Cache:   %s (%u reflections)\n",
+          reflectionPath.c_str(), (uint32_t)reflections.size());
+}
+
+bool VulkanShaders::saveReflection() {
+  std::lock_guard<std::mutex> lock(reflectionMutex);
+
+  std::vector<uint32_t> words;
+  words.push_back(SHADER_REFLECTION_MAGIC);
+  words.push_back(SHADER_REFLECTION_VERSION);
+  words.push_back(reflections.size());
+
+  std::unordered_map<uint64_t, ShaderReflection>::const_iterator it;
+  for (it = reflections.begin(); it != reflections.end(); ++it) {
+    const ShaderReflection &reflection = it->second;
+    words.push_back((uint32_t)it->first);
+    words.push_back((uint32_t)(it->first >> 32));
+    words.push_back(reflection.stages);
+    words.push_back(reflection.pushConstantSize);
+    words.push_back(reflection.bindings.size());
+
+    for (uint32_t i = 0; i < reflection.bindings.size(); i++) {
+      words.push_back(reflection.bindings[i].set);
+      words.push_back(reflection.bindings[i].binding);
+      words.push_back(reflection.bindings[i].type);
+      words.push_back(reflection.bindings[i].count);
+    }
+  }
+
+  std::string temporary = reflectionPath + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file) return false;
+
+  size_t size = words.size() * sizeof(uint32_t);
+  bool ok = fwrite(words.data(), 1, size, file) == size;
+  ok = fflush(file) == 0 && ok;
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok ||
+      !VulkanTools::replaceFile(temporary.c_str(), reflectionPath.c_str())) {
+    remove(temporary.c_str());
+    return false;
+  }
+
+  reflectionDirty = false;
+  return true;
+}
@@ -0,0 +1,125 @@
+#ifndef VULKAN_SHADERS_HPP
+#define VULKAN_SHADERS_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanDescriptors.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define SHADER_DIR "engine/shaders"
+#define SHADER_DIR_ENV "VULKAN_EXAMPLE_SHADER_DIR"
+#define SHADER_REFLECTION_FILE "shader_reflection.bin"
+#define SHADER_REFLECTION_ENV "VULKAN_EXAMPLE_SHADER_REFLECTION"
+#define SHADER_RELOAD_ENV "VULKAN_EXAMPLE_SHADER_RELOAD"
+#define SHADER_REFLECTION_MAGIC 0x52505653
+#define SHADER_REFLECTION_VERSION 1
+#define SHADER_RELOAD_INTERVAL_MS 250
+#define SHADER_INVALID UINT32_MAX
+
+struct ShaderBinding {
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType type;
+  uint32_t count;
+};
+
+struct ShaderReflection {
+  VkShaderStageFlags stages;
+  uint32_t pushConstantSize;
+  std::vector<ShaderBinding> bindings;
+
+  DescriptorLayoutKey layoutKey(uint32_t set) const;
+};
+
+struct ShaderModuleEntry {
+  VkShaderModule module;
+  uint32_t references;
+};
+
+struct ShaderEntry {
+  std::string path;
+  uint64_t hash;
+  VkShaderModule module;
+  ShaderReflection reflection;
+};
+
+struct ShaderReload {
+  uint32_t shader;
+  uint64_t hash;
+  VkShaderModule module;
+  ShaderReflection reflection;
+};
+
+struct ShaderWatch {
+  uint32_t shader;
+  std::string path;
+  int64_t modified;
+};
+
+namespace VulkanSpirv {
+bool reflect(const uint32_t *code, size_t wordCount,
+             ShaderReflection &reflection);
+}
+
+// Shaders are memory-mapped rather than read, and modules are shared by
+// content hash so duplicate SPIR-V is only handed to the driver once.
+// Reflection is cached on disk by the same hash, so a warm start does no
+// SPIR-V parsing at all. With hot reload on, a watcher thread rebuilds
+// changed modules off the frame loop and applyReloads() swaps them in.
+class VulkanShaders {
+ public:
+  VulkanShaders();
+  ~VulkanShaders();
+  void init(VkDevice device, VulkanResources &resources,
+            bool hotReload = false, const char *reflectionPath = NULL);
+  void destroy();
+
+  static std::string path(const char *name);
+  uint32_t load(const char *path);
+  VkShaderModule module(uint32_t shader) const;
+  const ShaderReflection &reflection(uint32_t shader) const;
+
+  uint32_t applyReloads(std::vector<uint32_t> *reloaded = NULL);
+  bool saveReflection();
+
+  uint32_t moduleCount() const { return modules.size(); }
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  std::string reflectionPath;
+  bool reflectionDirty;
+
+  std::vector<ShaderEntry> shaders;
+  std::unordered_map<uint64_t, ShaderModuleEntry> modules;
+  std::unordered_map<uint64_t, ShaderReflection> reflections;
+  std::mutex reflectionMutex;
+  ShaderReflection emptyReflection;
+
+  std::thread watcher;
+  std::mutex watchMutex;
+  std::condition_variable wake;
+  std::vector<ShaderWatch> watches;
+  std::vector<ShaderReload> reloads;
+  bool watching;
+
+  bool prepare(const char *path, VulkanTools::MappedFile &file,
+               uint64_t &hash, ShaderReflection &reflection);
+  VkShaderModule createModule(const void *code, size_t size);
+  void releaseModule(uint64_t hash);
+  void loadReflection();
+  void watchLoop();
+};
+
+#endif
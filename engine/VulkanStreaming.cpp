@@ -0,0 +1,773 @@
+#include "VulkanStreaming.hpp"
+
+static const uint8_t ktx2Identifier[12] = {0xAB, 'K',  'T',  'X', ' ',  '2',
+                                           '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+
+struct Ktx2Level {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+enum TextureTranscode {
+  TRANSCODE_NONE = 0,
+  TRANSCODE_BC1,
+  TRANSCODE_BC1_ALPHA,
+  TRANSCODE_BC2,
+  TRANSCODE_BC3
+};
+
+struct TextureFormat {
+  VkFormat format;
+  uint32_t blockBytes;
+  uint32_t blockSize;
+  TextureTranscode transcode;
+  VkFormat fallback;
+};
+
+static const TextureFormat textureFormats[] = {
+    {VK_FORMAT_R8_UNORM, 1, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_R8G8_UNORM, 2, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_R8G8B8A8_UNORM, 4, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_R8G8B8A8_SRGB, 4, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_B8G8R8A8_UNORM, 4, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_B8G8R8A8_SRGB, 4, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_R16G16B16A16_SFLOAT, 8, 1, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, 4, TRANSCODE_BC1,
+     VK_FORMAT_R8G8B8A8_UNORM},
+    {VK_FORMAT_BC1_RGB_SRGB_BLOCK, 8, 4, TRANSCODE_BC1,
+     VK_FORMAT_R8G8B8A8_SRGB},
+    {VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, 4, TRANSCODE_BC1_ALPHA,
+     VK_FORMAT_R8G8B8A8_UNORM},
+    {VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8, 4, TRANSCODE_BC1_ALPHA,
+     VK_FORMAT_R8G8B8A8_SRGB},
+    {VK_FORMAT_BC2_UNORM_BLOCK, 16, 4, TRANSCODE_BC2,
+     VK_FORMAT_R8G8B8A8_UNORM},
+    {VK_FORMAT_BC2_SRGB_BLOCK, 16, 4, TRANSCODE_BC2, VK_FORMAT_R8G8B8A8_SRGB},
+    {VK_FORMAT_BC3_UNORM_BLOCK, 16, 4, TRANSCODE_BC3,
+     VK_FORMAT_R8G8B8A8_UNORM},
+    {VK_FORMAT_BC3_SRGB_BLOCK, 16, 4, TRANSCODE_BC3, VK_FORMAT_R8G8B8A8_SRGB},
+    {VK_FORMAT_BC4_UNORM_BLOCK, 8, 4, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_BC5_UNORM_BLOCK, 16, 4, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_BC6H_UFLOAT_BLOCK, 16, 4, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_BC7_UNORM_BLOCK, 16, 4, TRANSCODE_NONE, VK_FORMAT_UNDEFINED},
+    {VK_FORMAT_BC7_SRGB_BLOCK, 16, 4, TRANSCODE_NONE, VK_FORMAT_UNDEFINED}};
+
+static const TextureFormat *textureFormat(VkFormat format) {
+  for (uint32_t i = 0; i < sizeof(textureFormats) / sizeof(textureFormats[0]);
+       i++)
+    if (textureFormats[i].format == format) return &textureFormats[i];
+  return NULL;
+}
+
+static VkDeviceSize formatBytes(const TextureFormat &info, uint32_t width,
+                                uint32_t height) {
+  VkDeviceSize blocksX = (width + info.blockSize - 1) / info.blockSize;
+  VkDeviceSize blocksY = (height + info.blockSize - 1) / info.blockSize;
+  return blocksX * blocksY * info.blockBytes;
+}
+
+static void expand565(uint16_t color, uint8_t *rgba) {
+  uint32_t r = (color >> 11) & 31;
+  uint32_t g = (color >> 5) & 63;
+  uint32_t b = color & 31;
+  rgba[0] = (r << 3) | (r >> 2);
+  rgba[1] = (g << 2) | (g >> 4);
+  rgba[2] = (b << 3) | (b >> 2);
+  rgba[3] = 255;
+}
+
+// BC1 colors, which BC2 and BC3 also use in four-color mode only.
+static void decodeColors(const uint8_t *block, bool threeColor,
+                         uint8_t texels[16][4]) {
+  uint16_t c0 = block[0] | block[1] << 8;
+  uint16_t c1 = block[2] | block[3] << 8;
+
+  uint8_t palette[4][4];
+  expand565(c0, palette[0]);
+  expand565(c1, palette[1]);
+  for (uint32_t k = 0; k < 3; k++) {
+    if (c0 > c1 || !threeColor) {
+      palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+      palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+    } else {
+      palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+      palette[3][k] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = c0 > c1 || !threeColor ? 255 : 0;
+
+  uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 |
+                     (uint32_t)block[7] << 24;
+  for (uint32_t i = 0; i < 16; i++)
+    memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+static void decodeAlpha(const uint8_t *block, TextureTranscode transcode,
+                        uint8_t texels[16][4]) {
+  if (transcode == TRANSCODE_BC2) {
+    for (uint32_t i = 0; i < 16; i++)
+      texels[i][3] = ((block[i / 2] >> ((i & 1) * 4)) & 15) * 17;
+    return;
+  }
+
+  uint32_t alpha[8];
+  alpha[0] = block[0];
+  alpha[1] = block[1];
+  if (alpha[0] > alpha[1]) {
+    for (uint32_t k = 1; k < 7; k++)
+      alpha[k + 1] = ((7 - k) * alpha[0] + k * alpha[1]) / 7;
+  } else {
+    for (uint32_t k = 1; k < 5; k++)
+      alpha[k + 1] = ((5 - k) * alpha[0] + k * alpha[1]) / 5;
+    alpha[6] = 0;
+    alpha[7] = 255;
+  }
+
+  uint64_t bits = 0;
+  for (uint32_t j = 0; j < 6; j++) bits |= (uint64_t)block[2 + j] << (8 * j);
+  for (uint32_t i = 0; i < 16; i++) texels[i][3] = alpha[(bits >> (3 * i)) & 7];
+}
+
+static void transcodeLevel(const uint8_t *source, TextureTranscode transcode,
+                           uint32_t width, uint32_t height, uint8_t *rgba) {
+  uint32_t blocksX = (width + 3) / 4;
+  uint32_t blocksY = (height + 3) / 4;
+  uint32_t blockBytes =
+      transcode == TRANSCODE_BC1 || transcode == TRANSCODE_BC1_ALPHA ? 8 : 16;
+
+  uint8_t texels[16][4];
+  for (uint32_t by = 0; by < blocksY; by++) {
+    for (uint32_t bx = 0; bx < blocksX; bx++) {
+      const uint8_t *block = source + (by * blocksX + bx) * blockBytes;
+      if (blockBytes == 8) {
+        decodeColors(block, true, texels);
+        if (transcode == TRANSCODE_BC1)
+          for (uint32_t i = 0; i < 16; i++) texels[i][3] = 255;
+      } else {
+        decodeColors(block + 8, false, texels);
+        decodeAlpha(block, transcode, texels);
+      }
+
+      for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+        for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+          memcpy(rgba + ((by * 4 + y) * width + bx * 4 + x) * 4,
+                 texels[y * 4 + x], 4);
+    }
+  }
+}
+
+VulkanTextureStreamer::VulkanTextureStreamer()
+    : physicalDevice(VK_NULL_HANDLE),
+      device(VK_NULL_HANDLE),
+      memory(NULL),
+      resources(NULL),
+      upload(NULL),
+      bindless(NULL),
+      mipmaps(NULL),
+      support(),
+      textureSampler(VK_NULL_HANDLE),
+      textureHeap(0),
+      frame(0),
+      evictBytes(0),
+      outstanding(0),
+      totals(),
+      tailCount(0),
+      fullCount(0) {}
+
+StreamingSupport VulkanTextureStreamer::query(
+    VkPhysicalDevice physicalDevice) {
+  StreamingSupport support = {};
+
+  VkPhysicalDeviceFeatures features;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+  support.compressedBC = features.textureCompressionBC == VK_TRUE;
+
+  return support;
+}
+
+void VulkanTextureStreamer::deviceFeatures(const StreamingSupport &support,
+                                           VkPhysicalDeviceFeatures &features) {
+  if (support.compressedBC) features.textureCompressionBC = VK_TRUE;
+}
+
+void VulkanTextureStreamer::init(VkPhysicalDevice physicalDevice,
+                                 VkDevice device, VulkanMemory &memory,
+                                 VulkanResources &resources,
+                                 VulkanUpload &upload,
+                                 const StreamingSupport &support,
+                                 VulkanBindless *bindless,
+                                 VulkanMipGenerator *mipmaps) {
+  this->physicalDevice = physicalDevice;
+  this->device = device;
+  this->memory = &memory;
+  this->resources = &resources;
+  this->upload = &upload;
+  this->bindless = bindless;
+  this->mipmaps = mipmaps;
+  this->support = support;
+
+  VkSamplerCreateInfo samplerInfo = {};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.pNext = NULL;
+  samplerInfo.flags = 0;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+  VkResult result =
+      vkd.CreateSampler(device, &samplerInfo, vkAllocator, &textureSampler);
+  assert(result == VK_SUCCESS);
+  debugUtils.name(VK_OBJECT_TYPE_SAMPLER, textureSampler, "texture sampler");
+
+  // Until the first texture lands, assume the heap images usually go to.
+  uint32_t memoryType =
+      memory.findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (memoryType != UINT32_MAX)
+    textureHeap = memory.memoryProperties.memoryTypes[memoryType].heapIndex;
+
+  memory.addPressureListener([this](uint32_t heap, VkDeviceSize excess) {
+    if (heap == textureHeap) evictBytes += excess;
+  });
+
+  decoders.init(TEXTURE_DECODE_THREADS);
+}
+
+void VulkanTextureStreamer::destroy() {
+  if (device == VK_NULL_HANDLE) return;
+
+  printStats();
+
+  decoders.destroy();
+  completed.clear();
+  arrived.clear();
+  outstanding = 0;
+
+  StreamedTexture *items = textures.data();
+  for (uint32_t i = 0; i < textures.size(); i++) {
+    if (items[i].image.valid()) resources->destroyImage(items[i].image);
+    if (items[i].bindlessIndex != UINT32_MAX)
+      bindless->removeImage(items[i].bindlessIndex);
+  }
+  textures.clear();
+
+  vkd.DestroySampler(device, textureSampler, vkAllocator);
+  textureSampler = VK_NULL_HANDLE;
+  device = VK_NULL_HANDLE;
+}
+
+bool VulkanTextureStreamer::sampled(VkFormat format) const {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+  return (properties.optimalTilingFeatures &
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool VulkanTextureStreamer::parse(StreamedTexture &texture) {
+  if (!texture.file->open(texture.path.c_str())) return false;
+
+  const uint8_t *data = (const uint8_t *)texture.file->data();
+  size_t size = texture.file->size();
+  if (size < sizeof(Ktx2Header)) return false;
+
+  Ktx2Header header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+    return false;
+
+  // Only plain 2D textures: no supercompression, arrays or cube maps.
+  if (header.supercompressionScheme != 0 || header.pixelWidth == 0 ||
+      header.pixelHeight == 0 || header.pixelDepth > 1 ||
+      header.layerCount > 1 || header.faceCount != 1 ||
+      header.levelCount > 32)
+    return false;
+
+  const TextureFormat *info = textureFormat((VkFormat)header.vkFormat);
+  if (!info) return false;
+
+  // A level count of 0 stores level 0 alone and leaves the rest of the
+  // chain to the loader, which can only build it for uncompressed formats
+  // the GPU can downsample.
+  uint32_t storedLevels = header.levelCount;
+  texture.generatedLevels = 0;
+  if (storedLevels == 0) {
+    if (!mipmaps || info->blockSize > 1 ||
+        mipmaps->method(info->format) == MIP_UNSUPPORTED)
+      return false;
+    uint32_t levels = VulkanMipGenerator::levelCount(header.pixelWidth,
+                                                     header.pixelHeight);
+    storedLevels = 1;
+    texture.generatedLevels = levels - 1;
+  }
+
+  size_t indexEnd = sizeof(header) + storedLevels * sizeof(Ktx2Level);
+  if (indexEnd > size) return false;
+
+  texture.levels.resize(storedLevels + texture.generatedLevels);
+  for (uint32_t i = 0; i < texture.levels.size(); i++) {
+    TextureLevel &level = texture.levels[i];
+    level.width = std::max(header.pixelWidth >> i, 1u);
+    level.height = std::max(header.pixelHeight >> i, 1u);
+    level.offset = 0;
+    level.size = formatBytes(*info, level.width, level.height);
+    if (i >= storedLevels) continue;
+
+    Ktx2Level entry;
+    memcpy(&entry, data + sizeof(header) + i * sizeof(Ktx2Level),
+           sizeof(entry));
+    level.offset = entry.byteOffset;
+    if (entry.byteOffset > size || entry.byteLength < level.size ||
+        entry.byteLength > size - entry.byteOffset)
+      return false;
+  }
+
+  texture.fileFormat = info->format;
+  texture.format = info->format;
+  texture.transcode = false;
+  bool compressed = info->blockSize > 1;
+  if (compressed && (!support.compressedBC || !sampled(info->format))) {
+    if (info->fallback == VK_FORMAT_UNDEFINED || !sampled(info->fallback))
+      return false;
+    texture.format = info->fallback;
+    texture.transcode = true;
+  } else if (!sampled(info->format)) {
+    return false;
+  }
+
+  // A generated chain is all or nothing, and level 0 has to fit the ring.
+  if (texture.generatedLevels > 0) {
+    texture.tailLevel = 0;
+    texture.maxLevel = 0;
+    return texture.levels[0].size <= upload->maxRingSize;
+  }
+
+  uint32_t count = texture.levels.size();
+  texture.tailLevel = count - 1;
+  for (uint32_t i = 0; i < count; i++) {
+    if (std::max(texture.levels[i].width, texture.levels[i].height) <=
+        TEXTURE_TAIL_SIZE) {
+      texture.tailLevel = i;
+      break;
+    }
+  }
+
+  // A level goes through the ring in one copy, so the ring's full size
+  // caps how much detail can ever be resident.
+  texture.maxLevel = texture.tailLevel;
+  while (texture.maxLevel > 0 &&
+         imageBytes(texture, texture.maxLevel - 1) -
+                 imageBytes(texture, texture.maxLevel) <=
+             upload->maxRingSize)
+    texture.maxLevel--;
+
+  return true;
+}
+
+ResourceHandle VulkanTextureStreamer::load(const char *path) {
+  StreamedTexture texture;
+  texture.path = path;
+  texture.file = std::make_shared<VulkanTools::MappedFile>();
+  if (!parse(texture)) {
+    fprintf(stderr, "Failed to load texture %s\n", path);
+    return ResourceHandle();
+  }
+
+  texture.residentLevel = texture.levels.size();
+  texture.requestedLevel = UINT32_MAX;
+  texture.serial = 0;
+  texture.wantedLevel = texture.tailLevel;
+  texture.lastDemanded = frame;
+  texture.lastNeeded = frame;
+  texture.full = false;
+  texture.bindlessIndex = UINT32_MAX;
+  texture.residentBytes = 0;
+  texture.loadStart = VulkanTrace::now();
+
+  ResourceHandle handle = textures.insert(texture);
+  textures.get(handle)->handle = handle;
+  totals.textures++;
+  return handle;
+}
+
+void VulkanTextureStreamer::unload(ResourceHandle handle) {
+  StreamedTexture texture;
+  if (!textures.remove(handle, &texture)) return;
+
+  // Any request still decoding is dropped when it arrives.
+  if (texture.image.valid()) resources->destroyImage(texture.image);
+  if (texture.bindlessIndex != UINT32_MAX)
+    bindless->removeImage(texture.bindlessIndex);
+  totals.residentBytes -= texture.residentBytes;
+}
+
+uint32_t VulkanTextureStreamer::levelFor(const StreamedTexture &texture,
+                                         float screenPixels) {
+  float largest = std::max(texture.levels[0].width, texture.levels[0].height);
+  uint32_t level = 0;
+  if (screenPixels <= 0.0f)
+    level = texture.tailLevel;
+  else if (largest > screenPixels)
+    level = (uint32_t)std::floor(std::log2(largest / screenPixels));
+
+  return std::min(std::max(level, texture.maxLevel), texture.tailLevel);
+}
+
+void VulkanTextureStreamer::demand(ResourceHandle handle, float screenPixels) {
+  StreamedTexture *texture = textures.get(handle);
+  if (!texture) return;
+
+  uint32_t level = levelFor(*texture, screenPixels);
+  if (texture->lastDemanded != frame || level < texture->wantedLevel)
+    texture->wantedLevel = level;
+  texture->lastDemanded = frame;
+  if (level <= texture->residentLevel) texture->lastNeeded = frame;
+}
+
+VkDeviceSize VulkanTextureStreamer::imageBytes(const StreamedTexture &texture,
+                                               uint32_t baseLevel) {
+  VkDeviceSize bytes = 0;
+  for (uint32_t i = baseLevel; i < texture.levels.size(); i++) {
+    const TextureLevel &level = texture.levels[i];
+    bytes += texture.transcode ? (VkDeviceSize)level.width * level.height * 4
+                               : level.size;
+  }
+  return bytes;
+}
+
+// Promotions stop short of the point where the heap would come under
+// pressure, so they never trigger the evictions that would undo them.
+bool VulkanTextureStreamer::fitsBudget(VkDeviceSize bytes) const {
+  MemoryBudget budget = memory->getBudget(textureHeap);
+  if (budget.budgetBytes == 0) return true;
+
+  return budget.usageBytes + bytes <=
+         budget.budgetBytes * MEMORY_BUDGET_PRESSURE;
+}
+
+void VulkanTextureStreamer::request(StreamedTexture &texture,
+                                    uint32_t level) {
+  TextureRequest *request = new TextureRequest();
+  request->texture = texture.handle;
+  request->serial = ++texture.serial;
+  request->baseLevel = level;
+  request->file = texture.file;
+  request->transcode = texture.transcode;
+  request->fileFormat = texture.fileFormat;
+  request->levels.assign(texture.levels.begin() + level,
+                         texture.levels.end() - texture.generatedLevels);
+  request->generatedLevels = texture.generatedLevels;
+
+  texture.requestedLevel = level;
+  outstanding++;
+
+  decoders.submit([this, request](uint32_t thread) {
+    decode(*request);
+    std::lock_guard<std::mutex> lock(completedMutex);
+    completed.push_back(std::unique_ptr<TextureRequest>(request));
+  });
+}
+
+void VulkanTextureStreamer::decode(TextureRequest &request) {
+  TRACE_ZONE("decode texture");
+  const uint8_t *data = (const uint8_t *)request.file->data();
+
+  // Touching every page now keeps the upload's copy out of the mapping
+  // from faulting on the frame thread.
+  if (!request.transcode) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < request.levels.size(); i++)
+      for (VkDeviceSize offset = 0; offset < request.levels[i].size;
+           offset += TEXTURE_PAGE_SIZE)
+        sum += data[request.levels[i].offset + offset];
+    volatile uint32_t sink = sum;
+    (void)sink;
+    return;
+  }
+
+  const TextureFormat *info = textureFormat(request.fileFormat);
+  VkDeviceSize total = 0;
+  for (uint32_t i = 0; i < request.levels.size(); i++)
+    total += (VkDeviceSize)request.levels[i].width * request.levels[i].height *
+             4;
+  request.decoded.resize(total);
+
+  VkDeviceSize offset = 0;
+  for (uint32_t i = 0; i < request.levels.size(); i++) {
+    TextureLevel &level = request.levels[i];
+    transcodeLevel(data + level.offset, info->transcode, level.width,
+                   level.height, request.decoded.data() + offset);
+    level.offset = offset;
+    level.size = (VkDeviceSize)level.width * level.height * 4;
+    offset += level.size;
+  }
+}
+
+VkDeviceSize VulkanTextureStreamer::apply(TextureRequest &request) {
+  outstanding--;
+  StreamedTexture *texture = textures.get(request.texture);
+  if (!texture || texture->serial != request.serial) return 0;
+
+  texture->requestedLevel = UINT32_MAX;
+
+  VkImageCreateInfo imageInfo = {};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.pNext = NULL;
+  imageInfo.flags = 0;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = texture->format;
+  imageInfo.extent.width = request.levels[0].width;
+  imageInfo.extent.height = request.levels[0].height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = request.levels.size() + request.generatedLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage =
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (request.generatedLevels > 0)
+    imageInfo.usage |=
+        VulkanMipGenerator::usage(mipmaps->method(texture->format));
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.queueFamilyIndexCount = 0;
+  imageInfo.pQueueFamilyIndices = NULL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  ResourceHandle image = resources->createImage(
+      imageInfo, VK_IMAGE_ASPECT_COLOR_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, ALLOCATION_FREE_LIST,
+      MEMORY_TEXTURES);
+  const ImageResource *resource = resources->image(image);
+  VkImage vkImage = resource->image;
+  VkDeviceSize bytes = resource->allocation.size;
+  uint32_t memoryType = resource->allocation.memoryType;
+  debugUtils.name(VK_OBJECT_TYPE_IMAGE, vkImage, texture->path.c_str());
+
+  const uint8_t *source = request.transcode
+                              ? request.decoded.data()
+                              : (const uint8_t *)request.file->data();
+  VkDeviceSize uploaded = 0;
+  for (uint32_t i = 0; i < request.levels.size(); i++) {
+    const TextureLevel &level = request.levels[i];
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = i;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {level.width, level.height, 1};
+    upload->uploadImage(vkImage, region, source + level.offset, level.size);
+    uploaded += level.size;
+  }
+
+  // The chain is built in the frame that acquires level 0, before anything
+  // can sample it.
+  if (request.generatedLevels > 0)
+    mipmaps->add(vkImage, texture->format, imageInfo.extent.width,
+                 imageInfo.extent.height, imageInfo.mipLevels,
+                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  // The old image stays alive until the frames sampling it have retired.
+  uint32_t previous = texture->residentLevel;
+  if (texture->image.valid()) resources->destroyImage(texture->image);
+  texture->image = image;
+  if (bindless && bindless->enabled()) {
+    if (texture->bindlessIndex != UINT32_MAX)
+      bindless->removeImage(texture->bindlessIndex);
+    texture->bindlessIndex = bindless->addImage(image, textureSampler);
+  }
+
+  texture->residentLevel = request.baseLevel;
+  totals.residentBytes += bytes - texture->residentBytes;
+  totals.peakBytes = std::max(totals.peakBytes, totals.residentBytes);
+  totals.uploadedBytes += uploaded;
+  texture->residentBytes = bytes;
+  textureHeap = memory->memoryProperties.memoryTypes[memoryType].heapIndex;
+
+  double ms = (VulkanTrace::now() - texture->loadStart) / 1000000.0;
+  if (previous == texture->levels.size()) {
+    totals.tailMs += ms;
+    tailCount++;
+  } else if (request.baseLevel < previous) {
+    totals.promotions++;
+  } else {
+    totals.evictions++;
+  }
+  if (!texture->full && request.baseLevel == texture->maxLevel) {
+    texture->full = true;
+    totals.fullMs += ms;
+    fullCount++;
+  }
+
+  return uploaded;
+}
+
+// Drops a level from the textures that have gone longest without being
+// asked for until the heap should be back under its budget.
+void VulkanTextureStreamer::evict(VkDeviceSize bytes) {
+  candidates.clear();
+  StreamedTexture *items = textures.data();
+  for (uint32_t i = 0; i < textures.size(); i++) {
+    const StreamedTexture &texture = items[i];
+    if (texture.requestedLevel != UINT32_MAX ||
+        texture.residentLevel >= texture.tailLevel)
+      continue;
+
+    uint64_t idle = frame - texture.lastDemanded;
+    candidates.push_back(std::make_pair(
+        (uint32_t)std::min<uint64_t>(idle, UINT32_MAX), i));
+  }
+  std::sort(candidates.rbegin(), candidates.rend());
+
+  VkDeviceSize freed = 0;
+  for (uint32_t i = 0; i < candidates.size() && freed < bytes; i++) {
+    StreamedTexture &texture = items[candidates[i].second];
+    uint32_t level = texture.residentLevel + 1;
+    freed += texture.residentBytes -
+             std::min(texture.residentBytes, imageBytes(texture, level));
+    request(texture, level);
+  }
+}
+
+void VulkanTextureStreamer::update() {
+  TRACE_ZONE("streaming");
+
+  {
+    std::lock_guard<std::mutex> lock(completedMutex);
+    for (uint32_t i = 0; i < completed.size(); i++)
+      arrived.push_back(std::move(completed[i]));
+    completed.clear();
+  }
+
+  // Uploads are spread over frames; the first that arrived always goes.
+  VkDeviceSize uploaded = 0;
+  uint32_t applied = 0;
+  while (applied < arrived.size() && uploaded < TEXTURE_UPLOAD_BUDGET)
+    uploaded += apply(*arrived[applied++]);
+  arrived.erase(arrived.begin(), arrived.begin() + applied);
+
+  if (evictBytes > 0) {
+    evict(evictBytes);
+    evictBytes = 0;
+  }
+
+  // Textures without their tail go first, then the ones furthest from the
+  // detail they were asked for. Lower levels are resident before higher
+  // ones since each request adds a single level.
+  candidates.clear();
+  StreamedTexture *items = textures.data();
+  for (uint32_t i = 0; i < textures.size(); i++) {
+    StreamedTexture &texture = items[i];
+    if (texture.requestedLevel != UINT32_MAX) continue;
+
+    if (texture.residentLevel == texture.levels.size()) {
+      candidates.push_back(std::make_pair(UINT32_MAX, i));
+      continue;
+    }
+
+    if (frame - texture.lastDemanded > TEXTURE_EVICT_FRAMES)
+      texture.wantedLevel = texture.tailLevel;
+
+    if (texture.wantedLevel < texture.residentLevel)
+      candidates.push_back(
+          std::make_pair(texture.residentLevel - texture.wantedLevel, i));
+    else if (texture.wantedLevel > texture.residentLevel &&
+             frame - texture.lastNeeded > TEXTURE_EVICT_FRAMES)
+      request(texture, texture.wantedLevel);
+  }
+  std::sort(candidates.rbegin(), candidates.rend());
+
+  for (uint32_t i = 0;
+       i < candidates.size() && outstanding < TEXTURE_MAX_REQUESTS; i++) {
+    StreamedTexture &texture = items[candidates[i].second];
+    bool tail = texture.residentLevel == texture.levels.size();
+    uint32_t level = tail ? texture.tailLevel : texture.residentLevel - 1;
+    if (!tail && !fitsBudget(imageBytes(texture, level))) continue;
+
+    request(texture, level);
+  }
+
+  frame++;
+}
+
+bool VulkanTextureStreamer::ready(ResourceHandle handle) const {
+  const StreamedTexture *texture = textures.get(handle);
+  return texture && texture->image.valid();
+}
+
+VkImageView VulkanTextureStreamer::view(ResourceHandle handle) const {
+  const StreamedTexture *texture = textures.get(handle);
+  if (!texture || !texture->image.valid()) return VK_NULL_HANDLE;
+
+  return resources->image(texture->image)->view;
+}
+
+uint32_t VulkanTextureStreamer::bindlessIndex(ResourceHandle handle) const {
+  const StreamedTexture *texture = textures.get(handle);
+  return texture ? texture->bindlessIndex : UINT32_MAX;
+}
+
+uint32_t VulkanTextureStreamer::residentLevel(ResourceHandle handle) const {
+  const StreamedTexture *texture = textures.get(handle);
+  return texture ? texture->residentLevel : UINT32_MAX;
+}
+
+TextureStreamStats VulkanTextureStreamer::stats() const {
+  TextureStreamStats stats = totals;
+  stats.textures = textures.size();
+  stats.tailMs = tailCount > 0 ? totals.tailMs / tailCount : 0.0;
+  stats.fullMs = fullCount > 0 ? totals.fullMs / fullCount : 0.0;
+  return stats;
+}
+
+void VulkanTextureStreamer::printStats() const {
+  if (totals.textures == 0) return;
+
+  TextureStreamStats current = stats();
+  fprintf(stdout,
+          "Textures:       %u loaded, %.1f MB resident, %.1f MB peak, "
+          "%.1f MB uploaded\n",
+          totals.textures, current.residentBytes / (1024.0 * 1024.0),
+          current.peakBytes / (1024.0 * 1024.0),
+          current.uploadedBytes / (1024.0 * 1024.0));
+  fprintf(stdout,
+          "Streaming:      tail %.2f ms, full %.2f ms, %u promotions, "
+          "%u evictions\n",
+          current.tailMs, current.fullMs, current.promotions,
+          current.evictions);
+}
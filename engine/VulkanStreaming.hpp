@@ -0,0 +1,184 @@
+#ifndef VULKAN_STREAMING_HPP
+#define VULKAN_STREAMING_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "VulkanBindless.hpp"
+#include "VulkanJobs.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanMipmaps.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanTrace.hpp"
+#include "VulkanUpload.hpp"
+
+#define TEXTURE_LOAD_ENV "VULKAN_EXAMPLE_TEXTURE"
+#define TEXTURE_DECODE_THREADS 2
+#define TEXTURE_TAIL_SIZE 128
+#define TEXTURE_MAX_REQUESTS 8
+#define TEXTURE_UPLOAD_BUDGET (4 * 1024 * 1024)
+#define TEXTURE_EVICT_FRAMES 120
+#define TEXTURE_PAGE_SIZE 4096
+
+struct StreamingSupport {
+  bool compressedBC;
+};
+
+struct TextureLevel {
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct StreamedTexture {
+  ResourceHandle handle;
+  std::string path;
+  std::shared_ptr<VulkanTools::MappedFile> file;
+  VkFormat fileFormat;
+  VkFormat format;
+  bool transcode;
+  std::vector<TextureLevel> levels;
+  // Levels past the file's only one, for files that leave the chain to the
+  // loader; the GPU fills them in from level 0.
+  uint32_t generatedLevels;
+  // Levels from tailLevel down are loaded first and never evicted;
+  // maxLevel is the most detailed level the staging ring can carry.
+  uint32_t tailLevel;
+  uint32_t maxLevel;
+  // The most detailed level on the GPU, or levels.size() before the tail
+  // has arrived, and the level an outstanding request will make resident.
+  uint32_t residentLevel;
+  uint32_t requestedLevel;
+  uint32_t serial;
+  // The most detailed level asked for in the last frame it was asked for,
+  // and the last frame that needed every resident level.
+  uint32_t wantedLevel;
+  uint64_t lastDemanded;
+  uint64_t lastNeeded;
+  bool full;
+  ResourceHandle image;
+  uint32_t bindlessIndex;
+  VkDeviceSize residentBytes;
+  uint64_t loadStart;
+};
+
+// Work for a decode thread: the levels from baseLevel down, either paged in
+// from the mapped file or transcoded into decoded.
+struct TextureRequest {
+  ResourceHandle texture;
+  uint32_t serial;
+  uint32_t baseLevel;
+  std::shared_ptr<VulkanTools::MappedFile> file;
+  bool transcode;
+  VkFormat fileFormat;
+  std::vector<TextureLevel> levels;
+  uint32_t generatedLevels;
+  std::vector<uint8_t> decoded;
+};
+
+struct TextureStreamStats {
+  uint32_t textures;
+  VkDeviceSize residentBytes;
+  VkDeviceSize peakBytes;
+  uint64_t uploadedBytes;
+  uint32_t promotions;
+  uint32_t evictions;
+  double tailMs;
+  double fullMs;
+};
+
+// Streams pre-mipped, block-compressed textures from KTX2 files. A file is
+// mapped and its header read on load(); everything else happens off the
+// frame: decode threads page each level in, or transcode BC1-3 to RGBA8 on
+// devices without BC support, and update() uploads finished levels through
+// the staging ring. A texture becomes usable once its mip tail, the levels
+// of TEXTURE_TAIL_SIZE and below, is resident. After that it is promoted a
+// level at a time toward the detail demand() asks for, while the texture
+// heap stays under MEMORY_BUDGET_PRESSURE of its budget, and loses levels
+// again when it goes unasked for TEXTURE_EVICT_FRAMES frames or the heap
+// comes under pressure. Without sparse residency a change of level
+// replaces the image with one holding exactly the resident levels, so the
+// lower levels are uploaded again from the mapping; the old image is
+// retired with the frames that may still sample it. Uncompressed files that
+// leave their mips to the loader arrive whole instead: level 0 is uploaded
+// and VulkanMipGenerator builds the rest, so they are never promoted or
+// evicted.
+class VulkanTextureStreamer {
+ public:
+  VulkanTextureStreamer();
+
+  static StreamingSupport query(VkPhysicalDevice physicalDevice);
+  static void deviceFeatures(const StreamingSupport &support,
+                             VkPhysicalDeviceFeatures &features);
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device,
+            VulkanMemory &memory, VulkanResources &resources,
+            VulkanUpload &upload, const StreamingSupport &support,
+            VulkanBindless *bindless = NULL,
+            VulkanMipGenerator *mipmaps = NULL);
+  void destroy();
+
+  ResourceHandle load(const char *path);
+  void unload(ResourceHandle texture);
+  void demand(ResourceHandle texture, float screenPixels);
+  void update();
+
+  bool ready(ResourceHandle texture) const;
+  VkImageView view(ResourceHandle texture) const;
+  uint32_t bindlessIndex(ResourceHandle texture) const;
+  uint32_t residentLevel(ResourceHandle texture) const;
+  VkSampler sampler() const { return textureSampler; }
+
+  TextureStreamStats stats() const;
+  void printStats() const;
+
+ private:
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VulkanMemory *memory;
+  VulkanResources *resources;
+  VulkanUpload *upload;
+  VulkanBindless *bindless;
+  VulkanMipGenerator *mipmaps;
+  StreamingSupport support;
+  VkSampler textureSampler;
+  uint32_t textureHeap;
+  uint64_t frame;
+  VkDeviceSize evictBytes;
+
+  HandleTable<StreamedTexture> textures;
+  VulkanJobs decoders;
+  uint32_t outstanding;
+  std::mutex completedMutex;
+  std::vector<std::unique_ptr<TextureRequest> > completed;
+  std::vector<std::unique_ptr<TextureRequest> > arrived;
+  std::vector<std::pair<uint32_t, uint32_t> > candidates;
+  TextureStreamStats totals;
+  uint32_t tailCount;
+  uint32_t fullCount;
+
+  bool parse(StreamedTexture &texture);
+  bool sampled(VkFormat format) const;
+  static uint32_t levelFor(const StreamedTexture &texture,
+                           float screenPixels);
+  static VkDeviceSize imageBytes(const StreamedTexture &texture,
+                                 uint32_t baseLevel);
+  bool fitsBudget(VkDeviceSize bytes) const;
+  void request(StreamedTexture &texture, uint32_t level);
+  void evict(VkDeviceSize bytes);
+  VkDeviceSize apply(TextureRequest &request);
+  static void decode(TextureRequest &request);
+};
+
+#endif
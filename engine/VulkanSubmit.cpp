@@ -0,0 +1,228 @@
+#include "VulkanSubmit.hpp"
+
+VulkanSubmitter::VulkanSubmitter()
+    : timelines(NULL),
+      arena(NULL),
+      frameSubmitCount(0),
+      frameBatchCount(0),
+      lastSubmits(0),
+      lastBatches(0),
+      submits(0),
+      frames(0) {}
+
+void VulkanSubmitter::init(VulkanTimeline &timeline,
+                           VulkanFrameArena &arena) {
+  timelines = timeline.enabled() ? &timeline : NULL;
+  this->arena = &arena;
+}
+
+SubmitQueue &VulkanSubmitter::find(VkQueue queue) {
+  for (uint32_t i = 0; i < queues.size(); i++)
+    if (queues[i].queue == queue) return queues[i];
+
+  SubmitQueue entry;
+  entry.queue = queue;
+  entry.batchCount = 0;
+  entry.deviceMask = 0;
+  entry.fence = VK_NULL_HANDLE;
+  queues.push_back(entry);
+  return queues.back();
+}
+
+SubmitBatch &VulkanSubmitter::batch(SubmitQueue &entry, bool wait) {
+  bool fresh = entry.batchCount == 0;
+  if (!fresh) {
+    const SubmitBatch &last = entry.batches[entry.batchCount - 1];
+    fresh = !last.signalSemaphores.empty() ||
+            (wait && !last.cmdBuffers.empty()) ||
+            last.deviceMask != entry.deviceMask;
+  }
+
+  if (fresh) {
+    if (entry.batchCount == entry.batches.size())
+      entry.batches.push_back(SubmitBatch());
+
+    SubmitBatch &next = entry.batches[entry.batchCount++];
+    next.deviceMask = entry.deviceMask;
+    next.waitSemaphores.clear();
+    next.waitValues.clear();
+    next.waitStages.clear();
+    next.waitDevices.clear();
+    next.cmdBuffers.clear();
+    next.signalSemaphores.clear();
+    next.signalValues.clear();
+    next.signalDevices.clear();
+  }
+
+  return entry.batches[entry.batchCount - 1];
+}
+
+bool VulkanSubmitter::signals(const SubmitQueue &entry,
+                              VkSemaphore semaphore) const {
+  for (uint32_t i = 0; i < entry.batchCount; i++) {
+    const std::vector<VkSemaphore> &signalled =
+        entry.batches[i].signalSemaphores;
+    if (std::find(signalled.begin(), signalled.end(), semaphore) !=
+        signalled.end())
+      return true;
+  }
+  return false;
+}
+
+void VulkanSubmitter::setDeviceMask(VkQueue queue, uint32_t deviceMask) {
+  find(queue).deviceMask = deviceMask;
+}
+
+void VulkanSubmitter::wait(VkQueue queue, VkSemaphore semaphore,
+                           VkPipelineStageFlags stages, uint32_t device) {
+  find(queue);
+
+  // Nothing pending ever waits on another queue's pending signal, so the
+  // signalling queue can always go straight away.
+  for (uint32_t i = 0; i < queues.size(); i++)
+    if (queues[i].queue != queue && signals(queues[i], semaphore))
+      flushQueue(queues[i]);
+
+  SubmitBatch &current = batch(find(queue), true);
+  current.waitSemaphores.push_back(semaphore);
+  current.waitValues.push_back(0);
+  current.waitStages.push_back(stages);
+  current.waitDevices.push_back(device);
+}
+
+void VulkanSubmitter::wait(VkQueue queue, VkQueue producer, uint64_t value,
+                           VkPipelineStageFlags stages) {
+  assert(timelines);
+  find(queue);
+  find(producer);
+
+  // Timeline waits may go ahead of their signal, but the value is only
+  // handed out when the producer's pending work is flushed.
+  if (value > timelines->submitted(producer)) flushQueue(find(producer));
+  assert(value <= timelines->submitted(producer));
+
+  SubmitBatch &current = batch(find(queue), true);
+  current.waitSemaphores.push_back(timelines->semaphore(producer));
+  current.waitValues.push_back(value);
+  current.waitStages.push_back(stages);
+  current.waitDevices.push_back(SUBMIT_FIRST_DEVICE);
+}
+
+void VulkanSubmitter::submit(VkQueue queue, VkCommandBuffer cmdBuffer) {
+  batch(find(queue), false).cmdBuffers.push_back(cmdBuffer);
+}
+
+void VulkanSubmitter::signal(VkQueue queue, VkSemaphore semaphore,
+                             uint32_t device) {
+  SubmitQueue &entry = find(queue);
+
+  // Signals close the batch they're added to but don't start one.
+  if (entry.batchCount == 0) batch(entry, false);
+  SubmitBatch &last = entry.batches[entry.batchCount - 1];
+  last.signalSemaphores.push_back(semaphore);
+  last.signalValues.push_back(0);
+  last.signalDevices.push_back(device);
+}
+
+void VulkanSubmitter::fence(VkQueue queue, VkFence fence) {
+  SubmitQueue &entry = find(queue);
+  if (entry.fence != VK_NULL_HANDLE && entry.fence != fence)
+    flushQueue(entry);
+
+  if (entry.batchCount == 0) batch(entry, false);
+  entry.fence = fence;
+}
+
+void VulkanSubmitter::flushQueue(SubmitQueue &entry) {
+  if (entry.batchCount == 0) return;
+
+  if (timelines) {
+    SubmitBatch &last = entry.batches[entry.batchCount - 1];
+    last.signalSemaphores.push_back(timelines->semaphore(entry.queue));
+    last.signalValues.push_back(timelines->advance(entry.queue));
+    last.signalDevices.push_back(SUBMIT_FIRST_DEVICE);
+  }
+
+  VkSubmitInfo *submitInfos = arena->alloc<VkSubmitInfo>(entry.batchCount);
+  VkTimelineSemaphoreSubmitInfo *timelineInfos =
+      arena->alloc<VkTimelineSemaphoreSubmitInfo>(entry.batchCount);
+  VkDeviceGroupSubmitInfo *groupInfos =
+      arena->alloc<VkDeviceGroupSubmitInfo>(entry.batchCount);
+  for (uint32_t i = 0; i < entry.batchCount; i++) {
+    SubmitBatch &current = entry.batches[i];
+    const void *next = NULL;
+    VkTimelineSemaphoreSubmitInfo &timelineInfo = timelineInfos[i];
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.pNext = NULL;
+    timelineInfo.waitSemaphoreValueCount = current.waitValues.size();
+    timelineInfo.pWaitSemaphoreValues = current.waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = current.signalValues.size();
+    timelineInfo.pSignalSemaphoreValues = current.signalValues.data();
+    if (timelines) next = &timelineInfo;
+
+    if (current.deviceMask != 0) {
+      // The lowest bit of the mask is the first GPU the batch runs on.
+      uint32_t first = 0;
+      while (!(current.deviceMask & (1u << first))) first++;
+      for (uint32_t j = 0; j < current.waitDevices.size(); j++)
+        if (current.waitDevices[j] == SUBMIT_FIRST_DEVICE)
+          current.waitDevices[j] = first;
+      for (uint32_t j = 0; j < current.signalDevices.size(); j++)
+        if (current.signalDevices[j] == SUBMIT_FIRST_DEVICE)
+          current.signalDevices[j] = first;
+      current.cmdDeviceMasks.assign(current.cmdBuffers.size(),
+                                    current.deviceMask);
+
+      VkDeviceGroupSubmitInfo &groupInfo = groupInfos[i];
+      groupInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO;
+      groupInfo.pNext = next;
+      groupInfo.waitSemaphoreCount = current.waitDevices.size();
+      groupInfo.pWaitSemaphoreDeviceIndices = current.waitDevices.data();
+      groupInfo.commandBufferCount = current.cmdDeviceMasks.size();
+      groupInfo.pCommandBufferDeviceMasks = current.cmdDeviceMasks.data();
+      groupInfo.signalSemaphoreCount = current.signalDevices.size();
+      groupInfo.pSignalSemaphoreDeviceIndices = current.signalDevices.data();
+      next = &groupInfo;
+    }
+
+    VkSubmitInfo &submitInfo = submitInfos[i];
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = next;
+    submitInfo.waitSemaphoreCount = current.waitSemaphores.size();
+    submitInfo.pWaitSemaphores = current.waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = current.waitStages.data();
+    submitInfo.commandBufferCount = current.cmdBuffers.size();
+    submitInfo.pCommandBuffers = current.cmdBuffers.data();
+    submitInfo.signalSemaphoreCount = current.signalSemaphores.size();
+    submitInfo.pSignalSemaphores = current.signalSemaphores.data();
+  }
+
+  VkResult result =
+      vkd.QueueSubmit(entry.queue, entry.batchCount, submitInfos, entry.fence);
+  assert(result == VK_SUCCESS);
+
+  frameSubmitCount++;
+  frameBatchCount += entry.batchCount;
+  submits++;
+  entry.batchCount = 0;
+  entry.fence = VK_NULL_HANDLE;
+}
+
+void VulkanSubmitter::flush(VkQueue queue) {
+  for (uint32_t i = 0; i < queues.size(); i++)
+    if (queues[i].queue == queue) flushQueue(queues[i]);
+}
+
+void VulkanSubmitter::flush() {
+  for (uint32_t i = 0; i < queues.size(); i++) flushQueue(queues[i]);
+}
+
+void VulkanSubmitter::endFrame() {
+  flush();
+
+  lastSubmits = frameSubmitCount;
+  lastBatches = frameBatchCount;
+  frameSubmitCount = 0;
+  frameBatchCount = 0;
+  frames++;
+}
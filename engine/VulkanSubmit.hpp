@@ -0,0 +1,92 @@
+#ifndef VULKAN_SUBMIT_HPP
+#define VULKAN_SUBMIT_HPP
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "VulkanArena.hpp"
+#include "VulkanTimeline.hpp"
+#include "VulkanTools.hpp"
+
+// Waits and signals go to the first GPU of their batch's device mask
+// unless given one.
+#define SUBMIT_FIRST_DEVICE UINT32_MAX
+
+struct SubmitBatch {
+  uint32_t deviceMask;
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<uint64_t> waitValues;
+  std::vector<VkPipelineStageFlags> waitStages;
+  std::vector<uint32_t> waitDevices;
+  std::vector<VkCommandBuffer> cmdBuffers;
+  std::vector<uint32_t> cmdDeviceMasks;
+  std::vector<VkSemaphore> signalSemaphores;
+  std::vector<uint64_t> signalValues;
+  std::vector<uint32_t> signalDevices;
+};
+
+struct SubmitQueue {
+  VkQueue queue;
+  std::vector<SubmitBatch> batches;
+  uint32_t batchCount;
+  uint32_t deviceMask;
+  VkFence fence;
+};
+
+// Collects the command buffers, waits and signals every subsystem queues up
+// over a frame and issues them with one vkQueueSubmit per queue. A wait
+// after commands or a command after a signal starts a new VkSubmitInfo, so
+// each batch keeps the order it was recorded in. Waiting on a semaphore
+// that another queue still has to signal flushes that queue first, since a
+// binary semaphore's signal has to be submitted before its wait. Only one
+// fence goes with a submission; a second one flushes what came before it.
+// With timelines enabled, every submission also signals the queue's next
+// timeline value, and work can wait on another queue reaching a value. On
+// a device group, setDeviceMask() picks the GPUs that run what is queued
+// next, and a change of mask starts a new batch. The submit infos and their
+// chains for each vkQueueSubmit come from the frame arena.
+class VulkanSubmitter {
+ public:
+  VulkanSubmitter();
+  void init(VulkanTimeline &timeline, VulkanFrameArena &arena);
+
+  void setDeviceMask(VkQueue queue, uint32_t deviceMask);
+  void wait(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags stages,
+            uint32_t device = SUBMIT_FIRST_DEVICE);
+  void wait(VkQueue queue, VkQueue producer, uint64_t value,
+            VkPipelineStageFlags stages);
+  void submit(VkQueue queue, VkCommandBuffer cmdBuffer);
+  void signal(VkQueue queue, VkSemaphore semaphore,
+              uint32_t device = SUBMIT_FIRST_DEVICE);
+  void fence(VkQueue queue, VkFence fence);
+
+  void flush(VkQueue queue);
+  void flush();
+  void endFrame();
+
+  uint32_t frameSubmits() const { return lastSubmits; }
+  uint32_t frameBatches() const { return lastBatches; }
+  uint64_t totalSubmits() const { return submits; }
+  uint64_t totalFrames() const { return frames; }
+  VulkanTimeline *timeline() const { return timelines; }
+
+ private:
+  VulkanTimeline *timelines;
+  VulkanFrameArena *arena;
+  std::vector<SubmitQueue> queues;
+  uint32_t frameSubmitCount;
+  uint32_t frameBatchCount;
+  uint32_t lastSubmits;
+  uint32_t lastBatches;
+  uint64_t submits;
+  uint64_t frames;
+
+  SubmitQueue &find(VkQueue queue);
+  SubmitBatch &batch(SubmitQueue &entry, bool wait);
+  bool signals(const SubmitQueue &entry, VkSemaphore semaphore) const;
+  void flushQueue(SubmitQueue &entry);
+};
+
+#endif
@@ -0,0 +1,524 @@
+#ifndef VULKAN_SWAPCHAIN_HPP
+#define VULKAN_SWAPCHAIN_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+#include "VulkanTrace.hpp"
+#include "VulkanWindowSystem.hpp"
+
+#define GET_INSTANCE_PROC_ADDR(inst, entry)                              \
+  {                                                                      \
+    fp##entry = (PFN_vk##entry)vkGetInstanceProcAddr(inst, "vk" #entry); \
+    if (!fp##entry)                                                      \
+      VulkanTools::exitOnError(                                          \
+          "vkGetInstanceProcAddr failed to find vk" #entry);             \
+  }
+
+#define GET_DEVICE_PROC_ADDR(dev, entry)                              \
+  {                                                                   \
+    fp##entry = (PFN_vk##entry)vkGetDeviceProcAddr(dev, "vk" #entry); \
+    if (!fp##entry)                                                   \
+      VulkanTools::exitOnError(                                       \
+          "vkGetDeviceProcAddr failed to find vk" #entry);            \
+  }
+
+struct SwapChainBuffer {
+  VkImage image;
+  VkImageView view;
+};
+
+struct SwapchainPolicy {
+  std::vector<VkPresentModeKHR> presentModes;
+  uint32_t imageCount;
+
+  SwapchainPolicy() : imageCount(0) {
+    presentModes.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+    presentModes.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+  }
+
+  SwapchainPolicy(VkPresentModeKHR presentMode, uint32_t imageCount = 0)
+      : presentModes(1, presentMode), imageCount(imageCount) {}
+
+  static SwapchainPolicy lowLatency() {
+    SwapchainPolicy policy(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    policy.presentModes.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+    return policy;
+  }
+
+  static SwapchainPolicy tearFree() {
+    return SwapchainPolicy(VK_PRESENT_MODE_MAILBOX_KHR);
+  }
+
+  static SwapchainPolicy powerSaving() {
+    return SwapchainPolicy(VK_PRESENT_MODE_FIFO_KHR, 1);
+  }
+
+  static SwapchainPolicy adaptiveVsync() {
+    return SwapchainPolicy(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+  }
+
+  static SwapchainPolicy tripleBuffered() {
+    return SwapchainPolicy(VK_PRESENT_MODE_MAILBOX_KHR, 3);
+  }
+};
+
+class VulkanSwapchain {
+private:
+  VkInstance instance;
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkSurfaceKHR surface;
+  VulkanResources *resources;
+
+  PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
+  PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR
+    fpGetPhysicalDeviceSurfaceCapabilitiesKHR;
+  PFN_vkGetPhysicalDeviceSurfaceFormatsKHR fpGetPhysicalDeviceSurfaceFormatsKHR;
+  PFN_vkGetPhysicalDeviceSurfacePresentModesKHR
+    fpGetPhysicalDeviceSurfacePresentModesKHR;
+  PFN_vkDestroySurfaceKHR fpDestroySurfaceKHR;
+
+  PFN_vkCreateSwapchainKHR fpCreateSwapchainKHR;
+  PFN_vkDestroySwapchainKHR fpDestroySwapchainKHR;
+  PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
+  PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
+  PFN_vkQueuePresentKHR fpQueuePresentKHR;
+
+public:
+  VkSwapchainKHR swapchain;
+  VkExtent2D extent;
+  VkPresentModeKHR presentMode;
+  // Device group present modes the swapchain is created for; 0 outside a
+  // device group.
+  VkDeviceGroupPresentModeFlagsKHR groupModes;
+
+  uint32_t generation;
+  uint32_t imageCount;
+  uint32_t queueIndex;
+  uint32_t graphicsQueueIndex;
+  std::vector<VkBool32> presentSupport;
+
+  VkFormat colorFormat;
+  VkColorSpaceKHR colorSpace;
+  VkImageUsageFlags imageUsage;
+  // Usage beyond color attachment, like TRANSFER_SRC for capture, added
+  // where the surface supports it.
+  VkImageUsageFlags requestedUsage;
+
+  std::vector<VkImage> images;
+  std::vector<SwapChainBuffer> buffers;
+
+  VulkanSwapchain()
+      : device(VK_NULL_HANDLE),
+        surface(VK_NULL_HANDLE),
+        resources(NULL),
+        swapchain(VK_NULL_HANDLE) {
+    extent.width = 0;
+    extent.height = 0;
+    groupModes = 0;
+    requestedUsage = 0;
+    generation = 0;
+    imageCount = 0;
+    queueIndex = UINT32_MAX;
+    graphicsQueueIndex = UINT32_MAX;
+  }
+
+  void init(VkInstance instance, VkPhysicalDevice physicalDevice) {
+    TRACE_ZONE("swapchain.init");
+    this->instance = instance;
+    this->physicalDevice = physicalDevice;
+
+    GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceSupportKHR);
+    GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceCapabilitiesKHR);
+    GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceFormatsKHR);
+    GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfacePresentModesKHR);
+    GET_INSTANCE_PROC_ADDR(instance, DestroySurfaceKHR);
+  }
+
+  void initDevice(VkDevice device, uint32_t graphicsQueueIndex,
+                  uint32_t presentQueueIndex) {
+    this->device = device;
+    this->graphicsQueueIndex = graphicsQueueIndex;
+    queueIndex = presentQueueIndex;
+
+    GET_DEVICE_PROC_ADDR(device, CreateSwapchainKHR);
+    GET_DEVICE_PROC_ADDR(device, DestroySwapchainKHR);
+    GET_DEVICE_PROC_ADDR(device, GetSwapchainImagesKHR);
+    GET_DEVICE_PROC_ADDR(device, AcquireNextImageKHR);
+    GET_DEVICE_PROC_ADDR(device, QueuePresentKHR);
+  }
+
+  void createSurface(
+#if defined(_WIN32)
+      HINSTANCE windowInstance, HWND window
+#elif defined(__linux__)
+      const NativeWindow &window
+#endif
+      ) {
+    TRACE_ZONE("createSurface");
+#if defined(_WIN32)
+    VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {};
+    surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+    surfaceCreateInfo.pNext = NULL;
+    surfaceCreateInfo.flags = 0;
+    surfaceCreateInfo.hinstance = windowInstance;
+    surfaceCreateInfo.hwnd = window;
+    VkResult result =
+        vkCreateWin32SurfaceKHR(instance, &surfaceCreateInfo, vkAllocator,
+                                &surface);
+#elif defined(__linux__)
+    VkResult result = VulkanWindowSystem::createSurface(
+        instance, physicalDevice, window, &surface);
+#endif
+
+    assert(result == VK_SUCCESS);
+
+    uint32_t queueCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, NULL);
+
+    assert(queueCount >= 1);
+
+    presentSupport.resize(queueCount);
+
+    for (uint32_t i = 0; i < queueCount; i++) {
+      result = fpGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface,
+                                                    &presentSupport[i]);
+      assert(result == VK_SUCCESS);
+    }
+
+    uint32_t formatCount = 0;
+    result = fpGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface,
+                                                  &formatCount, NULL);
+
+    assert(result == VK_SUCCESS && formatCount >= 1);
+
+    std::vector<VkSurfaceFormatKHR> surfaceFormats(formatCount);
+    result = fpGetPhysicalDeviceSurfaceFormatsKHR(
+        physicalDevice, surface, &formatCount, surfaceFormats.data());
+
+    assert(result == VK_SUCCESS);
+
+    if (formatCount == 1 && surfaceFormats[0].format == VK_FORMAT_UNDEFINED)
+      colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    else
+      colorFormat = surfaceFormats[0].format;
+
+    colorSpace = surfaceFormats[0].colorSpace;
+  }
+
+  void create(VkCommandBuffer cmdBuffer,
+              const SwapchainPolicy &policy = SwapchainPolicy(),
+              uint32_t width = WINDOW_WIDTH, uint32_t height = WINDOW_HEIGHT) {
+    TRACE_ZONE("swapchain.create");
+    VkSurfaceCapabilitiesKHR caps = {};
+    VkResult result = fpGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice,
+                                                                surface, &caps);
+
+    if (result != VK_SUCCESS)
+      VulkanTools::exitOnError(
+          "Failed to get physical device surface capabilities");
+
+    VkExtent2D swapchainExtent = {};
+
+    if (caps.currentExtent.width == UINT32_MAX ||
+        caps.currentExtent.height == UINT32_MAX) {
+      swapchainExtent.width = width;
+      swapchainExtent.height = height;
+
+      if (swapchainExtent.width < caps.minImageExtent.width)
+        swapchainExtent.width = caps.minImageExtent.width;
+      if (swapchainExtent.width > caps.maxImageExtent.width)
+        swapchainExtent.width = caps.maxImageExtent.width;
+      if (swapchainExtent.height < caps.minImageExtent.height)
+        swapchainExtent.height = caps.minImageExtent.height;
+      if (swapchainExtent.height > caps.maxImageExtent.height)
+        swapchainExtent.height = caps.maxImageExtent.height;
+    } else {
+      swapchainExtent = caps.currentExtent;
+    }
+
+    if (swapchainExtent.width == 0 || swapchainExtent.height == 0) {
+      extent = swapchainExtent;
+      return;
+    }
+
+    uint32_t presentModeCount = 0;
+    result = fpGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface,
+                                                       &presentModeCount, NULL);
+
+    assert(result == VK_SUCCESS);
+    assert(presentModeCount >= 1);
+
+    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    result = fpGetPhysicalDeviceSurfacePresentModesKHR(
+        physicalDevice, surface, &presentModeCount, presentModes.data());
+
+    assert(result == VK_SUCCESS);
+
+    presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    bool presentModeFound = false;
+
+    for (uint32_t i = 0; i < policy.presentModes.size() && !presentModeFound;
+         i++) {
+      for (uint32_t j = 0; j < presentModeCount; j++) {
+        if (presentModes[j] == policy.presentModes[i]) {
+          presentMode = presentModes[j];
+          presentModeFound = true;
+          break;
+        }
+      }
+    }
+
+    uint32_t imageCount = policy.imageCount;
+
+    if (imageCount == 0) imageCount = caps.minImageCount + 1;
+    if (imageCount < caps.minImageCount) imageCount = caps.minImageCount;
+    if (caps.maxImageCount > 0 && imageCount > caps.maxImageCount)
+      imageCount = caps.maxImageCount;
+
+    imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    if (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+      imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageUsage |= requestedUsage & caps.supportedUsageFlags;
+
+    VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
+    swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchainCreateInfo.surface = surface;
+    swapchainCreateInfo.minImageCount = imageCount;
+    swapchainCreateInfo.imageFormat = colorFormat;
+    swapchainCreateInfo.imageColorSpace = colorSpace;
+    swapchainCreateInfo.imageExtent = {swapchainExtent.width,
+                                       swapchainExtent.height};
+    swapchainCreateInfo.imageArrayLayers = 1;
+    swapchainCreateInfo.imageUsage = imageUsage;
+    uint32_t queueFamilyIndices[] = {graphicsQueueIndex, queueIndex};
+
+    if (graphicsQueueIndex != queueIndex) {
+      swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+      swapchainCreateInfo.queueFamilyIndexCount = 2;
+      swapchainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+    } else {
+      swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      swapchainCreateInfo.queueFamilyIndexCount = 0;
+      swapchainCreateInfo.pQueueFamilyIndices = NULL;
+    }
+    swapchainCreateInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    swapchainCreateInfo.presentMode = presentMode;
+    swapchainCreateInfo.clipped = VK_TRUE;
+    swapchainCreateInfo.oldSwapchain = swapchain;
+
+    VkDeviceGroupSwapchainCreateInfoKHR groupInfo = {};
+    groupInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SWAPCHAIN_CREATE_INFO_KHR;
+    groupInfo.pNext = NULL;
+    groupInfo.modes = groupModes;
+    if (groupModes != 0) swapchainCreateInfo.pNext = &groupInfo;
+
+    VkSwapchainKHR oldSwapchain = swapchain;
+    result =
+        fpCreateSwapchainKHR(device, &swapchainCreateInfo, vkAllocator,
+                             &swapchain);
+
+    assert(result == VK_SUCCESS);
+
+    if (resources) {
+      retireBuffers(oldSwapchain);
+    } else {
+      destroyBuffers();
+
+      if (oldSwapchain != VK_NULL_HANDLE)
+        fpDestroySwapchainKHR(device, oldSwapchain, vkAllocator);
+    }
+
+    extent = swapchainExtent;
+    generation++;
+
+    result = fpGetSwapchainImagesKHR(device, swapchain, &imageCount, NULL);
+
+    assert(result == VK_SUCCESS);
+
+    this->imageCount = imageCount;
+    images.resize(imageCount);
+    buffers.resize(imageCount);
+
+    result =
+        fpGetSwapchainImagesKHR(device, swapchain, &imageCount, images.data());
+
+    assert(result == VK_SUCCESS);
+
+    VulkanTools::BarrierBatch barriers;
+    VkImageSubresourceRange range =
+        VulkanTools::subresourceRange(VK_IMAGE_ASPECT_COLOR_BIT);
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+      VkImageViewCreateInfo imageCreateInfo = {};
+      imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      imageCreateInfo.pNext = NULL;
+      imageCreateInfo.format = colorFormat;
+      imageCreateInfo.components = {
+          VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G,
+          VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+      imageCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      imageCreateInfo.subresourceRange.baseMipLevel = 0;
+      imageCreateInfo.subresourceRange.levelCount = 1;
+      imageCreateInfo.subresourceRange.baseArrayLayer = 0;
+      imageCreateInfo.subresourceRange.layerCount = 1;
+      imageCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      imageCreateInfo.flags = 0;
+
+      buffers[i].image = images[i];
+      barriers.image(buffers[i].image, VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, range);
+      imageCreateInfo.image = buffers[i].image;
+      result =
+          vkd.CreateImageView(device, &imageCreateInfo, vkAllocator,
+                              &buffers[i].view);
+
+      assert(result == VK_SUCCESS);
+    }
+
+    barriers.record(cmdBuffer);
+  }
+
+  void setResources(VulkanResources *resources) { this->resources = resources; }
+
+  void retireBuffers(VkSwapchainKHR oldSwapchain) {
+    for (uint32_t i = 0; i < buffers.size(); i++)
+      resources->retireImageView(buffers[i].view);
+
+    if (oldSwapchain != VK_NULL_HANDLE) {
+      VkDevice device = this->device;
+      PFN_vkDestroySwapchainKHR destroySwapchain = fpDestroySwapchainKHR;
+      resources->retireCallback([device, destroySwapchain, oldSwapchain]() {
+        destroySwapchain(device, oldSwapchain, vkAllocator);
+      });
+    }
+
+    buffers.clear();
+    images.clear();
+  }
+
+  void destroy() {
+    destroyBuffers();
+
+    if (swapchain != VK_NULL_HANDLE) {
+      fpDestroySwapchainKHR(device, swapchain, vkAllocator);
+      swapchain = VK_NULL_HANDLE;
+    }
+
+    if (surface != VK_NULL_HANDLE) {
+      fpDestroySurfaceKHR(instance, surface, vkAllocator);
+      surface = VK_NULL_HANDLE;
+    }
+  }
+
+  void destroyBuffers() {
+    for (uint32_t i = 0; i < buffers.size(); i++)
+      vkd.DestroyImageView(device, buffers[i].view, vkAllocator);
+
+    buffers.clear();
+    images.clear();
+  }
+
+  // Usage the surface allows its images, or 0 when it can't be queried.
+  VkImageUsageFlags supportedUsage() {
+    VkSurfaceCapabilitiesKHR caps = {};
+    if (fpGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface,
+                                                 &caps) != VK_SUCCESS)
+      return 0;
+
+    return caps.supportedUsageFlags;
+  }
+
+  // Present modes the surface allows with the device's group, or 0 when
+  // the device isn't a group. Takes the device since it can run before
+  // initDevice().
+  VkDeviceGroupPresentModeFlagsKHR groupPresentModes(VkDevice device) {
+    VkDeviceGroupPresentModeFlagsKHR modes = 0;
+    if (!vkd.GetDeviceGroupSurfacePresentModesKHR ||
+        vkd.GetDeviceGroupSurfacePresentModesKHR(device, surface, &modes) !=
+            VK_SUCCESS)
+      return 0;
+
+    return modes;
+  }
+
+  // A device mask says which GPUs of a device group will use the image.
+  VkResult getSwapchainNext(VkSemaphore presentCompleteSemaphore,
+                            uint32_t *buffer, uint64_t timeout = UINT64_MAX,
+                            VkFence fence = VK_NULL_HANDLE,
+                            uint32_t deviceMask = 0) {
+    VkResult result;
+    if (deviceMask != 0 && vkd.AcquireNextImage2KHR) {
+      VkAcquireNextImageInfoKHR acquireInfo = {};
+      acquireInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR;
+      acquireInfo.pNext = NULL;
+      acquireInfo.swapchain = swapchain;
+      acquireInfo.timeout = timeout;
+      acquireInfo.semaphore = presentCompleteSemaphore;
+      acquireInfo.fence = fence;
+      acquireInfo.deviceMask = deviceMask;
+      result = vkd.AcquireNextImage2KHR(device, &acquireInfo, buffer);
+    } else {
+      result = fpAcquireNextImageKHR(device, swapchain, timeout,
+                                     presentCompleteSemaphore, fence, buffer);
+    }
+
+    switch (result) {
+      case VK_SUCCESS:
+      case VK_SUBOPTIMAL_KHR:
+      case VK_NOT_READY:
+      case VK_TIMEOUT:
+      case VK_ERROR_OUT_OF_DATE_KHR:
+        break;
+      default:
+        VulkanTools::exitOnError("Failed to get next image in swapchain");
+    }
+
+    return result;
+  }
+
+  VkResult swapchainPresent(VkQueue queue, uint32_t buffer,
+                            VkSemaphore renderCompleteSemaphore,
+                            const void *pNext = NULL) {
+    return swapchainPresent(queue, 1, &swapchain, &buffer, 1,
+                            &renderCompleteSemaphore, NULL, pNext);
+  }
+
+  // Presents to several swapchains on this device with one call, so every
+  // window flips from the same semaphores on the same frame. Each
+  // swapchain's own result lands in results when it is given.
+  VkResult swapchainPresent(VkQueue queue, uint32_t count,
+                            const VkSwapchainKHR *swapchains,
+                            const uint32_t *buffers, uint32_t waitCount,
+                            const VkSemaphore *waitSemaphores,
+                            VkResult *results, const void *pNext = NULL) {
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = pNext;
+    presentInfo.waitSemaphoreCount = waitCount;
+    presentInfo.pWaitSemaphores = waitSemaphores;
+    presentInfo.swapchainCount = count;
+    presentInfo.pSwapchains = swapchains;
+    presentInfo.pImageIndices = buffers;
+    presentInfo.pResults = results;
+
+    VkResult result = fpQueuePresentKHR(queue, &presentInfo);
+
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR &&
+        result != VK_ERROR_OUT_OF_DATE_KHR)
+      VulkanTools::exitOnError("Failed to present swapchain image");
+
+    return result;
+  }
+};
+
+#endif  // VULKAN_SWAPCHAIN_HPP
@@ -0,0 +1,157 @@
+#include "VulkanTasks.hpp"
+
+#if VULKAN_COROUTINES
+
+void VulkanTaskScheduler::WorkerAwaiter::await_suspend(
+    std::coroutine_handle<> handle) {
+  scheduler->jobs->submitBackground([handle](uint32_t) { handle.resume(); });
+}
+
+void VulkanTaskScheduler::MainAwaiter::await_suspend(
+    std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> lock(scheduler->mutex);
+  scheduler->mainReady.push_back(handle);
+}
+
+void VulkanTaskScheduler::FileAwaiter::await_suspend(
+    std::coroutine_handle<> handle) {
+  // The awaiter lives in the suspended frame, so the job can fill it in.
+  FileAwaiter *awaiter = this;
+  scheduler->jobs->submitBackground([awaiter, handle](uint32_t) {
+    if (!readWholeFile(awaiter->path, awaiter->data))
+      fprintf(stderr, "Failed to read %s\n", awaiter->path.c_str());
+    handle.resume();
+  });
+}
+
+void VulkanTaskScheduler::TimelineAwaiter::await_suspend(
+    std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> lock(scheduler->mutex);
+  if (!scheduler->timelines->enabled()) {
+    scheduler->retireWaiting.push_back(handle);
+    return;
+  }
+
+  TimelineWait wait = {handle, queue, value};
+  scheduler->timelineWaits.push_back(wait);
+}
+
+void VulkanTaskScheduler::RetireAwaiter::await_suspend(
+    std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> lock(scheduler->mutex);
+  scheduler->retireWaiting.push_back(handle);
+}
+
+VulkanTaskScheduler::VulkanTaskScheduler()
+    : jobs(NULL),
+      resources(NULL),
+      timelines(NULL),
+      retireEpoch(0),
+      retiredEpoch(0),
+      draining(false),
+      live(0),
+      spawned(0) {}
+
+void VulkanTaskScheduler::init(VulkanJobs &jobs, VulkanResources &resources,
+                               VulkanTimeline &timeline) {
+  this->jobs = &jobs;
+  this->resources = &resources;
+  timelines = &timeline;
+  draining = false;
+}
+
+void VulkanTaskScheduler::destroy() {
+  if (!jobs) return;
+
+  // With the device idle every GPU wait is over, so tasks only have their
+  // own work left to finish.
+  draining = true;
+  while (live > 0) {
+    poll();
+    std::this_thread::yield();
+  }
+
+  if (spawned > 0)
+    fprintf(stdout, "Tasks:          %llu run\n", (unsigned long long)spawned);
+
+  retiring.clear();
+  jobs = NULL;
+}
+
+VulkanTaskScheduler::DetachedTask VulkanTaskScheduler::run(
+    VulkanTaskScheduler *scheduler, Task<void> task) {
+  co_await task;
+  scheduler->live--;
+}
+
+void VulkanTaskScheduler::spawn(Task<void> task) {
+  live++;
+  spawned++;
+  run(this, std::move(task));
+}
+
+void VulkanTaskScheduler::poll() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Tasks that started waiting since the last poll share one retire
+    // callback, and batches retire in the order they were queued.
+    if (!retireWaiting.empty()) {
+      RetireBatch batch;
+      batch.epoch = ++retireEpoch;
+      batch.handles.swap(retireWaiting);
+      retiring.push_back(std::move(batch));
+
+      uint64_t epoch = retireEpoch;
+      resources->retireCallback([this, epoch]() { retiredEpoch = epoch; });
+    }
+
+    while (!retiring.empty() &&
+           (draining || retiring.front().epoch <= retiredEpoch)) {
+      std::vector<std::coroutine_handle<> > &handles =
+          retiring.front().handles;
+      resuming.insert(resuming.end(), handles.begin(), handles.end());
+      retiring.pop_front();
+    }
+
+    for (size_t i = 0; i < timelineWaits.size();) {
+      TimelineWait &wait = timelineWaits[i];
+      if (draining || timelines->reached(wait.queue, wait.value)) {
+        resuming.push_back(wait.handle);
+        wait = timelineWaits.back();
+        timelineWaits.pop_back();
+      } else {
+        i++;
+      }
+    }
+
+    resuming.insert(resuming.end(), mainReady.begin(), mainReady.end());
+    mainReady.clear();
+  }
+
+  // Resumed tasks may wait again, which takes the lock.
+  for (size_t i = 0; i < resuming.size(); i++) resuming[i].resume();
+  resuming.clear();
+}
+
+bool VulkanTaskScheduler::readWholeFile(const std::string &path,
+                                        std::vector<uint8_t> &data) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) return false;
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  bool ok = size >= 0;
+  if (ok) {
+    data.resize(size);
+    ok = fread(data.data(), 1, size, file) == (size_t)size;
+  }
+  fclose(file);
+
+  if (!ok) data.clear();
+  return ok;
+}
+
+#endif
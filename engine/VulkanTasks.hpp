@@ -0,0 +1,254 @@
+#ifndef VULKAN_TASKS_HPP
+#define VULKAN_TASKS_HPP
+
+// configure --enable-coroutines builds with C++20 and sets this. Without it
+// the engine stays C++11 and this header declares nothing.
+#ifndef VULKAN_COROUTINES
+#define VULKAN_COROUTINES 0
+#endif
+
+#if VULKAN_COROUTINES
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "VulkanJobs.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTimeline.hpp"
+
+template <typename T>
+class Task;
+
+// Tasks start suspended and run when awaited, then resume whoever awaited
+// them from their final suspend, on whichever thread they finished on.
+struct TaskPromiseBase {
+  std::coroutine_handle<> continuation;
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      std::coroutine_handle<> next = handle.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+  std::optional<T> value;
+
+  Task<T> get_return_object();
+  void return_value(T result) { value = std::move(result); }
+  T result() { return std::move(*value); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object();
+  void return_void() {}
+  void result() {}
+};
+
+// A coroutine returning T to the coroutine that co_awaits it. The Task owns
+// its frame, so it has to outlive the co_await, which a temporary does.
+template <typename T = void>
+class Task {
+ public:
+  typedef TaskPromise<T> promise_type;
+
+  Task() : handle() {}
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle(handle) {}
+  Task(Task &&other) noexcept : handle(other.handle) { other.handle = {}; }
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle) handle.destroy();
+      handle = other.handle;
+      other.handle = {};
+    }
+    return *this;
+  }
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  ~Task() {
+    if (handle) handle.destroy();
+  }
+
+  bool await_ready() const noexcept { return !handle || handle.done(); }
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<> awaiting) noexcept {
+    handle.promise().continuation = awaiting;
+    return handle;
+  }
+  T await_resume() { return handle.promise().result(); }
+
+ private:
+  std::coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise<T> >::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(
+      std::coroutine_handle<TaskPromise<void> >::from_promise(*this));
+}
+
+// Runs tasks on the job pool without each system growing its own callback
+// plumbing. A task moves between threads by what it awaits: worker() and
+// readFile() continue on a job thread, as background jobs that frame work
+// goes ahead of; mainThread() continues in the next poll(); timeline() and
+// frameRetired() continue in the poll() after the GPU gets there. A load
+// reads as the sequence it is:
+//
+//   Task<void> load(VulkanTaskScheduler &tasks, const char *path) {
+//     std::vector<uint8_t> file = co_await tasks.readFile(path);
+//     Image image = transcode(file);   // still on the job thread
+//     co_await tasks.mainThread();
+//     upload(image);                   // the upload ring is single-threaded
+//     co_await tasks.frameRetired();
+//     publish(image);
+//   }
+//
+// and spawn(load(tasks, path)) starts it. poll() goes once a frame on the
+// frame's thread, before the frame's uploads are submitted, and is the
+// only place tasks touch engine state unguarded. destroy() expects an idle
+// device and runs every task to its end.
+class VulkanTaskScheduler {
+ public:
+  struct WorkerAwaiter {
+    VulkanTaskScheduler *scheduler;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+  };
+
+  struct MainAwaiter {
+    VulkanTaskScheduler *scheduler;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+  };
+
+  struct FileAwaiter {
+    VulkanTaskScheduler *scheduler;
+    std::string path;
+    std::vector<uint8_t> data;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    std::vector<uint8_t> await_resume() { return std::move(data); }
+  };
+
+  struct TimelineAwaiter {
+    VulkanTaskScheduler *scheduler;
+    VkQueue queue;
+    uint64_t value;
+
+    bool await_ready() const noexcept { return value == 0; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+  };
+
+  struct RetireAwaiter {
+    VulkanTaskScheduler *scheduler;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+  };
+
+  VulkanTaskScheduler();
+
+  void init(VulkanJobs &jobs, VulkanResources &resources,
+            VulkanTimeline &timeline);
+  void destroy();
+
+  void spawn(Task<void> task);
+  void poll();
+
+  WorkerAwaiter worker() { return WorkerAwaiter{this}; }
+  MainAwaiter mainThread() { return MainAwaiter{this}; }
+  FileAwaiter readFile(const std::string &path) {
+    return FileAwaiter{this, path, std::vector<uint8_t>()};
+  }
+  // Without timeline semaphores this waits for the frame to retire, which
+  // covers everything submitted before it.
+  TimelineAwaiter timeline(VkQueue queue, uint64_t value) {
+    return TimelineAwaiter{this, queue, value};
+  }
+  // After the GPU finishes the frame being recorded, and so the uploads it
+  // waits on.
+  RetireAwaiter frameRetired() { return RetireAwaiter{this}; }
+
+  uint32_t liveTasks() const { return live; }
+
+ private:
+  struct DetachedTask {
+    struct promise_type {
+      DetachedTask get_return_object() { return DetachedTask(); }
+      std::suspend_never initial_suspend() const noexcept { return {}; }
+      std::suspend_never final_suspend() const noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+  };
+
+  struct TimelineWait {
+    std::coroutine_handle<> handle;
+    VkQueue queue;
+    uint64_t value;
+  };
+
+  struct RetireBatch {
+    uint64_t epoch;
+    std::vector<std::coroutine_handle<> > handles;
+  };
+
+  VulkanJobs *jobs;
+  VulkanResources *resources;
+  VulkanTimeline *timelines;
+
+  std::mutex mutex;
+  std::vector<std::coroutine_handle<> > mainReady;
+  std::vector<std::coroutine_handle<> > retireWaiting;
+  std::vector<TimelineWait> timelineWaits;
+  std::deque<RetireBatch> retiring;
+  std::vector<std::coroutine_handle<> > resuming;
+  uint64_t retireEpoch;
+  uint64_t retiredEpoch;
+  bool draining;
+
+  std::atomic<uint32_t> live;
+  uint64_t spawned;
+
+  static DetachedTask run(VulkanTaskScheduler *scheduler, Task<void> task);
+  static bool readWholeFile(const std::string &path,
+                            std::vector<uint8_t> &data);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+#include "VulkanTimeline.hpp"
+
+VulkanTimeline::VulkanTimeline()
+    : device(VK_NULL_HANDLE), active(false), waits(0) {}
+
+TimelineSupport VulkanTimeline::query(VkInstance instance,
+                                      VkPhysicalDevice physicalDevice) {
+  TimelineSupport support = {};
+
+  std::vector<const char *> extensions;
+  extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  if (!VulkanDevice::supportsExtensions(physicalDevice, extensions))
+    return support;
+
+  PFN_vkGetPhysicalDeviceFeatures2 getFeatures2 =
+      (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+          instance, "vkGetPhysicalDeviceFeatures2KHR");
+  if (!getFeatures2) return support;
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+  timelineFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  timelineFeatures.pNext = NULL;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &timelineFeatures;
+  getFeatures2(physicalDevice, &features);
+
+  support.supported = timelineFeatures.timelineSemaphore == VK_TRUE;
+  return support;
+}
+
+void VulkanTimeline::deviceExtensions(const TimelineSupport &support,
+                                      std::vector<const char *> &extensions) {
+  if (support.supported)
+    extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+}
+
+void VulkanTimeline::deviceFeatures(
+    const TimelineSupport &support,
+    VkPhysicalDeviceTimelineSemaphoreFeatures &features) {
+  features = VkPhysicalDeviceTimelineSemaphoreFeatures();
+  features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  features.pNext = NULL;
+  features.timelineSemaphore = support.supported ? VK_TRUE : VK_FALSE;
+}
+
+void VulkanTimeline::init(VkDevice device, const TimelineSupport &support,
+                          bool enable) {
+  this->device = device;
+  active = support.supported && enable && vkd.GetSemaphoreCounterValueKHR &&
+           vkd.WaitSemaphoresKHR;
+  waits = 0;
+
+  if (active)
+    fprintf(stdout, "Timeline:       on, one semaphore per queue\n");
+  else
+    fprintf(stdout, "Timeline:       %s, using fences\n",
+            support.supported ? "off" : "unsupported");
+}
+
+void VulkanTimeline::destroy() {
+  for (uint32_t i = 0; i < queues.size(); i++)
+    vkd.DestroySemaphore(device, queues[i].semaphore, vkAllocator);
+
+  queues.clear();
+  active = false;
+}
+
+TimelineQueue &VulkanTimeline::find(VkQueue queue) {
+  assert(active);
+
+  for (uint32_t i = 0; i < queues.size(); i++)
+    if (queues[i].queue == queue) return queues[i];
+
+  VkSemaphoreTypeCreateInfo typeInfo = {};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.pNext = NULL;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  semaphoreInfo.flags = 0;
+
+  TimelineQueue entry = {};
+  entry.queue = queue;
+  VkResult result =
+      vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                          &entry.semaphore);
+  assert(result == VK_SUCCESS);
+
+  queues.push_back(entry);
+  return queues.back();
+}
+
+VkSemaphore VulkanTimeline::semaphore(VkQueue queue) {
+  return find(queue).semaphore;
+}
+
+uint64_t VulkanTimeline::advance(VkQueue queue) {
+  return ++find(queue).submitted;
+}
+
+uint64_t VulkanTimeline::submitted(VkQueue queue) {
+  return find(queue).submitted;
+}
+
+uint64_t VulkanTimeline::next(VkQueue queue) {
+  return find(queue).submitted + 1;
+}
+
+uint64_t VulkanTimeline::completed(VkQueue queue) {
+  TimelineQueue &entry = find(queue);
+  if (entry.completed == entry.submitted) return entry.completed;
+
+  VkResult result = vkd.GetSemaphoreCounterValueKHR(device, entry.semaphore,
+                                                    &entry.completed);
+  assert(result == VK_SUCCESS);
+  return entry.completed;
+}
+
+bool VulkanTimeline::reached(VkQueue queue, uint64_t value) {
+  TimelineQueue &entry = find(queue);
+  return value <= entry.completed || value <= completed(queue);
+}
+
+void VulkanTimeline::wait(VkQueue queue, uint64_t value) {
+  if (reached(queue, value)) return;
+
+  TimelineQueue &entry = find(queue);
+  assert(value <= entry.submitted);
+
+  VkSemaphoreWaitInfo waitInfo = {};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.pNext = NULL;
+  waitInfo.flags = 0;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &entry.semaphore;
+  waitInfo.pValues = &value;
+
+  VkResult result = vkd.WaitSemaphoresKHR(device, &waitInfo, UINT64_MAX);
+  assert(result == VK_SUCCESS);
+
+  entry.completed = value;
+  waits++;
+}
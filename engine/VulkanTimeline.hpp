@@ -0,0 +1,66 @@
+#ifndef VULKAN_TIMELINE_HPP
+#define VULKAN_TIMELINE_HPP
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanTools.hpp"
+
+#define TIMELINE_DISABLE_ENV "VULKAN_EXAMPLE_NO_TIMELINE"
+
+struct TimelineSupport {
+  bool supported;
+};
+
+struct TimelineQueue {
+  VkQueue queue;
+  VkSemaphore semaphore;
+  uint64_t submitted;
+  uint64_t completed;
+};
+
+// Every queue gets one timeline semaphore whose value goes up by one with
+// each vkQueueSubmit the submitter issues on it. "Queue X has reached N" is
+// then all anything needs to know about GPU progress: the CPU checks or
+// waits on the counter instead of a fence per frame or per upload, and other
+// queues wait on the same value from the GPU. Values reserved with next()
+// are reached by the first submission that follows.
+class VulkanTimeline {
+ public:
+  VulkanTimeline();
+
+  static TimelineSupport query(VkInstance instance,
+                               VkPhysicalDevice physicalDevice);
+  static void deviceExtensions(const TimelineSupport &support,
+                               std::vector<const char *> &extensions);
+  static void deviceFeatures(
+      const TimelineSupport &support,
+      VkPhysicalDeviceTimelineSemaphoreFeatures &features);
+
+  void init(VkDevice device, const TimelineSupport &support, bool enable);
+  void destroy();
+
+  bool enabled() const { return active; }
+  VkSemaphore semaphore(VkQueue queue);
+  uint64_t advance(VkQueue queue);
+  uint64_t submitted(VkQueue queue);
+  uint64_t next(VkQueue queue);
+  uint64_t completed(VkQueue queue);
+  bool reached(VkQueue queue, uint64_t value);
+  void wait(VkQueue queue, uint64_t value);
+
+  uint64_t blockingWaits() const { return waits; }
+
+ private:
+  VkDevice device;
+  bool active;
+  std::vector<TimelineQueue> queues;
+  uint64_t waits;
+
+  TimelineQueue &find(VkQueue queue);
+};
+
+#endif
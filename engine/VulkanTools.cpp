@@ -0,0 +1,331 @@
+#include "VulkanTools.hpp"
+
+void VulkanTools::exitOnError(const char *msg) {
+#if defined(_WIN32)
+  MessageBox(NULL, msg, ENGINE_NAME, MB_ICONERROR);
+#else
+  printf(msg);
+  fflush(stdout);
+#endif
+  exit(EXIT_FAILURE);
+}
+
+VulkanTools::LayoutAccess VulkanTools::layoutAccess(VkImageLayout layout,
+                                                   bool source) {
+  LayoutAccess result = {};
+
+  switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+      result.stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_PREINITIALIZED:
+      result.stages = VK_PIPELINE_STAGE_HOST_BIT;
+      result.access = VK_ACCESS_HOST_WRITE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      result.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      result.access = source ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                             : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      result.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      result.access = source ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+                             : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      result.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      result.access = source ? 0
+                             : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_SHADER_READ_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      result.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+      result.access = source ? 0 : VK_ACCESS_SHADER_READ_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      result.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      result.access = source ? 0 : VK_ACCESS_TRANSFER_READ_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      result.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      result.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+      break;
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+      result.stages = source ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT
+                             : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+      break;
+    default:
+      result.stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      result.access = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+      break;
+  }
+
+  return result;
+}
+
+VkImageSubresourceRange VulkanTools::subresourceRange(
+    VkImageAspectFlags aspects, uint32_t baseMipLevel, uint32_t levelCount,
+    uint32_t baseArrayLayer, uint32_t layerCount) {
+  VkImageSubresourceRange range = {};
+  range.aspectMask = aspects;
+  range.baseMipLevel = baseMipLevel;
+  range.levelCount = levelCount;
+  range.baseArrayLayer = baseArrayLayer;
+  range.layerCount = layerCount;
+  return range;
+}
+
+VulkanTools::BarrierBatch::BarrierBatch() : srcStages(0), dstStages(0) {}
+
+VulkanTools::BarrierBatch &VulkanTools::BarrierBatch::image(
+    VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+    const VkImageSubresourceRange &range, uint32_t srcQueueFamily,
+    uint32_t dstQueueFamily) {
+  LayoutAccess src = layoutAccess(oldLayout, true);
+  LayoutAccess dst = layoutAccess(newLayout, false);
+
+  return this->image(image, oldLayout, newLayout, range, src.stages,
+                     src.access, dst.stages, dst.access, srcQueueFamily,
+                     dstQueueFamily);
+}
+
+VulkanTools::BarrierBatch &VulkanTools::BarrierBatch::image(
+    VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+    const VkImageSubresourceRange &range, VkPipelineStageFlags srcStages,
+    VkAccessFlags srcAccess, VkPipelineStageFlags dstStages,
+    VkAccessFlags dstAccess, uint32_t srcQueueFamily,
+    uint32_t dstQueueFamily) {
+  VkImageMemoryBarrier imageBarrier = {};
+  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageBarrier.pNext = NULL;
+  imageBarrier.srcAccessMask = srcAccess;
+  imageBarrier.dstAccessMask = dstAccess;
+  imageBarrier.oldLayout = oldLayout;
+  imageBarrier.newLayout = newLayout;
+  imageBarrier.srcQueueFamilyIndex = srcQueueFamily;
+  imageBarrier.dstQueueFamilyIndex = dstQueueFamily;
+  imageBarrier.image = image;
+  imageBarrier.subresourceRange = range;
+  imageBarriers.push_back(imageBarrier);
+
+  this->srcStages |= srcStages;
+  this->dstStages |= dstStages;
+  return *this;
+}
+
+VulkanTools::BarrierBatch &VulkanTools::BarrierBatch::buffer(
+    VkBuffer buffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStages, VkAccessFlags dstAccess,
+    VkDeviceSize offset, VkDeviceSize size, uint32_t srcQueueFamily,
+    uint32_t dstQueueFamily) {
+  VkBufferMemoryBarrier bufferBarrier = {};
+  bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferBarrier.pNext = NULL;
+  bufferBarrier.srcAccessMask = srcAccess;
+  bufferBarrier.dstAccessMask = dstAccess;
+  bufferBarrier.srcQueueFamilyIndex = srcQueueFamily;
+  bufferBarrier.dstQueueFamilyIndex = dstQueueFamily;
+  bufferBarrier.buffer = buffer;
+  bufferBarrier.offset = offset;
+  bufferBarrier.size = size;
+  bufferBarriers.push_back(bufferBarrier);
+
+  this->srcStages |= srcStages;
+  this->dstStages |= dstStages;
+  return *this;
+}
+
+VulkanTools::BarrierBatch &VulkanTools::BarrierBatch::memory(
+    VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+  VkMemoryBarrier memoryBarrier = {};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.pNext = NULL;
+  memoryBarrier.srcAccessMask = srcAccess;
+  memoryBarrier.dstAccessMask = dstAccess;
+  memoryBarriers.push_back(memoryBarrier);
+
+  this->srcStages |= srcStages;
+  this->dstStages |= dstStages;
+  return *this;
+}
+
+void VulkanTools::BarrierBatch::record(VkCommandBuffer cmdBuffer) {
+  if (empty()) return;
+
+  vkd.CmdPipelineBarrier(cmdBuffer, srcStages, dstStages, 0,
+                         memoryBarriers.size(), memoryBarriers.data(),
+                         bufferBarriers.size(), bufferBarriers.data(),
+                         imageBarriers.size(), imageBarriers.data());
+
+  srcStages = dstStages = 0;
+  memoryBarriers.clear();
+  imageBarriers.clear();
+  bufferBarriers.clear();
+}
+
+bool VulkanTools::BarrierBatch::empty() const {
+  return memoryBarriers.empty() && imageBarriers.empty() &&
+         bufferBarriers.empty();
+}
+
+bool VulkanTools::BarrierBatch::full() const {
+  return memoryBarriers.full() || imageBarriers.full() ||
+         bufferBarriers.full();
+}
+
+void VulkanTools::setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
+                                 VkImageAspectFlags aspects,
+                                 VkImageLayout oldLayout,
+                                 VkImageLayout newLayout) {
+  setImageLayout(cmdBuffer, image, oldLayout, newLayout,
+                 subresourceRange(aspects));
+}
+
+void VulkanTools::setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
+                                 VkImageLayout oldLayout,
+                                 VkImageLayout newLayout,
+                                 const VkImageSubresourceRange &range) {
+  BarrierBatch batch;
+  batch.image(image, oldLayout, newLayout, range).record(cmdBuffer);
+}
+
+bool VulkanTools::writePPM(const char *path, const void *rgba, uint32_t width,
+                           uint32_t height, uint32_t rowPitch) {
+  FILE *file = fopen(path, "wb");
+  if (!file) return false;
+
+  fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+  std::vector<unsigned char> row(width * 3);
+  bool ok = true;
+
+  for (uint32_t y = 0; y < height && ok; y++) {
+    const unsigned char *src = (const unsigned char *)rgba + y * rowPitch;
+    for (uint32_t x = 0; x < width; x++) {
+      row[x * 3 + 0] = src[x * 4 + 0];
+      row[x * 3 + 1] = src[x * 4 + 1];
+      row[x * 3 + 2] = src[x * 4 + 2];
+    }
+    ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+  }
+
+  return fclose(file) == 0 && ok;
+}
+
+void VulkanTools::hashCombine(size_t &seed, uint64_t value) {
+  seed ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+uint64_t VulkanTools::hashBytes(const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+bool VulkanTools::replaceFile(const char *from, const char *to) {
+#if defined(_WIN32)
+  return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING |
+                                   MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return rename(from, to) == 0;
+#endif
+}
+
+int64_t VulkanTools::fileModifiedTime(const char *path) {
+#if defined(_WIN32)
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+    return -1;
+
+  return ((int64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+         attributes.ftLastWriteTime.dwLowDateTime;
+#else
+  struct stat info;
+  if (stat(path, &info) != 0) return -1;
+
+  return (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+}
+
+#if defined(_WIN32)
+VulkanTools::MappedFile::MappedFile()
+    : view(NULL),
+      length(0),
+      file(INVALID_HANDLE_VALUE),
+      mapping(NULL) {}
+#else
+VulkanTools::MappedFile::MappedFile() : view(NULL), length(0), file(-1) {}
+#endif
+
+VulkanTools::MappedFile::~MappedFile() { close(); }
+
+bool VulkanTools::MappedFile::open(const char *path) {
+  close();
+
+#if defined(_WIN32)
+  file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                     FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    close();
+    return false;
+  }
+
+  mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping) view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  length = (size_t)fileSize.QuadPart;
+#else
+  file = ::open(path, O_RDONLY);
+  if (file < 0) return false;
+
+  struct stat info;
+  if (fstat(file, &info) != 0 || info.st_size == 0) {
+    close();
+    return false;
+  }
+
+  length = info.st_size;
+  view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0);
+  if (view == MAP_FAILED) view = NULL;
+#endif
+
+  if (!view) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void VulkanTools::MappedFile::close() {
+#if defined(_WIN32)
+  if (view) UnmapViewOfFile(view);
+  if (mapping) CloseHandle(mapping);
+  if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+  mapping = NULL;
+  file = INVALID_HANDLE_VALUE;
+#else
+  if (view) munmap(view, length);
+  if (file >= 0) ::close(file);
+  file = -1;
+#endif
+  view = NULL;
+  length = 0;
+}
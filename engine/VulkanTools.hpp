@@ -0,0 +1,132 @@
+#ifndef VULKAN_TOOLS_HPP
+#define VULKAN_TOOLS_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <vector>
+
+#include "VulkanAllocator.hpp"
+#include "VulkanArena.hpp"
+#include "VulkanDispatch.hpp"
+
+#define APPLICATION_NAME "Vulkan Example"
+#define ENGINE_NAME "Vulkan Engine"
+#define WINDOW_WIDTH 1280
+#define WINDOW_HEIGHT 720
+#define WINDOW_CASCADE 48
+#define FRAMES_IN_FLIGHT 2
+#define FRAME_RATE_LIMIT 0
+#define ACQUIRE_TIMEOUT 1000000
+#define HEADLESS_FRAME_COUNT 1000
+#define ALLOCATION_WARMUP_FRAMES 8
+#define OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+#define BARRIER_BATCH_SIZE 32
+
+namespace VulkanTools {
+void exitOnError(const char *msg);
+
+struct LayoutAccess {
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+};
+
+LayoutAccess layoutAccess(VkImageLayout layout, bool source);
+VkImageSubresourceRange subresourceRange(
+    VkImageAspectFlags aspects, uint32_t baseMipLevel = 0,
+    uint32_t levelCount = VK_REMAINING_MIP_LEVELS, uint32_t baseArrayLayer = 0,
+    uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
+
+// Barriers are kept in place rather than on the heap, since a batch lives
+// on the stack of whatever records it; BARRIER_BATCH_SIZE of each kind is
+// more than any pass here needs before it records.
+class BarrierBatch {
+ public:
+  BarrierBatch();
+
+  BarrierBatch &image(VkImage image, VkImageLayout oldLayout,
+                      VkImageLayout newLayout,
+                      const VkImageSubresourceRange &range,
+                      uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                      uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+  BarrierBatch &image(VkImage image, VkImageLayout oldLayout,
+                      VkImageLayout newLayout,
+                      const VkImageSubresourceRange &range,
+                      VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                      VkPipelineStageFlags dstStages, VkAccessFlags dstAccess,
+                      uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                      uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+  BarrierBatch &buffer(VkBuffer buffer, VkPipelineStageFlags srcStages,
+                       VkAccessFlags srcAccess, VkPipelineStageFlags dstStages,
+                       VkAccessFlags dstAccess, VkDeviceSize offset = 0,
+                       VkDeviceSize size = VK_WHOLE_SIZE,
+                       uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                       uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+  BarrierBatch &memory(VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                       VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+  void record(VkCommandBuffer cmdBuffer);
+  bool empty() const;
+  bool full() const;
+
+ private:
+  VkPipelineStageFlags srcStages;
+  VkPipelineStageFlags dstStages;
+  FixedVector<VkMemoryBarrier, BARRIER_BATCH_SIZE> memoryBarriers;
+  FixedVector<VkImageMemoryBarrier, BARRIER_BATCH_SIZE> imageBarriers;
+  FixedVector<VkBufferMemoryBarrier, BARRIER_BATCH_SIZE> bufferBarriers;
+};
+
+void setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
+                    VkImageAspectFlags aspects, VkImageLayout oldLayout,
+                    VkImageLayout newLayout);
+void setImageLayout(VkCommandBuffer cmdBuffer, VkImage image,
+                    VkImageLayout oldLayout, VkImageLayout newLayout,
+                    const VkImageSubresourceRange &range);
+
+bool writePPM(const char *path, const void *rgba, uint32_t width,
+              uint32_t height, uint32_t rowPitch);
+
+void hashCombine(size_t &seed, uint64_t value);
+uint64_t hashBytes(const void *data, size_t size);
+
+bool replaceFile(const char *from, const char *to);
+int64_t fileModifiedTime(const char *path);
+
+// A read-only view of a whole file. The mapping is paged in on demand, so
+// large files cost no heap copy and no read until their bytes are touched.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const char *path);
+  void close();
+
+  const void *data() const { return view; }
+  size_t size() const { return length; }
+
+ private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  void *view;
+  size_t length;
+#if defined(_WIN32)
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int file;
+#endif
+};
+}
+
+#endif  // VULKAN_TOOLS_HPP
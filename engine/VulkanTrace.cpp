@@ -0,0 +1,151 @@
+#include "VulkanTrace.hpp"
+
+namespace {
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<TraceRing> > rings;
+  std::chrono::steady_clock::time_point epoch;
+
+  TraceRegistry() : epoch(std::chrono::steady_clock::now()) {}
+};
+
+TraceRegistry &registry() {
+  static TraceRegistry instance;
+  return instance;
+}
+
+TraceRing *localRing() {
+  static thread_local TraceRing *ring = NULL;
+  if (ring) return ring;
+
+  TraceRegistry &traces = registry();
+  std::lock_guard<std::mutex> lock(traces.mutex);
+
+  traces.rings.push_back(std::unique_ptr<TraceRing>(new TraceRing()));
+  ring = traces.rings.back().get();
+  ring->thread = traces.rings.size() - 1;
+  ring->head = 0;
+  return ring;
+}
+
+// Exporting is meant to run once the traced threads are idle; events written
+// concurrently with a snapshot may be torn or dropped.
+void snapshot(std::vector<TraceEvent> &events,
+              std::vector<uint32_t> &threads) {
+  TraceRegistry &traces = registry();
+  std::lock_guard<std::mutex> lock(traces.mutex);
+
+  for (uint32_t i = 0; i < traces.rings.size(); i++) {
+    TraceRing &ring = *traces.rings[i];
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+    for (uint64_t e = first; e < head; e++) {
+      events.push_back(ring.events[e % TRACE_RING_SIZE]);
+      threads.push_back(ring.thread);
+    }
+  }
+}
+
+void writeString(FILE *file, const char *text) {
+  fputc('"', file);
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') fputc('\\', file);
+    fputc(*c, file);
+  }
+  fputc('"', file);
+}
+}
+
+uint64_t VulkanTrace::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - registry().epoch)
+      .count();
+}
+
+void VulkanTrace::record(const char *name, uint64_t start, uint64_t end) {
+  TraceRing *ring = localRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+  TraceEvent &event = ring->events[head % TRACE_RING_SIZE];
+  event.name = name;
+  event.start = start;
+  event.end = end;
+
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool VulkanTrace::exportChrome(const char *path) {
+  std::vector<TraceEvent> events;
+  std::vector<uint32_t> threads;
+  snapshot(events, threads);
+
+  FILE *file = fopen(path, "w");
+  if (!file) return false;
+
+  fprintf(file, "{\"traceEvents\":[\n");
+  for (uint32_t i = 0; i < events.size(); i++) {
+    fprintf(file, "{\"name\":");
+    writeString(file, events[i].name);
+    fprintf(file,
+            ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            threads[i], events[i].start / 1000.0,
+            (events[i].end - events[i].start) / 1000.0,
+            i + 1 < events.size() ? "," : "");
+  }
+  fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+  return fclose(file) == 0;
+}
+
+bool VulkanTrace::exportBinary(const char *path) {
+  std::vector<TraceEvent> events;
+  std::vector<uint32_t> threads;
+  snapshot(events, threads);
+
+  std::map<std::string, uint32_t> nameIndices;
+  std::vector<const char *> names;
+  std::vector<TraceBinaryEvent> records(events.size());
+
+  for (uint32_t i = 0; i < events.size(); i++) {
+    std::map<std::string, uint32_t>::iterator it =
+        nameIndices.find(events[i].name);
+    if (it == nameIndices.end()) {
+      it = nameIndices.insert(std::make_pair(events[i].name, names.size()))
+               .first;
+      names.push_back(events[i].name);
+    }
+
+    records[i].name = it->second;
+    records[i].thread = threads[i];
+    records[i].start = events[i].start;
+    records[i].duration = events[i].end - events[i].start;
+  }
+
+  FILE *file = fopen(path, "wb");
+  if (!file) return false;
+
+  TraceBinaryHeader header;
+  header.magic = TRACE_BINARY_MAGIC;
+  header.version = TRACE_BINARY_VERSION;
+  header.nameCount = names.size();
+  header.eventCount = records.size();
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (uint32_t i = 0; i < names.size(); i++)
+    ok = fwrite(names[i], strlen(names[i]) + 1, 1, file) == 1 && ok;
+  if (!records.empty())
+    ok = fwrite(records.data(), sizeof(TraceBinaryEvent), records.size(),
+                file) == records.size() && ok;
+
+  return fclose(file) == 0 && ok;
+}
+
+bool VulkanTrace::exportFile(const char *path) {
+  size_t length = strlen(path);
+  bool json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+
+  bool ok = json ? exportChrome(path) : exportBinary(path);
+  fprintf(stdout, "CPU Trace:      %s (%s)\n", path, ok ? "written" : "failed");
+  return ok;
+}
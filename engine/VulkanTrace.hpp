@@ -0,0 +1,68 @@
+#ifndef VULKAN_TRACE_HPP
+#define VULKAN_TRACE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TRACE_RING_SIZE 8192
+#define TRACE_FILE_ENV "VULKAN_EXAMPLE_TRACE"
+#define TRACE_BINARY_MAGIC 0x52544b56
+#define TRACE_BINARY_VERSION 1
+
+struct TraceEvent {
+  const char *name;
+  uint64_t start;
+  uint64_t end;
+};
+
+struct TraceRing {
+  uint32_t thread;
+  std::atomic<uint64_t> head;
+  TraceEvent events[TRACE_RING_SIZE];
+};
+
+struct TraceBinaryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nameCount;
+  uint32_t eventCount;
+};
+
+struct TraceBinaryEvent {
+  uint32_t name;
+  uint32_t thread;
+  uint64_t start;
+  uint64_t duration;
+};
+
+namespace VulkanTrace {
+uint64_t now();
+void record(const char *name, uint64_t start, uint64_t end);
+bool exportChrome(const char *path);
+bool exportBinary(const char *path);
+bool exportFile(const char *path);
+}
+
+class TraceZone {
+ public:
+  TraceZone(const char *name) : name(name), start(VulkanTrace::now()) {}
+  ~TraceZone() { VulkanTrace::record(name, start, VulkanTrace::now()); }
+
+ private:
+  const char *name;
+  uint64_t start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+#endif
@@ -0,0 +1,149 @@
+#include "VulkanUniforms.hpp"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+VulkanUniformRing::VulkanUniformRing()
+    : setLayout(VK_NULL_HANDLE),
+      descriptorSet(VK_NULL_HANDLE),
+      alignment(1),
+      bindRange(0),
+      device(VK_NULL_HANDLE),
+      resources(NULL),
+      mapped(NULL),
+      descriptorPool(VK_NULL_HANDLE),
+      frameSize(0),
+      base(0),
+      head(0) {}
+
+void VulkanUniformRing::init(VkDevice device, VulkanResources &resources,
+                             VulkanDescriptorLayouts &layouts,
+                             const VkPhysicalDeviceLimits &limits,
+                             uint32_t framesInFlight, VkDeviceSize frameSize,
+                             VkDeviceSize bindRange,
+                             VkShaderStageFlags stages) {
+  this->device = device;
+  this->resources = &resources;
+
+  alignment = limits.minUniformBufferOffsetAlignment;
+  if (alignment == 0) alignment = 1;
+
+  this->bindRange = bindRange;
+  if (this->bindRange > limits.maxUniformBufferRange)
+    this->bindRange = limits.maxUniformBufferRange;
+  this->frameSize = alignUp(frameSize, alignment);
+
+  // The descriptor's range sits past the offset of every allocation, so the
+  // buffer keeps one extra range at its end for the last frame's region.
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = this->frameSize * framesInFlight + this->bindRange;
+  bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = NULL;
+
+  buffer = resources.createBuffer(
+      bufferInfo,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ALLOCATION_FREE_LIST,
+      MEMORY_UNIFORMS);
+  const BufferResource *resource = resources.buffer(buffer);
+  mapped = (char *)resource->allocation.mapped;
+  assert(mapped != NULL);
+
+  DescriptorLayoutKey layoutKey;
+  layoutKey.add(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, stages);
+  setLayout = layouts.layout(layoutKey);
+
+  VkDescriptorPoolSize poolSize = {};
+  poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  poolSize.descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.pNext = NULL;
+  poolInfo.flags = 0;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+
+  VkResult result =
+      vkd.CreateDescriptorPool(device, &poolInfo, vkAllocator, &descriptorPool);
+  assert(result == VK_SUCCESS);
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.pNext = NULL;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &setLayout;
+
+  result = vkd.AllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+  assert(result == VK_SUCCESS);
+
+  VkDescriptorBufferInfo descriptorInfo = {};
+  descriptorInfo.buffer = resource->buffer;
+  descriptorInfo.offset = 0;
+  descriptorInfo.range = this->bindRange;
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.pNext = NULL;
+  write.dstSet = descriptorSet;
+  write.dstBinding = 0;
+  write.dstArrayElement = 0;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  write.pImageInfo = NULL;
+  write.pBufferInfo = &descriptorInfo;
+  write.pTexelBufferView = NULL;
+
+  vkd.UpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+  base = 0;
+  head = 0;
+}
+
+void VulkanUniformRing::destroy() {
+  if (descriptorPool != VK_NULL_HANDLE)
+    vkd.DestroyDescriptorPool(device, descriptorPool, vkAllocator);
+  if (resources) resources->destroyBuffer(buffer);
+
+  descriptorPool = VK_NULL_HANDLE;
+  setLayout = VK_NULL_HANDLE;
+  descriptorSet = VK_NULL_HANDLE;
+  buffer = ResourceHandle();
+  mapped = NULL;
+}
+
+void VulkanUniformRing::beginFrame(uint32_t frame) {
+  base = frame * frameSize;
+  head = 0;
+}
+
+UniformAllocation VulkanUniformRing::allocate(VkDeviceSize size) {
+  assert(size <= bindRange);
+
+  VkDeviceSize aligned = alignUp(size, alignment);
+  VkDeviceSize offset = head.fetch_add(aligned);
+  if (offset + aligned > frameSize)
+    VulkanTools::exitOnError("Uniform ring is full for this frame");
+
+  UniformAllocation allocation;
+  allocation.data = mapped + base + offset;
+  allocation.offset = (uint32_t)(base + offset);
+  return allocation;
+}
+
+void VulkanUniformRing::bind(VkCommandBuffer cmdBuffer,
+                             VkPipelineLayout pipelineLayout,
+                             uint32_t firstSet, uint32_t offset,
+                             VkPipelineBindPoint bindPoint) const {
+  vkd.CmdBindDescriptorSets(cmdBuffer, bindPoint, pipelineLayout, firstSet, 1,
+                            &descriptorSet, 1, &offset);
+}
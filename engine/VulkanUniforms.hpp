@@ -0,0 +1,67 @@
+#ifndef VULKAN_UNIFORMS_HPP
+#define VULKAN_UNIFORMS_HPP
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#include "VulkanDescriptors.hpp"
+#include "VulkanResources.hpp"
+#include "VulkanTools.hpp"
+
+#define UNIFORM_RING_FRAME_SIZE (1024 * 1024)
+#define UNIFORM_RING_BIND_RANGE 256
+
+struct UniformAllocation {
+  void *data;
+  uint32_t offset;
+};
+
+// Per-object uniforms are written into a persistently mapped ring with one
+// region per frame in flight. A single UNIFORM_BUFFER_DYNAMIC descriptor
+// covers the whole buffer, so each draw only passes its offset when binding.
+class VulkanUniformRing {
+ public:
+  VulkanUniformRing();
+  void init(VkDevice device, VulkanResources &resources,
+            VulkanDescriptorLayouts &layouts,
+            const VkPhysicalDeviceLimits &limits, uint32_t framesInFlight,
+            VkDeviceSize frameSize = UNIFORM_RING_FRAME_SIZE,
+            VkDeviceSize bindRange = UNIFORM_RING_BIND_RANGE,
+            VkShaderStageFlags stages = VK_SHADER_STAGE_ALL_GRAPHICS);
+  void destroy();
+
+  void beginFrame(uint32_t frame);
+  UniformAllocation allocate(VkDeviceSize size);
+  void bind(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout,
+            uint32_t firstSet, uint32_t offset,
+            VkPipelineBindPoint bindPoint =
+                VK_PIPELINE_BIND_POINT_GRAPHICS) const;
+
+  template <typename T>
+  uint32_t push(const T &data) {
+    UniformAllocation allocation = allocate(sizeof(T));
+    memcpy(allocation.data, &data, sizeof(T));
+    return allocation.offset;
+  }
+
+  VkDeviceSize frameBytes() const { return head.load(); }
+
+  VkDescriptorSetLayout setLayout;
+  VkDescriptorSet descriptorSet;
+  VkDeviceSize alignment;
+  VkDeviceSize bindRange;
+
+ private:
+  VkDevice device;
+  VulkanResources *resources;
+  ResourceHandle buffer;
+  char *mapped;
+  VkDescriptorPool descriptorPool;
+  VkDeviceSize frameSize;
+  VkDeviceSize base;
+  std::atomic<VkDeviceSize> head;
+};
+
+#endif
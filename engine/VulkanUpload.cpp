@@ -0,0 +1,443 @@
+#include "VulkanUpload.hpp"
+
+VulkanUpload::VulkanUpload()
+    : ringSize(0),
+      maxRingSize(0),
+      waitStage(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT),
+      device(VK_NULL_HANDLE),
+      memory(NULL),
+      transferQueue(VK_NULL_HANDLE),
+      transferFamily(0),
+      graphicsFamily(0),
+      ringBuffer(VK_NULL_HANDLE),
+      head(0),
+      tail(0),
+      used(0),
+      cmdPool(VK_NULL_HANDLE),
+      currentSlot(0) {
+  ringMemory = {};
+}
+
+void VulkanUpload::init(VkDevice device, VulkanMemory &memory,
+                        const QueueRegistry &queues,
+                        VulkanSubmitter &submitter, uint32_t slotCount,
+                        VkDeviceSize ringSize) {
+  assert(slotCount >= 1);
+
+  this->device = device;
+  this->memory = &memory;
+  this->submitter = &submitter;
+  timeline = submitter.timeline();
+  maxRingSize = ringSize;
+  transferQueue = queues.queue(QUEUE_TRANSFER);
+  transferFamily = queues.family(QUEUE_TRANSFER);
+  graphicsFamily = queues.family(QUEUE_GRAPHICS);
+
+  createRing(ringSize);
+
+  // Under memory pressure the ring gives back half of itself.
+  memory.addPressureListener([this](uint32_t heap, VkDeviceSize excess) {
+    if (this->memory->memoryProperties.memoryTypes[ringMemory.memoryType]
+            .heapIndex == heap)
+      trim();
+  });
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.pNext = NULL;
+  cmdPoolInfo.queueFamilyIndex = transferFamily;
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  VkResult result =
+      vkd.CreateCommandPool(device, &cmdPoolInfo, vkAllocator, &cmdPool);
+  assert(result == VK_SUCCESS);
+
+  std::vector<VkCommandBuffer> cmdBuffers(slotCount);
+
+  VkCommandBufferAllocateInfo cmdInfo = {};
+  cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdInfo.pNext = NULL;
+  cmdInfo.commandPool = cmdPool;
+  cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdInfo.commandBufferCount = slotCount;
+
+  result = vkd.AllocateCommandBuffers(device, &cmdInfo, cmdBuffers.data());
+  assert(result == VK_SUCCESS);
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = NULL;
+  semaphoreInfo.flags = 0;
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.pNext = NULL;
+  fenceInfo.flags = 0;
+
+  slots.resize(slotCount);
+  for (uint32_t i = 0; i < slotCount; i++) {
+    slots[i].cmdBuffer = cmdBuffers[i];
+    slots[i].fence = VK_NULL_HANDLE;
+    slots[i].value = 0;
+    slots[i].ringBytes = 0;
+    slots[i].recording = false;
+    slots[i].pending = false;
+
+    result = vkd.CreateSemaphore(device, &semaphoreInfo, vkAllocator,
+                                 &slots[i].semaphore);
+    assert(result == VK_SUCCESS);
+
+    // With a timeline, slots are reclaimed off the transfer queue's counter.
+    if (timeline) continue;
+    result = vkd.CreateFence(device, &fenceInfo, vkAllocator, &slots[i].fence);
+    assert(result == VK_SUCCESS);
+  }
+
+  currentSlot = 0;
+}
+
+void VulkanUpload::destroy() {
+  if (slots.empty()) return;
+
+  if (slots[currentSlot].recording) flush();
+  for (uint32_t i = 0; i < slots.size(); i++) {
+    if (slots[i].pending) reclaim(i);
+
+    vkd.DestroySemaphore(device, slots[i].semaphore, vkAllocator);
+    vkd.DestroyFence(device, slots[i].fence, vkAllocator);
+  }
+  slots.clear();
+
+  vkd.DestroyCommandPool(device, cmdPool, vkAllocator);
+  vkd.DestroyBuffer(device, ringBuffer, vkAllocator);
+  memory->free(ringMemory);
+
+  bufferAcquires.clear();
+  imageAcquires.clear();
+}
+
+void VulkanUpload::createRing(VkDeviceSize size) {
+  ringSize = size;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = NULL;
+  bufferInfo.flags = 0;
+  bufferInfo.size = ringSize;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bufferInfo.queueFamilyIndexCount = 0;
+  bufferInfo.pQueueFamilyIndices = NULL;
+
+  VkResult result =
+      vkd.CreateBuffer(device, &bufferInfo, vkAllocator, &ringBuffer);
+  assert(result == VK_SUCCESS);
+  debugUtils.name(VK_OBJECT_TYPE_BUFFER, ringBuffer, "upload ring");
+
+  ringMemory = memory->allocateBuffer(
+      ringBuffer,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      0, ALLOCATION_FREE_LIST, MEMORY_STAGING);
+  assert(ringMemory.mapped != NULL);
+
+  head = tail = used = 0;
+}
+
+// Waits for everything in flight through the ring, since the copies still
+// read from the old buffer.
+void VulkanUpload::resize(VkDeviceSize size) {
+  flush();
+  for (uint32_t i = 0; i < slots.size(); i++)
+    if (slots[i].pending) reclaim(i);
+
+  vkd.DestroyBuffer(device, ringBuffer, vkAllocator);
+  memory->free(ringMemory);
+  createRing(size);
+}
+
+// Halves the ring, down to UPLOAD_RING_MIN_SIZE, between frames. An upload
+// larger than the trimmed ring grows it back, up to the size it was created
+// with.
+bool VulkanUpload::trim() {
+  if (slots.empty() || slots[currentSlot].recording) return false;
+
+  VkDeviceSize size =
+      std::max<VkDeviceSize>(ringSize / 2, UPLOAD_RING_MIN_SIZE);
+  if (size >= ringSize) return false;
+
+  resize(size);
+  return true;
+}
+
+bool VulkanUpload::tryReserve(VkDeviceSize size, VkDeviceSize alignment,
+                              VkDeviceSize *offset) {
+  if (used == 0) head = tail = 0;
+
+  VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+  VkDeviceSize consumed;
+
+  if (head > tail || used == 0) {
+    if (aligned + size <= ringSize) {
+      *offset = aligned;
+      consumed = aligned + size - head;
+    } else if (size <= tail) {
+      *offset = 0;
+      consumed = ringSize - head + size;
+    } else {
+      return false;
+    }
+  } else if (head < tail && aligned + size <= tail) {
+    *offset = aligned;
+    consumed = aligned + size - head;
+  } else {
+    return false;
+  }
+
+  head = *offset + size;
+  used += consumed;
+  slots[currentSlot].ringBytes += consumed;
+  return true;
+}
+
+VkDeviceSize VulkanUpload::reserve(VkDeviceSize size, VkDeviceSize alignment,
+                                   const void *data) {
+  if (size > maxRingSize)
+    VulkanTools::exitOnError("Upload exceeds the staging ring size");
+  if (size > ringSize) resize(maxRingSize);
+
+  if (slots[currentSlot].pending) reclaim(currentSlot);
+
+  VkDeviceSize offset;
+  while (!tryReserve(size, alignment, &offset)) {
+    uint32_t oldest = UINT32_MAX;
+    for (uint32_t i = 1; i < slots.size(); i++) {
+      uint32_t slot = (currentSlot + i) % slots.size();
+      if (slots[slot].pending) {
+        oldest = slot;
+        break;
+      }
+    }
+
+    if (oldest != UINT32_MAX)
+      reclaim(oldest);
+    else
+      flush();
+  }
+
+  memcpy((char *)ringMemory.mapped + offset, data, size);
+  return offset;
+}
+
+VkCommandBuffer VulkanUpload::begin() {
+  UploadSlot &slot = slots[currentSlot];
+  if (slot.recording) return slot.cmdBuffer;
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.pNext = NULL;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = NULL;
+
+  VkResult result = vkd.BeginCommandBuffer(slot.cmdBuffer, &beginInfo);
+  assert(result == VK_SUCCESS);
+
+  slot.recording = true;
+  debugUtils.beginLabel(slot.cmdBuffer, "upload");
+  return slot.cmdBuffer;
+}
+
+void VulkanUpload::end(bool signal) {
+  UploadSlot &slot = slots[currentSlot];
+  assert(slot.recording);
+
+  bool transfer = transferFamily != graphicsFamily;
+  imageReleases = slot.imageBarriers;
+  bufferReleases.clear();
+  if (transfer) bufferReleases = slot.bufferBarriers;
+
+  for (uint32_t i = 0; i < bufferReleases.size(); i++) {
+    bufferReleases[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferReleases[i].dstAccessMask = 0;
+  }
+
+  for (uint32_t i = 0; i < imageReleases.size(); i++) {
+    imageReleases[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageReleases[i].dstAccessMask = 0;
+    if (!transfer) {
+      imageReleases[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageReleases[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+  }
+
+  if (!bufferReleases.empty() || !imageReleases.empty())
+    vkd.CmdPipelineBarrier(slot.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL,
+                           bufferReleases.size(), bufferReleases.data(),
+                           imageReleases.size(), imageReleases.data());
+
+  if (transfer) {
+    bufferAcquires.insert(bufferAcquires.end(), slot.bufferBarriers.begin(),
+                          slot.bufferBarriers.end());
+    imageAcquires.insert(imageAcquires.end(), slot.imageBarriers.begin(),
+                         slot.imageBarriers.end());
+  }
+  slot.bufferBarriers.clear();
+  slot.imageBarriers.clear();
+
+  debugUtils.endLabel(slot.cmdBuffer);
+  VkResult result = vkd.EndCommandBuffer(slot.cmdBuffer);
+  assert(result == VK_SUCCESS);
+
+  if (slot.fence != VK_NULL_HANDLE)
+    submitter->fence(transferQueue, slot.fence);
+  submitter->submit(transferQueue, slot.cmdBuffer);
+  if (signal) submitter->signal(transferQueue, slot.semaphore);
+  if (timeline) slot.value = timeline->next(transferQueue);
+
+  slot.recording = false;
+  slot.pending = true;
+}
+
+void VulkanUpload::reclaim(uint32_t index) {
+  UploadSlot &slot = slots[index];
+  assert(slot.pending);
+
+  // The slot's submission may still be waiting in the coalescer.
+  submitter->flush(transferQueue);
+
+  if (timeline) {
+    timeline->wait(transferQueue, slot.value);
+  } else {
+    VkResult result =
+        vkd.WaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+
+    result = vkd.ResetFences(device, 1, &slot.fence);
+    assert(result == VK_SUCCESS);
+  }
+
+  tail = (tail + slot.ringBytes) % ringSize;
+  used -= slot.ringBytes;
+  slot.ringBytes = 0;
+  slot.pending = false;
+}
+
+void VulkanUpload::uploadBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                const void *data, VkDeviceSize size,
+                                VkAccessFlags dstAccess) {
+  VkDeviceSize srcOffset = reserve(size, UPLOAD_ALIGNMENT, data);
+  VkCommandBuffer cmdBuffer = begin();
+
+  VkBufferCopy copy = {};
+  copy.srcOffset = srcOffset;
+  copy.dstOffset = offset;
+  copy.size = size;
+  vkd.CmdCopyBuffer(cmdBuffer, ringBuffer, buffer, 1, &copy);
+
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.pNext = NULL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccess;
+  barrier.srcQueueFamilyIndex = transferFamily;
+  barrier.dstQueueFamilyIndex = graphicsFamily;
+  barrier.buffer = buffer;
+  barrier.offset = offset;
+  barrier.size = size;
+  slots[currentSlot].bufferBarriers.push_back(barrier);
+}
+
+void VulkanUpload::uploadShared(VkBuffer buffer, VkDeviceSize offset,
+                               const void *data, VkDeviceSize size) {
+  VkDeviceSize srcOffset = reserve(size, UPLOAD_ALIGNMENT, data);
+  VkCommandBuffer cmdBuffer = begin();
+
+  VkBufferCopy copy = {};
+  copy.srcOffset = srcOffset;
+  copy.dstOffset = offset;
+  copy.size = size;
+  vkd.CmdCopyBuffer(cmdBuffer, ringBuffer, buffer, 1, &copy);
+}
+
+void VulkanUpload::copyShared(VkBuffer srcBuffer, VkBuffer dstBuffer,
+                              const VkBufferCopy *regions,
+                              uint32_t regionCount) {
+  if (regionCount == 0) return;
+
+  VkCommandBuffer cmdBuffer = begin();
+  VulkanTools::BarrierBatch barriers;
+  barriers
+      .memory(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT)
+      .record(cmdBuffer);
+  vkd.CmdCopyBuffer(cmdBuffer, srcBuffer, dstBuffer, regionCount, regions);
+}
+
+uint32_t VulkanUpload::sharedFamilies(uint32_t *families) const {
+  families[0] = graphicsFamily;
+  families[1] = transferFamily;
+  return transferFamily != graphicsFamily ? 2 : 1;
+}
+
+void VulkanUpload::uploadImage(VkImage image, const VkBufferImageCopy &region,
+                               const void *data, VkDeviceSize size,
+                               VkImageLayout finalLayout,
+                               VkAccessFlags dstAccess) {
+  VkDeviceSize srcOffset = reserve(size, UPLOAD_ALIGNMENT, data);
+  VkCommandBuffer cmdBuffer = begin();
+
+  VkImageSubresourceRange range = VulkanTools::subresourceRange(
+      region.imageSubresource.aspectMask, region.imageSubresource.mipLevel, 1,
+      region.imageSubresource.baseArrayLayer,
+      region.imageSubresource.layerCount);
+  VulkanTools::setImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+
+  VkBufferImageCopy copy = region;
+  copy.bufferOffset = srcOffset;
+  vkd.CmdCopyBufferToImage(cmdBuffer, ringBuffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.pNext = NULL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = dstAccess;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = finalLayout;
+  barrier.srcQueueFamilyIndex = transferFamily;
+  barrier.dstQueueFamilyIndex = graphicsFamily;
+  barrier.image = image;
+  barrier.subresourceRange = range;
+  slots[currentSlot].imageBarriers.push_back(barrier);
+}
+
+VkSemaphore VulkanUpload::submit() {
+  if (slots.empty() || !slots[currentSlot].recording) return VK_NULL_HANDLE;
+
+  VkSemaphore semaphore = slots[currentSlot].semaphore;
+  end(true);
+  currentSlot = (currentSlot + 1) % slots.size();
+
+  return semaphore;
+}
+
+void VulkanUpload::flush() {
+  if (!slots[currentSlot].recording) return;
+
+  end(false);
+  reclaim(currentSlot);
+}
+
+void VulkanUpload::acquire(VkCommandBuffer cmdBuffer) {
+  if (bufferAcquires.empty() && imageAcquires.empty()) return;
+
+  vkd.CmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL,
+                         bufferAcquires.size(), bufferAcquires.data(),
+                         imageAcquires.size(), imageAcquires.data());
+
+  bufferAcquires.clear();
+  imageAcquires.clear();
+}
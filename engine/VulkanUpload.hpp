@@ -0,0 +1,102 @@
+#ifndef VULKAN_UPLOAD_HPP
+#define VULKAN_UPLOAD_HPP
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#include "VulkanDebug.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanSubmit.hpp"
+#include "VulkanTools.hpp"
+
+#define UPLOAD_RING_SIZE (8 * 1024 * 1024)
+#define UPLOAD_RING_MIN_SIZE (1024 * 1024)
+#define UPLOAD_ALIGNMENT 16
+
+struct UploadSlot {
+  VkCommandBuffer cmdBuffer;
+  VkFence fence;
+  uint64_t value;
+  VkSemaphore semaphore;
+  VkDeviceSize ringBytes;
+  bool recording;
+  bool pending;
+  std::vector<VkBufferMemoryBarrier> bufferBarriers;
+  std::vector<VkImageMemoryBarrier> imageBarriers;
+};
+
+class VulkanUpload {
+ public:
+  VulkanUpload();
+  void init(VkDevice device, VulkanMemory &memory, const QueueRegistry &queues,
+            VulkanSubmitter &submitter, uint32_t slotCount,
+            VkDeviceSize ringSize = UPLOAD_RING_SIZE);
+  void destroy();
+
+  void uploadBuffer(
+      VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+      VkAccessFlags dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                VK_ACCESS_INDEX_READ_BIT);
+  void uploadImage(VkImage image, const VkBufferImageCopy &region,
+                   const void *data, VkDeviceSize size,
+                   VkImageLayout finalLayout =
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT);
+
+  // For buffers created concurrent between sharedFamilies(): no ownership
+  // moves to graphics, which sees the writes once it waits on submit()'s
+  // semaphore. Copies wait for every transfer recorded before them.
+  void uploadShared(VkBuffer buffer, VkDeviceSize offset, const void *data,
+                    VkDeviceSize size);
+  void copyShared(VkBuffer srcBuffer, VkBuffer dstBuffer,
+                  const VkBufferCopy *regions, uint32_t regionCount);
+  uint32_t sharedFamilies(uint32_t *families) const;
+
+  VkSemaphore submit();
+  void flush();
+  void acquire(VkCommandBuffer cmdBuffer);
+  bool trim();
+
+  VkDeviceSize ringSize;
+  VkDeviceSize maxRingSize;
+  VkPipelineStageFlags waitStage;
+
+ private:
+  VkDevice device;
+  VulkanMemory *memory;
+  VulkanSubmitter *submitter;
+  VulkanTimeline *timeline;
+  VkQueue transferQueue;
+  uint32_t transferFamily;
+  uint32_t graphicsFamily;
+
+  VkBuffer ringBuffer;
+  MemoryAllocation ringMemory;
+  VkDeviceSize head;
+  VkDeviceSize tail;
+  VkDeviceSize used;
+
+  VkCommandPool cmdPool;
+  std::vector<UploadSlot> slots;
+  uint32_t currentSlot;
+  std::vector<VkBufferMemoryBarrier> bufferAcquires;
+  std::vector<VkImageMemoryBarrier> imageAcquires;
+  std::vector<VkBufferMemoryBarrier> bufferReleases;
+  std::vector<VkImageMemoryBarrier> imageReleases;
+
+  void createRing(VkDeviceSize size);
+  void resize(VkDeviceSize size);
+  bool tryReserve(VkDeviceSize size, VkDeviceSize alignment,
+                  VkDeviceSize *offset);
+  VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment,
+                       const void *data);
+  VkCommandBuffer begin();
+  void end(bool signal);
+  void reclaim(uint32_t slot);
+};
+
+#endif
@@ -0,0 +1,536 @@
+#include "VulkanWindowSystem.hpp"
+
+#if defined(__linux__)
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+#include <poll.h>
+#include "xdg-shell-client-protocol.h"
+#endif
+
+VulkanWindowSystem::VulkanWindowSystem()
+    : system(WINDOW_SYSTEM_XCB),
+      connected(false),
+      closed(false),
+      windowCount(0),
+      connection(NULL),
+      screen(NULL),
+      wmProtocols(0),
+      wmDeleteWin(0)
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+      ,
+      display(NULL),
+      registry(NULL),
+      compositor(NULL),
+      wmBase(NULL)
+#endif
+{
+}
+
+WindowSystem VulkanWindowSystem::select(const char *name) {
+  if (name && name[0] != '\0') {
+    if (strcmp(name, "xcb") == 0) return WINDOW_SYSTEM_XCB;
+    if (strcmp(name, "display") == 0) return WINDOW_SYSTEM_DISPLAY;
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+    if (strcmp(name, "wayland") == 0) return WINDOW_SYSTEM_WAYLAND;
+#endif
+
+    fprintf(stderr,
+            "No window system matches %s=%s, selecting automatically.\n",
+            WINDOW_SYSTEM_ENV, name);
+  }
+
+  // Under a Wayland session X clients go through Xwayland, one more hop.
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+  if (getenv("WAYLAND_DISPLAY") != NULL) return WINDOW_SYSTEM_WAYLAND;
+#endif
+  return WINDOW_SYSTEM_XCB;
+}
+
+const char *VulkanWindowSystem::name(WindowSystem system) {
+  switch (system) {
+    case WINDOW_SYSTEM_WAYLAND:
+      return "wayland";
+    case WINDOW_SYSTEM_DISPLAY:
+      return "display";
+    default:
+      return "xcb";
+  }
+}
+
+const char *VulkanWindowSystem::surfaceExtension(WindowSystem system) {
+  switch (system) {
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+    case WINDOW_SYSTEM_WAYLAND:
+      return VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME;
+#endif
+    case WINDOW_SYSTEM_DISPLAY:
+      return VK_KHR_DISPLAY_EXTENSION_NAME;
+    default:
+      return VK_KHR_XCB_SURFACE_EXTENSION_NAME;
+  }
+}
+
+VkResult VulkanWindowSystem::createSurface(VkInstance instance,
+                                           VkPhysicalDevice physicalDevice,
+                                           const NativeWindow &window,
+                                           VkSurfaceKHR *surface) {
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+  if (window.system == WINDOW_SYSTEM_WAYLAND) {
+    VkWaylandSurfaceCreateInfoKHR surfaceCreateInfo = {};
+    surfaceCreateInfo.sType =
+        VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+    surfaceCreateInfo.pNext = NULL;
+    surfaceCreateInfo.flags = 0;
+    surfaceCreateInfo.display = window.display;
+    surfaceCreateInfo.surface = window.surface;
+    return vkCreateWaylandSurfaceKHR(instance, &surfaceCreateInfo,
+                                     vkAllocator, surface);
+  }
+#endif
+
+  if (window.system == WINDOW_SYSTEM_DISPLAY)
+    return createDisplaySurface(instance, physicalDevice, window.displayIndex,
+                                surface);
+
+  VkXcbSurfaceCreateInfoKHR surfaceCreateInfo = {};
+  surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+  surfaceCreateInfo.pNext = NULL;
+  surfaceCreateInfo.flags = 0;
+  surfaceCreateInfo.connection = window.connection;
+  surfaceCreateInfo.window = window.window;
+  return vkCreateXcbSurfaceKHR(instance, &surfaceCreateInfo, vkAllocator,
+                               surface);
+}
+
+void VulkanWindowSystem::init(WindowSystem system) {
+  this->system = system;
+  connected = true;
+  closed = false;
+
+  switch (system) {
+    case WINDOW_SYSTEM_XCB:
+      connectXcb();
+      break;
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+    case WINDOW_SYSTEM_WAYLAND:
+      connectWayland();
+      break;
+#endif
+    default:
+      break;
+  }
+
+  fprintf(stdout, "Window System:  %s\n", name(system));
+}
+
+void VulkanWindowSystem::destroy() {
+  if (!connected) return;
+
+  // The surfaces made from these windows have to be gone already.
+  if (system == WINDOW_SYSTEM_XCB) {
+    for (uint32_t i = 0; i < xcbWindows.size(); i++)
+      xcb_destroy_window(connection, xcbWindows[i]);
+    xcb_disconnect(connection);
+    xcbWindows.clear();
+    connection = NULL;
+  }
+
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+  if (system == WINDOW_SYSTEM_WAYLAND) {
+    for (uint32_t i = 0; i < waylandWindows.size(); i++) {
+      xdg_toplevel_destroy(waylandWindows[i].toplevel);
+      xdg_surface_destroy(waylandWindows[i].xdgSurface);
+      wl_surface_destroy(waylandWindows[i].surface);
+    }
+    waylandWindows.clear();
+    if (wmBase) xdg_wm_base_destroy(wmBase);
+    if (compositor) wl_compositor_destroy(compositor);
+    wl_registry_destroy(registry);
+    wl_display_disconnect(display);
+    wmBase = NULL;
+    compositor = NULL;
+    registry = NULL;
+    display = NULL;
+  }
+#endif
+
+  windowCount = 0;
+  connected = false;
+}
+
+NativeWindow VulkanWindowSystem::createWindow(uint32_t width,
+                                              uint32_t height) {
+  NativeWindow window = {};
+  window.system = system;
+
+  switch (system) {
+    case WINDOW_SYSTEM_XCB:
+      window = createXcbWindow(width, height);
+      break;
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+    case WINDOW_SYSTEM_WAYLAND:
+      window = createWaylandWindow(width, height);
+      break;
+#endif
+    default:
+      // Each window takes the next display; it has nothing to create until
+      // its surface is made.
+      window.displayIndex = windowCount;
+      break;
+  }
+
+  windowCount++;
+  return window;
+}
+
+bool VulkanWindowSystem::pumpEvents(const ResizeCallback &resized) {
+  switch (system) {
+    case WINDOW_SYSTEM_XCB:
+      return pumpXcb(resized);
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+    case WINDOW_SYSTEM_WAYLAND:
+      return pumpWayland(resized);
+#endif
+    default:
+      return !closed;
+  }
+}
+
+void VulkanWindowSystem::connectXcb() {
+  int screenp = 0;
+  connection = xcb_connect(NULL, &screenp);
+
+  if (xcb_connection_has_error(connection))
+    VulkanTools::exitOnError("Failed to connect to X server using XCB.");
+
+  xcb_screen_iterator_t iter =
+      xcb_setup_roots_iterator(xcb_get_setup(connection));
+
+  for (int s = screenp; s > 0; s--) xcb_screen_next(&iter);
+
+  screen = iter.data;
+
+  xcb_intern_atom_cookie_t wmDeleteCookie = xcb_intern_atom(
+      connection, 0, strlen("WM_DELETE_WINDOW"), "WM_DELETE_WINDOW");
+  xcb_intern_atom_cookie_t wmProtocolsCookie =
+      xcb_intern_atom(connection, 0, strlen("WM_PROTOCOLS"), "WM_PROTOCOLS");
+  xcb_intern_atom_reply_t *wmDeleteReply =
+      xcb_intern_atom_reply(connection, wmDeleteCookie, NULL);
+  xcb_intern_atom_reply_t *wmProtocolsReply =
+      xcb_intern_atom_reply(connection, wmProtocolsCookie, NULL);
+  wmDeleteWin = wmDeleteReply->atom;
+  wmProtocols = wmProtocolsReply->atom;
+  free(wmDeleteReply);
+  free(wmProtocolsReply);
+}
+
+NativeWindow VulkanWindowSystem::createXcbWindow(uint32_t width,
+                                                 uint32_t height) {
+  xcb_window_t window = xcb_generate_id(connection);
+  uint32_t eventMask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+  uint32_t valueList[] = {screen->black_pixel,
+                          XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+
+  // Later windows cascade down and to the right of the first.
+  int16_t offset = windowCount * WINDOW_CASCADE;
+  xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, screen->root,
+                    offset, offset, width, height, 0,
+                    XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                    eventMask, valueList);
+  xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window,
+                      XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8,
+                      strlen(APPLICATION_NAME), APPLICATION_NAME);
+
+  xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, wmProtocols,
+                      4, 32, 1, &wmDeleteWin);
+  xcb_map_window(connection, window);
+  xcb_flush(connection);
+
+  xcbWindows.push_back(window);
+
+  NativeWindow native = {};
+  native.system = WINDOW_SYSTEM_XCB;
+  native.connection = connection;
+  native.window = window;
+  return native;
+}
+
+bool VulkanWindowSystem::pumpXcb(const ResizeCallback &resized) {
+  xcb_generic_event_t *event;
+  xcb_client_message_event_t *cm;
+  xcb_configure_notify_event_t *cfg;
+
+  while ((event = xcb_poll_for_event(connection)) != NULL) {
+    switch (event->response_type & ~0x80) {
+      case XCB_CLIENT_MESSAGE: {
+        cm = (xcb_client_message_event_t *)event;
+
+        // Closing any of the windows ends the loop for all of them.
+        if (cm->data.data32[0] == wmDeleteWin) closed = true;
+
+        break;
+      }
+      case XCB_CONFIGURE_NOTIFY: {
+        cfg = (xcb_configure_notify_event_t *)event;
+        for (uint32_t i = 0; i < xcbWindows.size(); i++)
+          if (xcbWindows[i] == cfg->window)
+            resized(i, cfg->width, cfg->height);
+
+        break;
+      }
+    }
+
+    free(event);
+  }
+
+  if (xcb_connection_has_error(connection)) closed = true;
+
+  return !closed;
+}
+
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+struct WaylandListeners {
+  static void global(void *data, struct wl_registry *registry, uint32_t name,
+                     const char *interface, uint32_t version) {
+    VulkanWindowSystem *windowSystem = (VulkanWindowSystem *)data;
+
+    if (strcmp(interface, wl_compositor_interface.name) == 0)
+      windowSystem->compositor = (struct wl_compositor *)wl_registry_bind(
+          registry, name, &wl_compositor_interface, 1);
+    else if (strcmp(interface, xdg_wm_base_interface.name) == 0)
+      windowSystem->wmBase = (struct xdg_wm_base *)wl_registry_bind(
+          registry, name, &xdg_wm_base_interface, 1);
+  }
+
+  static void globalRemove(void *, struct wl_registry *, uint32_t) {}
+
+  // A client that stops answering pings is taken for hung.
+  static void ping(void *, struct xdg_wm_base *wmBase, uint32_t serial) {
+    xdg_wm_base_pong(wmBase, serial);
+  }
+
+  static void surfaceConfigure(void *, struct xdg_surface *xdgSurface,
+                               uint32_t serial) {
+    xdg_surface_ack_configure(xdgSurface, serial);
+  }
+
+  // A zero size leaves the size to the client.
+  static void toplevelConfigure(void *data, struct xdg_toplevel *,
+                                int32_t width, int32_t height,
+                                struct wl_array *) {
+    WaylandWindow *window = (WaylandWindow *)data;
+    if (width <= 0 || height <= 0) return;
+
+    window->width = width;
+    window->height = height;
+    window->resized = true;
+  }
+
+  static void toplevelClose(void *data, struct xdg_toplevel *) {
+    ((WaylandWindow *)data)->owner->closed = true;
+  }
+};
+
+static const struct wl_registry_listener registryListener = {
+    WaylandListeners::global, WaylandListeners::globalRemove};
+static const struct xdg_wm_base_listener wmBaseListener = {
+    WaylandListeners::ping};
+static const struct xdg_surface_listener xdgSurfaceListener = {
+    WaylandListeners::surfaceConfigure};
+// Bound at version 1, so the later toplevel events are never sent.
+static const struct xdg_toplevel_listener toplevelListener = {
+    WaylandListeners::toplevelConfigure, WaylandListeners::toplevelClose};
+
+void VulkanWindowSystem::connectWayland() {
+  display = wl_display_connect(NULL);
+  if (!display)
+    VulkanTools::exitOnError("Failed to connect to the Wayland compositor.");
+
+  registry = wl_display_get_registry(display);
+  wl_registry_add_listener(registry, &registryListener, this);
+  wl_display_roundtrip(display);
+
+  if (!compositor || !wmBase)
+    VulkanTools::exitOnError("Wayland compositor has no xdg-shell support.");
+
+  xdg_wm_base_add_listener(wmBase, &wmBaseListener, this);
+}
+
+NativeWindow VulkanWindowSystem::createWaylandWindow(uint32_t width,
+                                                     uint32_t height) {
+  waylandWindows.push_back(WaylandWindow());
+  WaylandWindow &window = waylandWindows.back();
+  window.owner = this;
+  window.index = windowCount;
+  window.width = width;
+  window.height = height;
+  window.resized = false;
+
+  window.surface = wl_compositor_create_surface(compositor);
+  window.xdgSurface = xdg_wm_base_get_xdg_surface(wmBase, window.surface);
+  xdg_surface_add_listener(window.xdgSurface, &xdgSurfaceListener, &window);
+  window.toplevel = xdg_surface_get_toplevel(window.xdgSurface);
+  xdg_toplevel_add_listener(window.toplevel, &toplevelListener, &window);
+  xdg_toplevel_set_title(window.toplevel, APPLICATION_NAME);
+  xdg_toplevel_set_app_id(window.toplevel, APPLICATION_NAME);
+
+  // Nothing may be attached to the surface before its first configure.
+  wl_surface_commit(window.surface);
+  wl_display_roundtrip(display);
+
+  NativeWindow native = {};
+  native.system = WINDOW_SYSTEM_WAYLAND;
+  native.display = display;
+  native.surface = window.surface;
+  return native;
+}
+
+bool VulkanWindowSystem::pumpWayland(const ResizeCallback &resized) {
+  // Read whatever the compositor has sent without blocking the frame.
+  while (wl_display_prepare_read(display) != 0)
+    wl_display_dispatch_pending(display);
+  wl_display_flush(display);
+
+  struct pollfd fd = {wl_display_get_fd(display), POLLIN, 0};
+  if (poll(&fd, 1, 0) > 0)
+    wl_display_read_events(display);
+  else
+    wl_display_cancel_read(display);
+
+  if (wl_display_dispatch_pending(display) < 0) closed = true;
+
+  for (uint32_t i = 0; i < waylandWindows.size(); i++) {
+    WaylandWindow &window = waylandWindows[i];
+    if (!window.resized) continue;
+
+    window.resized = false;
+    resized(window.index, window.width, window.height);
+  }
+
+  return !closed;
+}
+#endif
+
+VkResult VulkanWindowSystem::createDisplaySurface(
+    VkInstance instance, VkPhysicalDevice physicalDevice,
+    uint32_t displayIndex, VkSurfaceKHR *surface) {
+  uint32_t displayCount = 0;
+  VkResult result = vkGetPhysicalDeviceDisplayPropertiesKHR(
+      physicalDevice, &displayCount, NULL);
+  assert(result == VK_SUCCESS);
+
+  if (displayIndex >= displayCount)
+    VulkanTools::exitOnError("Failed to find a display for every window");
+
+  std::vector<VkDisplayPropertiesKHR> displays(displayCount);
+  result = vkGetPhysicalDeviceDisplayPropertiesKHR(physicalDevice,
+                                                   &displayCount,
+                                                   displays.data());
+  assert(result == VK_SUCCESS);
+  VkDisplayKHR display = displays[displayIndex].display;
+
+  // The largest mode, at its highest refresh rate, is taken as the
+  // display's native one.
+  uint32_t modeCount = 0;
+  result = vkGetDisplayModePropertiesKHR(physicalDevice, display, &modeCount,
+                                         NULL);
+  assert(result == VK_SUCCESS);
+  if (modeCount == 0)
+    VulkanTools::exitOnError("Failed to find a mode for the display");
+
+  std::vector<VkDisplayModePropertiesKHR> modes(modeCount);
+  result = vkGetDisplayModePropertiesKHR(physicalDevice, display, &modeCount,
+                                         modes.data());
+  assert(result == VK_SUCCESS);
+
+  uint32_t best = 0;
+  for (uint32_t i = 1; i < modeCount; i++) {
+    const VkDisplayModeParametersKHR &mode = modes[i].parameters;
+    const VkDisplayModeParametersKHR &current = modes[best].parameters;
+    uint64_t area = (uint64_t)mode.visibleRegion.width *
+                    mode.visibleRegion.height;
+    uint64_t bestArea = (uint64_t)current.visibleRegion.width *
+                        current.visibleRegion.height;
+
+    if (area > bestArea ||
+        (area == bestArea && mode.refreshRate > current.refreshRate))
+      best = i;
+  }
+  const VkDisplayModePropertiesKHR &mode = modes[best];
+
+  // The first plane that can scan out to the display and isn't showing
+  // another one.
+  uint32_t planeCount = 0;
+  result = vkGetPhysicalDeviceDisplayPlanePropertiesKHR(physicalDevice,
+                                                        &planeCount, NULL);
+  assert(result == VK_SUCCESS);
+
+  std::vector<VkDisplayPlanePropertiesKHR> planes(planeCount);
+  result = vkGetPhysicalDeviceDisplayPlanePropertiesKHR(
+      physicalDevice, &planeCount, planes.data());
+  assert(result == VK_SUCCESS);
+
+  uint32_t planeIndex = UINT32_MAX;
+  for (uint32_t i = 0; i < planeCount && planeIndex == UINT32_MAX; i++) {
+    if (planes[i].currentDisplay != VK_NULL_HANDLE &&
+        planes[i].currentDisplay != display)
+      continue;
+
+    uint32_t supportedCount = 0;
+    result = vkGetDisplayPlaneSupportedDisplaysKHR(physicalDevice, i,
+                                                   &supportedCount, NULL);
+    assert(result == VK_SUCCESS);
+
+    std::vector<VkDisplayKHR> supported(supportedCount);
+    result = vkGetDisplayPlaneSupportedDisplaysKHR(
+        physicalDevice, i, &supportedCount, supported.data());
+    assert(result == VK_SUCCESS);
+
+    for (uint32_t j = 0; j < supportedCount; j++)
+      if (supported[j] == display) planeIndex = i;
+  }
+
+  if (planeIndex == UINT32_MAX)
+    VulkanTools::exitOnError("Failed to find a plane for the display");
+
+  VkDisplayPlaneCapabilitiesKHR caps = {};
+  result = vkGetDisplayPlaneCapabilitiesKHR(
+      physicalDevice, mode.displayMode, planeIndex, &caps);
+  assert(result == VK_SUCCESS);
+
+  VkDisplayPlaneAlphaFlagBitsKHR alphaModes[] = {
+      VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR,
+      VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR,
+      VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR,
+      VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR};
+  VkDisplayPlaneAlphaFlagBitsKHR alphaMode = alphaModes[0];
+  const uint32_t alphaCount = sizeof(alphaModes) / sizeof(alphaModes[0]);
+  for (uint32_t i = 0; i < alphaCount; i++) {
+    if (caps.supportedAlpha & alphaModes[i]) {
+      alphaMode = alphaModes[i];
+      break;
+    }
+  }
+
+  VkDisplaySurfaceCreateInfoKHR surfaceCreateInfo = {};
+  surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR;
+  surfaceCreateInfo.pNext = NULL;
+  surfaceCreateInfo.flags = 0;
+  surfaceCreateInfo.displayMode = mode.displayMode;
+  surfaceCreateInfo.planeIndex = planeIndex;
+  surfaceCreateInfo.planeStackIndex = planes[planeIndex].currentStackIndex;
+  surfaceCreateInfo.transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  surfaceCreateInfo.globalAlpha = 1.0f;
+  surfaceCreateInfo.alphaMode = alphaMode;
+  surfaceCreateInfo.imageExtent = mode.parameters.visibleRegion;
+
+  const char *displayName = displays[displayIndex].displayName;
+  fprintf(stdout, "Display:        %s, %ux%u at %.2f Hz\n",
+          displayName ? displayName : "unnamed",
+          mode.parameters.visibleRegion.width,
+          mode.parameters.visibleRegion.height,
+          mode.parameters.refreshRate / 1000.0);
+
+  return vkCreateDisplayPlaneSurfaceKHR(instance, &surfaceCreateInfo,
+                                        vkAllocator, surface);
+}
+#endif
@@ -0,0 +1,124 @@
+#ifndef VULKAN_WINDOW_SYSTEM_HPP
+#define VULKAN_WINDOW_SYSTEM_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
+#if defined(__linux__)
+#include <xcb/xcb.h>
+#endif
+
+#include "VulkanTools.hpp"
+
+#define WINDOW_SYSTEM_ENV "VULKAN_EXAMPLE_WINDOW_SYSTEM"
+
+#if defined(__linux__)
+enum WindowSystem {
+  WINDOW_SYSTEM_XCB,
+  WINDOW_SYSTEM_WAYLAND,
+  WINDOW_SYSTEM_DISPLAY
+};
+
+// What a surface is made from: an X window, a Wayland surface, or the
+// index of a display the GPU drives directly. Only the members of its
+// window system are set.
+struct NativeWindow {
+  WindowSystem system;
+  xcb_connection_t *connection;
+  xcb_window_t window;
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+  struct wl_display *display;
+  struct wl_surface *surface;
+#endif
+  uint32_t displayIndex;
+};
+
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+class VulkanWindowSystem;
+
+// A toplevel's xdg-shell objects and the last size it was configured to,
+// which the listeners point at, so they live in a deque.
+struct WaylandWindow {
+  VulkanWindowSystem *owner;
+  uint32_t index;
+  struct wl_surface *surface;
+  struct xdg_surface *xdgSurface;
+  struct xdg_toplevel *toplevel;
+  uint32_t width;
+  uint32_t height;
+  bool resized;
+};
+#endif
+
+// The Linux window systems the example can present through. XCB is always
+// built. Wayland is added by ./configure --enable-wayland and presents
+// through xdg-shell toplevels. The display backend has no window system at
+// all: each window is a display of the GPU's, driven at its largest mode
+// through VK_KHR_display, so presentation skips the compositor. Displays
+// send no events, so that loop only ends when the process does.
+class VulkanWindowSystem {
+ public:
+  typedef std::function<void(uint32_t window, uint32_t width,
+                             uint32_t height)>
+      ResizeCallback;
+
+  VulkanWindowSystem();
+
+  static WindowSystem select(const char *name);
+  static const char *name(WindowSystem system);
+  static const char *surfaceExtension(WindowSystem system);
+  static VkResult createSurface(VkInstance instance,
+                                VkPhysicalDevice physicalDevice,
+                                const NativeWindow &window,
+                                VkSurfaceKHR *surface);
+
+  void init(WindowSystem system);
+  void destroy();
+
+  NativeWindow createWindow(uint32_t width, uint32_t height);
+  bool pumpEvents(const ResizeCallback &resized);
+
+ private:
+  WindowSystem system;
+  bool connected;
+  bool closed;
+  uint32_t windowCount;
+
+  xcb_connection_t *connection;
+  xcb_screen_t *screen;
+  xcb_atom_t wmProtocols;
+  xcb_atom_t wmDeleteWin;
+  std::vector<xcb_window_t> xcbWindows;
+
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+  struct wl_display *display;
+  struct wl_registry *registry;
+  struct wl_compositor *compositor;
+  struct xdg_wm_base *wmBase;
+  std::deque<WaylandWindow> waylandWindows;
+
+  friend struct WaylandListeners;
+#endif
+
+  void connectXcb();
+  NativeWindow createXcbWindow(uint32_t width, uint32_t height);
+  bool pumpXcb(const ResizeCallback &resized);
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+  void connectWayland();
+  NativeWindow createWaylandWindow(uint32_t width, uint32_t height);
+  bool pumpWayland(const ResizeCallback &resized);
+#endif
+  static VkResult createDisplaySurface(VkInstance instance,
+                                       VkPhysicalDevice physicalDevice,
+                                       uint32_t displayIndex,
+                                       VkSurfaceKHR *surface);
+};
+#endif
+
+#endif
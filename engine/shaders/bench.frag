@@ -0,0 +1,13 @@
+#version 450
+
+// PIPELINE_CONSTANT_ALPHA_TEST, set by the alpha-tested pipeline variant.
+layout(constant_id = 0) const bool ALPHA_TEST = false;
+
+layout(location = 0) in vec3 color;
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+  if (ALPHA_TEST && ((int(gl_FragCoord.x) ^ int(gl_FragCoord.y)) & 1) != 0)
+    discard;
+  fragColor = vec4(color, 1.0);
+}
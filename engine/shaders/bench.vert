@@ -0,0 +1,15 @@
+#version 450
+
+// One small triangle per draw for the draw-call benchmark, placed on a grid
+// by the draw's first instance so nothing needs binding.
+
+layout(location = 0) out vec3 color;
+
+void main() {
+  uint cell = uint(gl_InstanceIndex) % 4096u;
+  vec2 origin = vec2(cell % 64u, cell / 64u) / 32.0 - 1.0;
+  vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) / 32.0;
+
+  gl_Position = vec4(origin + corner, 0.5, 1.0);
+  color = vec3(origin * 0.5 + 0.5, 0.5);
+}